@@ -11,9 +11,12 @@
 #include "ScopedLock.h"
 #include "Mem.h"
 #include "Statistics.h"
+#include "IoUring.h"
+#include "Loop.h"
 #include <fcntl.h>
 #include <new>
 #include <vector>
+#include <set>
 #include <pthread.h>
 #include <atomic>
 
@@ -455,6 +458,64 @@ int BigFile::getfd ( int32_t n , bool forReading ) {
 	return -1;
 }
 
+namespace {
+struct PrefetchRange {
+	int     m_fd;
+	int64_t m_offset;
+	int64_t m_len;
+};
+
+struct PrefetchState {
+	std::vector<PrefetchRange> m_ranges;
+};
+}
+
+// posix_fadvise(WILLNEED) reads the pages in synchronously on most kernels,
+// so the advice is given from an io thread
+static void prefetchWrapper_r(void *state) {
+	const PrefetchState *ps = static_cast<const PrefetchState*>(state);
+	for (const auto &r : ps->m_ranges) {
+		(void)posix_fadvise(r.m_fd, r.m_offset, r.m_len, POSIX_FADV_WILLNEED);
+	}
+}
+
+static void prefetchDoneWrapper(void *state, job_exit_t /*exit_type*/) {
+	PrefetchState *ps = static_cast<PrefetchState*>(state);
+	mdelete(ps, sizeof(*ps), "PrefetchState");
+	delete ps;
+}
+
+// . tell the kernel [offset,offset+size) will be read soon
+// . opens the parts if needed, the advice itself is given in a thread
+// . it is only a hint, so nothing is done if we can't get a thread
+void BigFile::prefetch(int64_t offset, int64_t size) {
+	PrefetchState *ps;
+	try {
+		ps = new PrefetchState;
+	} catch(std::bad_alloc&) {
+		return;
+	}
+	mnew(ps, sizeof(*ps), "PrefetchState");
+
+	while (size > 0) {
+		int32_t part = getPartNum(offset);
+		int64_t localOffset = offset - (int64_t)part * MAX_PART_SIZE;
+		int64_t len = std::min(size, (int64_t)MAX_PART_SIZE - localOffset);
+		int fd = getfd(part, true);
+		if (fd >= 0) {
+			ps->m_ranges.push_back(PrefetchRange{fd, localOffset, len});
+		}
+		offset += len;
+		size -= len;
+	}
+
+	if (ps->m_ranges.empty() ||
+	    !g_jobScheduler.submit(prefetchWrapper_r, prefetchDoneWrapper, ps, thread_type_unspecified_io, 0)) {
+		mdelete(ps, sizeof(*ps), "PrefetchState");
+		delete ps;
+	}
+}
+
 
 // . return -2 on error
 // . return -1 if does not exist
@@ -693,8 +754,15 @@ bool BigFile::readwrite ( void         *buf      ,
 
 	fstate->m_errno       = 0;
 	fstate->m_startTime   = gettimeofdayInMilliseconds();
+	fstate->m_startTimeUs = gettimeofdayInMicroseconds();
 	fstate->m_vfd         = m_vfd;
 
+	// queue reads on the io_uring if we have one. it doesn't tie up an
+	// i/o thread per outstanding read
+	if(callback && !doWrite && g_jobScheduler.are_new_jobs_allowed() && readIoUring(fstate)) {
+		return false;
+	}
+
 	if(callback && g_jobScheduler.are_new_jobs_allowed()) {
 		// . spawn a thread to do this i/o
 		// . this returns false and sets g_errno on error, true on success
@@ -759,7 +827,7 @@ bool BigFile::readwrite ( void         *buf      ,
 		    fstate->m_bytesDone,took,rate);
 	}
 
-	Statistics::register_io_time(fstate->m_doWrite, g_errno, fstate->m_bytesDone, took);
+	Statistics::register_io_time(fstate->m_doWrite, g_errno, fstate->m_bytesDone, gettimeofdayInMicroseconds() - fstate->m_startTimeUs);
 
 	// now log our stuff here
 	if ( g_errno && g_errno != EBADENGINEER ) {
@@ -832,7 +900,7 @@ void readwriteDoneWrapper(void *state, job_exit_t exit_type) {
 		log(LOG_INFO, "disk: Read %" PRId64" bytes in %" PRId64" ms (%" PRId32"KB/s).", fstate->m_bytesDone,took,rate);
 	}
 
-	Statistics::register_io_time(fstate->m_doWrite, fstate->m_errno, fstate->m_bytesDone, took);
+	Statistics::register_io_time(fstate->m_doWrite, fstate->m_errno, fstate->m_bytesDone, gettimeofdayInMicroseconds() - fstate->m_startTimeUs);
 
 	// recall g_errno from state's m_errno
 	g_errno = fstate->m_errno;
@@ -1125,6 +1193,287 @@ static bool readwrite_r ( FileState *fstate ) {
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// io_uring reads
+//
+// . reads are queued from any thread and reaped in the main thread when Loop
+//   sees the ring's eventfd become readable, so the callbacks are called from
+//   the same context as for reads done by the i/o threads
+// . a read spanning two part files is done as two consecutive ring reads
+
+struct IoUringRead {
+	FileState     *m_fstate;
+	const BigFile *m_bigfile;
+	struct iovec   m_iov;
+	bool           m_cancelled;
+};
+
+static IoUring s_ioUring;
+static std::set<IoUringRead*> s_ioUringReads; //outstanding reads
+static GbMutex s_ioUringMtx; //protects s_ioUring and s_ioUringReads
+static __thread int s_readBatchDepth = 0;
+
+static void ioUringCompletionWrapper(int fd, void *state);
+
+
+bool BigFile::initializeIoUring(unsigned entries) {
+	ScopedLock sl(s_ioUringMtx);
+	if(!s_ioUring.init(entries)) {
+		return false;
+	}
+
+	if(!g_loop.registerReadCallback(s_ioUring.getEventFd(), NULL, ioUringCompletionWrapper, "BigFile::ioUringCompletionWrapper", 0)) {
+		log(LOG_WARN, "disk: Could not register io_uring eventfd. Using i/o threads for reads.");
+		s_ioUring.reset();
+		return false;
+	}
+
+	return true;
+}
+
+
+void BigFile::finalizeIoUring() {
+	ScopedLock sl(s_ioUringMtx);
+	if(!s_ioUring.isInitialized()) {
+		return;
+	}
+
+	g_loop.unregisterReadCallback(s_ioUring.getEventFd(), NULL, ioUringCompletionWrapper);
+	// closing the ring waits for the outstanding reads in the kernel
+	s_ioUring.reset();
+
+	for(auto r : s_ioUringReads) {
+		delete r;
+	}
+	s_ioUringReads.clear();
+}
+
+
+void BigFile::beginReadBatch() {
+	s_readBatchDepth++;
+}
+
+
+void BigFile::endReadBatch() {
+	if(--s_readBatchDepth > 0) {
+		return;
+	}
+
+	ScopedLock sl(s_ioUringMtx);
+	if(s_ioUring.isInitialized() && s_ioUring.getNumQueued() > 0 && !s_ioUring.submit()) {
+		log(LOG_WARN, "disk: io_uring submit failed: %s", mstrerror(errno));
+	}
+}
+
+
+bool BigFile::isBeingRead() const {
+	if(g_jobScheduler.is_reading_file(this)) {
+		return true;
+	}
+
+	ScopedLock sl(s_ioUringMtx);
+	for(auto r : s_ioUringReads) {
+		if(r->m_bigfile == this) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// outstanding reads can't be pulled back from the kernel, so they complete
+// as cancelled instead
+static void cancelIoUringReads(const BigFile *bf) {
+	ScopedLock sl(s_ioUringMtx);
+	for(auto r : s_ioUringReads) {
+		if(r->m_bigfile == bf) {
+			r->m_cancelled = true;
+		}
+	}
+}
+
+
+// . point the iovec at the next piece of the read and queue it
+// . s_ioUringMtx must be held
+static bool queueIoUringRead(IoUringRead *r) {
+	FileState *fstate = r->m_fstate;
+
+	int64_t offset = fstate->m_offset + fstate->m_bytesDone;
+	int32_t filenum = offset / MAX_PART_SIZE;
+	int64_t localOffset = offset % MAX_PART_SIZE;
+
+	int64_t len = fstate->m_bytesToGo - fstate->m_bytesDone;
+	if(len > MAX_PART_SIZE - localOffset) {
+		len = MAX_PART_SIZE - localOffset;
+	}
+
+	int fd = -1;
+	if(filenum == fstate->m_filenum1) {
+		fd = fstate->m_fd1;
+	} else if(filenum == fstate->m_filenum2) {
+		fd = fstate->m_fd2;
+	}
+	if(fd < 0) {
+		return false;
+	}
+
+	r->m_iov.iov_base = fstate->m_buf + fstate->m_bytesDone;
+	r->m_iov.iov_len = len;
+
+	if(!s_ioUring.queueRead(fd, &r->m_iov, localOffset, (uint64_t)(uintptr_t)r)) {
+		return false;
+	}
+
+	if(s_readBatchDepth == 0 && !s_ioUring.submit()) {
+		// stays queued and is submitted with the next read
+		log(LOG_WARN, "disk: io_uring submit failed: %s", mstrerror(errno));
+	}
+
+	return true;
+}
+
+
+bool BigFile::readIoUring(FileState *fstate) {
+	if(!s_ioUring.isInitialized()) {
+		return false;
+	}
+
+	// let the i/o thread deal with files about to be unlinked
+	if((fstate->m_filename1[0] && isPendingUnlink(fstate->m_filename1)) ||
+	   (fstate->m_filename2[0] && isPendingUnlink(fstate->m_filename2))) {
+		return false;
+	}
+
+	if(fstate->m_bytesToGo <= 0) {
+		return false;
+	}
+
+	if(!fstate->m_buf) {
+		int64_t need = fstate->m_bytesToGo + fstate->m_allocOff;
+		char *p = (char *)mmalloc(need, "ThreadReadBuf");
+		if(!p) {
+			return false;
+		}
+		fstate->m_buf       = p + fstate->m_allocOff;
+		fstate->m_allocBuf  = p;
+		fstate->m_allocSize = need;
+	}
+
+	fstate->m_fd1 = getfd(fstate->m_filenum1, true);
+	fstate->m_fd2 = getfd(fstate->m_filenum2, true);
+	if(fstate->m_fd1 < 0 || fstate->m_fd2 < 0) {
+		return false;
+	}
+
+	fstate->m_closeCount1 = getCloseCount_r(fstate->m_fd1);
+	fstate->m_closeCount2 = getCloseCount_r(fstate->m_fd2);
+
+	IoUringRead *r = new IoUringRead;
+	r->m_fstate = fstate;
+	r->m_bigfile = this;
+	r->m_cancelled = false;
+
+	ScopedLock sl(s_ioUringMtx);
+	if(!s_ioUring.isInitialized()) {
+		delete r;
+		return false;
+	}
+
+	// never have more reads outstanding than the completion queue can hold
+	if(s_ioUringReads.size() >= s_ioUring.getNumCompletionEntries() || !queueIoUringRead(r)) {
+		delete r;
+		return false;
+	}
+
+	s_ioUringReads.insert(r);
+	return true;
+}
+
+
+static void ioUringCompletionWrapper(int /*fd*/, void * /*state*/) {
+	std::vector<std::pair<IoUringRead*,int32_t>> completed;
+	{
+		ScopedLock sl(s_ioUringMtx);
+		if(!s_ioUring.isInitialized()) {
+			return;
+		}
+
+		s_ioUring.clearEvent();
+
+		uint64_t userData;
+		int32_t res;
+		while(s_ioUring.getCompletion(&userData, &res)) {
+			completed.push_back(std::make_pair((IoUringRead *)(uintptr_t)userData, res));
+		}
+
+		// hand over anything left queued by a failed submit
+		if(s_ioUring.getNumQueued() > 0 && !s_ioUring.submit()) {
+			log(LOG_WARN, "disk: io_uring submit failed: %s", mstrerror(errno));
+		}
+	}
+
+	for(auto &c : completed) {
+		IoUringRead *r = c.first;
+		int32_t res = c.second;
+		FileState *fstate = r->m_fstate;
+
+		bool cancelled = r->m_cancelled;
+		bool done = true;
+
+		if(cancelled) {
+			// nothing
+		} else if(res < 0) {
+			fstate->m_errno = -res;
+			log(LOG_ERROR, "disk: io_uring read error: %s", mstrerror(-res));
+		} else if(res == 0) {
+			log(LOG_WARN, "disk: Read of %" PRId64" bytes at offset %" PRId64" failed because file is too short for that "
+			    "offset? fd1=%i fd2=%i", fstate->m_bytesToGo - fstate->m_bytesDone, fstate->m_offset + fstate->m_bytesDone,
+			    fstate->m_fd1, fstate->m_fd2);
+			fstate->m_errno = EBADENGINEER;
+		} else {
+			fstate->m_bytesDone += res;
+			if(fstate->m_bytesDone < fstate->m_bytesToGo) {
+				// short read or the next part file
+				ScopedLock sl(s_ioUringMtx);
+				if(queueIoUringRead(r)) {
+					done = false;
+				}
+			}
+
+			if(done && fstate->m_bytesDone < fstate->m_bytesToGo) {
+				// ring full. finish the read blocking
+				errno = 0;
+				if(!readwrite_r(fstate)) {
+					fstate->m_errno = errno;
+				}
+			}
+		}
+
+		if(!done) {
+			continue;
+		}
+
+		{
+			ScopedLock sl(s_ioUringMtx);
+			s_ioUringReads.erase(r);
+		}
+		delete r;
+
+		// same check as readwriteWrapper_r(). fd may have been closed and
+		// re-opened for another file
+		if(!cancelled && !fstate->m_errno &&
+		   (getCloseCount_r(fstate->m_fd1) != fstate->m_closeCount1 ||
+		    getCloseCount_r(fstate->m_fd2) != fstate->m_closeCount2)) {
+			fstate->m_errno = EFILECLOSED;
+		}
+
+		fstate->m_doneTime = gettimeofdayInMilliseconds();
+
+		readwriteDoneWrapper(fstate, cancelled ? job_exit_cancelled : job_exit_normal);
+	}
+}
+
+
 bool BigFile::unlink() {
 	logTrace( g_conf.m_logTraceBigFile, "BEGIN. filename [%s]", getFilename());
 	
@@ -1149,6 +1498,7 @@ bool BigFile::unlink() {
 	// remove all queued threads that point to us that have not
 	// yet been launched
 	g_jobScheduler.cancel_file_read_jobs(this);
+	cancelIoUringReads(this);
 	
 	bool anyErrors = false;
 	for(int32_t i = 0; i < m_maxParts; i++) {
@@ -1418,6 +1768,7 @@ bool BigFile::unlink(int32_t part, void (*callback)(void *state), void *state) {
 		// remove all queued threads that point to us that have not
 		// yet been launched
 		g_jobScheduler.cancel_file_read_jobs(this);
+		cancelIoUringReads(this);
 	}
 
 	// save callback for when all parts are unlinked
@@ -1824,7 +2175,7 @@ void BigFile::unlinkWrapper(File *f) {
 	//100ms, break after 5 seconds because then it is highly unlikely that
 	//any unfinished job refers to that area/file anymore.
 	for(int i=0; i<50; i++) {
-		if(!g_jobScheduler.is_reading_file(this))
+		if(!isBeingRead())
 			break;
 		usleep(100000); //sleep 100ms
 	}
@@ -1964,5 +2315,6 @@ bool BigFile::close ( ) {
 	// remove all queued threads that point to us that have not
 	// yet been launched
 	g_jobScheduler.cancel_file_read_jobs(this);
+	cancelIoUringReads(this);
 	return true;
 }
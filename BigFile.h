@@ -62,6 +62,8 @@ public:
 	// when we started for graphing purposes (in milliseconds)
 	int64_t       m_startTime;
 	int64_t       m_doneTime;
+	// same in microseconds for the latency histograms
+	int64_t       m_startTimeUs;
 
 	// it is
 	// a "virtual fd" for this whole file
@@ -104,6 +106,7 @@ public:
 		m_errno = 0;
 		m_startTime = 0;
 		m_doneTime = 0;
+		m_startTimeUs = 0;
 		m_vfd = 0;
 		m_closeCount1 = 0;
 		m_closeCount2 = 0;
@@ -206,6 +209,11 @@ class BigFile {
 	// which part (little File) of this BigFile has offset "offset"?
 	int getPartNum(int64_t offset) const { return offset / MAX_PART_SIZE; }
 
+	// . tell the kernel [offset,offset+size) will be read soon so it can
+	//   start reading it in the background
+	// . does not wait for the disk
+	void prefetch(int64_t offset, int64_t size);
+
 	// . opens the nth file if necessary to get its fd
 	// . returns -1 if none, >=0 on success
 	int getfd ( int32_t n , bool forReading );//, int32_t *vfd = NULL );
@@ -260,6 +268,10 @@ private:
 			 int32_t        niceness ,
 			 int32_t        allocOff       );
 
+	// . queue a non-blocking read on the io_uring
+	// . returns false if the read must go to the i/o threads instead
+	bool readIoUring(FileState *fstate);
+
 	// . returns false if blocked, true otherwise
 	// . sets g_errno on error
 	bool rename(const char *newBaseFilename,
@@ -334,6 +346,20 @@ public:
 
 	static bool anyOngoingUnlinksOrRenames();
 
+	// . io_uring backend for non-blocking reads. reads go to the i/o threads
+	//   if it isn't initialized (or not supported by the kernel) or is full
+	// . must be called after Loop::init()
+	static bool initializeIoUring(unsigned entries);
+	static void finalizeIoUring();
+
+	// . reads issued between beginReadBatch() and endReadBatch() are handed
+	//   to the kernel together with a single syscall. Calls may nest
+	static void beginReadBatch();
+	static void endReadBatch();
+
+	// is an i/o thread or io_uring reading from this file?
+	bool isBeingRead() const;
+
 	bool reset ( );
 
 	int32_t getMaxParts() const { return m_maxParts; }
@@ -52,6 +52,8 @@ Conf::Conf ( ) {
 	memset(m_dnsPorts, 0, sizeof(m_dnsPorts));
 	m_dnsCacheMaxAge = 0;
 	m_dnsCacheSize = 0;
+	m_dnsNegativeCacheMaxAge = 0;
+	m_dnsMaxPrefetches = 0;
 	m_dnsMaxCacheMem = 0;
 	m_askRootNameservers = false;
 	m_numRns = 0;
@@ -61,7 +63,9 @@ Conf::Conf ( ) {
 	m_maxOutstandingUrlClassifications = 0;
 	m_urlClassificationTimeout = 0;
 	m_mergeBufSize = 0;
+	m_mergeParallelRanges = 1;
 	m_doledbNukeInterval = 86400;
+	m_waitingTreeRebuildInterval = 86400;
 	m_posdbMaxLostPositivesPercentage = 0;
 	m_posdbFileCacheSize = 0;
 	m_posdbMaxTreeMem = 0;
@@ -87,7 +91,13 @@ Conf::Conf ( ) {
 	m_maxCpuThreads = 0;
 	m_maxIOThreads = 0;
 	m_maxExternalThreads = 0;
+	m_jobWorkStealing = false;
+	m_jobWorkStealingMaxNiceness = 0;
 	m_maxJobCleanupTime = 0;
+	m_useEpoll = true;
+	m_useIoUring = true;
+	m_ioUringQueueDepth = 256;
+	m_readPrefetchMinSize = 0;
 	m_vagusClusterId[0] = '\0';
 	m_vagusPort = 8720;
 	m_vagusKeepaliveSendInterval = 500;
@@ -95,10 +105,19 @@ Conf::Conf ( ) {
 	m_vagusMaxDeadTime = 5;
 	m_maxDocsWanted = 0;
 	m_maxFirstResultNum = 0;
+	m_streamResultsMinDocs = 0;
 	min_docid_splits = 0;
 	max_docid_splits = 0;
 	m_msg40_msg39_timeout = 0;
 	m_msg3a_msg39_network_overhead = 0;
+	m_parallelQueryIntersection = false;
+	m_maxParallelIntersectionUnits = 0;
+	m_useDocIdIntersectKernel = true;
+	m_useBlockMaxScoring = true;
+	m_useQueryResultCache = true;
+	m_queryResultCacheMaxAge = 0;
+	m_queryResultCacheMaxMem = 0;
+	m_queryTraceSampleRate = 0;
 	m_useHighFrequencyTermCache = false;
 	m_spideringEnabled = false;
 	m_injectionsEnabled = false;
@@ -108,15 +127,25 @@ Conf::Conf ( ) {
 	m_spiderAdultContent = true;
 	m_addUrlEnabled = false;
 	m_doStripeBalancing = false;
+	m_multicastAdaptiveSelection = true;
+	m_multicastHedging = false;
+	m_multicastHedgeMinDelay = 5;
 	m_isLive = false;
 	m_maxTotalSpiders = 0;
+	m_maxParsingSpiders = 0;
 	m_spiderUrlCacheMaxAge = 0;
 	m_spiderUrlCacheSize = 0;
+	m_robotsCacheMaxAge = 0;
+	m_robotsCacheSize = 0;
 	m_indexdbMaxIndexListAge = 0;
 	m_udpMaxSockets = 0;
+	m_udpBatchIo = true;
 	m_httpMaxSockets = 0;
 	m_httpsMaxSockets = 0;
 	m_httpMaxSendBufSize = 0;
+	m_httpCompression = true;
+	m_httpCompressionLevel = 6;
+	m_httpCompressionMinSize = 1024;
 	m_docSummaryWithDescriptionMaxCacheAge = 0;
 	m_sliderParm = 0;
 	m_termFreqWeightFreqMin = 0.0;
@@ -157,6 +186,7 @@ Conf::Conf ( ) {
 	m_verifyTreeIntegrity = false;
 	m_verifyDumpedLists = false;
 	m_verifyIndex = false;
+	m_mmapMapAndIndexFiles = true;
 	m_flushWrites = false;
 	m_verifyWrites = false;
 	m_corruptRetries = 0;
@@ -283,6 +313,8 @@ Conf::Conf ( ) {
 	memset(m_redirect, 0, sizeof(m_redirect));
 	m_useCompressionProxy = false;
 	m_gzipDownloads = false;
+	m_titleRecDictCompression = false;
+	m_titleRecZstdCompression = false;
 	m_useTmpCluster = false;
 	m_allowScale = true;
 	m_bypassValidation = false;
@@ -86,6 +86,8 @@ class Conf {
 
 	int64_t m_dnsCacheSize;
 	int64_t m_dnsCacheMaxAge;
+	int64_t m_dnsNegativeCacheMaxAge;
+	int32_t m_dnsMaxPrefetches;
 
 	int32_t  m_dnsMaxCacheMem;
 
@@ -104,8 +106,10 @@ class Conf {
 	
 	// used to limit all rdb's to one merge per machine at a time
 	int32_t  m_mergeBufSize;
+	int32_t  m_mergeParallelRanges;
 
 	int32_t m_doledbNukeInterval;
+	int32_t m_waitingTreeRebuildInterval;
 	
 	// rdb settings
 
@@ -155,9 +159,17 @@ class Conf {
 	int32_t  m_maxExternalThreads;
 	int32_t  m_maxFileMetaThreads;
 	int32_t  m_maxMergeThreads;
+	bool     m_jobWorkStealing; //let idle cpu/summary threads run each others' jobs. Only read at startup
+	int32_t  m_jobWorkStealingMaxNiceness;
 
 	int32_t  m_maxJobCleanupTime;
 
+	bool     m_useEpoll; //use epoll instead of select() in Loop. Only read at startup
+
+	bool     m_useIoUring; //use io_uring for non-blocking file reads. Only read at startup
+	int32_t  m_ioUringQueueDepth;
+	int32_t  m_readPrefetchMinSize;
+
 	char    m_vagusClusterId[128];
 	int32_t m_vagusPort;
 	int32_t m_vagusKeepaliveSendInterval; //milliseconds
@@ -166,12 +178,22 @@ class Conf {
 	
 	int32_t m_maxDocsWanted;        //maximum number of results in one go. Puts a limit on SearchInput::m_docsWanted
 	int32_t m_maxFirstResultNum;    //maximum document offset / result-page. Puts a limit on SearchInput::m_firstResultNum
+	int32_t m_streamResultsMinDocs; //json/xml requests for this many results or more are streamed. 0=never
 
 	int32_t  min_docid_splits; //minimum number of DocId splits using Msg40
 	int32_t  max_docid_splits; //maximum number of DocId splits using Msg40
 	int64_t  m_msg40_msg39_timeout; //timeout for entire get-docid-list phase, in milliseconds.
 	int64_t  m_msg3a_msg39_network_overhead; //additional latency/overhead of sending reqeust+response over network.
 
+	bool     m_parallelQueryIntersection;     //intersect posdb files/docid ranges concurrently in Msg39
+	int32_t  m_maxParallelIntersectionUnits;  //max number of file/docid-range units in flight per query
+	bool     m_useDocIdIntersectKernel;       //use the galloping/SIMD kernel for docid vote intersection
+	bool     m_useBlockMaxScoring;            //skip blocks of candidate docids whose max possible score can't win
+	bool     m_useQueryResultCache;           //cache the merged docids of queries in Msg3a
+	int32_t  m_queryResultCacheMaxAge;        //max age of cached query results, in seconds
+	int32_t  m_queryResultCacheMaxMem;        //memory for the query result cache, in bytes
+	int32_t  m_queryTraceSampleRate;          //trace the latency breakdown of every Nth query (0=never)
+
 	bool	m_useHighFrequencyTermCache;
 
 	bool  m_spideringEnabled;
@@ -184,27 +206,45 @@ class Conf {
 	bool  m_addUrlEnabled; // TODO: use at http interface level
 	bool  m_doStripeBalancing;
 
+	// prefer the twin with the lowest recent reply time and job queue
+	bool    m_multicastAdaptiveSelection;
+	// . resend a read request to another twin if the reply is slower than
+	//   the 95th percentile and take the first reply
+	// . the hedge delay is never below m_multicastHedgeMinDelay ms
+	bool    m_multicastHedging;
+	int32_t m_multicastHedgeMinDelay;
+
 	// . true if the server is on the production cluster
 	// . we enforce the 'elvtune -w 32 /dev/sd?' cmd on all drives because
 	//   that yields higher performance when dumping/merging on disk
 	bool  m_isLive;
 
 	int32_t  m_maxTotalSpiders;
+	// . how many of the downloaded docs may be parsed and indexed at
+	//   once. the others wait with just their reply in memory
+	int32_t  m_maxParsingSpiders;
 
 	int32_t m_spiderDeadHostCheckInterval;
 
 	int64_t m_spiderUrlCacheMaxAge;
 	int64_t m_spiderUrlCacheSize;
 
+	int64_t m_robotsCacheMaxAge;
+	int64_t m_robotsCacheSize;
+
 	// indexdb has a max cached age for getting IndexLists (10 mins deflt)
 	int32_t  m_indexdbMaxIndexListAge;
 
 	int32_t m_udpMaxSockets;
+	bool    m_udpBatchIo; //send/receive several dgrams per system call
 
 	// TODO: parse these out!!!!
 	int32_t  m_httpMaxSockets;
 	int32_t  m_httpsMaxSockets;
 	int32_t  m_httpMaxSendBufSize;
+	bool     m_httpCompression;        //gzip/brotli compress replies to clients that accept it
+	int32_t  m_httpCompressionLevel;   //1-9, for dynamic replies
+	int32_t  m_httpCompressionMinSize; //smaller replies are sent uncompressed
 
 	// a search results cache (for Msg40)
 	int64_t m_docSummaryWithDescriptionMaxCacheAge; //cache timeout for document summaries for documents with a meta-tag with description, in milliseconds
@@ -270,6 +310,9 @@ class Conf {
 	// verify validity of index while merging
 	bool m_verifyIndex;
 
+	// use map and index files in place with mmap instead of reading them into memory
+	bool m_mmapMapAndIndexFiles;
+
 	// calls fsync(fd) if true after each write
 	bool   m_flushWrites; 
 	bool   m_verifyWrites;
@@ -445,6 +488,8 @@ class Conf {
 	char m_redirect[MAX_URL_LEN];
 	bool m_useCompressionProxy;
 	bool m_gzipDownloads;
+	bool m_titleRecDictCompression;   //compress titlerecs with the collection's titlerec.dict
+	bool m_titleRecZstdCompression;   //compress titlerecs with zstd instead of zlib
 
 	// used by proxy to make proxy point to the temp cluster while
 	// the original cluster is updated
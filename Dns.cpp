@@ -167,7 +167,8 @@ bool Dns::init ( uint16_t clientPort ) {
 				 "dns"         ,  // dbname
 				 true,            // save cache to disk?
 				 12,              //cachekeysize
-				 -1            )) { // numPtrsMax
+				 -1,              // numPtrsMax
+				 8             )) { // numShards
 		log( LOG_ERROR, "dns: Cache init failed." );
 		return false;
 	}
@@ -2296,7 +2297,7 @@ bool Dns::isInCache ( key96_t key , int32_t *ip ) {
 	char *rec;
 	int32_t  recSize;
 	// return false if not in cache
-	RdbCacheLock rcl(m_rdbCache);
+	RdbCacheLock rcl(m_rdbCache,(const char *)&key);
 	if ( ! m_rdbCache.getRecord ( (collnum_t)0 ,
 				      key      , 
 				      &rec     ,
@@ -2342,7 +2343,7 @@ void Dns::addToCache ( key96_t hostnameKey , int32_t ip , int32_t ttl ) {
 		c = &m_rdbCache;
 
  	// just add a record to the cache
-	RdbCacheLock rcl(*c);
+	RdbCacheLock rcl(*c,(const char *)&hostnameKey);
 	c->addRecord((collnum_t)0,hostnameKey,(char *)&ip,4,
 		     timestamp);//rec size
 	// reset g_errno in case it had an error (we don't care)
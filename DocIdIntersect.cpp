@@ -0,0 +1,227 @@
+#include "DocIdIntersect.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DOCIDINTERSECT_X86
+#endif
+
+
+//when one array is this many times larger than the other we gallop through it
+static const size_t s_gallopingRatio = 64;
+
+
+void DocIdIntersect::decodeVoteBuf(const char *voteBuf, int32_t voteBufLen, std::vector<uint64_t> *keys) {
+	keys->clear();
+	keys->reserve(voteBufLen/6);
+	for(const char *p = voteBuf; p < voteBuf+voteBufLen; p += 6)
+		keys->push_back(getVoteRecKey(p));
+}
+
+
+void DocIdIntersect::decodeSubList(const char *subList, const char *subListEnd, std::vector<uint64_t> *keys, std::vector<uint32_t> *offsets) {
+	keys->clear();
+	offsets->clear();
+	const char *p = subList;
+	while(p < subListEnd) {
+		keys->push_back(getPosdbRecKey(p));
+		offsets->push_back((uint32_t)(p-subList));
+		// skip the 12-byte head and the 6-byte keys sharing its docid
+		p += 12;
+		while(p < subListEnd && (*p & 0x04))
+			p += 6;
+	}
+}
+
+
+size_t DocIdIntersect::intersectScalar(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	size_t i = 0, j = 0, n = 0;
+	while(i < na && j < nb) {
+		if(a[i] < b[j])
+			i++;
+		else if(a[i] > b[j])
+			j++;
+		else {
+			matchA[n] = i;
+			matchB[n] = j;
+			n++;
+			i++;
+			j++;
+		}
+	}
+	return n;
+}
+
+
+//for each element in "a" do an exponential search followed by a binary search in "b"
+size_t DocIdIntersect::intersectGalloping(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	size_t j = 0, n = 0;
+	for(size_t i = 0; i < na && j < nb; i++) {
+		const uint64_t v = a[i];
+		if(b[j] < v) {
+			size_t bound = 1;
+			while(j+bound < nb && b[j+bound] < v)
+				bound <<= 1;
+			const uint64_t *lo = b + j + bound/2 + 1;
+			const uint64_t *hi = b + std::min(j+bound+1, nb);
+			j = std::lower_bound(lo, hi, v) - b;
+			if(j >= nb)
+				break;
+		}
+		if(b[j] == v) {
+			matchA[n] = i;
+			matchB[n] = j;
+			n++;
+			j++;
+		}
+	}
+	return n;
+}
+
+
+#ifdef DOCIDINTERSECT_X86
+
+//Compare each a[i] against blocks of 4 b[] elements. "b" is advanced a block at
+//a time so the cost is roughly na + nb/4 compares. Like the scalar kernel a b[]
+//element is matched at most once so duplicate docids pair up the same way.
+__attribute__((target("sse4.2")))
+size_t DocIdIntersect::intersectSSE42(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	size_t i = 0, j = 0, n = 0;
+	size_t nextB = 0; //lowest b index that may still be matched
+	while(i < na && j+4 <= nb) {
+		const __m128i vb0 = _mm_loadu_si128((const __m128i*)(b+j));
+		const __m128i vb1 = _mm_loadu_si128((const __m128i*)(b+j+2));
+		const uint64_t blockMax = b[j+3];
+		// a docid equal to the last element of the block can only match here
+		// if that element wasn't already taken by the previous a[] entry
+		while(i < na && (a[i] < blockMax || (a[i] == blockMax && nextB <= j+3))) {
+			const __m128i va = _mm_set1_epi64x((long long)a[i]);
+			int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(va, vb0)))
+			         | (_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(va, vb1))) << 2);
+			if(nextB > j)
+				mask &= ~((1 << (nextB-j)) - 1);
+			if(mask) {
+				matchA[n] = i;
+				matchB[n] = j + __builtin_ctz(mask);
+				nextB = matchB[n] + 1;
+				n++;
+			}
+			i++;
+		}
+		j += 4;
+	}
+	// tail
+	if(i < na && j < nb) {
+		size_t m = intersectScalar(a+i, na-i, b+j, nb-j, matchA+n, matchB+n);
+		for(size_t k = n; k < n+m; k++) {
+			matchA[k] += i;
+			matchB[k] += j;
+		}
+		n += m;
+	}
+	return n;
+}
+
+
+__attribute__((target("avx2")))
+size_t DocIdIntersect::intersectAVX2(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	size_t i = 0, j = 0, n = 0;
+	size_t nextB = 0; //lowest b index that may still be matched
+	while(i < na && j+4 <= nb) {
+		const __m256i vb = _mm256_loadu_si256((const __m256i*)(b+j));
+		const uint64_t blockMax = b[j+3];
+		// a docid equal to the last element of the block can only match here
+		// if that element wasn't already taken by the previous a[] entry
+		while(i < na && (a[i] < blockMax || (a[i] == blockMax && nextB <= j+3))) {
+			const __m256i va = _mm256_set1_epi64x((long long)a[i]);
+			int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb)));
+			if(nextB > j)
+				mask &= ~((1 << (nextB-j)) - 1);
+			if(mask) {
+				matchA[n] = i;
+				matchB[n] = j + __builtin_ctz(mask);
+				nextB = matchB[n] + 1;
+				n++;
+			}
+			i++;
+		}
+		j += 4;
+	}
+	// tail
+	if(i < na && j < nb) {
+		size_t m = intersectScalar(a+i, na-i, b+j, nb-j, matchA+n, matchB+n);
+		for(size_t k = n; k < n+m; k++) {
+			matchA[k] += i;
+			matchB[k] += j;
+		}
+		n += m;
+	}
+	return n;
+}
+
+#else
+
+size_t DocIdIntersect::intersectSSE42(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	return intersectScalar(a, na, b, nb, matchA, matchB);
+}
+
+size_t DocIdIntersect::intersectAVX2(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	return intersectScalar(a, na, b, nb, matchA, matchB);
+}
+
+#endif
+
+
+namespace {
+
+struct BlockKernel {
+	DocIdIntersect::intersect_fn_t fn;
+	const char *name;
+	BlockKernel() {
+		fn = &DocIdIntersect::intersectScalar;
+		name = "scalar";
+#ifdef DOCIDINTERSECT_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) {
+			fn = &DocIdIntersect::intersectAVX2;
+			name = "avx2";
+		} else if(__builtin_cpu_supports("sse4.2")) {
+			fn = &DocIdIntersect::intersectSSE42;
+			name = "sse4.2";
+		}
+#endif
+	}
+};
+
+static const BlockKernel &getBlockKernelInstance() {
+	static const BlockKernel s_blockKernel;
+	return s_blockKernel;
+}
+
+} //anonymous namespace
+
+
+DocIdIntersect::intersect_fn_t DocIdIntersect::getBlockKernel() {
+	return getBlockKernelInstance().fn;
+}
+
+
+const char *DocIdIntersect::getBlockKernelName() {
+	return getBlockKernelInstance().name;
+}
+
+
+size_t DocIdIntersect::intersect(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB) {
+	if(na == 0 || nb == 0)
+		return 0;
+
+	// the kernels work best when walking the smaller array element by
+	// element and the larger one in blocks or gallops
+	if(na > nb)
+		return intersect(b, nb, a, na, matchB, matchA);
+
+	if(nb / na >= s_gallopingRatio)
+		return intersectGalloping(a, na, b, nb, matchA, matchB);
+
+	return getBlockKernel()(a, na, b, nb, matchA, matchB);
+}
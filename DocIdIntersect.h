@@ -0,0 +1,53 @@
+#ifndef GB_DOCIDINTERSECT_H_
+#define GB_DOCIDINTERSECT_H_
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <vector>
+
+//Docid intersection kernels used by PosdbTable when building the docid vote
+//buffer. Docids are compared as 40-bit keys: the 4 high bytes of the docid
+//(bytes 8-11 of a 12-byte posdb key) shifted up by 8 and the low docid bits
+//(byte 7 & 0xfc). Both the 6-byte m_docIdVoteBuf entries and the 12-byte
+//sublist heads can be decoded into that form and intersected as plain sorted
+//uint64_t arrays.
+namespace DocIdIntersect {
+
+//docid key of a 12-byte posdb record (as found in mangled sublists)
+static inline uint64_t getPosdbRecKey(const char *rec) {
+	return ((uint64_t)(*(const uint32_t *)(rec+8)) << 8) | (*(const unsigned char *)(rec+7) & 0xfc);
+}
+
+//docid key of a 6-byte docid vote buffer entry
+static inline uint64_t getVoteRecKey(const char *rec) {
+	return ((uint64_t)(*(const uint32_t *)(rec+1)) << 8) | *(const unsigned char *)rec;
+}
+
+//decode the docid keys of a 6-byte-per-entry docid vote buffer
+void decodeVoteBuf(const char *voteBuf, int32_t voteBufLen, std::vector<uint64_t> *keys);
+
+//decode the docid keys of the 12-byte heads of a mangled posdb sublist (12-byte
+//key followed by 6-byte keys of the same docid) plus the byte offset of each head
+void decodeSubList(const char *subList, const char *subListEnd, std::vector<uint64_t> *keys, std::vector<uint32_t> *offsets);
+
+typedef size_t (*intersect_fn_t)(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB);
+
+//The individual kernels. "a" and "b" must be sorted ascending. For every docid
+//found in both arrays the index into "a" and "b" is stored in matchA/matchB
+//(which must have room for min(na,nb) entries). Returns the number of matches.
+size_t intersectScalar(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB);
+size_t intersectGalloping(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB);
+size_t intersectSSE42(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB);
+size_t intersectAVX2(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB);
+
+//the block kernel chosen for this cpu at runtime (avx2, sse4.2 or scalar)
+intersect_fn_t getBlockKernel();
+const char *getBlockKernelName();
+
+//Intersect using galloping when the arrays are very different in size and the
+//best block kernel for this cpu otherwise.
+size_t intersect(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint32_t *matchA, uint32_t *matchB);
+
+} //namespace DocIdIntersect
+
+#endif // GB_DOCIDINTERSECT_H_
@@ -1,7 +1,12 @@
 #include "GbCompress.h"
 #include "Mem.h"
 #include "Log.h"
+#include <zstd.h>
+#include <zstd_errors.h>
 #include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 
 static void *malloc_replace(void *, unsigned int nitems, unsigned int size) {
@@ -85,3 +90,305 @@ int gbcompress(unsigned char *dest, uint32_t *destLen,
 	err = deflateEnd(&stream);
 	return err;
 }
+
+
+int gbuncompress(unsigned char *dest, uint32_t *destLen,
+		 const unsigned char *source, uint32_t sourceLen,
+		 const unsigned char *dict, uint32_t dictLen)
+{
+	z_stream stream;
+	memset(&stream,0,sizeof(stream));
+	stream.next_in = (Bytef*)source;
+	stream.avail_in = (uInt)sourceLen;
+	stream.next_out = dest;
+	stream.avail_out = (uInt)*destLen;
+	stream.zalloc = malloc_replace;
+	stream.zfree  = free_replace;
+
+	//preset dictionaries only exist in the zlib format
+	int err = inflateInit(&stream);
+
+	if(err != Z_OK)
+		return err;
+
+	err = inflate(&stream, Z_FINISH);
+	if(err == Z_NEED_DICT) {
+		if(!dict || stream.adler != gbdictid(dict, dictLen)) {
+			inflateEnd(&stream);
+			return Z_NEED_DICT;
+		}
+		err = inflateSetDictionary(&stream, dict, dictLen);
+		if(err == Z_OK)
+			err = inflate(&stream, Z_FINISH);
+	}
+	if(err != Z_STREAM_END) {
+		inflateEnd(&stream);
+		if (err == Z_NEED_DICT ||
+		    (err == Z_BUF_ERROR && stream.avail_in == 0))
+			return Z_DATA_ERROR;
+		return err;
+	}
+	*destLen = stream.total_out;
+
+	err = inflateEnd(&stream);
+	return err;
+}
+
+
+int gbcompress(unsigned char *dest, uint32_t *destLen,
+	       const unsigned char *source, uint32_t sourceLen,
+	       const unsigned char *dict, uint32_t dictLen)
+{
+	z_stream stream;
+	memset(&stream,0,sizeof(stream));
+	stream.next_in = (Bytef*)source;
+	stream.avail_in = (uInt)sourceLen;
+	stream.next_out = dest;
+	stream.avail_out = (uInt)*destLen;
+	stream.zalloc = malloc_replace;
+	stream.zfree  = free_replace;
+
+	stream.opaque = (voidpf)0;
+
+	int err = deflateInit (&stream, Z_DEFAULT_COMPRESSION);
+	if(err != Z_OK)
+		return err;
+
+	if(dict && dictLen > 0) {
+		err = deflateSetDictionary(&stream, dict, dictLen);
+		if(err != Z_OK) {
+			deflateEnd(&stream);
+			return err;
+		}
+	}
+
+	err = deflate(&stream, Z_FINISH);
+
+	if(err != Z_STREAM_END) {
+		deflateEnd(&stream);
+		return err == Z_OK ? Z_BUF_ERROR : err;
+	}
+	*destLen = stream.total_out;
+
+	err = deflateEnd(&stream);
+	return err;
+}
+
+
+// zstd's default level. faster than zlib's default and compresses better
+static const int s_zstdLevel = 3;
+
+namespace {
+// zstd contexts are expensive to make and not thread safe, so each thread
+// keeps its own
+struct ZstdContexts {
+	ZstdContexts() : m_cctx(NULL), m_dctx(NULL) {}
+	~ZstdContexts() {
+		ZSTD_freeCCtx(m_cctx);
+		ZSTD_freeDCtx(m_dctx);
+	}
+	ZSTD_CCtx *m_cctx;
+	ZSTD_DCtx *m_dctx;
+};
+}
+
+static thread_local ZstdContexts s_zstdContexts;
+
+
+static int getZstdError(size_t rc) {
+	if(ZSTD_getErrorCode(rc) == ZSTD_error_dstSize_tooSmall)
+		return Z_BUF_ERROR;
+	if(ZSTD_getErrorCode(rc) == ZSTD_error_memory_allocation)
+		return Z_MEM_ERROR;
+	return Z_DATA_ERROR;
+}
+
+
+GbZstdDict::GbZstdDict(const unsigned char *dict, uint32_t dictLen)
+  : m_cdict(ZSTD_createCDict(dict, dictLen, s_zstdLevel)),
+    m_ddict(ZSTD_createDDict(dict, dictLen))
+{
+	if(!isValid())
+		log(LOG_WARN, "zstd: Could not create dictionary of %" PRIu32" bytes", dictLen);
+}
+
+
+GbZstdDict::~GbZstdDict() {
+	ZSTD_freeCDict(m_cdict);
+	ZSTD_freeDDict(m_ddict);
+}
+
+
+int gbzstduncompress(unsigned char *dest, uint32_t *destLen,
+		     const unsigned char *source, uint32_t sourceLen,
+		     const GbZstdDict *dict)
+{
+	if(dict && !dict->isValid())
+		return Z_MEM_ERROR;
+
+	ZstdContexts &ctx = s_zstdContexts;
+	if(!ctx.m_dctx) {
+		ctx.m_dctx = ZSTD_createDCtx();
+		if(!ctx.m_dctx)
+			return Z_MEM_ERROR;
+	}
+
+	size_t rc;
+	if(dict)
+		rc = ZSTD_decompress_usingDDict(ctx.m_dctx, dest, *destLen, source, sourceLen, dict->m_ddict);
+	else
+		rc = ZSTD_decompressDCtx(ctx.m_dctx, dest, *destLen, source, sourceLen);
+	if(ZSTD_isError(rc))
+		return getZstdError(rc);
+
+	*destLen = rc;
+	return Z_OK;
+}
+
+
+int gbzstdcompress(unsigned char *dest, uint32_t *destLen,
+		   const unsigned char *source, uint32_t sourceLen,
+		   const GbZstdDict *dict)
+{
+	if(dict && !dict->isValid())
+		return Z_MEM_ERROR;
+
+	ZstdContexts &ctx = s_zstdContexts;
+	if(!ctx.m_cctx) {
+		ctx.m_cctx = ZSTD_createCCtx();
+		if(!ctx.m_cctx)
+			return Z_MEM_ERROR;
+	}
+
+	size_t rc;
+	if(dict)
+		rc = ZSTD_compress_usingCDict(ctx.m_cctx, dest, *destLen, source, sourceLen, dict->m_cdict);
+	else
+		rc = ZSTD_compressCCtx(ctx.m_cctx, dest, *destLen, source, sourceLen, s_zstdLevel);
+	if(ZSTD_isError(rc))
+		return getZstdError(rc);
+
+	*destLen = rc;
+	return Z_OK;
+}
+
+
+uint32_t gbzstdcompressbound(uint32_t sourceLen) {
+	return ZSTD_compressBound(sourceLen);
+}
+
+
+uint32_t gbdictid(const unsigned char *dict, uint32_t dictLen) {
+	return (uint32_t)adler32(adler32(0L, Z_NULL, 0), dict, dictLen);
+}
+
+
+uint32_t gbgetdictid(const unsigned char *source, uint32_t sourceLen) {
+	// zlib header is CMF, FLG and then DICTID (big endian) if FLG.FDICT is set
+	if(sourceLen < 6)
+		return 0;
+	if((source[0] & 0x0f) != Z_DEFLATED)
+		return 0;
+	if((source[0]*256 + source[1]) % 31 != 0)
+		return 0;
+	if(!(source[1] & 0x20))
+		return 0;
+	return ((uint32_t)source[2] << 24) | ((uint32_t)source[3] << 16) | ((uint32_t)source[4] << 8) | source[5];
+}
+
+
+//the dictionary is made of segments of this many bytes, scored by the document
+//frequency of the grams in them
+static const uint32_t s_dictGramSize = 8;
+static const uint32_t s_dictSegmentSize = 64;
+
+static uint64_t getGramHash(const char *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	v *= 0x9e3779b97f4a7c15ULL;
+	return v ^ (v >> 29);
+}
+
+namespace {
+struct GramCount {
+	uint32_t m_docCount;
+	uint32_t m_lastSample;
+};
+
+struct DictSegment {
+	uint64_t m_score;
+	uint32_t m_sample;
+	uint32_t m_offset;
+	bool operator<(const DictSegment &rhs) const { return m_score > rhs.m_score; }
+};
+} //anonymous namespace
+
+bool gbtraindict(const std::vector<std::string> &samples, uint32_t maxDictLen, std::string *dict) {
+	dict->clear();
+
+	// count in how many samples each gram occurs
+	std::unordered_map<uint64_t, GramCount> grams;
+	for(uint32_t i = 0; i < samples.size(); i++) {
+		const std::string &s = samples[i];
+		for(uint32_t j = 0; j + s_dictGramSize <= s.size(); j++) {
+			GramCount &gc = grams[getGramHash(s.data() + j)];
+			if(gc.m_docCount == 0 || gc.m_lastSample != i) {
+				gc.m_docCount++;
+				gc.m_lastSample = i;
+			}
+		}
+	}
+
+	// score each segment by how common its grams are. grams found in only
+	// one sample don't help compressing other documents
+	std::vector<DictSegment> segments;
+	for(uint32_t i = 0; i < samples.size(); i++) {
+		const std::string &s = samples[i];
+		for(uint32_t off = 0; off + s_dictSegmentSize <= s.size(); off += s_dictSegmentSize / 2) {
+			DictSegment seg;
+			seg.m_score = 0;
+			seg.m_sample = i;
+			seg.m_offset = off;
+			for(uint32_t j = off; j + s_dictGramSize <= off + s_dictSegmentSize; j++) {
+				uint32_t count = grams[getGramHash(s.data() + j)].m_docCount;
+				if(count > 1)
+					seg.m_score += count;
+			}
+			if(seg.m_score > 0)
+				segments.push_back(seg);
+		}
+	}
+	std::sort(segments.begin(), segments.end());
+
+	// pick the best segments, skipping those mostly covered by picked ones
+	std::unordered_set<uint64_t> covered;
+	std::vector<const DictSegment *> picked;
+	uint32_t dictLen = 0;
+	for(size_t i = 0; i < segments.size() && dictLen + s_dictSegmentSize <= maxDictLen; i++) {
+		const char *p = samples[segments[i].m_sample].data() + segments[i].m_offset;
+		uint32_t numGrams = s_dictSegmentSize - s_dictGramSize + 1;
+		uint32_t numCovered = 0;
+		for(uint32_t j = 0; j < numGrams; j++) {
+			if(covered.count(getGramHash(p + j)))
+				numCovered++;
+		}
+		if(numCovered * 2 > numGrams)
+			continue;
+		for(uint32_t j = 0; j < numGrams; j++)
+			covered.insert(getGramHash(p + j));
+		picked.push_back(&segments[i]);
+		dictLen += s_dictSegmentSize;
+	}
+
+	if(picked.empty())
+		return false;
+
+	// deflate finds matches closer to the end of the dictionary cheaper, so
+	// put the best segments last
+	dict->reserve(dictLen);
+	for(size_t i = picked.size(); i > 0; i--) {
+		const DictSegment *seg = picked[i-1];
+		dict->append(samples[seg->m_sample].data() + seg->m_offset, s_dictSegmentSize);
+	}
+	return true;
+}
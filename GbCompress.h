@@ -2,6 +2,8 @@
 #define GB_COMPRESS_H_
 
 #include <inttypes.h>
+#include <string>
+#include <vector>
 #include "zlib.h" // Z_OK, etc.
 
 int gbuncompress(unsigned char *dest, uint32_t *destLen,
@@ -10,4 +12,57 @@ int gbuncompress(unsigned char *dest, uint32_t *destLen,
 int gbcompress(unsigned char *dest, uint32_t *destLen,
 	       const unsigned char *source, uint32_t sourceLen);
 
+// . same as above but with a zlib preset dictionary
+// . the compressed stream records the adler32 of the dictionary so the
+//   reader can tell which dictionary it needs, see gbgetdictid()
+int gbuncompress(unsigned char *dest, uint32_t *destLen,
+		 const unsigned char *source, uint32_t sourceLen,
+		 const unsigned char *dict, uint32_t dictLen);
+
+int gbcompress(unsigned char *dest, uint32_t *destLen,
+	       const unsigned char *source, uint32_t sourceLen,
+	       const unsigned char *dict, uint32_t dictLen);
+
+// id of a preset dictionary (its adler32)
+uint32_t gbdictid(const unsigned char *dict, uint32_t dictLen);
+
+// . id of the preset dictionary a zlib stream was compressed with
+// . returns 0 if the stream does not use one
+uint32_t gbgetdictid(const unsigned char *source, uint32_t sourceLen);
+
+// digested zstd dictionary. expensive to make, so make it once per dictionary
+// and share it between threads. "dict" is used as a raw content dictionary so
+// any bytes will do, eg. a titlerec.dict
+class GbZstdDict {
+	GbZstdDict(const GbZstdDict&);
+	GbZstdDict& operator=(const GbZstdDict&);
+public:
+	GbZstdDict(const unsigned char *dict, uint32_t dictLen);
+	~GbZstdDict();
+
+	bool isValid() const { return m_cdict && m_ddict; }
+
+	struct ZSTD_CDict_s *m_cdict;
+	struct ZSTD_DDict_s *m_ddict;
+};
+
+// . zstd, optionally with a dictionary
+// . returns zlib error codes (Z_OK, Z_BUF_ERROR, Z_DATA_ERROR) so callers can
+//   treat both alike
+int gbzstduncompress(unsigned char *dest, uint32_t *destLen,
+		     const unsigned char *source, uint32_t sourceLen,
+		     const GbZstdDict *dict = NULL);
+
+int gbzstdcompress(unsigned char *dest, uint32_t *destLen,
+		   const unsigned char *source, uint32_t sourceLen,
+		   const GbZstdDict *dict = NULL);
+
+// worst case size of gbzstdcompress() output
+uint32_t gbzstdcompressbound(uint32_t sourceLen);
+
+// . build a preset dictionary of at most maxDictLen bytes out of the byte
+//   sequences that are most common across the sample documents
+// . returns false if there was nothing to build it from
+bool gbtraindict(const std::vector<std::string> &samples, uint32_t maxDictLen, std::string *dict);
+
 #endif
@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 #include <queue>
+#include <unordered_map>
 
 static ares_channel s_channel;
 static pthread_t s_thread;
@@ -25,7 +26,24 @@ static std::queue<struct DnsItem*> s_callbackQueue;
 static GbMutex s_callbackQueueMtx;
 
 static GbThreadQueue s_requestQueue;
-static GbCache<std::string, GbDns::DnsResponse> s_cache;
+
+// . cached responses expire on their own ttl (capped by dns cache max age)
+// . errors are cached as well, but only for dns negative cache max age
+struct CachedDnsResponse {
+	GbDns::DnsResponse m_response;
+	int64_t m_expireTimeMs;
+};
+
+static GbCache<std::string, CachedDnsResponse> s_cache;
+
+// don't go below this even if the nameserver gives us a lower ttl
+static const int64_t s_minCacheTtlMs = 60000;
+
+// A record lookups in flight. requests for the same hostname wait for the first one instead of
+// sending another query
+static std::unordered_map<std::string, std::vector<struct DnsItem*>> s_pendingRequests;
+static int32_t s_numPrefetches = 0;
+static GbMutex s_pendingRequestsMtx;
 
 static void a_callback(void *arg, int status, int timeouts, unsigned char *abuf, int alen);
 static void ns_callback(void *arg, int status, int timeouts, unsigned char *abuf, int alen);
@@ -127,15 +145,19 @@ struct DnsItem {
 		, m_hostname(hostname, hostnameLen)
 		, m_callback(callback)
 		, m_state(state)
-		, m_response() {
+		, m_response()
+		, m_ttl(-1) {
 	}
 
 	RequestType m_reqType;
 	std::string m_hostname;
-	void (*m_callback)(GbDns::DnsResponse *response, void *state);
+	void (*m_callback)(GbDns::DnsResponse *response, void *state);	// NULL for prefetch
 	void *m_state;
 
 	GbDns::DnsResponse m_response;
+
+	// lowest ttl of returned records (-1 if unknown)
+	int32_t m_ttl;
 };
 
 static void processRequest(void *item) {
@@ -187,7 +209,8 @@ bool GbDns::initializeSettings() {
 		}
 	}
 
-	s_cache.configure(g_conf.m_dnsCacheMaxAge*1000, g_conf.m_dnsCacheSize, g_conf.m_logTraceDnsCache, "dns cache");
+	// entries expire on their own expire time, so the cache itself only has to keep them for the longest one
+	s_cache.configure(std::max(g_conf.m_dnsCacheMaxAge, g_conf.m_dnsNegativeCacheMaxAge)*1000, g_conf.m_dnsCacheSize, g_conf.m_logTraceDnsCache, "dns cache");
 
 	return true;
 }
@@ -336,27 +359,98 @@ static int convert_ares_errorno(int ares_errno) {
 	return 0;
 }
 
-static void addToCallbackQueue(DnsItem *item, bool addToCache=true) {
-	if (addToCache) {
-		if (item->m_reqType == DnsItem::request_type_a) {
-			s_cache.insert(item->m_hostname, item->m_response);
-		} else if (item->m_reqType == DnsItem::request_type_ns) {
-			if (!item->m_response.m_nameservers.empty()) {
-				GbDns::DnsResponse response;
-				if (s_cache.lookup(item->m_hostname, &response)) {
-					// merge response
-					response.m_nameservers = item->m_response.m_nameservers;
-					s_cache.insert(item->m_hostname, response);
-				}
+static bool lookupCache(const std::string &hostname, GbDns::DnsResponse *response) {
+	CachedDnsResponse cached;
+	if (!s_cache.lookup(hostname, &cached) || cached.m_expireTimeMs < gettimeofdayInMilliseconds()) {
+		return false;
+	}
+
+	*response = cached.m_response;
+	return true;
+}
+
+static void cacheResponse(const DnsItem *item) {
+	int64_t maxAgeMs;
+	switch (item->m_response.m_errno) {
+		case 0:
+			maxAgeMs = g_conf.m_dnsCacheMaxAge * 1000;
+			if (item->m_ttl >= 0) {
+				maxAgeMs = std::min(maxAgeMs, std::max(item->m_ttl * static_cast<int64_t>(1000), s_minCacheTtlMs));
 			}
-		}
+			break;
+		case ENOMEM:
+		case ESHUTTINGDOWN:
+			// not an answer from the nameserver
+			return;
+		default:
+			maxAgeMs = g_conf.m_dnsNegativeCacheMaxAge * 1000;
+			break;
 	}
 
+	if (maxAgeMs <= 0) {
+		return;
+	}
+
+	CachedDnsResponse cached;
+	cached.m_response = item->m_response;
+	cached.m_expireTimeMs = gettimeofdayInMilliseconds() + maxAgeMs;
+	s_cache.insert(item->m_hostname, cached);
+}
+
+static void pushToCallbackQueue(DnsItem *item) {
 	ScopedLock sl(s_callbackQueueMtx);
 	logTrace(g_conf.m_logTraceDns, "adding to callback queue item=%p", item);
 	s_callbackQueue.push(item);
 }
 
+static void addToCallbackQueue(DnsItem *item, bool addToCache=true) {
+	if (!addToCache) {
+		pushToCallbackQueue(item);
+		return;
+	}
+
+	if (item->m_reqType == DnsItem::request_type_a) {
+		cacheResponse(item);
+
+		// answer the requests that waited for this one
+		std::vector<DnsItem*> waitingItems;
+		{
+			ScopedLock sl(s_pendingRequestsMtx);
+			auto it = s_pendingRequests.find(item->m_hostname);
+			if (it != s_pendingRequests.end()) {
+				waitingItems.swap(it->second);
+				s_pendingRequests.erase(it);
+			}
+
+			if (!item->m_callback) {
+				--s_numPrefetches;
+			}
+		}
+
+		for (auto waitingItem : waitingItems) {
+			waitingItem->m_response = item->m_response;
+			pushToCallbackQueue(waitingItem);
+		}
+
+		if (!item->m_callback) {
+			logTrace(g_conf.m_logTraceDns, "prefetch done hostname='%s' waiting=%zu", item->m_hostname.c_str(), waitingItems.size());
+			delete item;
+			return;
+		}
+	} else if (item->m_reqType == DnsItem::request_type_ns) {
+		if (!item->m_response.m_nameservers.empty()) {
+			CachedDnsResponse cached;
+			if (s_cache.lookup(item->m_hostname, &cached)) {
+				// merge response
+				cached.m_response.m_nameservers = item->m_response.m_nameservers;
+				s_cache.insert(item->m_hostname, cached);
+			}
+		}
+	}
+
+	pushToCallbackQueue(item);
+}
+
 static void a_callback(void *arg, int status, int timeouts, unsigned char *abuf, int alen) {
 	logTrace(g_conf.m_logTraceDns, "BEGIN");
 
@@ -385,6 +479,10 @@ static void a_callback(void *arg, int status, int timeouts, unsigned char *abuf,
 			char ipbuf[16];
 			logTrace(g_conf.m_logTraceDns, "ip=%s ttl=%d", iptoa(addrttls[i].ipaddr.s_addr, ipbuf), addrttls[i].ttl);
 			item->m_response.m_ips.push_back(addrttls[i].ipaddr.s_addr);
+
+			if (item->m_ttl < 0 || addrttls[i].ttl < item->m_ttl) {
+				item->m_ttl = addrttls[i].ttl;
+			}
 		}
 
 		for (int i = 0; host->h_aliases[i] != NULL; ++i) {
@@ -404,6 +502,23 @@ static void a_callback(void *arg, int status, int timeouts, unsigned char *abuf,
 	logTrace(g_conf.m_logTraceDns, "END");
 }
 
+// /etc/hosts overrides both the cache and the dns servers
+static bool lookupEtcHosts(const std::string &hostname, GbDns::DnsResponse *response) {
+	if (!g_conf.m_useEtcHosts) {
+		return false;
+	}
+
+	ScopedLock sl(s_channelMtx);
+	hostent *host = nullptr;
+	if (ares_gethostbyname_file(s_channel, hostname.c_str(), AF_INET, &host) != ARES_SUCCESS) {
+		return false;
+	}
+
+	response->m_ips.push_back(((in_addr*)host->h_addr_list[0])->s_addr);
+	ares_free_hostent(host);
+	return true;
+}
+
 void GbDns::getARecord(const char *hostname, size_t hostnameLen, void (*callback)(GbDns::DnsResponse *response, void *state), void *state) {
 	logTrace(g_conf.m_logTraceDns, "BEGIN hostname='%.*s'", static_cast<int>(hostnameLen), hostname);
 
@@ -423,33 +538,78 @@ void GbDns::getARecord(const char *hostname, size_t hostnameLen, void (*callback
 		}
 	}
 
-	if (g_conf.m_useEtcHosts) {
-		ScopedLock sl(s_channelMtx);
-		hostent *host = nullptr;
-		if (ares_gethostbyname_file(s_channel, item->m_hostname.c_str(), AF_INET, &host) == ARES_SUCCESS) {
-			item->m_response.m_ips.push_back(((in_addr*)host->h_addr_list[0])->s_addr);
-			addToCallbackQueue(item, false);
-
-			ares_free_hostent(host);
+	if (lookupEtcHosts(item->m_hostname, &(item->m_response))) {
+		addToCallbackQueue(item, false);
 
-			logTrace(g_conf.m_logTraceDns, "END. hostname found in /etc/host");
-			return;
-		}
+		logTrace(g_conf.m_logTraceDns, "END. hostname found in /etc/host");
+		return;
 	}
 
 	// check cache
-	if (s_cache.lookup(item->m_hostname, &(item->m_response))) {
+	if (lookupCache(item->m_hostname, &(item->m_response))) {
 		addToCallbackQueue(item, false);
 
 		logTrace(g_conf.m_logTraceDns, "END. hostname found in cache");
 		return;
 	}
 
+	{
+		ScopedLock sl(s_pendingRequestsMtx);
+		auto it = s_pendingRequests.find(item->m_hostname);
+		if (it != s_pendingRequests.end()) {
+			// wait for the lookup already in flight
+			it->second.push_back(item);
+
+			logTrace(g_conf.m_logTraceDns, "END. hostname lookup in flight");
+			return;
+		}
+
+		s_pendingRequests[item->m_hostname];
+	}
+
 	s_requestQueue.addItem(item);
 
 	logTrace(g_conf.m_logTraceDns, "END");
 }
 
+void GbDns::prefetchARecord(const char *hostname, size_t hostnameLen) {
+	if (g_conf.m_dnsMaxPrefetches <= 0 || hostnameLen == 0) {
+		return;
+	}
+
+	std::string host(hostname, hostnameLen);
+
+	// hostname is ip
+	in_addr addr;
+	if (is_digit(host[0]) && inet_pton(AF_INET, host.c_str(), &addr) == 1) {
+		return;
+	}
+
+	DnsResponse response;
+	if (lookupEtcHosts(host, &response) || lookupCache(host, &response)) {
+		return;
+	}
+
+	{
+		ScopedLock sl(s_pendingRequestsMtx);
+		if (s_numPrefetches >= g_conf.m_dnsMaxPrefetches || s_pendingRequests.find(host) != s_pendingRequests.end()) {
+			return;
+		}
+
+		s_pendingRequests[host];
+		++s_numPrefetches;
+	}
+
+	logTrace(g_conf.m_logTraceDns, "prefetching hostname='%s'", host.c_str());
+
+	s_requestQueue.addItem(new DnsItem(DnsItem::request_type_a, hostname, hostnameLen, NULL, NULL));
+}
+
+bool GbDns::getCachedARecord(const char *hostname, size_t hostnameLen, DnsResponse *response) {
+	std::string host(hostname, hostnameLen);
+	return lookupEtcHosts(host, response) || lookupCache(host, response);
+}
+
 static void ns_callback(void *arg, int status, int timeouts, unsigned char *abuf, int alen) {
 	logTrace(g_conf.m_logTraceDns, "BEGIN");
 	DnsItem *item = static_cast<DnsItem*>(arg);
@@ -20,6 +20,13 @@ namespace GbDns {
 	void finalize();
 
 	void getARecord(const char *hostname, size_t hostnameLen, void (*callback)(DnsResponse *response, void *state), void *state);
+
+	// start an A record lookup without waiting for it, so a later getARecord() is answered from cache
+	void prefetchARecord(const char *hostname, size_t hostnameLen);
+
+	// returns true if there is an /etc/hosts entry (when enabled) or a (positive or negative) cached A record. never blocks
+	bool getCachedARecord(const char *hostname, size_t hostnameLen, DnsResponse *response);
+
 	void getNSRecord(const char *hostname, size_t hostnameLen, void (*callback)(DnsResponse *response, void *state), void *state);
 
 	void makeCallbacks();
@@ -0,0 +1,49 @@
+#include "GbRWLock.h"
+#include <errno.h>
+#include <assert.h>
+
+GbRWLock::GbRWLock() {
+	// glibc prefers readers by default, so a steady stream of readers can
+	// starve the writer (Msg4 adds). Queue new readers behind a waiting writer.
+	// Non-recursive: a thread must not take the read lock twice.
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	int rc = pthread_rwlock_init(&rwlock, &attr);
+	assert(rc==0);
+	(void)rc;
+	pthread_rwlockattr_destroy(&attr);
+}
+
+#ifdef DEBUG_MUTEXES
+
+GbRWLock::~GbRWLock() {
+	int rc = pthread_rwlock_destroy(&rwlock);
+	assert(rc==0);
+}
+
+
+void GbRWLock::lock() {
+	int rc = pthread_rwlock_wrlock(&rwlock);
+	assert(rc==0);
+}
+
+void GbRWLock::lock_shared() {
+	int rc = pthread_rwlock_rdlock(&rwlock);
+	assert(rc==0);
+}
+
+void GbRWLock::unlock() {
+	int rc = pthread_rwlock_unlock(&rwlock);
+	assert(rc==0);
+}
+
+//we can only tell that somebody holds the lock (shared or exclusive)
+void GbRWLock::verify_is_locked() {
+	int rc = pthread_rwlock_trywrlock(&rwlock);
+	if(rc==0)
+		pthread_rwlock_unlock(&rwlock);
+	assert(rc==EBUSY || rc==EDEADLK);
+}
+
+#endif
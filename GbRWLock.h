@@ -0,0 +1,47 @@
+#ifndef GB_RWLOCK_H_
+#define GB_RWLOCK_H_
+
+#include <pthread.h>
+
+// reader/writer lock. Readers share the lock; a writer excludes everybody.
+// A waiting writer holds up new readers so it can't be starved.
+class GbRWLock {
+	GbRWLock(const GbRWLock&);
+	GbRWLock& operator=(const GbRWLock&);
+public:
+	pthread_rwlock_t rwlock;
+
+	GbRWLock();
+
+#ifndef DEBUG_MUTEXES
+
+	~GbRWLock() {}
+
+	void lock() {
+		pthread_rwlock_wrlock(&rwlock);
+	}
+
+	void lock_shared() {
+		pthread_rwlock_rdlock(&rwlock);
+	}
+
+	void unlock() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+
+	void verify_is_locked() {}
+
+#else
+
+	~GbRWLock();
+
+	void lock();
+	void lock_shared();
+	void unlock();
+	void verify_is_locked();
+
+#endif
+};
+
+
+#endif //GB_RWLOCK_H_
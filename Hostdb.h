@@ -46,6 +46,8 @@ struct HostRuntimeInformation {
 	int32_t   m_hostsConfCRC;
 	
 	int8_t    m_repairMode;
+	
+	int32_t   m_queuedJobs; //jobs waiting in the job scheduler. Used by Multicast for replica selection
 };
 
 
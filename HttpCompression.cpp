@@ -0,0 +1,566 @@
+#include "HttpCompression.h"
+#include "Conf.h"
+#include "SafeBuf.h"
+#include "Dir.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Errno.h"
+#include "fctypes.h"
+#include "JobScheduler.h"
+#include <brotli/encode.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+
+// static content bigger than this is sent from disk as-is
+static const int32_t s_maxStaticSize = 2*1024*1024;
+// total size of the compressed static content we keep
+static const int64_t s_maxStaticTotal = 64*1024*1024;
+// a static file that could not be read or compressed is tried again after
+// this long, doubling up to s_maxStaticRetryDelayMs
+static const int64_t s_minStaticRetryDelayMs = 10*1000;
+static const int64_t s_maxStaticRetryDelayMs = 60*60*1000;
+
+
+static void *zalloc_replace(void *, unsigned int nitems, unsigned int size) {
+	return g_mem.gbmalloc(size*nitems,"httpzlib");
+}
+
+static void zfree_replace(void *, void *s) {
+	g_mem.gbfree(s,"httpzlib", 0, false);
+}
+
+// zlib levels are 1-9, brotli qualities 0-11
+static int getBrotliQuality(int32_t level) {
+	if(level >= 9)
+		return BROTLI_MAX_QUALITY;
+	if(level <= 1)
+		return BROTLI_MIN_QUALITY;
+	return level - 1;
+}
+
+
+HttpCompressor::HttpCompressor()
+  : m_encoding(HTTP_ENCODING_IDENTITY),
+    m_zinit(false),
+    m_brotli(NULL)
+{
+	memset(&m_zstream,0,sizeof(m_zstream));
+}
+
+HttpCompressor::~HttpCompressor() {
+	reset();
+}
+
+void HttpCompressor::reset() {
+	if(m_zinit) {
+		deflateEnd(&m_zstream);
+		m_zinit = false;
+	}
+	if(m_brotli) {
+		BrotliEncoderDestroyInstance(m_brotli);
+		m_brotli = NULL;
+	}
+	m_encoding = HTTP_ENCODING_IDENTITY;
+}
+
+bool HttpCompressor::init(http_encoding_t encoding, int32_t level) {
+	reset();
+	if(level < 1) level = 1;
+	if(level > 9) level = 9;
+
+	if(encoding == HTTP_ENCODING_GZIP) {
+		memset(&m_zstream,0,sizeof(m_zstream));
+		m_zstream.zalloc = zalloc_replace;
+		m_zstream.zfree  = zfree_replace;
+		// 15+16 makes a gzip header and trailer
+		if(deflateInit2(&m_zstream, level, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			log(LOG_WARN,"http: deflateInit2 failed");
+			g_errno = ECOMPRESSFAILED;
+			return false;
+		}
+		m_zinit = true;
+	} else if(encoding == HTTP_ENCODING_BROTLI) {
+		m_brotli = BrotliEncoderCreateInstance(NULL,NULL,NULL);
+		if(!m_brotli) {
+			g_errno = ENOMEM;
+			return false;
+		}
+		BrotliEncoderSetParameter(m_brotli, BROTLI_PARAM_QUALITY, getBrotliQuality(level));
+		BrotliEncoderSetParameter(m_brotli, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+	}
+	m_encoding = encoding;
+	return true;
+}
+
+bool HttpCompressor::compress(const char *src, int32_t srcLen, bool finish, SafeBuf *dst) {
+	if(m_encoding == HTTP_ENCODING_IDENTITY)
+		return dst->safeMemcpy(src,srcLen);
+
+	if(m_encoding == HTTP_ENCODING_GZIP) {
+		m_zstream.next_in = (Bytef*)src;
+		m_zstream.avail_in = (uInt)srcLen;
+		int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+		for(;;) {
+			// a guess, we grow it if deflate runs out of room
+			int32_t need = (int32_t)deflateBound(&m_zstream, m_zstream.avail_in) + 64;
+			if(!dst->reserve(need))
+				return false;
+			m_zstream.next_out = (Bytef*)dst->getBufPtr();
+			m_zstream.avail_out = (uInt)dst->getAvail();
+			int err = deflate(&m_zstream, flush);
+			dst->incrementLength(dst->getAvail() - (int32_t)m_zstream.avail_out);
+			if(err == Z_STREAM_END)
+				break;
+			if(err != Z_OK && err != Z_BUF_ERROR) {
+				log(LOG_WARN,"http: deflate failed: %d", err);
+				g_errno = ECOMPRESSFAILED;
+				return false;
+			}
+			// all flushed when deflate had room to spare
+			if(!finish && m_zstream.avail_in == 0 && m_zstream.avail_out != 0)
+				break;
+		}
+		return true;
+	}
+
+	size_t availIn = srcLen;
+	const uint8_t *nextIn = (const uint8_t*)src;
+	BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+	for(;;) {
+		if(!dst->reserve((int32_t)BrotliEncoderMaxCompressedSize(availIn) + 1024))
+			return false;
+		size_t availOut = dst->getAvail();
+		uint8_t *nextOut = (uint8_t*)dst->getBufPtr();
+		if(!BrotliEncoderCompressStream(m_brotli, op, &availIn, &nextIn, &availOut, &nextOut, NULL)) {
+			log(LOG_WARN,"http: brotli compression failed");
+			g_errno = ECOMPRESSFAILED;
+			return false;
+		}
+		dst->incrementLength(dst->getAvail() - (int32_t)availOut);
+		if(availIn == 0 && !BrotliEncoderHasMoreOutput(m_brotli))
+			break;
+	}
+	return true;
+}
+
+
+const char *HttpCompression::getEncodingName(http_encoding_t encoding) {
+	switch(encoding) {
+		case HTTP_ENCODING_GZIP:   return "gzip";
+		case HTTP_ENCODING_BROTLI: return "br";
+		default:                   return "identity";
+	}
+}
+
+
+http_encoding_t HttpCompression::getAcceptedEncoding(const char *request, int32_t requestLen) {
+	// only look in the headers, not in a posted body
+	const char *end = request + requestLen;
+	const char *hdrEnd = (const char *)memmem(request, requestLen, "\r\n\r\n", 4);
+	if(hdrEnd)
+		end = hdrEnd + 2;
+
+	const char *p = strncasestr(request, (int32_t)(end-request), "\nAccept-Encoding:");
+	if(!p)
+		return HTTP_ENCODING_IDENTITY;
+	p += 17;
+	const char *lineEnd = p;
+	while(lineEnd < end && *lineEnd != '\r' && *lineEnd != '\n')
+		lineEnd++;
+
+	bool gzip = false;
+	bool brotli = false;
+	while(p < lineEnd) {
+		// one "coding;q=x" item
+		while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == ','))
+			p++;
+		const char *name = p;
+		while(p < lineEnd && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+			p++;
+		int32_t nameLen = p - name;
+		const char *item = p;
+		while(p < lineEnd && *p != ',')
+			p++;
+		// q=0 means "not acceptable"
+		bool refused = false;
+		const char *q = strncasestr(item, (int32_t)(p-item), "q=");
+		if(q && atof(q+2) <= 0.0)
+			refused = true;
+		if(refused || nameLen <= 0)
+			continue;
+		if((nameLen == 4 && strncasecmp(name,"gzip",4) == 0) ||
+		   (nameLen == 6 && strncasecmp(name,"x-gzip",6) == 0) ||
+		   (nameLen == 1 && name[0] == '*'))
+			gzip = true;
+		else if(nameLen == 2 && strncasecmp(name,"br",2) == 0)
+			brotli = true;
+	}
+
+	if(brotli)
+		return HTTP_ENCODING_BROTLI;
+	if(gzip)
+		return HTTP_ENCODING_GZIP;
+	return HTTP_ENCODING_IDENTITY;
+}
+
+
+bool HttpCompression::isCompressibleContentType(const char *contentType, int32_t contentTypeLen) {
+	if(contentTypeLen >= 5 && strncasecmp(contentType,"text/",5) == 0)
+		return true;
+	return strncasestr(contentType, contentTypeLen, "json") ||
+	       strncasestr(contentType, contentTypeLen, "xml") ||
+	       strncasestr(contentType, contentTypeLen, "javascript") ||
+	       strncasestr(contentType, contentTypeLen, "x-font-ttf");
+}
+
+bool HttpCompression::isCompressibleExtension(const char *ext) {
+	static const char * const s_exts[] = {
+		"html", "htm", "css", "js", "json", "xml", "txt", "svg", "csv", "ttf"
+	};
+	if(!ext)
+		return false;
+	for(const char *e : s_exts) {
+		if(strcasecmp(ext,e) == 0)
+			return true;
+	}
+	return false;
+}
+
+
+// value of a header in the mime, or NULL. valueLen excludes the \r\n
+static const char *getMimeField(const char *mime, int32_t mimeLen, const char *field, int32_t *valueLen) {
+	const char *p = strncasestr(mime, mimeLen, field);
+	if(!p || p == mime || p[-1] != '\n')
+		return NULL;
+	p += strlen(field);
+	const char *end = mime + mimeLen;
+	while(p < end && *p == ' ')
+		p++;
+	const char *e = p;
+	while(e < end && *e != '\r' && *e != '\n')
+		e++;
+	*valueLen = e - p;
+	return p;
+}
+
+
+http_encoding_t HttpCompression::getReplyEncoding(const char *request, int32_t requestLen,
+						  const char *mime, int32_t mimeLen, int32_t contentLen) {
+	if(!g_conf.m_httpCompression)
+		return HTTP_ENCODING_IDENTITY;
+	if(contentLen < g_conf.m_httpCompressionMinSize || contentLen <= 0)
+		return HTTP_ENCODING_IDENTITY;
+	if(!request || !mime || mimeLen <= 0)
+		return HTTP_ENCODING_IDENTITY;
+
+	int32_t len;
+	// gz, bz2 files etc.
+	if(getMimeField(mime, mimeLen, "Content-Encoding:", &len))
+		return HTTP_ENCODING_IDENTITY;
+	// keep partial replies as they are
+	if(getMimeField(mime, mimeLen, "Content-Range:", &len))
+		return HTTP_ENCODING_IDENTITY;
+	const char *ct = getMimeField(mime, mimeLen, "Content-Type:", &len);
+	if(!ct || !isCompressibleContentType(ct,len))
+		return HTTP_ENCODING_IDENTITY;
+
+	return getAcceptedEncoding(request, requestLen);
+}
+
+
+bool HttpCompression::addEncodingToMime(const char *mime, int32_t mimeLen, int32_t contentLen,
+					http_encoding_t encoding, SafeBuf *dst) {
+	// the blank line that ends the mime
+	if(mimeLen < 4 || memcmp(mime+mimeLen-4,"\r\n\r\n",4) != 0) {
+		g_errno = EBADENGINEER;
+		return false;
+	}
+	const char *head = mime;
+	int32_t headLen = mimeLen - 2;
+
+	int32_t valueLen;
+	const char *value = getMimeField(mime, mimeLen, "Content-Length:", &valueLen);
+	if(value && contentLen >= 0) {
+		if(!dst->safeMemcpy(head, value-head) ||
+		   !dst->safePrintf("%" PRId32, contentLen))
+			return false;
+		headLen -= (value+valueLen) - head;
+		head = value+valueLen;
+	}
+	return dst->safeMemcpy(head, headLen) &&
+	       dst->safePrintf("Content-Encoding: %s\r\n"
+			       "Vary: Accept-Encoding\r\n"
+			       "\r\n",
+			       getEncodingName(encoding)) &&
+	       dst->nullTerm();
+}
+
+
+bool HttpCompression::compress(http_encoding_t encoding, int32_t level, const char *src, int32_t srcLen, SafeBuf *dst) {
+	HttpCompressor compressor;
+	return compressor.init(encoding, level) &&
+	       compressor.compress(src, srcLen, true, dst);
+}
+
+
+namespace {
+
+struct StaticEntry {
+	time_t m_lastModified;
+	int32_t m_size;
+	// empty if it did not get smaller
+	std::string m_gzip;
+	std::string m_brotli;
+};
+
+}
+
+// only used by the main thread
+static std::unordered_map<std::string,StaticEntry> s_static;
+static int64_t s_staticTotal = 0;
+
+
+// "html//faq.html" and "html/faq.html" are the same file
+static std::string getStaticKey(const char *key) {
+	std::string k;
+	for(const char *p = key; *p; p++) {
+		if(*p == '/' && !k.empty() && k.back() == '/')
+			continue;
+		k.push_back(*p);
+	}
+	return k;
+}
+
+
+// compress content into a new entry. does not touch s_static so it can run in a job thread
+static bool compressStatic(time_t lastModified, const char *content, int32_t contentLen, StaticEntry *entry) {
+	entry->m_lastModified = lastModified;
+	entry->m_size = contentLen;
+
+	SafeBuf gz;
+	SafeBuf br;
+	if(!HttpCompression::compress(HTTP_ENCODING_GZIP, 9, content, contentLen, &gz) ||
+	   !HttpCompression::compress(HTTP_ENCODING_BROTLI, 9, content, contentLen, &br))
+		return false;
+	if(gz.length() < contentLen)
+		entry->m_gzip.assign(gz.getBufStart(), gz.length());
+	if(br.length() < contentLen)
+		entry->m_brotli.assign(br.getBufStart(), br.length());
+	return true;
+}
+
+
+static void insertStatic(const char *key, StaticEntry &&entry) {
+	std::string k = getStaticKey(key);
+	auto it = s_static.find(k);
+	if(it != s_static.end()) {
+		s_staticTotal -= it->second.m_gzip.size() + it->second.m_brotli.size();
+		s_static.erase(it);
+	}
+	int64_t size = entry.m_gzip.size() + entry.m_brotli.size();
+	if(s_staticTotal + size > s_maxStaticTotal) {
+		// remember it anyway so we do not compress it again and again
+		log(LOG_INFO,"http: not keeping compressed %s, static compression cache is full", key);
+		entry.m_gzip.clear();
+		entry.m_brotli.clear();
+		size = 0;
+	}
+	s_staticTotal += size;
+	s_static[k] = std::move(entry);
+}
+
+
+bool HttpCompression::addStatic(const char *key, time_t lastModified, const char *content, int32_t contentLen) {
+	if(contentLen > s_maxStaticSize)
+		return false;
+
+	StaticEntry entry;
+	if(!compressStatic(lastModified, content, contentLen, &entry))
+		return false;
+	insertStatic(key, std::move(entry));
+	return true;
+}
+
+
+static bool readStaticFile(const char *filename, std::string *content, time_t *lastModified) {
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_size > s_maxStaticSize) {
+		close(fd);
+		return false;
+	}
+	content->resize(st.st_size);
+	int32_t got = 0;
+	while(got < st.st_size) {
+		ssize_t n = read(fd, &(*content)[got], st.st_size - got);
+		if(n <= 0)
+			break;
+		got += n;
+	}
+	close(fd);
+	if(got != st.st_size) {
+		log(LOG_WARN,"http: could not read %s for compression", filename);
+		return false;
+	}
+	*lastModified = st.st_mtime;
+	return true;
+}
+
+
+bool HttpCompression::addStaticFile(const char *filename) {
+	std::string content;
+	time_t lastModified;
+	if(!readStaticFile(filename, &content, &lastModified))
+		return false;
+	return addStatic(filename, lastModified, content.data(), (int32_t)content.size());
+}
+
+
+namespace {
+
+struct StaticFileJob {
+	std::string m_filename;
+	StaticEntry m_entry;
+	bool m_ok;
+};
+
+}
+
+// files being compressed in a job. only used by the main thread
+static std::unordered_set<std::string> s_pendingStatic;
+
+namespace {
+
+struct StaticFileFailure {
+	int64_t m_retryTimeMs;
+	int64_t m_delayMs;
+};
+
+}
+
+// files that failed to be read or compressed. only used by the main thread
+static std::unordered_map<std::string,StaticFileFailure> s_failedStatic;
+
+static void compressStaticFileJob(void *state) {
+	StaticFileJob *job = static_cast<StaticFileJob*>(state);
+	std::string content;
+	time_t lastModified;
+	job->m_ok = readStaticFile(job->m_filename.c_str(), &content, &lastModified) &&
+	            compressStatic(lastModified, content.data(), (int32_t)content.size(), &job->m_entry);
+}
+
+static void compressedStaticFileJob(void *state, job_exit_t exit_type) {
+	StaticFileJob *job = static_cast<StaticFileJob*>(state);
+	std::string k = getStaticKey(job->m_filename.c_str());
+	s_pendingStatic.erase(k);
+	if(exit_type == job_exit_normal) {
+		if(job->m_ok) {
+			s_failedStatic.erase(k);
+			insertStatic(job->m_filename.c_str(), std::move(job->m_entry));
+		} else {
+			// don't read it again on every request for it
+			StaticFileFailure &failure = s_failedStatic[k];
+			failure.m_delayMs = failure.m_delayMs ? std::min(failure.m_delayMs * 2, s_maxStaticRetryDelayMs) : s_minStaticRetryDelayMs;
+			failure.m_retryTimeMs = gettimeofdayInMilliseconds() + failure.m_delayMs;
+			log(LOG_INFO,"http: could not compress %s, trying again in %" PRId64" seconds",
+			    job->m_filename.c_str(), failure.m_delayMs / 1000);
+		}
+	}
+	delete job;
+}
+
+// . read and compress the file in a job so the main loop doesn't wait for it
+// . the file is sent uncompressed until the job is done
+static void submitStaticFileJob(const char *filename) {
+	std::string k = getStaticKey(filename);
+	if(s_pendingStatic.count(k))
+		return;
+	auto it = s_failedStatic.find(k);
+	if(it != s_failedStatic.end() && gettimeofdayInMilliseconds() < it->second.m_retryTimeMs)
+		return;
+
+	StaticFileJob *job = new StaticFileJob;
+	job->m_filename = filename;
+	job->m_ok = false;
+	if(!g_jobScheduler.submit(compressStaticFileJob, compressedStaticFileJob, job, thread_type_unspecified_io, 0)) {
+		log(LOG_WARN,"http: could not submit compression job for %s", filename);
+		delete job;
+		return;
+	}
+	s_pendingStatic.insert(k);
+}
+
+
+static const StaticEntry *findStatic(const char *key, time_t lastModified, int32_t contentLen) {
+	auto it = s_static.find(getStaticKey(key));
+	if(it == s_static.end())
+		return NULL;
+	if(it->second.m_lastModified != lastModified || it->second.m_size != contentLen)
+		return NULL;
+	return &it->second;
+}
+
+static const std::string *getEncoded(const StaticEntry *entry, http_encoding_t encoding) {
+	const std::string *s = NULL;
+	if(encoding == HTTP_ENCODING_GZIP)
+		s = &entry->m_gzip;
+	else if(encoding == HTTP_ENCODING_BROTLI)
+		s = &entry->m_brotli;
+	if(!s || s->empty())
+		return NULL;
+	return s;
+}
+
+
+const std::string *HttpCompression::getStatic(const char *key, time_t lastModified, int32_t contentLen, http_encoding_t encoding) {
+	const StaticEntry *entry = findStatic(key, lastModified, contentLen);
+	return entry ? getEncoded(entry, encoding) : NULL;
+}
+
+
+const std::string *HttpCompression::getStaticFile(const char *filename, time_t lastModified, int32_t size, http_encoding_t encoding) {
+	if(size > s_maxStaticSize || encoding == HTTP_ENCODING_IDENTITY)
+		return NULL;
+	const StaticEntry *entry = findStatic(filename, lastModified, size);
+	if(!entry) {
+		// new or changed since we compressed it
+		submitStaticFileJob(filename);
+		return NULL;
+	}
+	return getEncoded(entry, encoding);
+}
+
+
+void HttpCompression::precompressStaticFiles(const char *dir) {
+	Dir d;
+	if(!d.set(dir) || !d.open())
+		return;
+	int32_t numFiles = 0;
+	while(const char *filename = d.getNextFilename()) {
+		const char *ext = strrchr(filename,'.');
+		if(!ext || !isCompressibleExtension(ext+1))
+			continue;
+		char fullPath[1024];
+		snprintf(fullPath, sizeof(fullPath), "%s/%s", dir, filename);
+		if(addStaticFile(fullPath))
+			numFiles++;
+	}
+	log(LOG_INIT,"http: Precompressed %" PRId32" static files, %" PRId64" bytes",
+	    numFiles, s_staticTotal);
+}
+
+
+void HttpCompression::clearStatic() {
+	s_static.clear();
+	s_staticTotal = 0;
+	s_failedStatic.clear();
+}
@@ -0,0 +1,98 @@
+#ifndef GB_HTTPCOMPRESSION_H_
+#define GB_HTTPCOMPRESSION_H_
+
+#include <inttypes.h>
+#include <time.h>
+#include <string>
+#include "zlib.h"
+
+class SafeBuf;
+struct BrotliEncoderStateStruct;
+
+//Compression of our own http replies (content-encoding), negotiated with the
+//Accept-Encoding request header. Brotli is preferred over gzip when the client
+//takes both.
+//
+//Dynamic pages are compressed when they are sent. Streamed replies use an
+//HttpCompressor that is flushed after every piece so the client can show
+//what it got so far. Static files and embedded assets are compressed once at
+//the highest level and kept in memory.
+
+enum http_encoding_t {
+	HTTP_ENCODING_IDENTITY = 0,
+	HTTP_ENCODING_GZIP     = 1,
+	HTTP_ENCODING_BROTLI   = 2
+};
+
+
+class HttpCompressor {
+public:
+	HttpCompressor();
+	~HttpCompressor();
+
+	//start a new stream. level is 1-9, it is mapped to brotli's 0-11
+	bool init(http_encoding_t encoding, int32_t level);
+	void reset();
+
+	http_encoding_t getEncoding() const { return m_encoding; }
+
+	//compress src and append the output to dst. Everything given so far can
+	//be decoded from the output. "finish" ends the stream.
+	//returns false and sets g_errno on error
+	bool compress(const char *src, int32_t srcLen, bool finish, SafeBuf *dst);
+
+private:
+	http_encoding_t m_encoding;
+	bool m_zinit;
+	z_stream m_zstream;
+	BrotliEncoderStateStruct *m_brotli;
+};
+
+
+namespace HttpCompression {
+
+//value of the Content-Encoding header
+const char *getEncodingName(http_encoding_t encoding);
+
+//best encoding the client accepts, looking at the Accept-Encoding header
+//of the raw request (only the headers are looked at)
+http_encoding_t getAcceptedEncoding(const char *request, int32_t requestLen);
+
+//is it worth compressing content of this type (text, json, xml, javascript, svg)
+bool isCompressibleContentType(const char *contentType, int32_t contentTypeLen);
+bool isCompressibleExtension(const char *ext);
+
+//encoding to use for a reply with this mime to the request. Identity if
+//compression is turned off, the content is too small or not compressible or
+//the mime already has a content-encoding
+http_encoding_t getReplyEncoding(const char *request, int32_t requestLen,
+				 const char *mime, int32_t mimeLen, int32_t contentLen);
+
+//copy the mime to dst adding the content-encoding and vary headers. The
+//content-length is changed to contentLen if it is there
+bool addEncodingToMime(const char *mime, int32_t mimeLen, int32_t contentLen,
+		       http_encoding_t encoding, SafeBuf *dst);
+
+//compress all of src in one go, appending to dst
+bool compress(http_encoding_t encoding, int32_t level, const char *src, int32_t srcLen, SafeBuf *dst);
+
+//compress static content and keep it. "key" is the file name or the url
+//path of an embedded asset, lastModified tells a changed file apart
+bool addStatic(const char *key, time_t lastModified, const char *content, int32_t contentLen);
+//read a file and addStatic() it. returns false if it could not be read
+bool addStaticFile(const char *filename);
+//compressed copy of static content. NULL if there is none or it is stale
+const std::string *getStatic(const char *key, time_t lastModified, int32_t contentLen, http_encoding_t encoding);
+//same for a file. A file that is new or has changed is read and compressed
+//in a job and NULL is returned until that is done. NULL if the file is too
+//big or does not get smaller
+const std::string *getStaticFile(const char *filename, time_t lastModified, int32_t size, http_encoding_t encoding);
+
+//compress the compressible files in the top directory of the html root
+void precompressStaticFiles(const char *dir);
+
+void clearStatic();
+
+} //namespace HttpCompression
+
+#endif // GB_HTTPCOMPRESSION_H_
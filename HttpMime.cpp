@@ -1079,7 +1079,8 @@ void HttpMime::makeMime  ( int32_t    totalContentLen    ,
 			   const char   *contentType        ,
 			   const char   *charset            ,
 			   int32_t    httpStatus         ,
-			   const char   *cookie             ) {
+			   const char   *cookie             ,
+			   bool    chunked            ) {
 	// assume UTF-8
 	//if ( ! charset ) charset = "utf-8";
 	// . make the content type line
@@ -1210,11 +1211,14 @@ void HttpMime::makeMime  ( int32_t    totalContentLen    ,
 		if ( httpStatus == 200 ) smsg = " OK";
 		//sprintf ( m_buf , 
 		p += sprintf( p,
-			      "HTTP/1.0 %" PRId32"%s\r\n"
-			      , httpStatus , smsg );
+			      "HTTP/1.%d %" PRId32"%s\r\n"
+			      , chunked ? 1 : 0 , httpStatus , smsg );
+		// the length of each chunk is in the content instead
+		if ( chunked )
+			p += sprintf ( p , "Transfer-Encoding: chunked\r\n" );
 		// if content length is not known, as in diffbot.cpp, then
 		// do not print it into the mime
-		if ( totalContentLen >= 0 )
+		else if ( totalContentLen >= 0 )
 			p += sprintf ( p , 
 				       // make it at least 4 spaces so we can
 				       // change the length of the content 
@@ -1261,6 +1265,20 @@ void HttpMime::makeMime  ( int32_t    totalContentLen    ,
 }
 
 
+bool HttpMime::frameChunk(SafeBuf *sb, int32_t offset, bool lastChunk) {
+	int32_t len = sb->length() - offset;
+	// a zero-length chunk would end the reply
+	if ( len > 0 ) {
+		char hdr[16];
+		int32_t hdrLen = sprintf ( hdr , "%" PRIx32"\r\n" , len );
+		if ( ! sb->insert2 ( hdr , hdrLen , offset ) ) return false;
+		if ( ! sb->safeMemcpy ( "\r\n" , 2 ) ) return false;
+	}
+	if ( lastChunk && ! sb->safeMemcpy ( "0\r\n\r\n" , 5 ) ) return false;
+	return sb->nullTerm();
+}
+
+
 //FILE EXTENSIONS to MIME CONTENT-TYPE
 //------------------------------------
 
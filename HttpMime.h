@@ -93,6 +93,9 @@ public:
 	// . a cache time of 0 means use local caching rules
 	// . any other cacheTime is an explicit time to cache the page for
 	// . httpStatus of -1 means to auto determine
+	// . if chunked is true the reply is HTTP/1.1 with chunked transfer
+	//   encoding. totalContentLen must be -1 and the content must be
+	//   framed with frameChunk()
 	void makeMime(int32_t totalContentLen,
 	              int32_t cacheTime,
 	              time_t lastModified,
@@ -103,7 +106,14 @@ public:
 	              const char *contentType,
 	              const char *charset,
 	              int32_t httpStatus,
-	              const char *cookie);
+	              const char *cookie,
+	              bool chunked = false);
+
+	// . turn the content in sb after "offset" into one chunk of a
+	//   chunked reply. if "lastChunk" is true the terminating zero-length
+	//   chunk is appended as well
+	// . returns false and sets g_errno on error
+	static bool frameChunk(SafeBuf *sb, int32_t offset, bool lastChunk);
 
 	// make a redirect mime
 	void makeRedirMime ( const char *redirUrl , int32_t redirUrlLen );
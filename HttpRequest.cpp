@@ -122,6 +122,7 @@ void HttpRequest::reset() {
 	memset(m_fieldLens, 0, sizeof(m_fieldLens));
 	memset(m_fieldValues, 0, sizeof(m_fieldValues));
 	m_isSSL = false;
+	m_isHttp11 = false;
 	memset(m_redir, 0, sizeof(m_redir));
 	m_redirLen = 0;
 	memset(m_ref, 0, sizeof(m_ref));
@@ -556,6 +557,12 @@ bool HttpRequest::set ( char *origReq , int32_t origReqLen , TcpSocket *sock ) {
 		 g_errno = EBADREQUEST; 
 		 return false; 
 	 }
+	 // does the client understand HTTP/1.1 replies, like chunked ones?
+	 m_isHttp11 = false;
+	 const char *eol = strpbrk ( req , "\r\n" );
+	 if ( eol && eol - req >= 9 && strncmp ( eol - 9 , " HTTP/1.1" , 9 ) == 0 )
+		 m_isHttp11 = true;
+
 	 // . NULL terminate the request (a destructive operation!)
 	 // . this removes the last \n in the trailing \r\n 
 	 // . shit, but it fucks up POST requests
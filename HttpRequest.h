@@ -109,6 +109,7 @@ class HttpRequest {
 	const char *getHost     () const { return m_host;    }
 	int32_t  getHostLen     () const { return m_hostLen; }
 	bool  isLocal        () const { return m_isLocal; }
+	bool  isHttp11       () const { return m_isHttp11; }
 
 
 	// . the &ucontent= cgi var does not get its value decoded
@@ -222,6 +223,8 @@ private:
 
 	int32_t m_userIP;
 	bool m_isSSL;
+	// was the request line "... HTTP/1.1"
+	bool m_isHttp11;
 
 	// . ptr to the thing we're getting in the request
 	// . used by PageAddUrl4.cpp
@@ -13,6 +13,7 @@
 #include "Loop.h"
 #include "Msg13.h"
 #include "GbCompress.h"
+#include "HttpCompression.h"
 #include "UdpServer.h"
 #include "UdpSlot.h"
 #include "Dns.h"
@@ -107,6 +108,12 @@ bool HttpServer::init ( int16_t port,
 		log(LOG_INIT,"https: Listening on TCP port %i with sd=%i", 
 	    	    sslPort, m_ssltcp.m_sock );
 
+	// compress the static files once instead of on every request
+	if ( port || sslPort ) {
+		precompressDefaultCss();
+		HttpCompression::precompressStaticFiles ( g_hostdb.m_httpRootDir );
+	}
+
 	return true;
 }
 
@@ -994,6 +1001,30 @@ bool HttpServer::sendReply ( TcpSocket  *s , HttpRequest *r , bool isAdmin) {
 		logError("call sendErrorReply. 500 Bad request");
 		return sendErrorReply(s,500,mstrerror(g_errno));
 	}
+	// . small text files are sent compressed from memory if the client
+	//   takes it. they are compressed in a job the first time they are
+	//   asked for or when they have changed, and sent as-is until then
+	if ( ! partialContent && bytesToSend > 0 && g_conf.m_httpCompression &&
+	     HttpCompression::isCompressibleExtension ( ext ) ) {
+		http_encoding_t encoding =
+			HttpCompression::getAcceptedEncoding ( s->m_readBuf, s->m_readOffset );
+		const std::string *compressed =
+			HttpCompression::getStaticFile ( fullPath, lastModified, fileSize, encoding );
+		SafeBuf compressedMime;
+		if ( compressed &&
+		     HttpCompression::addEncodingToMime ( m.getMime(), m.getMimeLen(),
+							  compressed->size(), encoding,
+							  &compressedMime ) ) {
+			if ( g_conf.m_logDebugTcp )
+				log("tcp: deleting filestate=0x%" PTRFMT" [8]",
+				    (PTRTYPE)f);
+			mdelete ( f, sizeof(File), "HttpServer");
+			delete (f);
+			return sendReply2 ( compressedMime.getBufStart(), compressedMime.length(),
+					    compressed->data(), compressed->size(), s );
+		}
+	}
+
 	// . move the reply to a send buffer
 	// . don't make sendBuf bigger than g_httpMaxSendBufSize
 	int32_t mimeLen     = m.getMimeLen();
@@ -1079,6 +1110,33 @@ bool HttpServer::sendReply2 ( const char *mime,
 	int32_t myHostType = g_hostdb.m_myHost->m_type;
 	// get the server this socket uses
 	TcpServer *tcp = s->m_this;
+
+	// . compress the content if the client accepts gzip or brotli
+	// . not for ZET requests, those get compressed below, and not
+	//   for replies we forward as a proxy
+	SafeBuf compressedMime;
+	SafeBuf compressedContent;
+	if ( rb && rb[0] != 'Z' && ! alreadyCompressed && ! ( myHostType & HT_PROXY ) ) {
+		int32_t savedErrno = g_errno;
+		http_encoding_t encoding =
+			HttpCompression::getReplyEncoding ( rb, s->m_readOffset,
+							    mime, mimeLen, contentLen );
+		if ( encoding != HTTP_ENCODING_IDENTITY &&
+		     HttpCompression::compress ( encoding, g_conf.m_httpCompressionLevel,
+						 content, contentLen, &compressedContent ) &&
+		     compressedContent.length() < contentLen &&
+		     HttpCompression::addEncodingToMime ( mime, mimeLen,
+							  compressedContent.length(), encoding,
+							  &compressedMime ) ) {
+			mime       = compressedMime.getBufStart();
+			mimeLen    = compressedMime.length();
+			content    = compressedContent.getBufStart();
+			contentLen = compressedContent.length();
+		}
+		// if it failed we just send it uncompressed
+		g_errno = savedErrno;
+	}
+
 	// . move the reply to a send buffer
 	// . don't make sendBuf bigger than g_httpMaxSendBufSize
 	int32_t sendBufSize = mimeLen + contentLen;
@@ -13,6 +13,7 @@
 #include "HostFlags.h"
 #include "Process.h"
 #include "IOBuffer.h"
+#include "JobScheduler.h"
 #include <pthread.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -40,6 +41,7 @@
 //  dailyMergeCollnum
 //  repairMode
 //  totalDocsIndexed
+//  queuedJobs (optional, older instances don't send it)
 
 
 //We use two sockets toward the local Vagus instance. One for sending
@@ -130,6 +132,7 @@ static void process_alive_hosts(std::map<int,std::string> &alive_hosts) {
 		const char *daily_merge_collection_number_str = strtok_r(NULL,";",&ss);
 		const char *repair_mode_str = strtok_r(NULL,";",&ss);
 		const char *total_docs_indexed_str = strtok_r(NULL,";",&ss);
+		const char *queued_jobs_str = strtok_r(NULL,";",&ss);
 		if(!gb_version_str || gb_version_str[0]=='\0')
 			continue;
 		if(strlen(gb_version_str)>=sizeof(HostRuntimeInformation::m_gbVersionStr))
@@ -150,6 +153,12 @@ static void process_alive_hosts(std::map<int,std::string> &alive_hosts) {
 		int total_docs_indexed = (int)strtol(total_docs_indexed_str,&endptr,0);
 		if(endptr && *endptr)
 			continue;
+		int queued_jobs = 0;
+		if(queued_jobs_str) {
+			queued_jobs = (int)strtol(queued_jobs_str,&endptr,0);
+			if(endptr && *endptr)
+				continue;
+		}
 		
 		//phase 1: update host fields that seem safe
 		//when we get rid of PingServer entirely then this will take over
@@ -162,6 +171,7 @@ static void process_alive_hosts(std::map<int,std::string> &alive_hosts) {
 		hri.m_totalDocsIndexed = total_docs_indexed;
 		hri.m_hostsConfCRC = hosts_conf_crc;
 		hri.m_repairMode = repair_mode;
+		hri.m_queuedJobs = queued_jobs;
 		g_hostdb.updateHostRuntimeInformation(hostid, hri);
 		
 		//Host *h = g_hostdb.getHost(hostid);
@@ -344,13 +354,14 @@ void InstanceInfoExchange::weAreAlive() {
 		daily_merge_collection_number = g_dailyMerge.m_cr->m_collnum;
 
 	char extra_information[256];
-	sprintf(extra_information, "%s;%d;%d;%d;%d;%lu",
+	sprintf(extra_information, "%s;%d;%d;%d;%d;%lu;%u",
 	        getVersion(),
 		g_hostdb.getCRC(),
 		getOurHostFlags(),
 		daily_merge_collection_number,
 		g_repairMode,
-		g_process.getTotalDocsIndexed());
+		g_process.getTotalDocsIndexed(),
+		g_jobScheduler.num_queued_jobs());
 	
 	char command[256];
 	sprintf(command, "keepalive %s:%d:%u:%s\n",
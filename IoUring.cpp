@@ -0,0 +1,238 @@
+#include "IoUring.h"
+#include "Errno.h"
+#include "Log.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+	return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nrArgs) {
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+
+IoUring::IoUring()
+	: m_ringFd(-1)
+	, m_eventFd(-1)
+	, m_sqEntries(0)
+	, m_cqEntries(0)
+	, m_numQueued(0)
+	, m_sqRing(MAP_FAILED)
+	, m_sqRingSize(0)
+	, m_cqRing(MAP_FAILED)
+	, m_cqRingSize(0)
+	, m_sqes((struct io_uring_sqe *)MAP_FAILED)
+	, m_sqesSize(0)
+	, m_sqHead(NULL)
+	, m_sqTail(NULL)
+	, m_sqMask(NULL)
+	, m_sqArray(NULL)
+	, m_cqHead(NULL)
+	, m_cqTail(NULL)
+	, m_cqMask(NULL)
+	, m_cqes(NULL) {
+}
+
+
+IoUring::~IoUring() {
+	reset();
+}
+
+
+bool IoUring::init(unsigned entries) {
+	reset();
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	m_ringFd = sys_io_uring_setup(entries, &p);
+	if(m_ringFd < 0) {
+		g_errno = errno;
+		log(LOG_INFO, "disk: io_uring is not available: %s", mstrerror(g_errno));
+		return false;
+	}
+
+	m_sqEntries = p.sq_entries;
+	m_cqEntries = p.cq_entries;
+
+	m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		if(m_cqRingSize > m_sqRingSize) {
+			m_sqRingSize = m_cqRingSize;
+		}
+		m_cqRingSize = m_sqRingSize;
+	}
+
+	m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+	if(m_sqRing == MAP_FAILED) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: io_uring: mmap of submission ring failed: %s", mstrerror(g_errno));
+		reset();
+		return false;
+	}
+
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		m_cqRing = m_sqRing;
+	} else {
+		m_cqRing = mmap(NULL, m_cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+		if(m_cqRing == MAP_FAILED) {
+			g_errno = errno;
+			log(LOG_WARN, "disk: io_uring: mmap of completion ring failed: %s", mstrerror(g_errno));
+			reset();
+			return false;
+		}
+	}
+
+	m_sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+	m_sqes = (struct io_uring_sqe *)mmap(NULL, m_sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+	if(m_sqes == MAP_FAILED) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: io_uring: mmap of submission entries failed: %s", mstrerror(g_errno));
+		reset();
+		return false;
+	}
+
+	char *sq = (char *)m_sqRing;
+	m_sqHead  = (unsigned *)(sq + p.sq_off.head);
+	m_sqTail  = (unsigned *)(sq + p.sq_off.tail);
+	m_sqMask  = (unsigned *)(sq + p.sq_off.ring_mask);
+	m_sqArray = (unsigned *)(sq + p.sq_off.array);
+
+	char *cq = (char *)m_cqRing;
+	m_cqHead = (unsigned *)(cq + p.cq_off.head);
+	m_cqTail = (unsigned *)(cq + p.cq_off.tail);
+	m_cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+	m_cqes   = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	m_eventFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	if(m_eventFd < 0) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: io_uring: eventfd failed: %s", mstrerror(g_errno));
+		reset();
+		return false;
+	}
+
+	if(sys_io_uring_register(m_ringFd, IORING_REGISTER_EVENTFD, &m_eventFd, 1) < 0) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: io_uring: registering eventfd failed: %s", mstrerror(g_errno));
+		reset();
+		return false;
+	}
+
+	log(LOG_INFO, "disk: io_uring initialized with %u submission and %u completion entries", m_sqEntries, m_cqEntries);
+	return true;
+}
+
+
+void IoUring::reset() {
+	if(m_sqes != MAP_FAILED) {
+		munmap(m_sqes, m_sqesSize);
+		m_sqes = (struct io_uring_sqe *)MAP_FAILED;
+	}
+	if(m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+		munmap(m_cqRing, m_cqRingSize);
+	}
+	m_cqRing = MAP_FAILED;
+	if(m_sqRing != MAP_FAILED) {
+		munmap(m_sqRing, m_sqRingSize);
+		m_sqRing = MAP_FAILED;
+	}
+	if(m_eventFd >= 0) {
+		::close(m_eventFd);
+		m_eventFd = -1;
+	}
+	if(m_ringFd >= 0) {
+		::close(m_ringFd);
+		m_ringFd = -1;
+	}
+
+	m_sqEntries = 0;
+	m_cqEntries = 0;
+	m_numQueued = 0;
+	m_sqHead = m_sqTail = m_sqMask = m_sqArray = NULL;
+	m_cqHead = m_cqTail = m_cqMask = NULL;
+	m_cqes = NULL;
+}
+
+
+bool IoUring::queueRead(int fd, const struct iovec *iov, int64_t offset, uint64_t userData) {
+	// we are the only producer, the kernel only moves the head
+	unsigned tail = *m_sqTail;
+	unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+	if(tail - head >= m_sqEntries) {
+		return false;
+	}
+
+	unsigned idx = tail & *m_sqMask;
+	struct io_uring_sqe *sqe = &m_sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)iov;
+	sqe->len = 1;
+	sqe->off = offset;
+	sqe->user_data = userData;
+
+	m_sqArray[idx] = idx;
+	__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	m_numQueued++;
+	return true;
+}
+
+
+bool IoUring::submit() {
+	while(m_numQueued > 0) {
+		int rc = sys_io_uring_enter(m_ringFd, m_numQueued, 0, 0);
+		if(rc < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		m_numQueued -= rc;
+		if(rc == 0) {
+			// kernel didn't take any. try again with the next submit
+			errno = EAGAIN;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool IoUring::getCompletion(uint64_t *userData, int32_t *res) {
+	// we are the only consumer, the kernel only moves the tail
+	unsigned head = *m_cqHead;
+	unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+	if(head == tail) {
+		return false;
+	}
+
+	const struct io_uring_cqe *cqe = &m_cqes[head & *m_cqMask];
+	*userData = cqe->user_data;
+	*res = cqe->res;
+
+	__atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+
+void IoUring::clearEvent() {
+	eventfd_t value;
+	// non-blocking, fails with EAGAIN if nothing completed since last time
+	(void)eventfd_read(m_eventFd, &value);
+}
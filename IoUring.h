@@ -0,0 +1,81 @@
+#ifndef GB_IOURING_H
+#define GB_IOURING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// . a minimal io_uring submission/completion queue pair using the raw
+//   syscalls (we don't depend on liburing)
+// . completions are signalled on an eventfd so the ring can be polled by Loop
+// . not thread safe. Callers serialize queueing/submitting and reaping
+class IoUring {
+public:
+	IoUring();
+	~IoUring();
+
+	// . returns false and sets g_errno if the kernel doesn't support io_uring
+	bool init(unsigned entries);
+	void reset();
+
+	bool isInitialized() const { return m_ringFd >= 0; }
+
+	// readable when there are completions to reap
+	int getEventFd() const { return m_eventFd; }
+
+	unsigned getNumEntries() const { return m_sqEntries; }
+	unsigned getNumCompletionEntries() const { return m_cqEntries; }
+
+	// . queue a read of iov into the submission queue. the iovec must stay
+	//   valid until the read completes
+	// . returns false if the submission queue is full
+	bool queueRead(int fd, const struct iovec *iov, int64_t offset, uint64_t userData);
+
+	// number of reads queued and not yet handed to the kernel
+	unsigned getNumQueued() const { return m_numQueued; }
+
+	// . hand queued reads to the kernel
+	// . returns false and sets errno on error, in which case the reads stay
+	//   queued and are handed over by the next submit()
+	bool submit();
+
+	// . get the next completion. res is the read() return value or -errno
+	// . returns false if there is none
+	bool getCompletion(uint64_t *userData, int32_t *res);
+
+	// clear the eventfd counter before reaping
+	void clearEvent();
+
+private:
+	IoUring(const IoUring&);
+	IoUring& operator=(const IoUring&);
+
+	int m_ringFd;
+	int m_eventFd;
+
+	unsigned m_sqEntries;
+	unsigned m_cqEntries;
+	unsigned m_numQueued;
+
+	void *m_sqRing;
+	size_t m_sqRingSize;
+	void *m_cqRing;
+	size_t m_cqRingSize;
+	struct io_uring_sqe *m_sqes;
+	size_t m_sqesSize;
+
+	unsigned *m_sqHead;
+	unsigned *m_sqTail;
+	unsigned *m_sqMask;
+	unsigned *m_sqArray;
+
+	unsigned *m_cqHead;
+	unsigned *m_cqTail;
+	unsigned *m_cqMask;
+	struct io_uring_cqe *m_cqes;
+};
+
+#endif // GB_IOURING_H
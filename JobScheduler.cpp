@@ -1,6 +1,7 @@
 #include "JobScheduler.h"
 #include "ScopedLock.h"
 #include "BigFile.h" //for FileState definition
+#include "Statistics.h"
 #include <pthread.h>
 #include <vector>
 #include <list>
@@ -22,6 +23,13 @@ static uint64_t now_ms() {
 	return tv.tv_sec*1000 + tv.tv_usec/1000;
 }
 
+//return current time expressed as microseconds since 1970
+static uint64_t now_us() {
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec*(uint64_t)1000000 + tv.tv_usec;
+}
+
 
 
 
@@ -41,6 +49,8 @@ struct JobEntry {
 	//for statistics:
 	thread_type_t     thread_type;
 	uint64_t          queue_enter_time;   //when this job was queued
+	uint64_t          queue_enter_time_us;//same, in microseconds for the queue wait histograms
+	bool              stolen;             //run by an idle thread of another pool
 	uint64_t          start_time;	      //when this job started running
 	uint64_t          stop_time;	      //when this job stopped running
 	uint64_t          finish_time;        //when the finish callback was called
@@ -50,16 +60,50 @@ struct JobEntry {
 
 
 
+//Can an idle thread from another pool run jobs of this type? Only pure
+//CPU-bound jobs that never wait for other jobs qualify. Coordinator jobs wait
+//for intersection jobs so letting other pools run them could deadlock, and
+//I/O or external jobs would tie up the CPU threads.
+static bool is_stealable_thread_type(thread_type_t thread_type) {
+	switch(thread_type) {
+		case thread_type_query_constrain:
+		case thread_type_query_merge:
+		case thread_type_query_intersect:
+		case thread_type_query_summary:
+		case thread_type_spider_index:
+		case thread_type_index_merge:
+		case thread_type_verify_data:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+//work stealing configuration, shared by all pools and covered by the
+//scheduler mutex
+struct WorkStealingParameters {
+	bool enabled;
+	int  max_niceness;      //only jobs with this or a lower priority/niceness are stolen
+};
+
+
 //a set of jobs, prioritized
 class JobQueue : public std::vector<JobEntry> {
 public:
 	pthread_cond_t cond_not_empty;
 	unsigned potential_worker_threads;
+	unsigned idle_worker_threads;           //threads waiting on cond_not_empty
+	std::vector<JobQueue*> steal_from;      //queues the idle threads of this queue may take jobs from
+	std::vector<JobQueue*> thieves;         //queues whose idle threads may take jobs from this queue
 
 	JobQueue()
 	  : vector(),
 	    cond_not_empty PTHREAD_COND_INITIALIZER,
-	    potential_worker_threads(0)
+	    potential_worker_threads(0),
+	    idle_worker_threads(0),
+	    steal_from(),
+	    thieves()
 	{
 	}
 	
@@ -67,14 +111,30 @@ public:
 		pthread_cond_destroy(&cond_not_empty);
 	}
 	
-	void add(const JobEntry &e) {
+	void add(const JobEntry &e, const WorkStealingParameters &wsp) {
 		push_back(e);
+		//if all our own threads are busy then wake up an idle thread
+		//of another pool that can steal the job
+		if(idle_worker_threads==0 && is_stealable(e,wsp)) {
+			for(JobQueue *thief : thieves) {
+				if(thief->idle_worker_threads!=0) {
+					pthread_cond_signal(&thief->cond_not_empty);
+					return;
+				}
+			}
+		}
 		pthread_cond_signal(&cond_not_empty);
 	}
 	
-	JobEntry pop_top_priority();
-	
+	static bool is_stealable(const JobEntry &e, const WorkStealingParameters &wsp) {
+		return wsp.enabled &&
+		       e.initial_priority<=wsp.max_niceness &&
+		       is_stealable_thread_type(e.thread_type);
+	}
 	
+	JobEntry pop_top_priority();
+	bool has_stealable(const WorkStealingParameters &wsp) const;
+	JobEntry pop_top_stealable(const WorkStealingParameters &wsp);
 };
 
 
@@ -94,6 +154,29 @@ JobEntry JobQueue::pop_top_priority()
 }
 
 
+bool JobQueue::has_stealable(const WorkStealingParameters &wsp) const
+{
+	for(const auto &e : *this)
+		if(is_stealable(e,wsp))
+			return true;
+	return false;
+}
+
+
+JobEntry JobQueue::pop_top_stealable(const WorkStealingParameters &wsp)
+{
+	std::vector<JobEntry>::iterator best_iter = end();
+	for(std::vector<JobEntry>::iterator iter = begin(); iter!=end(); ++iter)
+		if(is_stealable(*iter,wsp) && (best_iter==end() || iter->initial_priority<best_iter->initial_priority))
+			best_iter = iter;
+	assert(best_iter!=end());
+	JobEntry tmp = *best_iter;
+	erase(best_iter);
+	tmp.stolen = true;
+	return tmp;
+}
+
+
 
 typedef std::vector<std::pair<JobEntry,job_exit_t>> ExitSet;
 typedef std::list<JobEntry> RunningSet;
@@ -106,6 +189,7 @@ struct PoolThreadParameters {
 	ExitSet           *exit_set;                  //set to store the finished job+exit-cause in
 	unsigned          *num_io_write_jobs_running; //global counter for scheduling
 	pthread_mutex_t   *mtx;                       //mutex covering above 3 containers
+	const WorkStealingParameters *wsp;            //covered by mtx too
 	job_done_notify_t job_done_notify;            //notifycation callback whenever a job returns
 	bool              stop;
 };
@@ -116,15 +200,28 @@ static void *job_pool_thread_function(void *pv) {
 	PoolThreadParameters *ptp= static_cast<PoolThreadParameters*>(pv);
 	pthread_mutex_lock(ptp->mtx);
 	while(!ptp->stop) {
-		if(ptp->job_queue->empty())
+		//own jobs first, then jobs we may steal from other pools
+		JobQueue *steal_queue = NULL;
+		if(ptp->job_queue->empty() && ptp->wsp->enabled) {
+			for(JobQueue *jq : ptp->job_queue->steal_from) {
+				if(jq->has_stealable(*ptp->wsp)) {
+					steal_queue = jq;
+					break;
+				}
+			}
+		}
+		if(ptp->job_queue->empty() && !steal_queue) {
+			ptp->job_queue->idle_worker_threads++;
 			pthread_cond_wait(&ptp->job_queue->cond_not_empty,ptp->mtx);
-		if(ptp->stop)
-			break;
-		if(ptp->job_queue->empty()) //spurious wakeup
+			ptp->job_queue->idle_worker_threads--;
+			//the queue may still be empty (spurious wakeup, or woken to steal
+			//a job), so look again
 			continue;
+		}
 		
 		//take the top-priority job and move it into the running set
-		RunningSet::iterator iter = ptp->running_set->insert(ptp->running_set->begin(),ptp->job_queue->pop_top_priority());
+		RunningSet::iterator iter = ptp->running_set->insert(ptp->running_set->begin(),
+		                                                     steal_queue ? steal_queue->pop_top_stealable(*ptp->wsp) : ptp->job_queue->pop_top_priority());
 		if(iter->is_io_job && iter->is_io_write_job)
 			++*(ptp->num_io_write_jobs_running);
 		pthread_mutex_unlock(ptp->mtx);
@@ -132,6 +229,7 @@ static void *job_pool_thread_function(void *pv) {
 		job_exit_t job_exit;
 		uint64_t now = now_ms();
 		iter->start_time = now;
+		Statistics::register_job_queue_time(iter->thread_type, now_us() - iter->queue_enter_time_us);
 		if(iter->start_deadline==0 || iter->start_deadline>now) {
 			// Clear g_errno so the thread/job starts with a clean slate
 			g_errno = 0;
@@ -172,6 +270,7 @@ public:
 	           JobQueue *job_queue, RunningSet *running_set, ExitSet *exit_set,
 		   unsigned *num_io_write_jobs_running,
 		   pthread_mutex_t *mtx,
+		   const WorkStealingParameters *wsp,
 		   job_done_notify_t job_done_notify_);
 	void initiate_stop();
 	void join_all();
@@ -188,6 +287,7 @@ ThreadPool::ThreadPool(const char *thread_name_prefix,
                        JobQueue *job_queue, RunningSet *running_set, ExitSet *exit_set,
 		       unsigned *num_io_write_jobs_running,
 		       pthread_mutex_t *mtx,
+		       const WorkStealingParameters *wsp,
                        job_done_notify_t job_done_notify_)
   : tid(num_threads)
 {
@@ -197,6 +297,7 @@ ThreadPool::ThreadPool(const char *thread_name_prefix,
 	ptp.exit_set = exit_set;
 	ptp.num_io_write_jobs_running = num_io_write_jobs_running;
 	ptp.mtx = mtx;
+	ptp.wsp = wsp;
 	ptp.job_done_notify = job_done_notify_?job_done_notify_:job_done_notify_noop;
 	ptp.stop = false;
 	for(unsigned i=0; i<tid.size(); i++) {
@@ -254,6 +355,8 @@ class JobScheduler_impl {
 	
 	unsigned   num_io_write_jobs_running;
 	
+	WorkStealingParameters work_stealing;
+	
 	ThreadPool coordinator_thread_pool;
 	ThreadPool cpu_thread_pool;
 	ThreadPool summary_thread_pool;
@@ -283,16 +386,23 @@ public:
 	    running_set(),
 	    exit_set(),
 	    num_io_write_jobs_running(0),
-	    coordinator_thread_pool("coord",num_coordinator_threads,&coordinator_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
-	    cpu_thread_pool("cpu",num_cpu_threads,&cpu_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
-	    summary_thread_pool("summary",num_summary_threads,&summary_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
-	    io_thread_pool("io",num_io_threads,&io_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
-	    external_thread_pool("ext",num_external_threads,&external_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
-	    file_meta_thread_pool("file",num_file_meta_threads,&file_meta_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
-	    merge_thread_pool("merge",num_merge_threads,&merge_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,job_done_notify),
+	    work_stealing(),
+	    coordinator_thread_pool("coord",num_coordinator_threads,&coordinator_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
+	    cpu_thread_pool("cpu",num_cpu_threads,&cpu_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
+	    summary_thread_pool("summary",num_summary_threads,&summary_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
+	    io_thread_pool("io",num_io_threads,&io_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
+	    external_thread_pool("ext",num_external_threads,&external_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
+	    file_meta_thread_pool("file",num_file_meta_threads,&file_meta_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
+	    merge_thread_pool("merge",num_merge_threads,&merge_job_queue,&running_set,&exit_set,&num_io_write_jobs_running,&mtx,&work_stealing,job_done_notify),
 	    no_threads(num_cpu_threads==0 && num_summary_threads==0 && num_io_threads==0 && num_external_threads==0 && num_file_meta_threads==0),
 	    new_jobs_allowed(true)
 	{
+		//the cpu and summary threads may run each others' jobs
+		ScopedLock sl(mtx);
+		cpu_job_queue.steal_from.push_back(&summary_job_queue);
+		summary_job_queue.thieves.push_back(&cpu_job_queue);
+		summary_job_queue.steal_from.push_back(&cpu_job_queue);
+		cpu_job_queue.thieves.push_back(&summary_job_queue);
 	}
 	
 	~JobScheduler_impl();
@@ -327,6 +437,8 @@ public:
 	}
 	void cancel_all_jobs_for_shutdown();
 	
+	void set_work_stealing(bool enabled, int max_niceness);
+	
 	unsigned num_queued_jobs() const;
 	
 	void cleanup_finished_jobs();
@@ -436,8 +548,9 @@ bool JobScheduler_impl::submit(thread_type_t thread_type, JobEntry &e)
 		return false;
 	
 	e.queue_enter_time = now_ms();
+	e.queue_enter_time_us = now_us();
 	ScopedLock sl(mtx);
-	job_queue->add(e);
+	job_queue->add(e,work_stealing);
 	return true;
 }
 
@@ -556,6 +669,16 @@ void JobScheduler_impl::cancel_all_jobs_for_shutdown() {
 
 
 
+void JobScheduler_impl::set_work_stealing(bool enabled, int max_niceness) {
+	ScopedLock sl(mtx);
+	work_stealing.enabled = enabled;
+	work_stealing.max_niceness = max_niceness;
+	//let idle threads look for jobs they can steal now
+	pthread_cond_broadcast(&cpu_job_queue.cond_not_empty);
+	pthread_cond_broadcast(&summary_job_queue.cond_not_empty);
+}
+
+
 unsigned JobScheduler_impl::num_queued_jobs() const
 {
 	ScopedLock sl(mtx);
@@ -577,6 +700,8 @@ void JobScheduler_impl::cleanup_finished_jobs()
 		
 		JobTypeStatistics &s = job_statistics[e.first.thread_type];
 		s.job_count++;
+		if(e.first.stolen)
+			s.stolen_count++;
 		s.queue_time += e.first.start_time - e.first.queue_enter_time;
 		s.running_time += e.first.stop_time - e.first.start_time;
 		s.done_time += e.first.finish_time - e.first.stop_time;
@@ -756,6 +881,12 @@ void JobScheduler::cancel_all_jobs_for_shutdown() {
 }
 
 
+void JobScheduler::set_work_stealing(bool enabled, int max_niceness) {
+	if(impl)
+		impl->set_work_stealing(enabled,max_niceness);
+}
+
+
 unsigned JobScheduler::num_queued_jobs() const
 {
 	if(impl)
@@ -794,3 +925,33 @@ std::map<thread_type_t,JobTypeStatistics> JobScheduler::query_job_statistics(boo
 // The global one-and-only scheduler
 
 JobScheduler g_jobScheduler;
+
+
+const char *thread_type_name(thread_type_t tt) {
+	switch(tt) {
+		case thread_type_query_coordinator:  return "query-coordinator";
+		case thread_type_query_read:         return "query-read";
+		case thread_type_query_constrain:    return "query-constrain";
+		case thread_type_query_merge:        return "query-merge";
+		case thread_type_query_intersect:    return "query-intersect";
+		case thread_type_query_summary:      return "query-summary";
+		case thread_type_spider_read:        return "spider-read";
+		case thread_type_spider_write:       return "spider-write";
+		case thread_type_spider_filter:      return "spider-filter";
+		case thread_type_spider_query:       return "spider-query";
+		case thread_type_spider_index:       return "spider-index";
+		case thread_type_merge_filter:       return "merge-filter";
+		case thread_type_replicate_write:    return "replicate-write";
+		case thread_type_replicate_read:     return "replicate-read";
+		case thread_type_file_merge:         return "file-merge";
+		case thread_type_file_meta_data:     return "file-meta-data";
+		case thread_type_index_merge:        return "index-merge";
+		case thread_type_index_generate:     return "index-generate";
+		case thread_type_verify_data:        return "verify-data";
+		case thread_type_statistics:         return "statistics";
+		case thread_type_unspecified_io:     return "unspecified IO";
+		case thread_type_generate_thumbnail: return "generate-thumbnail";
+		case thread_type_config_load:        return "config-load";
+		default: return "?";
+	}
+}
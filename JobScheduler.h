@@ -48,6 +48,9 @@ enum thread_type_t {
 	thread_type_config_load,
 };
 
+//short name of a thread type, for display purposes
+const char *thread_type_name(thread_type_t tt);
+
 
 
 //A digest of a job in the scheduler. For statistics and display purposes
@@ -70,6 +73,7 @@ struct JobDigest {
 //statistics for queue and execution time per thread type
 struct JobTypeStatistics {
 	uint64_t job_count;
+	uint64_t stolen_count;          //jobs run by an idle thread of another pool
 	uint64_t queue_time;            //time from enque to start, in nsecs
 	uint64_t running_time;          //time from start to stop, in nsecs
 	uint64_t done_time;             //time from stop to cleanup
@@ -115,6 +119,10 @@ public:
 	
 	void cancel_all_jobs_for_shutdown();
 	
+	//Let idle cpu and summary threads run each others' CPU-bound jobs
+	//with a priority/niceness of at most max_niceness
+	void set_work_stealing(bool enabled, int max_niceness);
+	
 	unsigned num_queued_jobs() const;
 	
 	void cleanup_finished_jobs();
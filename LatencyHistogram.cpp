@@ -0,0 +1,114 @@
+#include "LatencyHistogram.h"
+
+
+const int32_t LatencyHistogram::s_subBucketCount;
+const int32_t LatencyHistogram::s_subBucketHalf;
+const int32_t LatencyHistogram::s_maxShift;
+const int32_t LatencyHistogram::s_numBuckets;
+const int32_t LatencyHistogram::s_numStripes;
+
+
+// every thread sticks to one stripe, handed out round robin
+static std::atomic<uint32_t> s_nextStripe(0);
+static thread_local int32_t s_stripe = -1;
+
+static int32_t getStripe() {
+	if(s_stripe < 0)
+		s_stripe = s_nextStripe++ % LatencyHistogram::s_numStripes;
+	return s_stripe;
+}
+
+
+LatencyHistogram::LatencyHistogram() {
+	for(int32_t s = 0; s < s_numStripes; s++) {
+		for(int32_t i = 0; i < s_numBuckets; i++)
+			m_stripes[s].m_counts[i].store(0, std::memory_order_relaxed);
+		m_stripes[s].m_sum.store(0, std::memory_order_relaxed);
+		m_stripes[s].m_max.store(0, std::memory_order_relaxed);
+	}
+}
+
+
+int32_t LatencyHistogram::getBucketIndex(uint64_t value) {
+	if(value < (uint64_t)s_subBucketCount)
+		return (int32_t)value;
+	// shift the value down so it lands in [s_subBucketHalf,s_subBucketCount)
+	int32_t msb = 63 - __builtin_clzll(value);
+	int32_t shift = msb - 5;
+	if(shift > s_maxShift)
+		return s_numBuckets - 1;
+	return s_subBucketCount + (shift - 1) * s_subBucketHalf + (int32_t)((value >> shift) - s_subBucketHalf);
+}
+
+
+uint64_t LatencyHistogram::getBucketHighestValue(int32_t index) {
+	if(index < s_subBucketCount)
+		return (uint64_t)index;
+	int32_t shift = (index - s_subBucketCount) / s_subBucketHalf + 1;
+	uint64_t subBucket = (index - s_subBucketCount) % s_subBucketHalf + s_subBucketHalf;
+	return ((subBucket + 1) << shift) - 1;
+}
+
+
+void LatencyHistogram::record(uint64_t us) {
+	Stripe &stripe = m_stripes[getStripe()];
+	stripe.m_counts[getBucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+	stripe.m_sum.fetch_add(us, std::memory_order_relaxed);
+	uint64_t max = stripe.m_max.load(std::memory_order_relaxed);
+	while(us > max && !stripe.m_max.compare_exchange_weak(max, us, std::memory_order_relaxed))
+		;
+}
+
+
+void LatencyHistogram::getSnapshot(Snapshot *snapshot) const {
+	snapshot->m_counts.assign(s_numBuckets, 0);
+	snapshot->m_count = 0;
+	snapshot->m_sum = 0;
+	snapshot->m_max = 0;
+	for(int32_t s = 0; s < s_numStripes; s++) {
+		const Stripe &stripe = m_stripes[s];
+		for(int32_t i = 0; i < s_numBuckets; i++) {
+			uint64_t count = stripe.m_counts[i].load(std::memory_order_relaxed);
+			snapshot->m_counts[i] += count;
+			snapshot->m_count += count;
+		}
+		snapshot->m_sum += stripe.m_sum.load(std::memory_order_relaxed);
+		uint64_t max = stripe.m_max.load(std::memory_order_relaxed);
+		if(max > snapshot->m_max)
+			snapshot->m_max = max;
+	}
+}
+
+
+uint64_t LatencyHistogram::Snapshot::getValueAtPercentile(double percentile) const {
+	if(m_count == 0)
+		return 0;
+	if(percentile > 100.0)
+		percentile = 100.0;
+	uint64_t target = (uint64_t)(percentile / 100.0 * m_count + 0.5);
+	if(target < 1)
+		target = 1;
+	uint64_t seen = 0;
+	for(int32_t i = 0; i < (int32_t)m_counts.size(); i++) {
+		seen += m_counts[i];
+		if(seen >= target) {
+			uint64_t value = getBucketHighestValue(i);
+			return value < m_max ? value : m_max;
+		}
+	}
+	return m_max;
+}
+
+
+void LatencyHistogram::Snapshot::subtract(const Snapshot &earlier) {
+	m_count = 0;
+	m_max = 0;
+	for(int32_t i = 0; i < (int32_t)m_counts.size(); i++) {
+		if(i < (int32_t)earlier.m_counts.size())
+			m_counts[i] = m_counts[i] > earlier.m_counts[i] ? m_counts[i] - earlier.m_counts[i] : 0;
+		m_count += m_counts[i];
+		if(m_counts[i])
+			m_max = getBucketHighestValue(i);
+	}
+	m_sum = m_sum > earlier.m_sum ? m_sum - earlier.m_sum : 0;
+}
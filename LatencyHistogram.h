@@ -0,0 +1,63 @@
+#ifndef GB_LATENCYHISTOGRAM_H
+#define GB_LATENCYHISTOGRAM_H
+
+#include <inttypes.h>
+#include <atomic>
+#include <vector>
+
+// . HDR-style latency histogram of microsecond values
+// . log-linear buckets: values below 64 are exact, above that every power
+//   of two is split in 32 sub-buckets so the relative error is below 3%
+// . values above ~38 hours are counted in the last bucket
+// . recording is lock-free. Each thread records into one of a few stripes
+//   so the threads don't fight over the same cache lines. The stripes are
+//   summed when a snapshot is taken.
+class LatencyHistogram {
+public:
+	static const int32_t s_subBucketCount = 64;
+	static const int32_t s_subBucketHalf  = 32;
+	static const int32_t s_maxShift       = 31;
+	static const int32_t s_numBuckets     = s_subBucketCount + s_maxShift * s_subBucketHalf;
+	static const int32_t s_numStripes     = 8;
+
+	class Snapshot {
+	public:
+		Snapshot() : m_count(0), m_sum(0), m_max(0) {}
+
+		// . highest value that is equivalent to the value at the
+		//   percentile (0-100)
+		// . returns 0 if empty
+		uint64_t getValueAtPercentile(double percentile) const;
+
+		// . turn this into the values recorded since the "earlier"
+		//   snapshot of the same histogram was taken
+		// . the max becomes the top of the highest non-empty bucket
+		void subtract(const Snapshot &earlier);
+
+		std::vector<uint64_t> m_counts;
+		uint64_t m_count;
+		uint64_t m_sum;
+		uint64_t m_max;
+	};
+
+	LatencyHistogram();
+
+	void record(uint64_t us);
+
+	// sum the stripes. the counts of concurrent records may be missing
+	void getSnapshot(Snapshot *snapshot) const;
+
+	static int32_t getBucketIndex(uint64_t value);
+	static uint64_t getBucketHighestValue(int32_t index);
+
+private:
+	struct alignas(64) Stripe {
+		std::atomic<uint64_t> m_counts[s_numBuckets];
+		std::atomic<uint64_t> m_sum;
+		std::atomic<uint64_t> m_max;
+	};
+
+	Stripe m_stripes[s_numStripes];
+};
+
+#endif // GB_LATENCYHISTOGRAM_H
@@ -23,12 +23,17 @@
 #include <signal.h>
 #include <fcntl.h>      // fcntl()
 #include <sys/poll.h>   // POLLIN, POLLPRI, ...
+#include <sys/epoll.h>
 
 // raised from 5000 to 10000 because we have more UdpSlots now and Multicast
 // will call g_loop.registerSleepCallback() if it fails to get a UdpSlot to
 // send on.
 #define MAX_SLOTS 10000
 
+// max events we get from one epoll_wait(). the interest list is level
+// triggered so anything left over is returned by the next call.
+#define MAX_EPOLL_EVENTS 1024
+
 
 // TODO: . if signal queue overflows another signal is sent
 //       . capture that signal and use poll or something???
@@ -108,6 +113,36 @@ static int32_t s_numReadFds = 0;
 static int s_writeFds[MAX_NUM_FDS];
 static int32_t s_numWriteFds = 0;
 
+// the events each fd is currently registered for with epoll
+static uint32_t s_epollEvents[MAX_NUM_FDS];
+
+// . fds epoll refuses (regular files). like with select() they are always
+//   ready, so they are handed to the callbacks on every poll
+static bool s_isAlwaysReady[MAX_NUM_FDS];
+static int s_alwaysReadyFds[MAX_NUM_FDS];
+static int32_t s_numAlwaysReadyFds = 0;
+
+static void setAlwaysReady ( int fd, bool alwaysReady ) {
+	if ( s_isAlwaysReady[fd] == alwaysReady ) {
+		return;
+	}
+	s_isAlwaysReady[fd] = alwaysReady;
+	if ( alwaysReady ) {
+		s_alwaysReadyFds[s_numAlwaysReadyFds++] = fd;
+		return;
+	}
+	for ( int32_t i = 0 ; i < s_numAlwaysReadyFds ; i++ ) {
+		if ( s_alwaysReadyFds[i] == fd ) {
+			s_alwaysReadyFds[i] = s_alwaysReadyFds[--s_numAlwaysReadyFds];
+			break;
+		}
+	}
+}
+
+// fds doPoll() found ready
+static int s_readyReadFds[MAX_NUM_FDS];
+static int s_readyWriteFds[MAX_NUM_FDS];
+
 void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callback)(int fd,void *state), bool forReading) {
 	// bad fd
 	if(fd<0) {
@@ -137,7 +172,8 @@ void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callbac
 							s_readFds[i] = s_readFds[s_numReadFds-1];
 							s_numReadFds--;
 							// remove from select mask too
-							FD_CLR(fd,&s_selectMaskRead );
+							if(fd < FD_SETSIZE)
+								FD_CLR(fd,&s_selectMaskRead );
 							if(g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
 								log( "loop: unregistering read callback for fd=%i", fd );
 							}
@@ -150,7 +186,8 @@ void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callbac
 							s_writeFds[i] = s_writeFds[s_numWriteFds-1];
 							s_numWriteFds--;
 							// remove from select mask too
-							FD_CLR(fd,&s_selectMaskWrite);
+							if(fd < FD_SETSIZE)
+								FD_CLR(fd,&s_selectMaskWrite);
 							if(g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
 								log( LOG_DEBUG, "loop: unregistering write callback for fd=%" PRId32" from write #wrts=%" PRId32,
 								     ( int32_t ) fd, ( int32_t ) s_numWriteFds );
@@ -184,9 +221,83 @@ void Loop::unregisterCallback(Slot **slots, int fd, void *state, void (* callbac
 		m_minTick = min;
 	}
 
+	if ( fd < MAX_NUM_FDS ) {
+		updateEpollInterest ( fd, false );
+	}
+
 	return;
 }
 
+
+void Loop::updateEpollInterest ( int fd, bool registering ) {
+	if ( m_epollFd < 0 ) {
+		return;
+	}
+
+	uint32_t events = 0;
+	if ( m_readSlots[fd] ) {
+		events |= EPOLLIN;
+	}
+	if ( m_writeSlots[fd] ) {
+		events |= EPOLLOUT;
+	}
+
+	if ( events == s_epollEvents[fd] && ( !registering || events == 0 ) ) {
+		return;
+	}
+
+	struct epoll_event ev;
+	memset ( &ev, 0, sizeof(ev) );
+	ev.events = events;
+	ev.data.fd = fd;
+
+	// not in epoll
+	if ( s_isAlwaysReady[fd] && !registering ) {
+		if ( events == 0 ) {
+			setAlwaysReady ( fd, false );
+		}
+		s_epollEvents[fd] = events;
+		return;
+	}
+
+	int rc;
+	if ( events == 0 ) {
+		rc = epoll_ctl ( m_epollFd, EPOLL_CTL_DEL, fd, &ev );
+		// the fd may have been closed before it was unregistered, in
+		// which case the kernel already dropped it
+		if ( rc < 0 && (errno == ENOENT || errno == EBADF) ) {
+			rc = 0;
+		}
+	} else if ( s_epollEvents[fd] == 0 || registering ) {
+		rc = epoll_ctl ( m_epollFd, EPOLL_CTL_ADD, fd, &ev );
+		if ( rc < 0 && errno == EEXIST ) {
+			rc = epoll_ctl ( m_epollFd, EPOLL_CTL_MOD, fd, &ev );
+		}
+		// . epoll doesn't take regular files, e.g. static files
+		//   HttpServer sends
+		// . the fd may have been reused for one since last time
+		setAlwaysReady ( fd, rc < 0 && errno == EPERM );
+		if ( s_isAlwaysReady[fd] ) {
+			s_epollEvents[fd] = events;
+			return;
+		}
+	} else {
+		rc = epoll_ctl ( m_epollFd, EPOLL_CTL_MOD, fd, &ev );
+		// closed and reopened under the same number since last time
+		if ( rc < 0 && errno == ENOENT ) {
+			rc = epoll_ctl ( m_epollFd, EPOLL_CTL_ADD, fd, &ev );
+		}
+	}
+
+	if ( rc < 0 ) {
+		log( LOG_WARN, "loop: epoll_ctl(fd=%d, events=0x%x): %s", fd, events, strerror(errno) );
+		s_epollEvents[fd] = 0;
+		return;
+	}
+
+	s_epollEvents[fd] = events;
+}
+
 bool Loop::registerReadCallback(int fd, void *state, void (*callback)(int fd, void *state),
                                 const char *description, int32_t niceness) {
 	// the "true" answers the question "for reading?"
@@ -241,6 +352,13 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 		g_process.shutdownAbort(true);
 	}
 
+	// select() can't watch fds this big
+	if ( m_epollFd < 0 && fd >= FD_SETSIZE && fd < MAX_NUM_FDS ) {
+		g_errno = EBADENGINEER;
+		log( LOG_WARN, "loop: fd=%i is too big for select(). Enable epoll to use it.", fd );
+		return false;
+	}
+
 	if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
 		log( LOG_DEBUG, "loop: registering %s callback sd=%i", forReading ? "read" : "write", fd);
 	}
@@ -277,14 +395,16 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 		next = m_readSlots [ fd ];
 		m_readSlots  [ fd ] = s;
 		// if not already registered, add to list
-		if ( fd < MAX_NUM_FDS && ! FD_ISSET( fd,&s_selectMaskRead ) ) {
+		if ( fd < MAX_NUM_FDS && ! next ) {
 			// sanity
 			if ( s_numReadFds >= MAX_NUM_FDS){
 				g_process.shutdownAbort(true);
 			}
 			
 			s_readFds[s_numReadFds++] = fd;
-			FD_SET ( fd,&s_selectMaskRead  );
+			if ( fd < FD_SETSIZE ) {
+				FD_SET ( fd,&s_selectMaskRead  );
+			}
 		}
 	}
 	else {
@@ -292,14 +412,16 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 	 	m_writeSlots [ fd ] = s;
 	 	//FD_SET ( fd , &m_writefds );
 	 	// if not already registered, add to list
-	 	if ( fd<MAX_NUM_FDS && ! FD_ISSET ( fd,&s_selectMaskWrite ) ) {
+	 	if ( fd<MAX_NUM_FDS && ! next ) {
 	 		// sanity
 	 		if ( s_numWriteFds>=MAX_NUM_FDS){
 			    g_process.shutdownAbort(true);
 		    }
 
 	 		s_writeFds[s_numWriteFds++] = fd;
-	 		FD_SET ( fd,&s_selectMaskWrite  );
+	 		if ( fd < FD_SETSIZE ) {
+	 			FD_SET ( fd,&s_selectMaskWrite  );
+	 		}
 	 	}
 	}
 	// set our callback and state
@@ -329,6 +451,8 @@ bool Loop::addSlot(bool forReading, int fd, void *state, void (*callback)(int fd
 		return true;
 	}
 
+	updateEpollInterest ( fd, true );
+
 	// set fd non-blocking
 	return setNonBlocking(fd);
 }
@@ -370,6 +494,8 @@ void Loop::callCallbacks_ass ( bool forReading , int fd , int64_t now , int32_t
 	// ensure we called something
 	int32_t numCalled = 0;
 
+	int callbackType = fd == MAX_NUM_FDS ? callback_type_sleep : (forReading ? callback_type_read : callback_type_write);
+
 	// . now call all the callbacks
 	// . most will re-register themselves (i.e. call registerCallback...()
 	while ( s ) {
@@ -417,9 +543,15 @@ void Loop::callCallbacks_ass ( bool forReading , int fd , int64_t now , int32_t
 
 		m_slotMutex.unlock();
 		{
-			int64_t start = gettimeofdayInMilliseconds();
+			uint64_t start = gettimeofdayInMicroseconds();
 			s->m_callback(fd, s->m_state);
-			took = gettimeofdayInMilliseconds() - start;
+			uint64_t tookUs = gettimeofdayInMicroseconds() - start;
+			m_stats.m_numCallbacks[callbackType]++;
+			m_stats.m_callbackTime[callbackType] += tookUs;
+			FdTypeStats &fdTypeStats = m_fdTypeStats[s->m_description];
+			fdTypeStats.m_numCallbacks++;
+			fdTypeStats.m_callbackTime += tookUs;
+			took = tookUs / 1000;
 		}
 		m_slotMutex.lock();
 
@@ -441,6 +573,15 @@ void Loop::callCallbacks_ass ( bool forReading , int fd , int64_t now , int32_t
 	m_callbacksNext = NULL;
 }
 
+void Loop::getFdTypeStats ( std::map<std::string,FdTypeStats> *fdTypeStats ) const {
+	fdTypeStats->clear();
+	for ( const auto &it : m_fdTypeStats ) {
+		FdTypeStats &stats = (*fdTypeStats)[it.first ? it.first : "unknown"];
+		stats.m_numCallbacks += it.second.m_numCallbacks;
+		stats.m_callbackTime += it.second.m_callbackTime;
+	}
+}
+
 Loop::Loop()
   : m_callbacksNext(NULL),
     m_slotMutex(),
@@ -458,6 +599,8 @@ Loop::Loop()
 	m_slots = NULL;
 	m_pipeFd[0] = -1;
 	m_pipeFd[1] = -1;
+	m_epollFd = -1;
+	memset(&m_stats, 0, sizeof(m_stats));
 	m_shutdown = 0;
 	m_minTick = 40;
 	m_head = NULL;
@@ -475,6 +618,10 @@ Loop::~Loop ( ) {
 		close(m_pipeFd[1]);
 		m_pipeFd[1] = -1;
 	}
+	if(m_epollFd>=0) {
+		close(m_epollFd);
+		m_epollFd = -1;
+	}
 }
 
 // returns NULL and sets g_errno if none are left
@@ -510,6 +657,34 @@ bool Loop::init ( ) {
 	setNonBlocking(m_pipeFd[1]);
 	FD_SET(m_pipeFd[0],&s_selectMaskRead);
 
+	// pick the backend. fall back to select() if epoll isn't available
+	memset(s_epollEvents, 0, sizeof(s_epollEvents));
+	memset(s_isAlwaysReady, 0, sizeof(s_isAlwaysReady));
+	s_numAlwaysReadyFds = 0;
+	if(g_conf.m_useEpoll) {
+		m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if(m_epollFd < 0) {
+			log(LOG_WARN,"loop: epoll_create1() failed with errno=%d. Using select()",errno);
+		} else {
+			struct epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.fd = m_pipeFd[0];
+			if(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_pipeFd[0], &ev) != 0) {
+				log(LOG_WARN,"loop: epoll_ctl() failed with errno=%d. Using select()",errno);
+				close(m_epollFd);
+				m_epollFd = -1;
+			}
+		}
+	}
+	log(LOG_INFO,"loop: Using %s for polling fds", m_epollFd>=0 ? "epoll" : "select");
+
+	// in case anything registered before we were initialized
+	for(int fd = 0; fd < MAX_NUM_FDS; fd++) {
+		if(m_readSlots[fd] || m_writeSlots[fd])
+			updateEpollInterest(fd, true);
+	}
+
 	// sighupHandler() will set this to true so we know when to shutdown
 	m_shutdown  = 0;
 	// . reset this cuz we have no sleep callbacks right now
@@ -687,30 +862,16 @@ static void cleanupFinishedJobs() {
 }
 
 
-//--- TODO: flush the signal queue after polling until done
-//--- are we getting stale signals resolved by flush so we get
-//--- read event on a socket that isnt in read mode???
-// TODO: set signal handler to SIG_DFL to prevent signals from queuing up now
-// . this handles high priority fds first (lowest niceness)
-void Loop::doPoll ( ) {
-	// set time
-	//g_now = gettimeofdayInMilliseconds();
-
-	logDebug( g_conf.m_logDebugLoop, "loop: Entered doPoll." );
-
-	if(g_udpServer.needBottom()) {
-		g_udpServer.makeCallbacks(1);
-	}
-
-	if(m_lastKeepaliveTimestamp + g_conf.m_vagusKeepaliveSendInterval <= gettimeofdayInMilliseconds()) {
-		m_lastKeepaliveTimestamp = gettimeofdayInMilliseconds();
-		InstanceInfoExchange::weAreAlive();
-	}
-
-	GbDns::makeCallbacks();
+// drain the wakeup pipe
+static void drainPipe ( int fd ) {
+	char buf[32];
+	ssize_t ignored __attribute__((unused)) = read( fd, buf, sizeof(buf) ); // shut up gcc warning: ignoring return value
+}
 
-	int32_t n;
 
+// . returns number of ready fds or -1 on error
+// . select() backend. O(max fd) per call
+int32_t Loop::waitSelect ( int *readyRead, int32_t *numReadyRead, int *readyWrite, int32_t *numReadyWrite ) {
 	timeval v;
 	v.tv_sec  = 0;
 	// 10ms for sleepcallbacks so they can be called...
@@ -723,8 +884,6 @@ void Loop::doPoll ( ) {
 	fd_set readfds = s_selectMaskRead;
 	fd_set writefds = s_selectMaskWrite;
 
-	logDebug( g_conf.m_logDebugLoop, "loop: in select" );
-
 	// . poll the fd's searching for socket closes
 	// . the sigalrms and sigvtalrms and SIGCHLDs knock us out of this
 	//   select() with n < 0 and errno equal to EINTR.
@@ -732,16 +891,16 @@ void Loop::doPoll ( ) {
 	//   then when running disableTimer() above and we don't get
 	//   any EINTRs... can we mask those out here? it only seems to be
 	//   the SIGALRMs not the SIGVTALRMs that interrupt us.
-	n = select (MAX_NUM_FDS,
-		    &readfds,
-		    &writefds,
-		    NULL,//&exceptfds,
-		    &v );
+	int32_t n = select (FD_SETSIZE,
+			    &readfds,
+			    &writefds,
+			    NULL,//&exceptfds,
+			    &v );
 
 	if(n<0) {
 		g_errno = errno;
 		log( LOG_WARN, "loop: select: %s.", strerror( g_errno ) );
-		return;
+		return -1;
 	}
 	
 	errno = 0;
@@ -749,7 +908,7 @@ void Loop::doPoll ( ) {
 	logDebug( g_conf.m_logDebugLoop, "loop: select() returned %d", n);
 
 	if (g_conf.m_logDebugLoop || g_conf.m_logDebugTcp) {
-		for ( int32_t i = 0; i < MAX_NUM_FDS; i++) {
+		for ( int32_t i = 0; i < FD_SETSIZE; i++) {
 			// continue if not set for reading
 			if ( FD_ISSET ( i, &readfds ) ) {
 				log( LOG_DEBUG, "loop: fd=%" PRId32" is on for read", i);
@@ -757,44 +916,155 @@ void Loop::doPoll ( ) {
 			if ( FD_ISSET ( i, &writefds ) ) {
 				log( LOG_DEBUG, "loop: fd=%" PRId32" is on for write", i);
 			}
-			// if niceness is not -1, handle it below
 		}
 	}
 
-	cleanupFinishedJobs();
-
-	const int64_t now = gettimeofdayInMilliseconds();
-
 	if( n > 0 && FD_ISSET( m_pipeFd[0], &readfds ) ) {
-		//drain the wakeup pipe
-		char buf[32];
-		ssize_t ignored __attribute__((unused)) = read( m_pipeFd[0], buf, sizeof(buf) ); // shut up gcc warning: ignoring return value
+		drainPipe( m_pipeFd[0] );
 		n--;
-		FD_CLR( m_pipeFd[0], &readfds );
 	}
 
-	// now keep this fast, too. just check fds we need to.
-	for ( int32_t i = 0 ; i < s_numReadFds ; i++ ) {
-		if ( n == 0 ) break;
+	// just check fds we need to
+	for ( int32_t i = 0 ; i < s_numReadFds && *numReadyRead + *numReadyWrite < n ; i++ ) {
 		int fd = s_readFds[i];
+		if ( fd < FD_SETSIZE && FD_ISSET ( fd , &readfds ) ) {
+			readyRead[(*numReadyRead)++] = fd;
+		}
+	}
+	for ( int32_t i = 0 ; i < s_numWriteFds && *numReadyRead + *numReadyWrite < n ; i++ ) {
+		int fd = s_writeFds[i];
+		if ( fd < FD_SETSIZE && FD_ISSET ( fd , &writefds ) ) {
+			readyWrite[(*numReadyWrite)++] = fd;
+		}
+	}
+
+	return n;
+}
+
+
+// . returns number of ready fds or -1 on error
+// . epoll backend. level triggered so it behaves like select()
+int32_t Loop::waitEpoll ( int *readyRead, int32_t *numReadyRead, int *readyWrite, int32_t *numReadyWrite ) {
+	static struct epoll_event s_events[MAX_EPOLL_EVENTS];
+
+	// . 10ms for sleepcallbacks so they can be called
+	// . don't wait if there are always ready fds
+	int n = epoll_wait ( m_epollFd, s_events, MAX_EPOLL_EVENTS, s_numAlwaysReadyFds > 0 ? 0 : 10 );
+
+	if ( n < 0 ) {
+		g_errno = errno;
+		// signals knock us out of here too
+		if ( errno != EINTR ) {
+			log( LOG_WARN, "loop: epoll_wait: %s.", strerror( g_errno ) );
+		}
+		return -1;
+	}
+
+	errno = 0;
+
+	logDebug( g_conf.m_logDebugLoop, "loop: epoll_wait() returned %d", n);
+
+	for ( int i = 0 ; i < n ; i++ ) {
+		int fd = s_events[i].data.fd;
+		uint32_t events = s_events[i].events;
+
+		if ( fd == m_pipeFd[0] ) {
+			drainPipe( fd );
+			continue;
+		}
+
+		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
+			log( LOG_DEBUG, "loop: fd=%d got events 0x%x", fd, events);
+		}
+
+		// like select() errors and hangups make the fd both readable
+		// and writable so the callbacks find out about it
+		if ( events & (EPOLLERR|EPOLLHUP) ) {
+			events |= EPOLLIN|EPOLLOUT;
+		}
+		if ( (events & EPOLLIN) && m_readSlots[fd] ) {
+			readyRead[(*numReadyRead)++] = fd;
+		}
+		if ( (events & EPOLLOUT) && m_writeSlots[fd] ) {
+			readyWrite[(*numReadyWrite)++] = fd;
+		}
+	}
+
+	for ( int32_t i = 0 ; i < s_numAlwaysReadyFds ; i++ ) {
+		int fd = s_alwaysReadyFds[i];
+		if ( m_readSlots[fd] ) {
+			readyRead[(*numReadyRead)++] = fd;
+		}
+		if ( m_writeSlots[fd] ) {
+			readyWrite[(*numReadyWrite)++] = fd;
+		}
+	}
+
+	return *numReadyRead + *numReadyWrite;
+}
+
+
+//--- TODO: flush the signal queue after polling until done
+//--- are we getting stale signals resolved by flush so we get
+//--- read event on a socket that isnt in read mode???
+// TODO: set signal handler to SIG_DFL to prevent signals from queuing up now
+// . this handles high priority fds first (lowest niceness)
+void Loop::doPoll ( ) {
+	// set time
+	//g_now = gettimeofdayInMilliseconds();
+
+	logDebug( g_conf.m_logDebugLoop, "loop: Entered doPoll." );
+
+	if(g_udpServer.needBottom()) {
+		g_udpServer.makeCallbacks(1);
+	}
+
+	if(m_lastKeepaliveTimestamp + g_conf.m_vagusKeepaliveSendInterval <= gettimeofdayInMilliseconds()) {
+		m_lastKeepaliveTimestamp = gettimeofdayInMilliseconds();
+		InstanceInfoExchange::weAreAlive();
+	}
+
+	GbDns::makeCallbacks();
+
+	int32_t numReadyRead = 0;
+	int32_t numReadyWrite = 0;
+
+	logDebug( g_conf.m_logDebugLoop, "loop: in %s", m_epollFd >= 0 ? "epoll_wait" : "select" );
+
+	int32_t n;
+	if ( m_epollFd >= 0 ) {
+		n = waitEpoll ( s_readyReadFds, &numReadyRead, s_readyWriteFds, &numReadyWrite );
+	} else {
+		n = waitSelect ( s_readyReadFds, &numReadyRead, s_readyWriteFds, &numReadyWrite );
+	}
+
+	if ( n < 0 ) {
+		return;
+	}
+
+	m_stats.m_numWakeups++;
+	m_stats.m_numReadyFds += numReadyRead + numReadyWrite;
+
+	cleanupFinishedJobs();
+
+	const int64_t now = gettimeofdayInMilliseconds();
+
+	// now keep this fast, too. just check fds that are ready.
+	for ( int32_t i = 0 ; i < numReadyRead ; i++ ) {
+		int fd = s_readyReadFds[i];
 		Slot *s = m_readSlots  [ fd ];
 	 	// if niceness is not 0, handle it below
 		if ( s && s->m_niceness > 0 ) continue;
-		// must be set
-		if ( ! FD_ISSET ( fd , &readfds ) ) continue;
 		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
 			log( LOG_DEBUG, "loop: calling cback0 niceness=%" PRId32" fd=%i", s ? s->m_niceness : -1, fd );
 		}
 		callCallbacks_ass (true,fd, now,0);//read?
 	}
-	for ( int32_t i = 0 ; i < s_numWriteFds ; i++ ) {
-		if ( n == 0 ) break;
-		int fd = s_writeFds[i];
+	for ( int32_t i = 0 ; i < numReadyWrite ; i++ ) {
+		int fd = s_readyWriteFds[i];
 		Slot *s = m_writeSlots  [ fd ];
 	 	// if niceness is not 0, handle it below
 		if ( s && s->m_niceness > 0 ) continue;
-		// fds are always ready for writing so take this out.
-		if ( ! FD_ISSET ( fd , &writefds ) ) continue;
 		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
 			log( LOG_DEBUG, "loop: calling wcback0 niceness=%" PRId32" fd=%i", s ? s->m_niceness : -1, fd );
 		}
@@ -804,36 +1074,25 @@ void Loop::doPoll ( ) {
 	cleanupFinishedJobs();
 
 	// now for lower priority fds
-	for ( int32_t i = 0 ; i < s_numReadFds ; i++ ) {
-		if ( n == 0 ) break;
-		int fd = s_readFds[i];
+	for ( int32_t i = 0 ; i < numReadyRead ; i++ ) {
+		int fd = s_readyReadFds[i];
 		Slot *s = m_readSlots  [ fd ];
 	  	// if niceness is <= 0 we did it above
 		if ( s && s->m_niceness <= 0 ) continue;
-		// must be set
-		if ( ! FD_ISSET ( fd , &readfds ) ) continue;
 		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
 			log( LOG_DEBUG, "loop: calling cback1 fd=%i", fd );
 		}
 		callCallbacks_ass (true,fd, now,1);//read?
 	}
 
-	for ( int32_t i = 0 ; i < s_numWriteFds ; i++ ) {
-		if ( n == 0 ) {
-			break;
-		}
-
-	 	int fd = s_writeFds[i];
+	for ( int32_t i = 0 ; i < numReadyWrite ; i++ ) {
+	 	int fd = s_readyWriteFds[i];
 		Slot *s = m_writeSlots[fd];
 
 	  	// if niceness is <= 0 we did it above
 	 	if ( s && s->m_niceness <= 0 ) {
 	 		continue;
 	 	}
-	 	// must be set
-	 	if ( ! FD_ISSET ( fd , &writefds ) ) {
-	 		continue;
-	 	}
 		if ( g_conf.m_logDebugLoop || g_conf.m_logDebugTcp ) {
 			if( s ) {
 				log( LOG_DEBUG, "loop: calling wcback1 niceness=%" PRId32" fd=%i", s->m_niceness, fd );
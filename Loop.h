@@ -7,6 +7,9 @@
 #define GB_LOOP_H
 
 #include "GbMutex.h"
+#include <map>
+#include <string>
+#include <unordered_map>
 
 
 int gbsystem(const char *cmd);
@@ -21,8 +24,10 @@ void printStackTrace (bool print_location = false);
 class Slot;
 
 
-// linux 2.2 kernel has this limitation
-#define MAX_NUM_FDS 1024
+// . max fd we can register callbacks for
+// . the select() backend can only handle fds below FD_SETSIZE (1024), the
+//   epoll backend handles all of them
+#define MAX_NUM_FDS 8192
 
 
 // . niceness can only be 0, 1 or 2
@@ -99,8 +104,44 @@ class Loop {
 
 	// called when sigqueue overflows and we gotta do a select() or poll()
 	void doPoll ( );
+
+	// callback types for the counters below
+	enum {
+		callback_type_read = 0,
+		callback_type_write,
+		callback_type_sleep,
+		callback_type_end
+	};
+
+	// counters shown on the stats page. only touched by the main thread.
+	struct Stats {
+		int64_t m_numWakeups;                           //times select()/epoll_wait() returned
+		int64_t m_numReadyFds;                          //ready fds returned by them
+		int64_t m_numCallbacks[callback_type_end];      //callbacks called
+		int64_t m_callbackTime[callback_type_end];      //microseconds spent in callbacks
+	};
+	const Stats &getStats() const { return m_stats; }
+
+	// calls and time per kind of fd. the kind is the description given
+	// when the callback was registered (tcp read, udp send, disk read...)
+	struct FdTypeStats {
+		int64_t m_numCallbacks;
+		int64_t m_callbackTime;                         //microseconds
+	};
+	void getFdTypeStats ( std::map<std::string,FdTypeStats> *fdTypeStats ) const;
+
+	bool isUsingEpoll() const { return m_epollFd >= 0; }
  private:
 
+	// wait for ready fds and store them in readyRead/readyWrite
+	int32_t waitSelect ( int *readyRead, int32_t *numReadyRead, int *readyWrite, int32_t *numReadyWrite );
+	int32_t waitEpoll  ( int *readyRead, int32_t *numReadyRead, int *readyWrite, int32_t *numReadyWrite );
+
+	// . make the epoll interest set of "fd" match the registered callbacks
+	// . "registering" always tells the kernel, because the fd may have been
+	//   closed and reused since we last did
+	void updateEpollInterest ( int fd, bool registering );
+
 
 	void unregisterCallback ( Slot **slots , int fd , void *state ,
 				  void (* callback)(int fd,void *state) ,
@@ -138,6 +179,13 @@ class Loop {
 	GbMutex m_slotMutex; //protects all slot linked list modification and traversal
 	
 	int m_pipeFd[2]; //used for waking up from select/poll
+
+	int m_epollFd; //-1 if using select()
+
+	Stats m_stats;
+	// keyed by the description pointer so the callback path doesn't
+	// allocate. getFdTypeStats() merges equal descriptions
+	std::unordered_map<const char *, FdTypeStats> m_fdTypeStats;
 	
 	int64_t m_lastKeepaliveTimestamp;
 };
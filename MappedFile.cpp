@@ -0,0 +1,67 @@
+#include "MappedFile.h"
+#include "Errno.h"
+#include "Log.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+MappedFile::MappedFile()
+	: m_data(NULL)
+	, m_size(0) {
+}
+
+
+MappedFile::~MappedFile() {
+	unmap();
+}
+
+
+bool MappedFile::map(const char *filename) {
+	unmap();
+
+	int fd = ::open(filename, O_RDONLY);
+	if(fd < 0) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: Could not open %s for mapping: %s", filename, mstrerror(g_errno));
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: Could not stat %s: %s", filename, mstrerror(g_errno));
+		::close(fd);
+		return false;
+	}
+
+	if(st.st_size <= 0) {
+		g_errno = EBADENGINEER;
+		::close(fd);
+		return false;
+	}
+
+	void *p = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the fd is closed
+	::close(fd);
+	if(p == MAP_FAILED) {
+		g_errno = errno;
+		log(LOG_WARN, "disk: Could not mmap %s: %s", filename, mstrerror(g_errno));
+		return false;
+	}
+
+	m_data = (char *)p;
+	m_size = st.st_size;
+	return true;
+}
+
+
+void MappedFile::unmap() {
+	if(m_data) {
+		munmap(m_data, m_size);
+		m_data = NULL;
+		m_size = 0;
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef GB_MAPPEDFILE_H
+#define GB_MAPPEDFILE_H
+
+#include <stddef.h>
+
+// . a private (copy-on-write) memory mapping of a whole file
+// . pages not written to are shared with the kernel page cache and with
+//   other processes mapping the same file, and are loaded on first access
+// . writes to the mapping are never written back to the file
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	// . returns false and sets g_errno on error
+	// . an empty file cannot be mapped
+	bool map(const char *filename);
+	void unmap();
+
+	bool isMapped() const { return m_data != NULL; }
+
+	char *getData() { return m_data; }
+	const char *getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+	// is "p" inside the mapping?
+	bool contains(const void *p) const {
+		return m_data && (const char *)p >= m_data && (const char *)p < m_data + m_size;
+	}
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	char *m_data;
+	size_t m_size;
+};
+
+#endif // GB_MAPPEDFILE_H
@@ -126,6 +126,8 @@ bool Msg13::registerHandler ( ) {
 	int32_t maxCacheNodesRobots = memRobots / 106;
 	int32_t maxCacheNodesOthers = memOthers / (10*1024);
 
+	// . not sharded. a page can be nearly as big as the whole cache and
+	//   would not fit in a shard
 	if ( ! s_httpCacheRobots.init ( memRobots ,
 					-1        , // fixedDataSize
 					maxCacheNodesRobots ,
@@ -513,7 +515,7 @@ void handleRequest13 ( UdpSlot *slot , int32_t niceness  ) {
 	// the key is just the 64 bit hash of the url
 	key96_t k; k.n1 = 0; k.n0 = r->m_cacheKey;
 	// see if in there already
-	RdbCacheLock rcl(*c);
+	RdbCacheLock rcl(*c,(const char *)&k);
 	bool inCache = c->getRecord ( (collnum_t)0     , // share btwn colls
 					k                , // cacheKey
 					&rec             ,
@@ -1758,7 +1760,7 @@ void gotHttpReply2 ( void *state ,
 		char *serializeCacheData = serializeMsg(sizeof(cacheData), &cacheData.size_reply, &cacheData.size_reply, &cacheData.ptr_reply, &cacheData, &serializeCacheDataSize, NULL, 0);
 
 		// add it, use a generic collection
-		RdbCacheLock rcl(*c);
+		RdbCacheLock rcl(*c,(const char *)&k);
 		c->addRecord((collnum_t) 0, k, serializeCacheData, serializeCacheDataSize);
 
 		// ignore errors caching it
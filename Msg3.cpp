@@ -390,6 +390,8 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 
 	// . now start reading/scanning the files
 	// . our m_scans array starts at 0
+	// . hand all the file reads to the kernel together
+	BigFile::beginReadBatch();
 	for ( int32_t i = 0 ; i < m_numFileNums ; i++ ) {
 		// get the page range
 
@@ -581,6 +583,12 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 		}
 		
 
+		// . let the kernel start on big reads right away. the read
+		//   itself may wait for a free disk thread, and Msg2 plans
+		//   the reads of all query terms before any of them is done
+		if ( g_conf.m_readPrefetchMinSize > 0 && bytesToRead >= g_conf.m_readPrefetchMinSize )
+			ff->prefetch ( offset, bytesToRead );
+
 		// . do the scan/read of file #i
 		// . this returns false if blocked, true otherwise
 		// . this will set g_errno on error
@@ -605,6 +613,7 @@ bool Msg3::readList  ( rdbid_t           rdbId,
 			break; 
 		}
 	}
+	BigFile::endReadBatch();
 
 	{
 		ScopedLock sl(m_mtxScanCounters);
@@ -11,7 +11,12 @@
 #include "Conf.h"
 #include "Mem.h"
 #include "GbSignature.h"
+#include "Hostdb.h"
+#include "QueryTrace.h"
 #include <new>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 #include "ScopedLock.h"
 #include <pthread.h>
 #include <assert.h>
@@ -23,6 +28,9 @@
 
 static const int signature_init = 0x2c9a3f0e;
 
+// starts at the startup time so a restarted host doesn't reuse an old one
+static std::atomic<uint32_t> s_indexGeneration((uint32_t)time(NULL));
+
 
 // called to send back the reply
 static void  sendReply         ( UdpSlot *slot         ,
@@ -78,6 +86,105 @@ static void JobFinishedCallback(void *state) {
 	assert(rc==0);
 }
 
+
+//Counts outstanding sub-tasks (list reads or intersections) of a parallel
+//intersection so the coordinator thread can wait for all of them
+class PendingJobs {
+public:
+	declare_signature
+	int pending;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	PendingJobs()
+	  : pending(0)
+	{
+		pthread_mutex_init(&mtx,NULL);
+		pthread_cond_init(&cond,NULL);
+		set_signature();
+	}
+	~PendingJobs() {
+		verify_signature();
+		pthread_mutex_destroy(&mtx);
+		pthread_cond_destroy(&cond);
+		clear_signature();
+	}
+	void add() {
+		verify_signature();
+		ScopedLock sl(mtx);
+		pending++;
+	}
+	void done() {
+		verify_signature();
+		ScopedLock sl(mtx);
+		assert(pending>0);
+		pending--;
+		if(pending==0) {
+			int rc = pthread_cond_signal(&cond);
+			assert(rc==0);
+		}
+	}
+	void wait_for_all() {
+		verify_signature();
+		ScopedLock sl(mtx);
+		while(pending!=0)
+			pthread_cond_wait(&cond,&mtx);
+	}
+};
+
+
+//A (posdb file, docid range) slice of a query. When intersecting in parallel
+//each slice has its own query terms, lists, PosdbTable and TopTree
+class IntersectionWorkUnit {
+public:
+	declare_signature
+	PendingJobs *pendingJobs;
+	int fileNum;          //file number, or numFiles for the tree
+	int64_t docIdStart;
+	int64_t docIdEnd;
+	Query query;
+	Msg2 msg2;
+	RdbList *lists;
+	DocumentIndexChecker documentIndexChecker;
+	PosdbTable posdbTable;
+	TopTree toptree;
+	int32_t err;
+	IntersectionWorkUnit(RdbBase *base, PendingJobs *pendingJobs_, int fileNum_, int64_t docIdStart_, int64_t docIdEnd_)
+	  : pendingJobs(pendingJobs_),
+	    fileNum(fileNum_),
+	    docIdStart(docIdStart_),
+	    docIdEnd(docIdEnd_),
+	    lists(NULL),
+	    documentIndexChecker(base),
+	    err(0)
+	{
+		documentIndexChecker.setFileNum(fileNum);
+		set_signature();
+	}
+	~IntersectionWorkUnit() {
+		verify_signature();
+		delete[] lists;
+		lists = NULL;
+		msg2.reset();
+		posdbTable.reset();
+		clear_signature();
+	}
+};
+
+static void workUnitGotListsCallback(void *state) {
+	IntersectionWorkUnit *unit = static_cast<IntersectionWorkUnit*>(state);
+	verify_signature_at(unit->signature);
+	unit->pendingJobs->done();
+}
+
+static void workUnitIntersectThreadFunction(void *state) {
+	IntersectionWorkUnit *unit = static_cast<IntersectionWorkUnit*>(state);
+	verify_signature_at(unit->signature);
+	unit->posdbTable.intersectLists();
+	if(g_errno)
+		unit->err = g_errno;
+	unit->pendingJobs->done();
+}
+
 } //anonymous namespace
 
 
@@ -144,6 +251,15 @@ void Msg39Request::reset() {
 }
 
 
+uint32_t Msg39::getIndexGeneration() {
+	return s_indexGeneration;
+}
+
+void Msg39::bumpIndexGeneration() {
+	s_indexGeneration++;
+}
+
+
 bool Msg39::registerHandler ( ) {
 	// . register ourselves with the udp server
 	// . it calls our callback when it receives a msg of type 0x39
@@ -192,6 +308,7 @@ void Msg39::reset() {
 	m_numClusterDocIds = 0;
 	m_numVisible = 0;
 	m_debug = false;
+	m_trace.reset();
 }
 
 
@@ -299,6 +416,11 @@ void Msg39::getDocIds ( UdpSlot *slot ) {
 	}
 
 	log(LOG_DEBUG,"query: msg39: processing query '%*.*s', this=%p", (int)m_msg39req->size_query, (int)m_msg39req->size_query, m_msg39req->ptr_query, this);
+
+	// the spans are relative to when we got the request
+	if ( m_msg39req->m_doTrace )
+		m_trace.start(g_hostdb.getMyHostId());
+
 	// OK, we have deserialized and checked the msg39request and we can now process
 	// it by shoveling into the jobe queue. that means that the main thread (or whoever
 	// called us) is freed up and can do other stuff.
@@ -331,6 +453,9 @@ void Msg39::getDocIds2() {
 	//record start time of the query
 	m_startTimeQuery = gettimeofdayInMilliseconds();
 
+	// time spent waiting for a coordinator thread
+	m_trace.addSpan("msg39 queue wait", QUERY_TRACE_LEVEL_MSG39, m_trace.getStartTime());
+
 	// a handy thing
 	m_debug = false;
 	if ( m_msg39req->m_debug       ) m_debug = true;
@@ -347,56 +472,67 @@ void Msg39::getDocIds2() {
 	}
 
 	// . set our m_query instance
-	if ( ! m_query.set2 ( m_msg39req->ptr_query,
-			      m_msg39req->m_language ,
-			      m_msg39req->m_queryExpansion ,
-			      m_msg39req->m_useQueryStopWords ,
-	              m_msg39req->m_allowHighFrequencyTermCache,
-			      m_msg39req->m_maxQueryTerms ) ) {
-		log("query: msg39: setQuery: %s." , 
-		    mstrerror(g_errno) );
+	if ( ! setQuery ( &m_query, cr ) ) {
 		sendReply ( m_slot , this , NULL , 0 , 0 , true );
 		return ; 
 	}
 
+	// set m_errno
+	if ( m_query.m_truncated ) m_errno = EQUERYTRUNCATED;
+
+	// debug
+	if ( m_debug )
+		logf(LOG_DEBUG,"query: msg39: [%" PTRFMT"] Got request "
+		     "for q=%s", (PTRTYPE) this,m_query.originalQuery());
+
+	// reset this
+	m_toptree.reset();
+
+	controlLoop();
+}
+
+
+// . sets up "q" from the query string and parameters in the request
+// . returns false and sets g_errno on error
+bool Msg39::setQuery(Query *q, const CollectionRec *cr) {
+	if ( ! q->set2 ( m_msg39req->ptr_query,
+			 m_msg39req->m_language ,
+			 m_msg39req->m_queryExpansion ,
+			 m_msg39req->m_useQueryStopWords ,
+			 m_msg39req->m_allowHighFrequencyTermCache,
+			 m_msg39req->m_maxQueryTerms ) ) {
+		log("query: msg39: setQuery: %s." , 
+		    mstrerror(g_errno) );
+		return false;
+	}
+
 	// wtf?
 	if ( g_errno ) gbshutdownLogicError();
 
 	if(m_msg39req->m_modifyQuery)
-		m_query.modifyQuery(&m_msg39req->m_scoringWeights, cr->m_modifyDomainLikeSearches, cr->m_modifyAPILikeSearches);
+		q->modifyQuery(&m_msg39req->m_scoringWeights, cr->m_modifyDomainLikeSearches, cr->m_modifyAPILikeSearches);
 
-	// set m_errno
-	if ( m_query.m_truncated ) m_errno = EQUERYTRUNCATED;
 	// ensure matches with the msg3a sending us this request
-	if ( m_query.getNumTerms() != m_msg39req->m_nqt ) {
+	if ( q->getNumTerms() != m_msg39req->m_nqt ) {
 		g_errno = EBADENGINEER;
 		log(LOG_ERROR, "query: Query parsing inconsistency for q='%s'. %i != %i. "
 		    "langid=%d. Check langids and m_queryExpansion parms "
 		    "which are the only parms that could be different in "
 		    "Query::set2(). You probably have different mysynoyms.txt "
 		    "files on two different hosts! check that!!"
-		    ,m_query.originalQuery()
-		    ,(int)m_query.getNumTerms()
+		    ,q->originalQuery()
+		    ,(int)q->getNumTerms()
 		    ,(int)m_msg39req->m_nqt
 		    ,(int)m_msg39req->m_language
 		    );
-		sendReply ( m_slot , this , NULL , 0 , 0 , true );
-		return ; 
+		return false;
 	}
 
 	//set term frequencyweights based on msg39req
-	for(int i=0; i<m_query.getNumTerms(); i++)
-		m_query.m_qterms[i].m_termFreqWeight = ((float *)m_msg39req->ptr_termFreqWeights)[i];
-
-	// debug
-	if ( m_debug )
-		logf(LOG_DEBUG,"query: msg39: [%" PTRFMT"] Got request "
-		     "for q=%s", (PTRTYPE) this,m_query.originalQuery());
+	for(int i=0; i<q->getNumTerms(); i++)
+		q->m_qterms[i].m_termFreqWeight = ((float *)m_msg39req->ptr_termFreqWeights)[i];
 
-	// reset this
-	m_toptree.reset();
-
-	controlLoop();
+	return true;
 }
 
 
@@ -423,10 +559,22 @@ void Msg39::controlLoop ( ) {
 	int numDocIdSplits = 1;
 	const int totalChunks = (numFiles+1)*numDocIdSplits;
 	int chunksSearched = 0;
+	int64_t traceStart = 0;
 	
 	if(g_errno) //ugly logic due to C++ prohibited jump over local variable initialization
 		goto hadError;
 
+	// . fan out the file/docid-range units over the intersection threads
+	// . the scoring info buffers are per-PosdbTable so we can only merge
+	//   top trees when no scoring info was requested
+	if(g_conf.m_parallelQueryIntersection && !m_msg39req->m_getDocIdScoringInfo && numFiles>0) {
+		if(!controlLoopParallel(base, numFiles, numDocIdSplits, &chunksSearched)) {
+			log(LOG_ERROR,"Msg39::controlLoop: got error %d in controlLoopParallel()", g_errno);
+			goto hadError;
+		}
+		goto skipRest;
+	}
+
 	for(int fileNum = 0; fileNum<numFiles+1; fileNum++) {
 		if(fileNum<numFiles && !base->isReadable(fileNum)) {
 			log(LOG_DEBUG,"posdb file #%d is not currently readable. Skipping", fileNum);
@@ -470,6 +618,7 @@ void Msg39::controlLoop ( ) {
 				docidRangeStart = MAX_DOCID;
 			int64_t d1 = docidRangeStart;
 
+			traceStart = m_trace.getNow();
 			if(fileNum!=numFiles)
 				getLists(fileNum,d0,d1);
 			else
@@ -478,14 +627,17 @@ void Msg39::controlLoop ( ) {
 				log(LOG_ERROR,"Msg39::controlLoop: got error %d after getLists()", g_errno);
 				goto hadError;
 			}
+			m_trace.addSpan(fileNum!=numFiles ? "msg39 getlists" : "msg39 getlists tree", QUERY_TRACE_LEVEL_MSG39, traceStart);
 
 			// Intersect the lists we loaded (using a thread)
+			traceStart = m_trace.getNow();
 			documentIndexChecker.setFileNum(fileNum);
 			intersectLists(documentIndexChecker);
 			if ( g_errno ) {
 				log(LOG_ERROR,"Msg39::controlLoop: got error %d after intersectLists()", g_errno);
 				goto hadError;
 			}
+			m_trace.addSpan(fileNum!=numFiles ? "msg39 intersect" : "msg39 intersect tree", QUERY_TRACE_LEVEL_MSG39, traceStart);
 			
 			// Sum up stats
 			if ( m_posdbTable.m_t1 ) {
@@ -503,6 +655,7 @@ void Msg39::controlLoop ( ) {
 		}
 	}
 skipRest:
+	traceStart = m_trace.getNow();
 
 	// ok, we are done, get cluster recs of the winning docids
 	// . this loads them using msg51 from clusterdb
@@ -521,6 +674,9 @@ skipRest:
 		goto hadError;
 	}
 
+	if ( m_gotClusterRecs )
+		m_trace.addSpan("msg39 clusterrecs", QUERY_TRACE_LEVEL_MSG39, traceStart);
+
 	// . all done! set stats and send back reply
 	// . only sends back the cluster recs if m_gotClusterRecs is true
 	estimateHitsAndSendReply(chunksSearched/(double)totalChunks);
@@ -534,69 +690,232 @@ hadError:
 
 
 
-// . returns false if blocked, true otherwise
-// . sets g_errno on error
-// . called either from 
-//   1) doDocIdSplitLoop
-//   2) or getDocIds2() if only 1 docidsplit
-void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
-	log(LOG_DEBUG, "query: msg39(this=%p)::getLists()",this);
-
-	if ( m_debug ) m_startTime = gettimeofdayInMilliseconds();
-	// . ask Indexdb for the IndexLists we need for these termIds
-	// . each rec in an IndexList is a termId/score/docId tuple
-
+// . sets the posdb start/end keys of each query term in "q" for the docid
+//   range, restricted to our stripe
+// . adjusts docIdStart/docIdEnd to the range actually read
+void Msg39::setTermListKeys(Query *q, int64_t *docIdStart, int64_t *docIdEnd) {
 	// . restrict to this docid?
 	// . will really make gbdocid:| searches much faster!
-	int64_t dr = m_query.m_docIdRestriction;
+	int64_t dr = q->m_docIdRestriction;
 	if ( dr ) {
-		docIdStart = dr;
-		docIdEnd   = dr + 1;
+		*docIdStart = dr;
+		*docIdEnd   = dr + 1;
 	}
 	
 	// if we have twins, then make sure the twins read different
 	// pieces of the same docid range to make things 2x faster
 	int32_t numStripes = g_hostdb.getNumStripes();
-	int64_t delta2 = ( docIdEnd - docIdStart ) / numStripes;
+	int64_t delta2 = ( *docIdEnd - *docIdStart ) / numStripes;
 	int32_t stripe = g_hostdb.getMyHost()->m_stripe;
-	docIdStart += delta2 * stripe; // is this right? // BR 20160313: Doubt it..
-	docIdEnd = docIdStart + delta2;
+	*docIdStart += delta2 * stripe; // is this right? // BR 20160313: Doubt it..
+	*docIdEnd = *docIdStart + delta2;
 	// add 1 to be safe so we don't lose a docid
-	docIdEnd++;
+	(*docIdEnd)++;
 	// TODO: add triplet support later for this to split the
 	// read 3 ways. 4 ways for quads, etc.
 	//if ( g_hostdb.getNumStripes() >= 3 ) gbshutdownLogicError();
 	// do not go over MAX_DOCID  because it gets masked and
 	// ends up being 0!!! and we get empty lists
-	if ( docIdEnd > MAX_DOCID ) docIdEnd = MAX_DOCID;
+	if ( *docIdEnd > MAX_DOCID ) *docIdEnd = MAX_DOCID;
 
 	if ( g_conf.m_logDebugQuery )
 	{
-		log(LOG_DEBUG,"query: docId start %" PRId64, docIdStart);
-		log(LOG_DEBUG,"query: docId   end %" PRId64, docIdEnd);
+		log(LOG_DEBUG,"query: docId start %" PRId64, *docIdStart);
+		log(LOG_DEBUG,"query: docId   end %" PRId64, *docIdEnd);
 	}
 
 	//
 	// set startkey/endkey for each term/termlist
 	//
-	for ( int32_t i = 0 ; i < m_query.getNumTerms() ; i++ ) {
+	for ( int32_t i = 0 ; i < q->getNumTerms() ; i++ ) {
 		// get the term id
-		int64_t tid = m_query.getTermId(i);
+		int64_t tid = q->getTermId(i);
 
 		// debug
 		if ( m_debug )
 			log("query: setting sk/ek for docids %" PRId64
 			    " to %" PRId64" for termid=%" PRId64
-			    , docIdStart
-			    , docIdEnd
+			    , *docIdStart
+			    , *docIdEnd
 			    , tid
 			    );
 		// store now in qterm
-		Posdb::makeStartKey ( m_query.m_qterms[i].m_startKey, tid, docIdStart );
-		Posdb::makeEndKey   ( m_query.m_qterms[i].m_endKey,   tid, docIdEnd   );
-		m_query.m_qterms[i].m_ks = sizeof(posdbkey_t);
+		Posdb::makeStartKey ( q->m_qterms[i].m_startKey, tid, *docIdStart );
+		Posdb::makeEndKey   ( q->m_qterms[i].m_endKey,   tid, *docIdEnd   );
+		q->m_qterms[i].m_ks = sizeof(posdbkey_t);
+	}
+}
+
+
+// . like the loop in controlLoop() but reads the lists of up to
+//   m_maxParallelIntersectionUnits (file, docid-range) units at once and
+//   intersects them concurrently, each into its own TopTree
+// . the DocumentIndexChecker makes each docid belong to exactly one file so
+//   the per-unit top trees are disjoint and can simply be merged
+// . returns false and sets g_errno on error
+bool Msg39::controlLoopParallel(RdbBase *base, int numFiles, int numDocIdSplits, int *chunksSearched) {
+	const CollectionRec *cr = g_collectiondb.getRec(m_msg39req->m_collnum);
+	if(!cr) {
+		g_errno = ENOCOLLREC;
+		return false;
+	}
+
+	struct UnitRange {
+		int fileNum;
+		int64_t docIdStart;
+		int64_t docIdEnd;
+	};
+	std::vector<UnitRange> ranges;
+	for(int fileNum = 0; fileNum<numFiles+1; fileNum++) {
+		if(fileNum<numFiles && !base->isReadable(fileNum)) {
+			log(LOG_DEBUG,"posdb file #%d is not currently readable. Skipping", fileNum);
+			continue;
+		}
+		int64_t docidRangeStart = 0;
+		const int64_t docidRangeDelta = MAX_DOCID / (int64_t)numDocIdSplits;
+		for(int docIdSplitNumber = 0; docIdSplitNumber < numDocIdSplits; docIdSplitNumber++) {
+			UnitRange r;
+			r.fileNum = fileNum;
+			r.docIdStart = docidRangeStart;
+			docidRangeStart += docidRangeDelta;
+			if(docIdSplitNumber+1 == numDocIdSplits)
+				docidRangeStart = MAX_DOCID;
+			else if(docidRangeStart + 20 > MAX_DOCID)
+				docidRangeStart = MAX_DOCID;
+			r.docIdEnd = docidRangeStart;
+			ranges.push_back(r);
+		}
 	}
 
+	const int maxUnits = g_conf.m_maxParallelIntersectionUnits>0 ? g_conf.m_maxParallelIntersectionUnits : 1;
+	const int32_t nqt = m_query.getNumTerms();
+	std::vector<IntersectionWorkUnit*> units;
+	units.reserve(maxUnits);
+	PendingJobs pendingJobs;
+	bool ok = true;
+
+	for(size_t batchStart = 0; batchStart < ranges.size() && ok; batchStart += maxUnits) {
+		if(batchStart!=0) {
+			//Estimate if we can do this and next batches within the deadline
+			int64_t now = gettimeofdayInMilliseconds();
+			int64_t time_per_batch = (now - m_startTimeQuery) / (batchStart/maxUnits);
+			int64_t deadline = m_startTimeQuery + m_msg39req->m_timeout;
+			if(now + time_per_batch > deadline) {
+				log(LOG_INFO,"Msg39::controlLoopParallel(): batch starting at unit %d/%d would cross deadline. Skipping",
+				    (int)batchStart, (int)ranges.size());
+				break;
+			}
+		}
+
+		// issue the list reads of all the units in this batch at once
+		int64_t traceStart = m_trace.getNow();
+		size_t batchEnd = std::min(ranges.size(), batchStart+maxUnits);
+		for(size_t i = batchStart; i < batchEnd; i++) {
+			IntersectionWorkUnit *unit;
+			try {
+				unit = new IntersectionWorkUnit(base, &pendingJobs, ranges[i].fileNum, ranges[i].docIdStart, ranges[i].docIdEnd);
+				units.push_back(unit);
+				unit->lists = new RdbList[nqt];
+			} catch(std::bad_alloc) {
+				log(LOG_ERROR,"query: msg39: could not allocate intersection work unit");
+				g_errno = ENOMEM;
+				ok = false;
+				break;
+			}
+			if(!setQuery(&unit->query, cr)) {
+				ok = false;
+				break;
+			}
+			setTermListKeys(&unit->query, &unit->docIdStart, &unit->docIdEnd);
+
+			pendingJobs.add();
+			if(unit->msg2.getLists(m_msg39req->m_collnum,
+					       m_msg39req->m_addToCache,
+					       unit->query.m_qterms,
+					       unit->query.getNumTerms(),
+					       m_msg39req->ptr_whiteList,
+					       unit->fileNum!=numFiles ? unit->fileNum : -1,
+					       unit->docIdStart,
+					       unit->docIdEnd,
+					       unit->lists,
+					       unit,
+					       &workUnitGotListsCallback,
+					       m_msg39req->m_allowHighFrequencyTermCache,
+					       m_msg39req->m_niceness,
+					       m_debug))
+				pendingJobs.done();
+			if(g_errno) {
+				log(LOG_ERROR,"Msg39::controlLoopParallel: got error %d after getLists()", g_errno);
+				ok = false;
+				break;
+			}
+		}
+		// the reads that were issued must finish before we tear down
+		pendingJobs.wait_for_all();
+		m_trace.addSpan("msg39 batch getlists", QUERY_TRACE_LEVEL_MSG39, traceStart);
+
+		// ensure collection not deleted from under us
+		if(ok && !g_collectiondb.getRec(m_msg39req->m_collnum)) {
+			g_errno = ENOCOLLREC;
+			ok = false;
+		}
+
+		if(ok) {
+			traceStart = m_trace.getNow();
+			// intersect the units concurrently
+			for(auto unit : units) {
+				unit->posdbTable.init(&unit->query, m_debug, &unit->toptree, unit->documentIndexChecker, &unit->msg2, m_msg39req);
+				pendingJobs.add();
+				if(!g_jobScheduler.submit(&workUnitIntersectThreadFunction,
+							  0, //no finish callback
+							  unit,
+							  thread_type_query_intersect,
+							  m_msg39req->m_niceness))
+					workUnitIntersectThreadFunction(unit);
+			}
+			pendingJobs.wait_for_all();
+			m_trace.addSpan("msg39 batch intersect", QUERY_TRACE_LEVEL_MSG39, traceStart);
+		}
+
+		// merge the results into our top tree
+		for(auto unit : units) {
+			if(ok && unit->err) {
+				g_errno = unit->err;
+				log(LOG_ERROR,"Msg39::controlLoopParallel: got error %d after intersectLists()", g_errno);
+				ok = false;
+			}
+			if(ok && !m_toptree.addNodes(&unit->toptree))
+				ok = false;
+			if(ok) {
+				if(unit->posdbTable.m_t1)
+					g_stats.addStat_r(0, unit->posdbTable.m_t1, unit->posdbTable.m_t2, 0x0000ff00);
+				m_numTotalHits += unit->posdbTable.getTotalHits();
+				m_numTotalHits -= unit->posdbTable.getFilteredCount();
+				(*chunksSearched)++;
+			}
+			delete unit;
+		}
+		units.clear();
+	}
+
+	return ok;
+}
+
+
+// . returns false if blocked, true otherwise
+// . sets g_errno on error
+// . called either from 
+//   1) doDocIdSplitLoop
+//   2) or getDocIds2() if only 1 docidsplit
+void Msg39::getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd) {
+	log(LOG_DEBUG, "query: msg39(this=%p)::getLists()",this);
+
+	if ( m_debug ) m_startTime = gettimeofdayInMilliseconds();
+	// . ask Indexdb for the IndexLists we need for these termIds
+	// . each rec in an IndexList is a termId/score/docId tuple
+
+	setTermListKeys(&m_query, &docIdStart, &docIdEnd);
+
 	// debug msg
 	if ( m_debug || g_conf.m_logDebugQuery ) {
 		for ( int32_t i = 0 ; i < m_query.getNumTerms() ; i++ ) {
@@ -1010,6 +1329,8 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 	mr.m_nqt = nqt;
 	// the m_errno if any
 	mr.m_errno = m_errno;
+	mr.m_shardNum = getMyShardNum();
+	mr.m_indexGeneration = getIndexGeneration();
 	// the score info, in no particular order right now
 	mr.ptr_scoreInfo  = m_posdbTable.m_scoreInfoBuf.getBufStart();
 	mr.size_scoreInfo = m_posdbTable.m_scoreInfoBuf.length();
@@ -1035,6 +1356,11 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 	else
 		mr.size_clusterRecs = 0;
 
+	// the latency breakdown, if Msg3a asked for it
+	m_trace.addSpan("msg39 total", QUERY_TRACE_LEVEL_MSG39, m_trace.getStartTime());
+	mr.ptr_traceSpans   = const_cast<char*>(m_trace.getSpanBuf());
+	mr.size_traceSpans  = m_trace.getSpanBufSize();
+
 	// . that is pretty much it,so serialize it into buffer,"reply"
 	// . mr.ptr_docIds, etc., will point into the buffer so we can
 	//   re-serialize into it below from the tree
@@ -1044,7 +1370,7 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 	int32_t  replySize;
 	char *reply = serializeMsg(sizeof(Msg39Reply),   // baseSize
 				   &mr.size_docIds,      // firstSizeParm
-				   &mr.size_clusterRecs, // lastSizePrm
+				   &mr.size_traceSpans,  // lastSizePrm
 				   &mr.ptr_docIds,       // firstStrPtr
 				   &mr,                  // thisPtr
 				   &replySize,
@@ -1062,8 +1388,8 @@ void Msg39::estimateHitsAndSendReply(double pctSearched) {
 	unsigned *topFlags = (unsigned*)mr.ptr_flags;
 	key96_t *topRecs     = (key96_t*)  mr.ptr_clusterRecs;
 
-	// sanity
-	if(nqt!=m_msg2.getNumLists())
+	// sanity (m_msg2 is unused when the units were intersected in parallel)
+	if(m_msg2.getNumLists()!=0 && nqt!=m_msg2.getNumLists())
 		log("query: nqt mismatch for q=%s",m_query.originalQuery());
 
 	int32_t docCount = 0;
@@ -13,10 +13,13 @@
 #include "Msg51.h"
 #include "ScoringWeights.h"
 #include "JobScheduler.h"
+#include "QueryTrace.h"
 
 
 class UdpSlot;
 class DocumentIndexChecker;
+class CollectionRec;
+class RdbBase;
 
 
 class Msg39Request {
@@ -59,6 +62,7 @@ class Msg39Request {
 	bool    m_useQueryStopWords;
 	bool    m_allowHighFrequencyTermCache;
 	bool    m_doMaxScoreAlgo;
+	bool    m_doTrace;            // send back a latency breakdown
 
 	bool    m_modifyQuery;
 	ScoringWeights m_scoringWeights;
@@ -123,9 +127,13 @@ public:
 	double    m_pctSearched;
 	// error code
 	int32_t   m_errno;
+	// the shard that replied and its index generation, see
+	// Msg39::getIndexGeneration()
+	int32_t   m_shardNum;
+	uint32_t  m_indexGeneration;
 
 	// do not add new string parms before ptr_docIds or
-	// after ptr_clusterRecs so serializeMsg() calls still work
+	// after ptr_traceSpans so serializeMsg() calls still work
 	char  *ptr_docIds         ; // the results, int64_t
 	char  *ptr_scores         ; // now doubles! so we can have intScores
 	char  *ptr_flags          ; // from Docid2FlagsAndSiteMap
@@ -133,9 +141,10 @@ public:
 	char  *ptr_pairScoreBuf   ; // transparency info
 	char  *ptr_singleScoreBuf ; // transparency info
 	char  *ptr_clusterRecs    ; // key96_t (might be empty)
+	char  *ptr_traceSpans     ; // QueryTraceSpan (if m_doTrace)
 	
 	// do not add new string parms before size_docIds or
-	// after size_clusterRecs so serializeMsg() calls still work
+	// after size_traceSpans so serializeMsg() calls still work
 	int32_t   size_docIds;
 	int32_t   size_scores;
 	int32_t   size_flags;
@@ -143,6 +152,7 @@ public:
 	int32_t   size_pairScoreBuf  ;
 	int32_t   size_singleScoreBuf;
 	int32_t   size_clusterRecs;
+	int32_t   size_traceSpans;
 
 	// variable data comes here
 };
@@ -157,6 +167,11 @@ public:
 	// register our request handler for Msg39's
 	static bool registerHandler();
 
+	// . changes whenever posdb of this host is dumped or merged
+	// . sent in the reply so Msg3a can tell its cached results are old
+	static uint32_t getIndexGeneration();
+	static void bumpIndexGeneration();
+
 private:
 	static void handleRequest39(UdpSlot *slot, int32_t netnice);
 	// called by handler when a request for docids arrives
@@ -166,6 +181,11 @@ private:
 	void reset2();
 	static void coordinatorThreadFunc(void *state);
 	void getDocIds2();
+	// sets up a Query instance from the request. Returns false and sets
+	// g_errno on error
+	bool setQuery(Query *q, const CollectionRec *cr);
+	// sets start/end keys of the query terms for a docid range
+	void setTermListKeys(Query *q, int64_t *docIdStart, int64_t *docIdEnd);
 	// retrieves the lists needed as specified by termIds and PosdbTable
 	void getLists(int fileNum, int64_t docIdStart, int64_t docIdEnd);
 	// called when lists have been retrieved, uses PosdbTable to hash lists
@@ -215,8 +235,14 @@ private:
 	Msg51       m_msg51;
 	bool        m_gotClusterRecs;
 
+	// latency breakdown sent back to Msg3a if the request asked for it
+	QueryTrace  m_trace;
+
 	void        controlLoop();
 	static void intersectListsThreadFunction(void *state);
+	// fan out (file,docid-range) work units to the intersection threads
+	// and merge their top trees. Returns false and sets g_errno on error
+	bool        controlLoopParallel(RdbBase *base, int numFiles, int numDocIdSplits, int *chunksSearched);
 
 	int32_t m_docIdSplitNumber; //next split range to do
 	
@@ -14,10 +14,30 @@
 #include "Conf.h"
 #include "Lang.h"
 #include "Mem.h"
+#include "RdbCache.h"
+#include "hash.h"
 
 
 static void gotReplyWrapper3a     ( void *state , void *state2 ) ;
 
+// merged results of recent queries, see Msg3a::getResultsFromCache()
+static RdbCache s_resultCache;
+// . last index generation seen in the replies of each shard
+// . they are part of the cache key, so entries made before a shard dumped
+//   or merged posdb are no longer found once a reply tells us about it
+static uint32_t s_shardIndexGenerations[MAX_SHARDS];
+
+// a result cache record is this header followed by the docids, scores,
+// flags, cluster recs and cluster levels of the merged results
+struct ResultCacheHeader {
+	int32_t m_numDocIds;
+	int64_t m_numTotalEstimatedHits;
+	double  m_pctSearched;
+	bool    m_moreDocIdsAvail;
+};
+
+static const int32_t s_resultCacheBytesPerDocId = 8 + sizeof(double) + sizeof(unsigned) + sizeof(key96_t) + 1;
+
 Msg3a::Msg3a ( ) {
 	constructor();
 }
@@ -63,6 +83,11 @@ void Msg3a::constructor ( ) {
 	m_clusterLevels = NULL;
 	m_cursor = 0;
 	memset(m_replyMaxSize, 0, sizeof(m_replyMaxSize));
+	m_addToResultCache = false;
+	m_resultCacheKey.setMin();
+	m_trace = NULL;
+	memset(m_traceSendTime, 0, sizeof(m_traceSendTime));
+	memset(m_traceReplyTime, 0, sizeof(m_traceReplyTime));
 }
 
 Msg3a::~Msg3a ( ) {
@@ -98,6 +123,7 @@ void Msg3a::reset ( ) {
 	m_numDocIds    = 0;
 	m_collnums     = NULL;
 	m_numTotalEstimatedHits = 0LL;
+	m_addToResultCache = false;
 }
 
 
@@ -191,6 +217,23 @@ bool Msg3a::getDocIds(const SearchInput *si, Query *q, void *state,
 	if ( g_conf.m_logDebugQuery  ) m_debug = true;
 	if ( g_conf.m_logTimingQuery ) m_debug = true;
 
+	// . head queries are repeated a lot so try the result cache first
+	// . do not cache debug or scoring info requests, the DocIdScores
+	//   point into the shard replies
+	// . if we were told not to ask the other shards the results are
+	//   partial, so do not cache those either
+	bool useResultCache = g_conf.m_useQueryResultCache &&
+			      s_resultCache.isInitialized() &&
+			      ! m_debug &&
+			      ! m_msg39req.m_getDocIdScoringInfo &&
+			      ( ! si || si->m_askOtherShards );
+	if ( useResultCache ) {
+		m_resultCacheKey = getResultCacheKey();
+		if ( si && si->m_rcache && getResultsFromCache() )
+			return true;
+		m_addToResultCache = m_msg39req.m_addToCache;
+	}
+
 	// time how long it takes to get the term freqs
 	if ( m_debug ) {
 		// show the query terms
@@ -266,6 +309,8 @@ bool Msg3a::getDocIds(const SearchInput *si, Query *q, void *state,
 		m_rbufPtr = NULL;
 	}
 	m_msg39req.m_stripe = 0;
+	// ask the shards for their latency breakdown if we are tracing
+	m_msg39req.m_doTrace = m_trace && m_trace->isActive();
 	// . (re)serialize the request
 	// . returns NULL and sets g_errno on error
 	// . "m_rbuf" is a local storage space that can save a malloc
@@ -412,6 +457,7 @@ bool Msg3a::getDocIds(const SearchInput *si, Query *q, void *state,
 		// . if that host takes more than about 5 secs then sends to
 		//   next host
 		// . key should be largest termId in group we're sending to
+		m_traceSendTime[i] = m_trace ? m_trace->getNow() : 0;
 		bool status = m->send(req, m_rbufSize, msg_type_39, false, shardNum, false, (int32_t)qh, this, m, gotReplyWrapper3a, timeout, m_msg39req.m_niceness, firstHostId, true);
 		// if successfully launch, do the next one
 		if ( status ) {
@@ -489,6 +535,15 @@ void gotReplyWrapper3a ( void *state , void *state2 ) {
 	}
 
 	
+	// the network hop plus the time the shard worked on it
+	if ( THIS->m_trace && THIS->m_trace->isActive() ) {
+		int32_t i = m - THIS->m_mcast;
+		THIS->m_traceReplyTime[i] = THIS->m_trace->getNow();
+		char name[24];
+		snprintf(name, sizeof(name), "msg3a shard %" PRId32, i);
+		THIS->m_trace->addSpan(name, QUERY_TRACE_LEVEL_MSG3A, THIS->m_traceSendTime[i], THIS->m_traceReplyTime[i]);
+	}
+
 	// i guess h is NULL on error?
 	if ( h ) {
 		// how long did it take from the launch of request until now
@@ -622,7 +677,7 @@ bool Msg3a::gotAllShardReplies ( ) {
 		// deserialize it (just sets the ptr_ and size_ member vars)
 		int deserializedBytes = deserializeMsg(sizeof(Msg39Reply),
 						       &mr->size_docIds,
-						       &mr->size_clusterRecs,
+						       &mr->size_traceSpans,
 						       &mr->ptr_docIds,
 						       ((char*)mr) + sizeof(*mr));
 		if(deserializedBytes != replySize) {
@@ -633,6 +688,12 @@ bool Msg3a::gotAllShardReplies ( ) {
 
 		}
 
+		// merge the latency breakdown of the shard into ours
+		if ( m_trace &&
+		     ! m_trace->addRemoteSpans ( mr->ptr_traceSpans, mr->size_traceSpans,
+						 m_traceSendTime[i], m_traceReplyTime[i] ) )
+			log(LOG_WARN, "query: msg3a: Bad trace spans from shard #%" PRId32".", i);
+
 		// add of the total hits from each shard, this is how many
 		// total results the lastest shard is estimated to be able to
 		// return
@@ -641,6 +702,10 @@ bool Msg3a::gotAllShardReplies ( ) {
 		m_numTotalEstimatedHits += mr->m_estimatedHits;
 		pctSearchedSum += mr->m_pctSearched;
 
+		// the stale entries just age out of the cache
+		if ( mr->m_shardNum >= 0 && mr->m_shardNum < g_hostdb.getNumShards() )
+			s_shardIndexGenerations[mr->m_shardNum] = mr->m_indexGeneration;
+
 		// debug log stuff
 		if ( ! m_debug ) continue;
 		// cast these for printing out
@@ -666,6 +731,13 @@ bool Msg3a::gotAllShardReplies ( ) {
 	// this seems to always return true!
 	mergeLists ( );
 
+	// . do not cache results missing some shards
+	// . the replies may have brought newer shard index generations
+	if ( m_addToResultCache && ! g_errno && m_skippedShards == 0 ) {
+		m_resultCacheKey = getResultCacheKey();
+		addResultsToCache ( );
+	}
+
 	return true;
 }
 
@@ -964,6 +1036,169 @@ bool Msg3a::mergeLists() {
 	return true;
 }
 
+bool Msg3a::initResultCache ( ) {
+	int32_t maxMem = g_conf.m_queryResultCacheMaxMem;
+	// assume about 100 results of 33 bytes each per query
+	int32_t maxNodes = maxMem / (100 * s_resultCacheBytesPerDocId);
+	if ( maxNodes < 1 ) maxNodes = 1;
+
+	if ( ! s_resultCache.init ( maxMem ,
+				    -1        , // fixedDataSize
+				    maxNodes  ,
+				    "queryresults" , // dbname
+				    false     , // save to disk
+				    sizeof(key96_t) , // cachekeysize
+				    -1 ) )      // numPtrsMax
+		return false;
+
+	return true;
+}
+
+void Msg3a::resetResultCache ( ) {
+	s_resultCache.reset();
+}
+
+const RdbCache *Msg3a::getResultCache ( ) {
+	return &s_resultCache;
+}
+
+// . the key covers everything in the request that affects the results
+// . the query is normalized by collapsing whitespace, the termids and
+//   the term freq weights are not part of it because they come from
+//   the query and the index (covered by the shard index generations)
+key96_t Msg3a::getResultCacheKey ( ) const {
+	Msg39Request r;
+	gbmemcpy ( &r , &m_msg39req , sizeof(Msg39Request) );
+	// zero out things that do not change the results
+	r.m_niceness   = 0;
+	r.m_maxAge     = 0;
+	r.m_debug      = false;
+	r.m_doTrace    = false;
+	r.m_addToCache = false;
+	r.m_stripe     = 0;
+	r.m_timeout    = 0;
+	memset ( r.m_queryId , 0 , sizeof(r.m_queryId) );
+	int32_t fixedSize = (char *)&r.ptr_termFreqWeights - (char *)&r;
+
+	uint64_t h = hash64 ( (const char *)&r , fixedSize , 0 );
+
+	// collapse runs of whitespace and drop leading/trailing whitespace
+	SafeBuf nq;
+	const char *s = m_q->originalQuery();
+	bool inSpace = true;
+	for ( ; *s ; s++ ) {
+		if ( is_wspace_a(*s) ) {
+			inSpace = true;
+			continue;
+		}
+		if ( inSpace && nq.length() > 0 )
+			nq.pushChar(' ');
+		inSpace = false;
+		nq.pushChar(*s);
+	}
+	h = hash64 ( nq.getBufStart() , nq.length() , h );
+	if ( m_msg39req.ptr_whiteList && m_msg39req.size_whiteList > 0 )
+		h = hash64 ( m_msg39req.ptr_whiteList , m_msg39req.size_whiteList , h );
+	h = hash64h ( (uint64_t)m_q->getQueryHash() , h );
+	h = hash64 ( (const char *)s_shardIndexGenerations , g_hostdb.getNumShards() * sizeof(uint32_t) , h );
+
+	key96_t k;
+	k.n0 = h;
+	k.n1 = hash32 ( nq.getBufStart() , nq.length() , (uint32_t)m_msg39req.m_collnum );
+	return k;
+}
+
+// . fill in the merged results from the result cache
+// . returns false if they were not in it
+bool Msg3a::getResultsFromCache ( ) {
+	char    *rec;
+	int32_t  recSize;
+	RdbCacheLock rcl(s_resultCache);
+	if ( ! s_resultCache.getRecord ( m_msg39req.m_collnum ,
+					 m_resultCacheKey ,
+					 &rec ,
+					 &recSize ,
+					 false , // doCopy?
+					 g_conf.m_queryResultCacheMaxAge ,
+					 true ) ) // incCounts?
+		return false;
+
+	if ( recSize < (int32_t)sizeof(ResultCacheHeader) )
+		return false;
+	ResultCacheHeader hdr;
+	gbmemcpy ( &hdr , rec , sizeof(hdr) );
+	int32_t nd = hdr.m_numDocIds;
+	if ( nd < 0 || recSize != (int32_t)sizeof(hdr) + nd * s_resultCacheBytesPerDocId ) {
+		log(LOG_WARN,"query: msg3a: bad result cache record size %" PRId32, recSize);
+		return false;
+	}
+
+	// same layout as mergeLists() makes
+	int32_t need = nd * (s_resultCacheBytesPerDocId + sizeof(DocIdScore *));
+	m_finalBuf     = (char *)mmalloc ( need , "finalBuf" );
+	m_finalBufSize = need;
+	if ( ! m_finalBuf ) {
+		// just do the search then
+		g_errno = 0;
+		m_finalBufSize = 0;
+		return false;
+	}
+	char *p = m_finalBuf;
+	m_docIds        = (int64_t*)    p; p += nd * 8;
+	m_scores        = (double*)     p; p += nd * sizeof(double);
+	m_flags         = (unsigned*)   p; p += nd * sizeof(unsigned);
+	m_clusterRecs   = (key96_t*)    p; p += nd * sizeof(key96_t);
+	m_clusterLevels = (char*)       p; p += nd * 1;
+	m_scoreInfos    = (DocIdScore**)p; p += nd * sizeof(DocIdScore *);
+
+	// the cached arrays are in the same order
+	gbmemcpy ( m_finalBuf , rec + sizeof(hdr) , nd * s_resultCacheBytesPerDocId );
+	memset ( m_scoreInfos , 0 , nd * sizeof(DocIdScore *) );
+
+	m_numDocIds             = nd;
+	m_numTotalEstimatedHits = hdr.m_numTotalEstimatedHits;
+	m_pctSearched           = hdr.m_pctSearched;
+	m_moreDocIdsAvail       = hdr.m_moreDocIdsAvail;
+	m_skippedShards         = 0;
+	m_numQueriedHosts       = 0;
+
+	if ( g_conf.m_logDebugQuery )
+		logf(LOG_DEBUG,"query: msg3a: [%" PTRFMT"] got %" PRId32" docids from result cache",
+		     (PTRTYPE)this, nd);
+	return true;
+}
+
+void Msg3a::addResultsToCache ( ) {
+	ResultCacheHeader hdr;
+	memset ( &hdr , 0 , sizeof(hdr) );
+	hdr.m_numDocIds             = m_numDocIds;
+	hdr.m_numTotalEstimatedHits = m_numTotalEstimatedHits;
+	hdr.m_pctSearched           = m_pctSearched;
+	hdr.m_moreDocIdsAvail       = m_moreDocIdsAvail;
+
+	// mergeLists() sized the arrays for more docids than it may have
+	// found so copy each one separately
+	SafeBuf rec;
+	if ( ! rec.reserve ( sizeof(hdr) + m_numDocIds * s_resultCacheBytesPerDocId ) ) {
+		g_errno = 0;
+		return;
+	}
+	rec.safeMemcpy ( (char *)&hdr , sizeof(hdr) );
+	rec.safeMemcpy ( (char *)m_docIds , m_numDocIds * 8 );
+	rec.safeMemcpy ( (char *)m_scores , m_numDocIds * sizeof(double) );
+	rec.safeMemcpy ( (char *)m_flags , m_numDocIds * sizeof(unsigned) );
+	rec.safeMemcpy ( (char *)m_clusterRecs , m_numDocIds * sizeof(key96_t) );
+	rec.safeMemcpy ( m_clusterLevels , m_numDocIds );
+
+	RdbCacheLock rcl(s_resultCache);
+	s_resultCache.addRecord ( m_msg39req.m_collnum ,
+				  m_resultCacheKey ,
+				  rec.getBufStart() ,
+				  rec.length() );
+	// a full cache is not an error for the query
+	g_errno = 0;
+}
+
 void Msg3a::printTerms ( ) {
 	// loop over all query terms
 	int32_t n = m_q->getNumTerms();
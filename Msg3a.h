@@ -3,9 +3,11 @@
 
 #include "Msg39.h"
 #include "Multicast.h"
+#include "QueryTrace.h"
 
 class SearchInput;
 class Query;
+class RdbCache;
 
 void setTermFreqWeights ( collnum_t collnum , Query *q, float termFreqWeightFreqMin, float termFreqWeightFreqMax, float termFreqWeightMin, float termFreqWeightMax);
 
@@ -74,6 +76,16 @@ public:
 
 	bool mergeLists ( );
 
+	// . local cache of merged results keyed on the normalized query,
+	//   collection, language and ranking parms of the Msg39Request
+	// . entries expire after g_conf.m_queryResultCacheMaxAge seconds
+	// . the key includes the index generation of every shard (see
+	//   Msg39::getIndexGeneration()), so entries are no longer found once
+	//   a reply shows a shard dumped or merged posdb since
+	static bool initResultCache ( );
+	static void resetResultCache ( );
+	static const RdbCache *getResultCache ( );
+
 	// incoming parameters passed to Msg39::getDocIds() function
 	Query     *m_q;
 	int32_t       m_docsToGet;
@@ -144,6 +156,21 @@ public:
 	// when merging this list of docids into a final list keep
 	// track of the cursor into m_docIds[]
 	int32_t m_cursor;
+
+	// . latency breakdown of the query, owned by Msg40. may be NULL
+	// . the shards are asked for theirs if it is active
+	QueryTrace *m_trace;
+	int64_t     m_traceSendTime [MAX_SHARDS];
+	int64_t     m_traceReplyTime[MAX_SHARDS];
+
+private:
+	key96_t getResultCacheKey ( ) const;
+	bool getResultsFromCache ( );
+	void addResultsToCache ( );
+
+	// should we add the merged results to the result cache?
+	bool    m_addToResultCache;
+	key96_t m_resultCacheKey;
 };
 
 #endif // GB_MSG3A_H
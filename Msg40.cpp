@@ -20,6 +20,7 @@
 #include "ScopedLock.h"
 #include "Mem.h"
 #include "ScopedLock.h"
+#include "Hostdb.h"
 #include <new>
 
 
@@ -27,7 +28,7 @@
 // node cluster....
 #define MAX_OUTSTANDING_MSG20S 200
 
-static bool printHttpMime(int32_t format, SafeBuf *sb);
+static bool printHttpMime(int32_t format, SafeBuf *sb, bool chunked, http_encoding_t encoding);
 
 static void gotDocIdsWrapper             ( void *state );
 static bool gotSummaryWrapper            ( void *state );
@@ -51,6 +52,7 @@ Msg40::Msg40()
 	m_numPrinted    = 0;
 	m_printedHeader = false;
 	m_printedTail   = false;
+	m_chunked       = false;
 	m_sendsOut      = 0;
 	m_sendsIn       = 0;
 	m_printi        = 0;
@@ -84,6 +86,8 @@ Msg40::Msg40()
 	m_num3aRequests = 0;
 	m_num3aReplies = 0;
 	m_firstCollnum = 0;
+	m_traceDocIdsStart = 0;
+	m_traceSummariesStart = 0;
 }
 
 void Msg40::resetBuf2 ( ) {
@@ -236,6 +240,11 @@ bool Msg40::getResults ( SearchInput *si      ,
 	if ( g_conf.m_logTimingQuery || m_si->m_debug || g_conf.m_logDebugQuery) 
 		m_startTime = gettimeofdayInMilliseconds();
 
+	// . record the latency breakdown of some of the queries
+	// . finished by the caller when the results are sent
+	if ( m_si->m_debug || QueryTrace::shouldSample() )
+		m_trace.start ( g_hostdb.getMyHostId() );
+
 	// keep going
 	bool status = prepareToGetDocIds ( );
 
@@ -290,6 +299,8 @@ bool Msg40::getDocIds ( bool recall ) {
 	m_num3aReplies = 0;
 	m_num3aRequests = 0;
 
+	m_traceDocIdsStart = m_trace.getNow();
+
 	// how many are we searching? usually just one.
 	m_numCollsToSearch = m_si->m_collnumBuf.length() /sizeof(collnum_t);
 
@@ -439,6 +450,7 @@ bool Msg40::federatedLoop ( ) {
 		}
 		// assign it
 		m_msg3aPtrs[i] = mp;
+		mp->m_trace = &m_trace;
 		// assign the request for it
 		gbmemcpy ( &mp->m_msg39req , &mr , sizeof(Msg39Request) );
 		// then customize it to just search this collnum
@@ -488,6 +500,7 @@ bool Msg40::gotDocIds ( ) {
 	// return now if still waiting for a msg3a reply to get in
 	if ( m_num3aReplies < m_num3aRequests ) return false;
 
+	m_trace.addSpan ( "msg40 getdocids", QUERY_TRACE_LEVEL_MSG40, m_traceDocIdsStart );
 
 	// if searching over multiple collections let's merge their docids
 	// into m_msg3a now before we go forward
@@ -515,6 +528,7 @@ bool Msg40::gotDocIds ( ) {
 
 	// time this
 	m_startTime = gettimeofdayInMilliseconds();
+	m_traceSummariesStart = m_trace.getNow();
 
 	// we haven't got any Msg20 responses as of yet or sent any requests
 	m_numRequests  =  0;
@@ -1188,12 +1202,28 @@ bool Msg40::gotSummary ( ) {
 
 	st->m_sb.reset();
 
+	// where the content starts in st->m_sb, after the mime
+	int32_t contentOffset = 0;
+	bool lastChunk = false;
+
 	if(m_si->m_streamResults) {
 		// this is in PageResults.cpp
 		if ( ! m_printedHeader ) {
 			// only print header once
 			m_printedHeader = true;
-			printHttpMime(m_si->m_format,&st->m_sb);
+			// . http/1.1 clients get a chunked reply so they can
+			//   tell a complete reply from a truncated one
+			m_chunked = m_si->m_hr.isHttp11();
+			// compress the stream if the client takes it
+			http_encoding_t encoding = HTTP_ENCODING_IDENTITY;
+			if ( g_conf.m_httpCompression && st->m_socket )
+				encoding = HttpCompression::getAcceptedEncoding ( st->m_socket->m_readBuf,
+										  st->m_socket->m_readOffset );
+			if ( encoding != HTTP_ENCODING_IDENTITY &&
+			     ! m_compressor.init ( encoding, g_conf.m_httpCompressionLevel ) )
+				encoding = HTTP_ENCODING_IDENTITY;
+			printHttpMime(m_si->m_format,&st->m_sb,m_chunked,encoding);
+			contentOffset = st->m_sb.length();
 			printSearchResultsHeader ( st );
 		}
 
@@ -1323,6 +1353,7 @@ bool Msg40::gotSummary ( ) {
 		if ( ! m_printedTail &&
 		     m_printi >= m_msg3a.m_numDocIds ) {
 			m_printedTail = true;
+			lastChunk = true;
 			printSearchResultsTail ( st );
 			if ( m_sendsIn < m_sendsOut ) { g_process.shutdownAbort(true); }
 			if ( g_conf.m_logDebugTcp )
@@ -1349,6 +1380,31 @@ bool Msg40::gotSummary ( ) {
 	}
 
 
+	// . compress what was printed since the last send. the compressor
+	//   is flushed so the client can decode every piece as it arrives
+	if ( m_compressor.getEncoding() != HTTP_ENCODING_IDENTITY &&
+	     ! m_socketHadError &&
+	     ( st->m_sb.length() > contentOffset || lastChunk ) ) {
+		SafeBuf compressed;
+		if ( ! m_compressor.compress ( st->m_sb.getBufStart() + contentOffset,
+					       st->m_sb.length() - contentOffset,
+					       lastChunk, &compressed ) ) {
+			log("msg40: error compressing chunk: %s",mstrerror(g_errno));
+			m_socketHadError = g_errno;
+		} else {
+			st->m_sb.setLength ( contentOffset );
+			st->m_sb.safeMemcpy ( &compressed );
+		}
+	}
+	// . frame the content as a chunk when doing chunked transfer encoding
+	// . the zero-length chunk that ends the reply goes with the tail
+	if ( m_chunked && ! m_socketHadError &&
+	     ( st->m_sb.length() > contentOffset || lastChunk ) &&
+	     ! HttpMime::frameChunk ( &st->m_sb, contentOffset, lastChunk ) ) {
+		log("msg40: error framing chunk: %s",mstrerror(g_errno));
+		m_socketHadError = g_errno;
+	}
+
 	// . transmit the chunk in sb if non-zero length
 	// . steals the allocated buffer from sb and stores in the 
 	//   TcpSocket::m_sendBuf, which it frees when socket is
@@ -1808,6 +1864,7 @@ bool Msg40::gotEnoughSummaries() {
 
 	// get time now
 	int64_t now = gettimeofdayInMilliseconds();
+	m_trace.addSpan ( "msg40 summaries", QUERY_TRACE_LEVEL_MSG40, m_traceSummariesStart );
 	// . add the stat for how long to get all the summaries
 	// . use purple for tie to get all summaries
 	// . THIS INCLUDES Msg3a/Msg39 RECALLS!!!
@@ -2051,7 +2108,7 @@ bool Msg40::printSearchResult9 ( int32_t ix , int32_t *numPrintedSoFar ,
 }
 	
 
-static bool printHttpMime(int32_t format, SafeBuf *sb) {
+static bool printHttpMime(int32_t format, SafeBuf *sb, bool chunked, http_encoding_t encoding) {
 	// reserve 1.5MB now!
 	if ( ! sb->reserve(1500000 ,"pgresbuf" ) ) // 128000) )
 		return true;
@@ -2080,8 +2137,13 @@ static bool printHttpMime(int32_t format, SafeBuf *sb) {
 			ct, // "text/csv", // contenttype
 			"utf-8" , // charset
 			-1 , // httpstatus
-			NULL ); //cookie
-	sb->safeMemcpy(mime.getMime(),mime.getMimeLen() );
+			NULL , //cookie
+			chunked );
+	if ( encoding != HTTP_ENCODING_IDENTITY )
+		HttpCompression::addEncodingToMime ( mime.getMime(), mime.getMimeLen(), -1,
+						     encoding, sb );
+	else
+		sb->safeMemcpy(mime.getMime(),mime.getMimeLen() );
 	return true;
 }
 
@@ -13,6 +13,8 @@
 #include "Msg39.h"      // getTermFreqs()
 #include "Msg20.h"      // for getting summary from docId
 #include "Msg3a.h"
+#include "QueryTrace.h"
+#include "HttpCompression.h"
 #include "HashTableT.h"
 #include "GbMutex.h"
 
@@ -117,6 +119,8 @@ public:
 	int32_t m_numPrinted    ;
 	bool m_printedHeader ;
 	bool m_printedTail   ;
+	bool m_chunked       ; // streaming with chunked transfer encoding
+	HttpCompressor m_compressor; // compresses the streamed content
 	int32_t m_sendsOut      ;
 	int32_t m_sendsIn       ;
 	int32_t m_printi        ;
@@ -142,6 +146,13 @@ public:
 	// for timing how long to get all summaries
 	int64_t  m_startTime;
 
+	// . latency breakdown of a sampled query, including the Msg39 spans
+	//   of every shard
+	// . whoever sends the results calls m_trace.finish()
+	QueryTrace m_trace;
+	int64_t    m_traceDocIdsStart;
+	int64_t    m_traceSummariesStart;
+
 	// was Msg40 cached? if so, at what time?
 	time_t     m_cachedTime;
 
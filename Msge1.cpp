@@ -6,6 +6,9 @@
 #include "Conf.h"
 #include "Mem.h"
 #include "ScopedLock.h"
+#include "GbDns.h"
+#include "hash.h"
+#include <unordered_set>
 
 
 Msge1::Msge1()
@@ -23,6 +26,8 @@ Msge1::Msge1()
     m_n(0),
     m_mtx(),
     m_msgCs(),
+    m_hostIps(),
+    m_pendingHosts(),
     m_grv(NULL),
     m_state(NULL),
     m_callback(NULL),
@@ -33,6 +38,8 @@ Msge1::Msge1()
 		m_ns[i] = 0;
 	for(int i=0; i<MAX_OUTSTANDING_MSGE1; i++)
 		m_used[i] = false;
+	for(int i=0; i<MAX_OUTSTANDING_MSGE1; i++)
+		m_hostHashes[i] = 0;
 }
 
 Msge1::~Msge1() {
@@ -56,6 +63,71 @@ void Msge1::reset() {
 		m_ns[i] = 0;
 	for(int i=0; i<MAX_OUTSTANDING_MSGE1; i++)
 		m_used[i] = false;
+	for(int i=0; i<MAX_OUTSTANDING_MSGE1; i++)
+		m_hostHashes[i] = 0;
+	m_hostIps.clear();
+	m_pendingHosts.clear();
+}
+
+
+// . returns true and sets *ip if we don't need a dns lookup for this url
+// . ip is 0 or -1 if the firstip tag had an error, or the url is banned or
+//   blocked
+static bool getKnownIp(TagRec *gr, const char *url, int32_t nowGlobal, int32_t *ip) {
+	// grab the "firstip" from the tagRec if we can
+	Tag *tag = NULL;
+	if ( gr ) tag = gr->getTag("firstip");
+	// grab the ip that was in there
+	if ( tag ) *ip = atoip(tag->getTagData());
+	// if we had it but it was 0 or -1, then time that out
+	// after a day or so in case it works again! 0 and -1 mean
+	// NXDOMAIN or timeout error, etc.
+	if ( tag && ( *ip == 0 || *ip == -1 ) )
+		if ( nowGlobal - tag->m_timestamp > 3600*24 ) tag = NULL;
+	// . if we still got the tag, use that, even if ip is 0 or -1
+	// . this keeps things fast
+	// . this makes sure doConsistencyCheck() does not block too in
+	//   XmlDoc.cpp... cuz it cores if it does block
+	if ( tag ) {
+		return true;
+	}
+
+	// or if banned
+	Tag *btag = NULL;
+	if ( gr ) btag = gr->getTag("manualban");
+	if ( btag && btag->getTagData()[0] !='0') {
+		// debug for now
+		if ( g_conf.m_logDebugDns )
+			log("dns: skipping dns lookup on banned hostname");
+		// -1 means time out i guess
+		*ip = -1;
+		return true;
+	}
+
+	// if it is ip based that makes things easy
+	int32_t  hlen = 0;
+	const char *host = getHostFast ( url , &hlen );
+
+	// see if the hostname is actually an ip like "1.2.3.4"
+	*ip = 0;
+	if ( host && is_digit(host[0]) ) *ip = atoip ( host , hlen );
+	// if legit this is non-zero
+	if ( *ip ) {
+		return true;
+	}
+
+	Url u;
+	u.set(url);
+	if(isUrlBlocked(u)) {
+		// debug for now
+		if(g_conf.m_logDebugDns)
+			log("dns: skipping dns lookup of '%*.*s' because the URL is blocked", (int)u.getHostLen(), (int)u.getHostLen(), u.getHost());
+		// -1 means time out i guess
+		*ip = -1;
+		return true;
+	}
+
+	return false;
 }
 
 
@@ -112,6 +184,20 @@ bool Msge1::getFirstIps ( TagRec **grv ,
 	for(int i=0; i<MAX_OUTSTANDING_MSGE1; i++)
 		m_used[i] = false;
 
+	// . start dns lookups of the hosts we will look up now, so they are
+	//   in the dns cache by the time a slot frees up for them
+	// . we only do MAX_OUTSTANDING_MSGE1 lookups at a time ourselves
+	std::unordered_set<uint64_t> prefetchedHosts;
+	for ( int32_t i = 0 ; i < m_numUrls ; i++ ) {
+		int32_t ip;
+		if ( getKnownIp ( m_grv[i], m_urlPtrs[i], m_nowGlobal, &ip ) ) continue;
+		int32_t hostLen = 0;
+		const char *host = getHostFast ( m_urlPtrs[i] , &hostLen );
+		if ( ! host || hostLen <= 0 ) continue;
+		if ( ! prefetchedHosts.insert ( hash64 ( host , hostLen ) ).second ) continue;
+		GbDns::prefetchARecord ( host , hostLen );
+	}
+
 	// . launch the requests
 	return launchRequests(0);
 }
@@ -126,42 +212,11 @@ bool Msge1::launchRequests ( int32_t starti ) {
 
 	ScopedLock sl(m_mtx);
 	while(m_n < m_numUrls && m_numRequests - m_numReplies < maxOut) {
-		// grab the "firstip" from the tagRec if we can
-		TagRec *gr  = m_grv[m_n];
-		Tag    *tag = NULL;
-		if ( gr ) tag = gr->getTag("firstip");
+		// firstip tag, banned, ip based or blocked url
 		int32_t ip;
-		// grab the ip that was in there
-		if ( tag ) ip = atoip(tag->getTagData());
-		// if we had it but it was 0 or -1, then time that out
-		// after a day or so in case it works again! 0 and -1 mean
-		// NXDOMAIN or timeout error, etc.
-		if ( tag && ( ip == 0 || ip == -1 ) )
-			if ( m_nowGlobal - tag->m_timestamp > 3600*24 ) tag = NULL;
-		// . if we still got the tag, use that, even if ip is 0 or -1
-		// . this keeps things fast
-		// . this makes sure doConsistencyCheck() does not block too in
-		//   XmlDoc.cpp... cuz it cores if it does block
-		if ( tag ) {
+		if ( getKnownIp ( m_grv[m_n], m_urlPtrs[m_n], m_nowGlobal, &ip ) ) {
 			// now "ip" might actually be -1 or 0 (invalid) so be careful
 			m_ipBuf[m_n] = ip;
-			// what is this?
-			//if ( ip == 3 ) { g_process.shutdownAbort(true); }
-			m_numRequests++;
-			m_numReplies++;
-			m_n++;
-			continue;
-		}
-
-		// or if banned
-		Tag *btag = NULL;
-		if ( gr ) btag = gr->getTag("manualban");
-		if ( btag && btag->getTagData()[0] !='0') {
-			// debug for now
-			if ( g_conf.m_logDebugDns )
-				log("dns: skipping dns lookup on banned hostname");
-			// -1 means time out i guess
-			m_ipBuf[m_n] = -1;
 			m_numRequests++;
 			m_numReplies++;
 			m_n++;
@@ -171,38 +226,44 @@ bool Msge1::launchRequests ( int32_t starti ) {
 		// . get the next url
 		// . if m_xd is set, create the url from the ad id
 		const char *p = m_urlPtrs[m_n];
-
-		// if it is ip based that makes things easy
 		int32_t  hlen = 0;
 		const char *host = getHostFast ( p , &hlen );
 
-		// reset this again
-		ip = 0;
-		// see if the hostname is actually an ip like "1.2.3.4"
-		if ( host && is_digit(host[0]) ) ip = atoip ( host , hlen );
-		// if legit this is non-zero
-		if ( ip ) {
-			m_ipBuf[m_n] = ip;
+		uint64_t hostHash = hash64 ( host , hlen );
+
+		// did an earlier url of ours have the same host?
+		auto hostIt = m_hostIps.find ( hostHash );
+		if ( hostIt != m_hostIps.end() ) {
+			m_ipBuf[m_n] = hostIt->second;
 			m_numRequests++;
 			m_numReplies++;
 			m_n++;
 			continue;
 		}
 
-		Url url;
-		url.set(p);
-		if(isUrlBlocked(url)) {
-			// debug for now
-			if(g_conf.m_logDebugDns)
-				log("dns: skipping dns lookup of '%*.*s' because the URL is blocked", (int)url.getHostLen(), (int)url.getHostLen(), url.getHost());
-			// -1 means time out i guess
-			m_ipBuf[m_n] = -1;
+		// . it is being looked up, wait for it instead of doing it twice
+		// . doneSending() fills this one in, keep launching the others
+		auto pendingIt = m_pendingHosts.find ( hostHash );
+		if ( pendingIt != m_pendingHosts.end() ) {
+			pendingIt->second.push_back ( m_n );
+			m_n++;
+			continue;
+		}
+
+		// . we may have it locally (prefetched by XmlDoc when it
+		//   got the outlinks)
+		// . only use good ips, let msgc deal with the errors
+		GbDns::DnsResponse response;
+		if ( host && GbDns::getCachedARecord ( host , hlen , &response ) &&
+		     ! response.m_errno && ! response.m_ips.empty() ) {
+			m_ipBuf[m_n] = response.m_ips.front();
+			m_hostIps[hostHash] = m_ipBuf[m_n];
 			m_numRequests++;
 			m_numReplies++;
 			m_n++;
 			continue;
 		}
-		
+
 		// . grab a slot
 		int32_t i;
 		for ( i = starti ; i < MAX_OUTSTANDING_MSGE1 ; i++ )
@@ -213,6 +274,8 @@ bool Msge1::launchRequests ( int32_t starti ) {
 		m_ns  [i] = m_n++;
 		// claim it
 		m_used[i] = true;
+		m_hostHashes[i] = hostHash;
+		m_pendingHosts[hostHash];
 
 		// . start it off
 		// . this will start the pipeline for this url
@@ -275,6 +338,20 @@ void Msge1::doneSending_unlocked(int32_t slotIndex) {
 	int32_t n = m_ns[slotIndex];
 	// save the error if msgC had one
 	m_ipErrors[n] = g_errno;
+	// other urls with the same host can use it now
+	if ( ! g_errno )
+		m_hostIps[m_hostHashes[slotIndex]] = m_ipBuf[n];
+	// and the ones that were waiting for it get the same answer
+	auto pendingIt = m_pendingHosts.find ( m_hostHashes[slotIndex] );
+	if ( pendingIt != m_pendingHosts.end() ) {
+		for ( int32_t waiting : pendingIt->second ) {
+			m_ipBuf[waiting] = m_ipBuf[n];
+			m_ipErrors[waiting] = g_errno;
+			m_numRequests++;
+			m_numReplies++;
+		}
+		m_pendingHosts.erase ( pendingIt );
+	}
 	// save m_errno
 	if ( g_errno && ! m_errno ) m_errno = g_errno;
 	// reset error for successive calls to other msgs
@@ -8,6 +8,8 @@
 #include "MsgC.h"
 #include "Linkdb.h"
 #include "GbMutex.h"
+#include <unordered_map>
+#include <vector>
 
 class Msge1 {
 
@@ -70,6 +72,12 @@ private:
 	int32_t    m_ns          [ MAX_OUTSTANDING_MSGE1 ]; 
 	bool    m_used        [ MAX_OUTSTANDING_MSGE1 ]; 
 	MsgC    m_msgCs       [ MAX_OUTSTANDING_MSGE1 ]; // ips
+	uint64_t m_hostHashes [ MAX_OUTSTANDING_MSGE1 ];
+
+	// most outlinks share a few hosts, so we only look up each host once
+	std::unordered_map<uint64_t,int32_t> m_hostIps;
+	// hosts being looked up, and the other urls waiting for their ip
+	std::unordered_map<uint64_t,std::vector<int32_t>> m_pendingHosts;
 
 	// vector of TagRec ptrs
 	TagRec **m_grv;
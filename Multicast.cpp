@@ -10,6 +10,10 @@
 #include "ip.h"
 #include "Mem.h"
 #include "Msg0.h"         //msg+MSG0RDBIDOFFSET
+#include "Statistics.h"   //get_udp_roundtrip_snapshot()
+#include "LatencyHistogram.h"
+#include "GbMutex.h"
+#include "fctypes.h"
 
 
 // TODO: if we're ordered to close and we still are waiting on stuff
@@ -17,6 +21,130 @@
 //       slots to disk for sending later??
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Reply times, for replica selection and hedged requests
+
+// . the msg types whose reply times we track per host. They differ a lot
+//   between msg types (a msg39 takes much longer than a msg22) so they are
+//   tracked separately. All other types share the last entry.
+static const msg_type_t s_trackedMsgTypes[] = {
+	msg_type_0, msg_type_20, msg_type_22, msg_type_25, msg_type_39
+};
+static const int s_numTrackedMsgTypes = sizeof(s_trackedMsgTypes)/sizeof(s_trackedMsgTypes[0]);
+
+// . an exponentially weighted moving average of the reply time of a host,
+//   with the weight of a new sample being 1/8 like the tcp srtt
+// . samples older than s_replyTimeMaxAgeMs are forgotten so a host that
+//   was slow gets tried again
+struct ReplyTime {
+	int64_t m_ewmaUs;        // 0 if unknown
+	int64_t m_lastSampleMs;
+};
+static ReplyTime s_replyTimes[MAX_HOSTS][s_numTrackedMsgTypes+1];
+static const int64_t s_replyTimeMaxAgeMs = 10000;
+
+// . the hedge delay of a msg type is the 95th percentile of its udp round
+//   trip times since the previous refresh
+// . refreshed every s_hedgeWindowMs but only if there were at least
+//   s_hedgeMinSamples replies, otherwise the window keeps growing
+struct HedgeDelay {
+	LatencyHistogram::Snapshot m_base;
+	int64_t m_baseTimeMs;
+	int64_t m_lastCheckMs;
+	int64_t m_delayMs;       // -1 if unknown
+};
+static HedgeDelay s_hedgeDelays[s_numTrackedMsgTypes+1];
+static const int64_t s_hedgeWindowMs = 10000;
+static const uint64_t s_hedgeMinSamples = 100;
+
+static GbMutex s_mtxReplyTimes;
+
+// a host with this many queued jobs is assumed to take twice as long
+static const int64_t s_queuedJobsDoublingCost = 4;
+
+
+static int getTrackedMsgTypeIndex(msg_type_t msgType) {
+	for(int i = 0; i < s_numTrackedMsgTypes; i++)
+		if(s_trackedMsgTypes[i] == msgType)
+			return i;
+	return s_numTrackedMsgTypes;
+}
+
+void Multicast::recordReplyTime(const Host *h, msg_type_t msgType, int64_t us, int64_t nowMs, bool isLowerBound) {
+	if(h->m_hostId < 0 || h->m_hostId >= MAX_HOSTS)
+		return;
+	if(us <= 0)
+		us = 1;
+	ScopedLock sl(s_mtxReplyTimes);
+	ReplyTime &rt = s_replyTimes[h->m_hostId][getTrackedMsgTypeIndex(msgType)];
+	bool isKnown = rt.m_ewmaUs != 0 && nowMs - rt.m_lastSampleMs <= s_replyTimeMaxAgeMs;
+	// a cancelled request can only tell us that the host is slower than we thought
+	if(isLowerBound && isKnown && us <= rt.m_ewmaUs)
+		return;
+	if(!isKnown)
+		rt.m_ewmaUs = us;
+	else
+		rt.m_ewmaUs += (us - rt.m_ewmaUs) / 8;
+	rt.m_lastSampleMs = nowMs;
+}
+
+int64_t Multicast::getReplyTime(const Host *h, msg_type_t msgType, int64_t nowMs) {
+	if(h->m_hostId < 0 || h->m_hostId >= MAX_HOSTS)
+		return 0;
+	ScopedLock sl(s_mtxReplyTimes);
+	const ReplyTime &rt = s_replyTimes[h->m_hostId][getTrackedMsgTypeIndex(msgType)];
+	if(nowMs - rt.m_lastSampleMs > s_replyTimeMaxAgeMs)
+		return 0;
+	return rt.m_ewmaUs;
+}
+
+// . expected cost of sending a request to a host: its reply time scaled by
+//   the number of jobs queued on it as told by InstanceInfoExchange
+// . returns 0 if we haven't heard from it recently
+static int64_t getHostCost(const Host *h, msg_type_t msgType, int64_t nowMs) {
+	int64_t ewmaUs = Multicast::getReplyTime(h, msgType, nowMs);
+	if(ewmaUs == 0)
+		return 0;
+	int64_t queuedJobs = 0;
+	if(h->m_runtimeInformation.m_valid && h->m_runtimeInformation.m_queuedJobs > 0)
+		queuedJobs = h->m_runtimeInformation.m_queuedJobs;
+	return ewmaUs * (s_queuedJobsDoublingCost + queuedJobs) / s_queuedJobsDoublingCost;
+}
+
+// read requests that are safe to send to two twins at once
+static bool isHedgeable(msg_type_t msgType) {
+	return msgType == msg_type_0 ||
+	       msgType == msg_type_20 ||
+	       msgType == msg_type_22 ||
+	       msgType == msg_type_39;
+}
+
+// returns -1 if we don't know enough about the msg type yet
+static int64_t getHedgeDelay(msg_type_t msgType, int64_t nowMs) {
+	ScopedLock sl(s_mtxReplyTimes);
+	HedgeDelay &hd = s_hedgeDelays[getTrackedMsgTypeIndex(msgType)];
+	if(hd.m_lastCheckMs == 0) {
+		hd.m_baseTimeMs = nowMs;
+		hd.m_lastCheckMs = nowMs;
+		hd.m_delayMs = -1;
+	}
+	// snapshots aren't free so don't look more than once a second
+	if(nowMs - hd.m_baseTimeMs >= s_hedgeWindowMs && nowMs - hd.m_lastCheckMs >= 1000) {
+		hd.m_lastCheckMs = nowMs;
+		LatencyHistogram::Snapshot snapshot;
+		if(Statistics::get_udp_roundtrip_snapshot(msgType, &snapshot)) {
+			LatencyHistogram::Snapshot window(snapshot);
+			window.subtract(hd.m_base);
+			if(window.m_count >= s_hedgeMinSamples) {
+				hd.m_delayMs = (int64_t)(window.getValueAtPercentile(95.0) / 1000);
+				hd.m_base = std::move(snapshot);
+				hd.m_baseTimeMs = nowMs;
+			}
+		}
+	}
+	return hd.m_delayMs;
+}
+
 
 void Multicast::constructor() {
 	m_msg      = NULL;
@@ -52,6 +180,8 @@ Multicast::Multicast()
     m_readBufMaxSize(0),
     m_ownReadBuf(false),
     m_registeredSleep(false),
+    m_registeredHedge(false),
+    m_hedged(false),
     m_niceness(0),
     m_lastLaunch(0),
     m_freeReadBuf(false),
@@ -128,6 +258,8 @@ bool Multicast::send(char *msg, int32_t msgSize, msg_type_t msgType, bool ownMsg
 	m_readBufSize      = 0;
 	m_readBufMaxSize   = 0;
 	m_registeredSleep  = false;
+	m_registeredHedge  = false;
+	m_hedged           = false;
 	m_sentToTwin       = false;
 	m_key              = key;
 
@@ -457,6 +589,23 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 	// . this will prevent a ton of msg39s from hitting one host and
 	//   "spiking" it.
 	if ( balance ) n = g_hostdb.m_myHost->m_stripe;
+
+	// . find the twin that has been answering fastest
+	// . the host selected by the key or stripe is still preferred for
+	//   the sake of its caches, unless it is much slower than that
+	int64_t cost[MAX_HOSTS_PER_GROUP];
+	int32_t fastest = -1;
+	if ( g_conf.m_multicastAdaptiveSelection ) {
+		int64_t nowms = gettimeofdayInMilliseconds();
+		for ( int32_t i = 0 ; i < m_numHosts ; i++ )
+			cost[i] = getHostCost ( m_host[i].m_hostPtr, m_msgType, nowms );
+		fastest = pickFastestHost ( cost );
+	}
+	// true if host #i is known to be more than twice as slow as the fastest
+	auto isMuchSlower = [&](int32_t i) {
+		return fastest >= 0 && cost[fastest] > 0 && cost[i] > 2 * cost[fastest];
+	};
+
 	// . if key is not zero, use it to select a host in this group
 	// . if the host we want is dead then do it the old way
 	// . ignore the key if balance is true though! MDW
@@ -466,17 +615,26 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 		uint32_t i = hashLong ( key ) % m_numHosts;
 		// if he's not dead or retired use him right away
 		if ( ! m_host[i].m_retired &&
-		     ! g_hostdb.isDead ( m_host[i].m_hostPtr ) )
+		     ! g_hostdb.isDead ( m_host[i].m_hostPtr ) &&
+		     ! isMuchSlower ( i ) )
 			return i;
 	}
 
+	// without a stripe to stick to just go for the fastest
+	if ( fastest >= 0 && ! balance )
+		return fastest;
+
 	// no no no we need to randomize the order that we try them
 	Host *fh = m_host[n].m_hostPtr;
 	// if this host is not dead, use him
 	if ( ! m_host[n].m_retired &&
-	     ! g_hostdb.isDead(fh) )
+	     ! g_hostdb.isDead(fh) &&
+	     ! isMuchSlower ( n ) )
 		return n;
 
+	if ( fastest >= 0 )
+		return fastest;
+
 	// . ok now select the kth available host
 	// . make a list of the candidates
 	int32_t cand[32];
@@ -510,6 +668,26 @@ int32_t Multicast::pickBestHost ( uint32_t key , int32_t firstHostId ) {
 	return -1;
 }
 
+// . pick the alive, non-retired host with the lowest cost
+// . a host with unknown cost (0) is picked first so we learn about it
+// . returns -1 if there are no candidates or we know nothing about them
+int32_t Multicast::pickFastestHost ( const int64_t *cost ) const {
+	int32_t best    = -1;
+	int32_t unknown = -1;
+	for ( int32_t i = 0 ; i < m_numHosts ; i++ ) {
+		if ( m_host[i].m_retired ) continue;
+		if ( g_hostdb.isDead ( m_host[i].m_hostPtr ) ) continue;
+		if ( cost[i] == 0 ) {
+			if ( unknown < 0 ) unknown = i;
+			continue;
+		}
+		if ( best < 0 || cost[i] < cost[best] ) best = i;
+	}
+	if ( best < 0 ) return -1;
+	if ( unknown >= 0 ) return unknown;
+	return best;
+}
+
 // . returns false and sets error on g_errno
 // . returns true if kicked of the request (m_msg)
 // . sends m_msg to host "h"
@@ -529,6 +707,7 @@ bool Multicast::sendToHost ( int32_t i ) {
 	int64_t nowms = gettimeofdayInMilliseconds();
 	// save the time
 	m_host[i].m_launchTime = nowms;
+	m_host[i].m_launchTimeUs = gettimeofdayInMicroseconds();
 	// sometimes clock is updated on us
 	if ( m_startTime > nowms )
 		m_startTime = nowms;
@@ -615,6 +794,20 @@ bool Multicast::sendToHost ( int32_t i ) {
 			m_registeredSleep = true;
 		}
 	}
+
+	// . if the reply takes longer than usual send the request to a twin
+	//   as well. only once per multicast
+	if ( g_conf.m_multicastHedging && ! m_hedged &&
+	     m_niceness == 0 && m_numHosts > 1 && isHedgeable(m_msgType) ) {
+		int64_t delay = getHedgeDelay ( m_msgType, nowms );
+		if ( delay >= 0 ) {
+			if ( delay < g_conf.m_multicastHedgeMinDelay )
+				delay = g_conf.m_multicastHedgeMinDelay;
+			g_loop.registerSleepCallback(delay, this, hedgeCallbackWrapper, "Multicast::hedgeCallbackWrapper", m_niceness);
+			m_registeredHedge = true;
+			m_hedged = true;
+		}
+	}
 	// successful launch
 	return true;
 }
@@ -787,6 +980,39 @@ void Multicast::sleepCallback1() {
 }
 
 
+// called when the first request has taken longer than the hedge delay
+void Multicast::hedgeCallbackWrapper ( int bogusfd , void *state ) {
+	Multicast *that = static_cast<Multicast*>(state);
+	that->hedgeCallback();
+}
+
+void Multicast::hedgeCallback() {
+	// only hedge once
+	g_loop.unregisterSleepCallback(this, hedgeCallbackWrapper);
+	m_registeredHedge = false;
+
+	// don't hedge if we already went to a twin because of an error or
+	// because sleepCallback1() rerouted
+	int32_t numInProgress = 0;
+	for ( int32_t i = 0 ; i < m_numHosts ; i++ )
+		if ( m_host[i].m_inProgress )
+			numInProgress++;
+	if ( numInProgress != 1 )
+		return;
+
+	int64_t elapsed = gettimeofdayInMilliseconds() - m_lastLaunch;
+
+	// . the first reply wins and closeUpShop() cancels the other request
+	// . if there are no twins left just keep waiting
+	if ( sendToHostLoop(0,-1) ) {
+		logDebug(g_conf.m_logDebugMulticast, "multicast: sent hedged request msgType=0x%02x after %" PRId64" ms (this=0x%" PTRFMT")",
+		         (int)m_msgType, elapsed, (PTRTYPE)this);
+		g_stats.m_hedges[(int)m_msgType][m_niceness]++;
+	}
+	g_errno = 0;
+}
+
+
 void Multicast::gotReply1(void *state, UdpSlot *slot) {
 	Multicast *THIS = static_cast<Multicast*>(state);
 	THIS->gotReply1(slot);
@@ -828,6 +1054,12 @@ void Multicast::gotReply1 ( UdpSlot *slot ) {
 
 	Host *h = m_host[i].m_hostPtr;
 
+	// . remember how long the host took so pickBestHost() can avoid
+	//   slow twins. timeouts count too.
+	if ( ! g_errno || g_errno == EUDPTIMEDOUT )
+		recordReplyTime ( h, m_msgType, gettimeofdayInMicroseconds() - m_host[i].m_launchTimeUs,
+				  gettimeofdayInMilliseconds(), false );
+
 	// save the host we got a reply from
 	m_replyingHost    = h;
 	m_replyLaunchTime = m_host[i].m_launchTime;
@@ -962,6 +1194,10 @@ void Multicast::closeUpShop ( UdpSlot *slot ) {
 		g_loop.unregisterSleepCallback(this, sleepCallback1Wrapper);
 		m_registeredSleep = false;
 	}
+	if ( m_registeredHedge ) {
+		g_loop.unregisterSleepCallback(this, hedgeCallbackWrapper);
+		m_registeredHedge = false;
+	}
 
 	// allow us to be re-used now, callback might relaunch
 	m_inUse = false;
@@ -986,6 +1222,13 @@ void Multicast::destroySlotsInProgress ( UdpSlot *slot ) {
 		// must be in progress
 		if ( ! m_host[i].m_inProgress ) continue;
 
+		// . the host lost the race. it took at least this long, so only
+		//   let it raise what we know about the host, never lower it
+		if ( m_host[i].m_launchTimeUs )
+			recordReplyTime ( m_host[i].m_hostPtr, m_msgType,
+					  gettimeofdayInMicroseconds() - m_host[i].m_launchTimeUs,
+					  gettimeofdayInMilliseconds(), true );
+
 		// don't free his sendBuf, readBuf is ok to free, however
 		m_host[i].m_slot->m_sendBufAlloc = NULL;
 
@@ -45,6 +45,13 @@ class Multicast {
 	void constructor ( );
 	void destructor  ( );
 
+	// . per host reply times used to pick the fastest twin
+	// . "isLowerBound" is for cancelled requests. The host took at least
+	//   "us" so it only raises the reply time
+	static void recordReplyTime(const Host *h, msg_type_t msgType, int64_t us, int64_t nowMs, bool isLowerBound);
+	// returns 0 if we haven't heard from the host recently
+	static int64_t getReplyTime(const Host *h, msg_type_t msgType, int64_t nowMs);
+
 	// . returns false and sets errno on error
 	// . returns true on success -- your callback will be called
 	// . check errno when your callback is called
@@ -143,13 +150,15 @@ private:
 		UdpSlot    *m_slot;
 		int32_t     m_errno;            // did we have an errno with this slot?
 		int64_t     m_launchTime;
+		int64_t     m_launchTimeUs;     // for measuring the reply time of the host
 		HostSlot()
 		  : m_hostPtr(NULL),
 		    m_retired(false),
 		    m_inProgress(false),
 		    m_slot(NULL),
 		    m_errno(0),
-		    m_launchTime(0)
+		    m_launchTime(0),
+		    m_launchTimeUs(0)
 		{ }
 		void reset() {
 			m_hostPtr=NULL;
@@ -158,6 +167,7 @@ private:
 			m_slot=NULL;
 			m_errno=0;
 			m_launchTime=0;
+			m_launchTimeUs=0;
 		}
 	} m_host[MAX_HOSTS_PER_GROUP];
 	int32_t        m_numHosts;
@@ -173,6 +183,10 @@ private:
 	bool        m_ownReadBuf;
 	// are we registered for a callback every 1 second
 	bool        m_registeredSleep;
+	// are we registered for sending a hedged request
+	bool        m_registeredHedge;
+	// did we (plan to) send a hedged request
+	bool        m_hedged;
 
 	int32_t        m_niceness;
 
@@ -198,6 +212,8 @@ private:
 	static void sleepCallback1Wrapper(int bogusfd, void *state);
 	void sleepCallback1();
 	static void sleepWrapper2(int bogusfd, void *state);
+	static void hedgeCallbackWrapper(int bogusfd, void *state);
+	void hedgeCallback();
 	static void gotReply1(void *state, UdpSlot *slot);
 	void gotReply1(UdpSlot *slot);
 	static void gotReply2(void *state, UdpSlot *slot);
@@ -206,6 +222,7 @@ private:
 	bool sendToHostLoop(int32_t key, int32_t firstHostId);
 	bool sendToHost    ( int32_t i ); 
 	int32_t pickBestHost(uint32_t key, int32_t firstHostId);
+	int32_t pickFastestHost(const int64_t *cost) const;
 	void closeUpShop   ( UdpSlot *slot ) ;
 };
 
@@ -0,0 +1,16 @@
+#include "gb-include.h"
+
+#include "TcpServer.h"
+#include "Pages.h"
+#include "SafeBuf.h"
+#include "Statistics.h"
+
+
+// latency histograms in the prometheus text exposition format
+bool sendPageMetrics( TcpSocket *s , HttpRequest *r ) {
+	StackBuf<64*1024> p;
+
+	Statistics::print_metrics(&p);
+
+	return g_httpServer.sendDynamicPage (s, (char*)p.getBufStart(), p.length(), -1, false, "text/plain; version=0.0.4", -1, NULL, "utf8" );
+}
@@ -0,0 +1,37 @@
+#include "gb-include.h"
+
+#include "TcpServer.h"
+#include "Pages.h"
+#include "SafeBuf.h"
+#include "QueryTrace.h"
+
+
+// . shows the latency breakdown of the recently traced queries
+// . "format=json" returns them in the chrome trace event format, "id=N"
+//   restricts that to a single trace
+bool sendPageQueryTraces ( TcpSocket *s , HttpRequest *r ) {
+	if ( r->getReplyFormat() == FORMAT_JSON ) {
+		SafeBuf sb;
+		int64_t traceId = r->getLongLong("id", 0);
+		if ( ! QueryTrace::printChromeTrace(&sb, traceId) )
+			return g_httpServer.sendErrorReply(s, 404, "Trace not found");
+		return g_httpServer.sendDynamicPage(s, sb.getBufStart(), sb.length(), -1, false, "application/json", -1, NULL, "utf8");
+	}
+
+	StackBuf<64*1024> p;
+	g_pages.printAdminTop ( &p , s , r );
+
+	if ( r->getLong("clear", 0) )
+		QueryTrace::clearTraces();
+
+	p.safePrintf("<p>Every Nth query is traced as set by the <i>query trace sample rate</i> "
+		     "parameter on the search controls page. Queries with debug enabled are always traced. "
+		     "Times are in milliseconds relative to the start of the query. "
+		     "Shard spans are placed in the middle of their round trip. "
+		     "<a href=\"/admin/querytraces?clear=1\">Clear</a></p>\n");
+
+	QueryTrace::printTraces(&p);
+
+	return g_httpServer.sendDynamicPage ( s , (char*) p.getBufStart() ,
+						p.length() );
+}
@@ -95,6 +95,8 @@ static bool sendReply(State0 *st, char *reply) {
 	logf(LOG_DEBUG,"gb: sending back %" PRId32" bytes",rlen);
 
 	Statistics::register_query_time(si->m_q.m_numWords, si->m_queryLangId, savedErr, (gettimeofdayInMilliseconds() - st->m_startTime));
+	// store the latency breakdown if this query was traced
+	st->m_msg40.m_trace.finish(si->m_q.originalQuery(), savedErr);
 
 	// . log the time
 	// . do not do this if g_errno is set lest m_sbuf1 be bogus b/c
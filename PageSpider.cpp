@@ -255,9 +255,9 @@ static bool generatePageHTML(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	// count # of spiders out
 	int32_t j = 0;
 	// first print the spider recs we are spidering
-	for (int32_t i = 0; i < (int32_t)MAX_SPIDERS; i++) {
+	for (int32_t i = 0; i < g_spiderLoop.getNumDocSlots(); i++) {
 		// get it
-		XmlDoc *xd = g_spiderLoop.m_docs[i];
+		XmlDoc *xd = g_spiderLoop.getDoc(i);
 		// skip if empty
 		if (!xd) continue;
 		// sanity check
@@ -352,8 +352,8 @@ static bool generatePageHTML(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	sb->safePrintf("<span class=\"comment\">");
 	// print time format: 7/23/1971 10:45:32
 	int64_t timems = gettimeofdayInMilliseconds();
-	sb->safePrintf(" (current time = %" PRIu64") (totalcount=%" PRId32") (waittablecount=%" PRId32")",
-	              timems, sc->m_waitingTree.getNumUsedNodes(), sc->getWaitingTableCount());
+	sb->safePrintf(" (current time = %" PRIu64") (totalcount=%" PRId32") (waittablecount=%" PRId32") (ipscantablecount=%" PRId32")",
+	              timems, sc->m_waitingTree.getNumUsedNodes(), sc->getWaitingTableCount(), sc->getIpScanTableCount());
 
 	char ipbuf[16];
 	sb->safePrintf(" (spiderdb scanning ip %s)", iptoa(sc->getScanningIp(),ipbuf));
@@ -477,8 +477,8 @@ static bool generatePageJSON(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	// count # of spiders out
 	int32_t j = 0;
 	// first print the spider recs we are spidering
-	for (int32_t i = 0; i < (int32_t)MAX_SPIDERS; i++) {
-		XmlDoc *xd = g_spiderLoop.m_docs[i];
+	for (int32_t i = 0; i < g_spiderLoop.getNumDocSlots(); i++) {
+		XmlDoc *xd = g_spiderLoop.getDoc(i);
 		if (!xd) {
 			continue;
 		}
@@ -560,6 +560,7 @@ static bool generatePageJSON(CollectionRec *cr, SafeBuf *sb, const SafeBuf *dole
 	/////////////////
 
 	sb->safePrintf("\t\"waitingTreeCount\": %d,\n", sc->m_waitingTree.getNumUsedNodes());
+	sb->safePrintf("\t\"ipScanTableCount\": %d,\n", sc->getIpScanTableCount());
 
 	sb->safePrintf("\t\"waitingTrees\": [\n");
 
@@ -20,7 +20,9 @@
 #include "Sections.h"
 #include "Msg13.h"
 #include "Msg3.h"
+#include "Msg3a.h"
 #include "Mem.h"
+#include "Loop.h"
 #include <math.h>
 
 
@@ -259,6 +261,109 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 
 	if ( format == FORMAT_HTML ) p.safePrintf("</table><br><br>\n");
 
+	//
+	// event loop stats
+	//
+	{
+		const Loop::Stats &ls = g_loop.getStats();
+		static const char * const s_callbackTypeNames[Loop::callback_type_end] = { "read", "write", "sleep" };
+		std::map<std::string,Loop::FdTypeStats> fdTypeStats;
+		g_loop.getFdTypeStats ( &fdTypeStats );
+
+		if ( format == FORMAT_HTML ) {
+			p.safePrintf ( "<table %s>"
+				       "<tr class=hdrow>"
+				       "<td colspan=4>"
+				       "<center><b>Event Loop (%s)</b></td></tr>\n"
+				       "<tr class=poo><td><b>wakeups</b></td><td colspan=3>%" PRId64"</td></tr>\n"
+				       "<tr class=poo><td><b>ready fds</b></td><td colspan=3>%" PRId64"</td></tr>\n"
+				       "<tr class=poo><td><b>callback type</b></td>"
+				       "<td><b>calls</b></td>"
+				       "<td><b>total time (ms)</b></td>"
+				       "<td><b>avg time (us)</b></td></tr>\n"
+				       , TABLE_STYLE
+				       , g_loop.isUsingEpoll() ? "epoll" : "select"
+				       , ls.m_numWakeups
+				       , ls.m_numReadyFds );
+			for ( int i = 0 ; i < Loop::callback_type_end ; i++ )
+				p.safePrintf ( "<tr class=poo><td>%s</td>"
+					       "<td>%" PRId64"</td>"
+					       "<td>%" PRId64"</td>"
+					       "<td>%" PRId64"</td></tr>\n"
+					       , s_callbackTypeNames[i]
+					       , ls.m_numCallbacks[i]
+					       , ls.m_callbackTime[i] / 1000
+					       , ls.m_numCallbacks[i] ? ls.m_callbackTime[i] / ls.m_numCallbacks[i] : 0 );
+			p.safePrintf ( "<tr class=poo><td><b>fd type</b></td>"
+				       "<td><b>calls</b></td>"
+				       "<td><b>total time (ms)</b></td>"
+				       "<td><b>avg time (us)</b></td></tr>\n" );
+			for ( const auto &it : fdTypeStats )
+				p.safePrintf ( "<tr class=poo><td>%s</td>"
+					       "<td>%" PRId64"</td>"
+					       "<td>%" PRId64"</td>"
+					       "<td>%" PRId64"</td></tr>\n"
+					       , it.first.c_str()
+					       , it.second.m_numCallbacks
+					       , it.second.m_callbackTime / 1000
+					       , it.second.m_numCallbacks ? it.second.m_callbackTime / it.second.m_numCallbacks : 0 );
+			p.safePrintf ( "</table><br><br>\n" );
+		}
+
+		if ( format == FORMAT_XML ) {
+			p.safePrintf ( "\t<loopStats>\n"
+				       "\t\t<backend>%s</backend>\n"
+				       "\t\t<wakeups>%" PRId64"</wakeups>\n"
+				       "\t\t<readyFds>%" PRId64"</readyFds>\n"
+				       , g_loop.isUsingEpoll() ? "epoll" : "select"
+				       , ls.m_numWakeups
+				       , ls.m_numReadyFds );
+			for ( int i = 0 ; i < Loop::callback_type_end ; i++ )
+				p.safePrintf ( "\t\t<callbacks>\n"
+					       "\t\t\t<type>%s</type>\n"
+					       "\t\t\t<calls>%" PRId64"</calls>\n"
+					       "\t\t\t<timeUs>%" PRId64"</timeUs>\n"
+					       "\t\t</callbacks>\n"
+					       , s_callbackTypeNames[i]
+					       , ls.m_numCallbacks[i]
+					       , ls.m_callbackTime[i] );
+			for ( const auto &it : fdTypeStats )
+				p.safePrintf ( "\t\t<fdType>\n"
+					       "\t\t\t<name><![CDATA[%s]]></name>\n"
+					       "\t\t\t<calls>%" PRId64"</calls>\n"
+					       "\t\t\t<timeUs>%" PRId64"</timeUs>\n"
+					       "\t\t</fdType>\n"
+					       , it.first.c_str()
+					       , it.second.m_numCallbacks
+					       , it.second.m_callbackTime );
+			p.safePrintf ( "\t</loopStats>\n" );
+		}
+
+		if ( format == FORMAT_JSON ) {
+			p.safePrintf ( "\t\"loopStats\":{\n"
+				       "\t\t\"backend\":\"%s\",\n"
+				       "\t\t\"wakeups\":%" PRId64",\n"
+				       "\t\t\"readyFds\":%" PRId64",\n"
+				       , g_loop.isUsingEpoll() ? "epoll" : "select"
+				       , ls.m_numWakeups
+				       , ls.m_numReadyFds );
+			for ( int i = 0 ; i < Loop::callback_type_end ; i++ )
+				p.safePrintf ( "\t\t\"%sCallbacks\":{\"calls\":%" PRId64",\"timeUs\":%" PRId64"},\n"
+					       , s_callbackTypeNames[i]
+					       , ls.m_numCallbacks[i]
+					       , ls.m_callbackTime[i] );
+			p.safePrintf ( "\t\t\"fdTypes\":[\n" );
+			for ( auto it = fdTypeStats.begin() ; it != fdTypeStats.end() ; ++it )
+				p.safePrintf ( "\t\t\t{\"name\":\"%s\",\"calls\":%" PRId64",\"timeUs\":%" PRId64"}%s\n"
+					       , it->first.c_str()
+					       , it->second.m_numCallbacks
+					       , it->second.m_callbackTime
+					       , std::next(it) != fdTypeStats.end() ? "," : "" );
+			p.safePrintf ( "\t\t]\n" );
+			p.safePrintf ( "\t},\n" );
+		}
+	}
+
 	// stripe loads
 	if ( g_hostdb.m_myHost->m_isProxy ) {
 		p.safePrintf ( 
@@ -300,6 +405,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 	caches[numCaches++] = g_dns.getCache();
 	caches[numCaches++] = g_dns.getCacheLocal();
 	caches[numCaches++] = &g_spiderLoop.m_winnerListCache;
+	caches[numCaches++] = Msg3a::getResultCache();
 
 	if ( format == FORMAT_HTML ) {
 		p.safePrintf (
@@ -338,6 +444,8 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			     caches[i]->getMaxMem());
 		p.safePrintf("\t\t<saveToDisk>%" PRId32"</saveToDisk>\n",
 			     (int32_t)caches[i]->useDisk());
+		p.safePrintf("\t\t<numShards>%" PRId32"</numShards>\n",
+			     caches[i]->getNumShards());
 		p.safePrintf("\t</cacheStats>\n");
 	}
 
@@ -362,8 +470,10 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			     caches[i]->getMemOccupied());
 		p.safePrintf("\t\t\"maxBytes\":%" PRId32",\n",
 			     caches[i]->getMaxMem());
-		p.safePrintf("\t\t\"saveToDisk\":%" PRId32"\n",
+		p.safePrintf("\t\t\"saveToDisk\":%" PRId32",\n",
 			     (int32_t)caches[i]->useDisk());
+		p.safePrintf("\t\t\"numShards\":%" PRId32"\n",
+			     caches[i]->getNumShards());
 		p.safePrintf("\t},\n");
 	}
 
@@ -443,6 +553,24 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 		p.safePrintf("<td>%" PRId64"</td>",a);
 	}
 
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>shards</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		int32_t a = caches[i]->getNumShards();
+		p.safePrintf("<td>%" PRId32"</td>",a);
+	}
+
+	// tries per shard, to see if the key hash spreads the load
+	p.safePrintf ("</tr>\n<tr class=poo><td><b><nobr>shard tries</nobr></b></td>" );
+	for ( int32_t i = 0 ; i < numCaches ; i++ ) {
+		p.safePrintf("<td>");
+		for ( int32_t j = 0 ; j < caches[i]->getNumShards() ; j++ ) {
+			const RdbCache *shard = caches[i]->getShard(j);
+			p.safePrintf("%s%" PRId64, j ? " " : "",
+				     shard->getNumHits() + shard->getNumMisses());
+		}
+		p.safePrintf("</td>");
+	}
+
 	// end the table now
 	p.safePrintf ( "</tr>\n</table><br><br>" );
 
@@ -1050,6 +1178,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			      "<td><b>acks out</td>\n"
 
 			      "<td><b>reroutes</td>\n"
+			      "<td><b>hedges</td>\n"
 			      "<td><b>dropped</td>\n"
 			      "<td><b>cancels read</td>\n"
 			      "<td><b>errors</td>\n"
@@ -1073,6 +1202,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 			// skip it if has no handler
 			if ( ! g_udpServer.hasHandler(i1) ) continue;
 			if ( ! g_stats.m_reroutes   [i1][i3] &&
+			     ! g_stats.m_hedges     [i1][i3] &&
 			     ! g_stats.m_packetsIn  [i1][i3] &&
 			     ! g_stats.m_packetsOut [i1][i3] &&
 			     ! g_stats.m_errors     [i1][i3] &&
@@ -1093,6 +1223,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     "<td>%" PRId32"</td>" // acks in
 					     "<td>%" PRId32"</td>" // acks out
 					     "<td>%" PRId32"</td>" // reroutes
+					     "<td>%" PRId32"</td>" // hedges
 					     "<td>%" PRId32"</td>" // dropped
 					     "<td>%" PRId32"</td>" // cancel read
 					     "<td>%" PRId32"</td>" // errors
@@ -1107,6 +1238,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     g_stats.m_acksIn [i1][i3],
 					     g_stats.m_acksOut[i1][i3],
 					     g_stats.m_reroutes[i1][i3],
+					     g_stats.m_hedges[i1][i3],
 					     g_stats.m_dropped[i1][i3],
 					     g_stats.m_cancelRead[i1][i3],
 					     g_stats.m_errors[i1][i3],
@@ -1123,6 +1255,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     "\t\t<acksIn>%" PRId32"</acksIn>\n"
 					     "\t\t<acksOut>%" PRId32"</acksOut>\n"
 					     "\t\t<reroutes>%" PRId32"</reroutes>\n"
+					     "\t\t<hedges>%" PRId32"</hedges>\n"
 					     "\t\t<dropped>%" PRId32"</dropped>\n"
 					     "\t\t<cancelsRead>%" PRId32"</cancelsRead>\n"
 					     "\t\t<errors>%" PRId32"</errors>\n"
@@ -1136,6 +1269,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     g_stats.m_acksIn [i1][i3],
 					     g_stats.m_acksOut[i1][i3],
 					     g_stats.m_reroutes[i1][i3],
+					     g_stats.m_hedges[i1][i3],
 					     g_stats.m_dropped[i1][i3],
 					     g_stats.m_cancelRead[i1][i3],
 					     g_stats.m_errors[i1][i3],
@@ -1152,6 +1286,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     "\t\t\"acksIn\":%" PRId32",\n"
 					     "\t\t\"acksOut\":%" PRId32",\n"
 					     "\t\t\"reroutes\":%" PRId32",\n"
+					     "\t\t\"hedges\":%" PRId32",\n"
 					     "\t\t\"dropped\":%" PRId32",\n"
 					     "\t\t\"cancelsRead\":%" PRId32",\n"
 					     "\t\t\"errors\":%" PRId32",\n"
@@ -1165,6 +1300,7 @@ bool sendPageStats ( TcpSocket *s , HttpRequest *r ) {
 					     g_stats.m_acksIn [i1][i3],
 					     g_stats.m_acksOut[i1][i3],
 					     g_stats.m_reroutes[i1][i3],
+					     g_stats.m_hedges[i1][i3],
 					     g_stats.m_dropped[i1][i3],
 					     g_stats.m_cancelRead[i1][i3],
 					     g_stats.m_errors[i1][i3],
@@ -14,6 +14,7 @@
 #include "ip.h"
 #include "Conf.h"
 #include "GbUtil.h"
+#include "HttpCompression.h"
 #include "default_css.inc"
 
 
@@ -189,6 +190,11 @@ static WebPage s_pages[] = {
 	  sendPageThreads,
 	  PG_STATUS|PG_NOAPI|PG_MASTERADMIN|PG_ACTIVE},
 
+	{ PAGE_QUERYTRACES, "admin/querytraces", 0 , "Query traces" ,  0 , page_method_t::page_method_get,
+	  "latency breakdown of recent queries",
+	  sendPageQueryTraces,
+	  PG_STATUS|PG_NOAPI|PG_MASTERADMIN|PG_ACTIVE},
+
 	{ PAGE_API , "admin/api"         , 0 , "api" , 0 , page_method_t::page_method_get,
 	  "api",  
 	  sendPageAPI,
@@ -234,6 +240,11 @@ static WebPage s_pages[] = {
 	  sendPageHealthCheck,
 	  PG_NOAPI|PG_ACTIVE},
 
+	{ PAGE_METRICS   , "metrics"      , 0 , "metrics"     ,  0 , page_method_t::page_method_get,
+	  "latency metrics in the prometheus text format",
+	  sendPageMetrics,
+	  PG_NOAPI|PG_ACTIVE},
+
 };
 static const int32_t s_numPages = sizeof(s_pages) / sizeof(WebPage);
 
@@ -320,6 +331,7 @@ bool Pages::sendDynamicReply ( TcpSocket *s , HttpRequest *r , int32_t page ) {
 	if ( page == PAGE_ADDURL ) publicPage = true;
 	if ( page == PAGE_GET ) publicPage = true;
 	if ( page == PAGE_HEALTHCHECK ) publicPage = true;
+	if ( page == PAGE_METRICS ) publicPage = true;
 
 	// now use this...
 	bool isMasterAdmin = g_conf.isMasterAdmin ( s , r );
@@ -1115,6 +1127,7 @@ bool  Pages::printAdminLinks ( SafeBuf *sb,
 		if ( i == PAGE_SEARCHBOX ) continue;
 		if ( i == PAGE_TITLEDB ) continue;
 		if ( i == PAGE_HEALTHCHECK ) continue;
+		if ( i == PAGE_METRICS ) continue;
 		
 
 
@@ -1406,6 +1419,12 @@ bool sendPageAPI ( TcpSocket *s , HttpRequest *r ) {
 }
 
 
+// the embedded default.css never changes so it is compressed once at startup
+void precompressDefaultCss() {
+	HttpCompression::addStatic("/default.css", 0,
+				   embedded_default_css, sizeof(embedded_default_css)-1);
+}
+
 bool sendPageDefaultCss(TcpSocket *s, HttpRequest *r) {
 	HttpMime mime;
 	mime.makeMime(sizeof(embedded_default_css)-1, //content length
@@ -1418,6 +1437,23 @@ bool sendPageDefaultCss(TcpSocket *s, HttpRequest *r) {
 	              NULL, //charset
 	              200, //httpStatus
 	              NULL);
+
+	http_encoding_t encoding = HTTP_ENCODING_IDENTITY;
+	if ( g_conf.m_httpCompression )
+		encoding = HttpCompression::getAcceptedEncoding(s->m_readBuf, s->m_readOffset);
+	const std::string *compressed = HttpCompression::getStatic("/default.css", 0,
+								  sizeof(embedded_default_css)-1,
+								  encoding);
+	SafeBuf compressedMime;
+	if ( compressed &&
+	     HttpCompression::addEncodingToMime(mime.getMime(), mime.getMimeLen(),
+						compressed->size(), encoding, &compressedMime) )
+		return g_httpServer.sendReply2(compressedMime.getBufStart(), compressedMime.length(),
+					       compressed->data(), compressed->size(),
+					       s,
+					       false,
+					       r);
+
 	return g_httpServer.sendReply2(mime.getMime(), mime.getMimeLen(),
 				       embedded_default_css, sizeof(embedded_default_css)-1,
 				       s,
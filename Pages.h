@@ -65,11 +65,14 @@ bool sendPageAddUrl2  ( TcpSocket *s , HttpRequest *r );
 bool sendPageGeneric  ( TcpSocket *s , HttpRequest *r ); // in Parms.cpp
 bool sendPageProfiler   ( TcpSocket *s , HttpRequest *r );
 bool sendPageThreads    ( TcpSocket *s , HttpRequest *r );
+bool sendPageQueryTraces( TcpSocket *s , HttpRequest *r );
 bool sendPageAPI        ( TcpSocket *s , HttpRequest *r );
 bool sendPageHelp       ( TcpSocket *s , HttpRequest *r );
 bool sendPageGraph      ( TcpSocket *s , HttpRequest *r );
 bool sendPageHealthCheck ( TcpSocket *sock , HttpRequest *hr ) ;
+bool sendPageMetrics     ( TcpSocket *sock , HttpRequest *hr ) ;
 bool sendPageDefaultCss(TcpSocket *s, HttpRequest *r);
+void precompressDefaultCss();
 
 
 enum class page_method_t {
@@ -210,6 +213,7 @@ enum {
 
 	PAGE_PROFILER    ,
 	PAGE_THREADS     ,
+	PAGE_QUERYTRACES ,
 
 	PAGE_API ,
 
@@ -221,6 +225,7 @@ enum {
 	PAGE_PARSER      ,
 	PAGE_SITEDB      ,
 	PAGE_HEALTHCHECK ,
+	PAGE_METRICS     ,
 	PAGE_NONE     	};
 	
 
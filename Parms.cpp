@@ -4858,7 +4858,7 @@ void Parms::init ( ) {
 		"pages the spider is allowed to download "
 		"simultaneously for ALL collections PER HOST? Caution: "
 		"raising this too high could result in some Out of Memory "
-		"(OOM) errors. The hard limit is currently 300. Each "
+		"(OOM) errors. Each "
 		"collection has its own limit in the <i>spider controls</i> "
 		"that you may have to increase as well.";
 	m->m_cgi   = "mtsp";
@@ -4868,6 +4868,19 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "max parsing spiders";
+	m->m_desc  = "What is the maximum number of downloaded web pages "
+		"that are parsed and indexed simultaneously PER HOST? The "
+		"other downloaded pages wait for their turn. This bounds "
+		"the memory and cpu used when <i>max total spiders</i> "
+		"is high.";
+	m->m_cgi   = "mpsp";
+	simple_m_set(Conf,m_maxParsingSpiders);
+	m->m_def   = "100";
+	m->m_group = false;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "spider dead host check interval";
 	m->m_desc  = "Number of seconds before rechecking Hostdb for dead host. This will impact how fast we stop spidering"
 	             "after dead host is detected.";
@@ -4901,6 +4914,29 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "parsed robots.txt cache size";
+	m->m_desc  = "How many parsed robots.txt to keep so they are not parsed again for every url of a site. "
+	             "Set to 0 to disable";
+	m->m_cgi   = "robotscachesize";
+	simple_m_set(Conf,m_robotsCacheSize);
+	m->m_def   = "10000";
+	m->m_units = "";
+	m->m_group = true;
+	m->m_flags = PF_REBUILDSPIDERSETTINGS;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "parsed robots.txt cache max age";
+	m->m_desc  = "How long to keep a parsed robots.txt";
+	m->m_cgi   = "robotscachemaxage";
+	simple_m_set(Conf,m_robotsCacheMaxAge);
+	m->m_def   = "3600";
+	m->m_units = "seconds";
+	m->m_group = false;
+	m->m_flags = PF_REBUILDSPIDERSETTINGS;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "spider IP based url";
 	m->m_desc  = "Should we spider IP based url (eg: http://127.0.0.1/)";
 	m->m_cgi   = "spipurl";
@@ -4964,6 +5000,17 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "udp batch io";
+	m->m_desc  = "If enabled UDP datagrams are received with recvmmsg() and the datagrams of a "
+		"message are sent with sendmmsg() or UDP segmentation offload, several per system call.";
+	m->m_cgi   = "udp_batch_io";
+	simple_m_set(Conf,m_udpBatchIo);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "max http sockets";
 	m->m_desc  = "Maximum sockets available to serve incoming HTTP "
 		"requests. Too many outstanding requests will increase "
@@ -4987,6 +5034,40 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "http compression";
+	m->m_desc  = "If enabled, pages, JSON/XML replies and static files are sent gzip or "
+		"brotli compressed to clients that accept it (Accept-Encoding). Static files "
+		"in the html directory and embedded files are compressed once and kept in memory.";
+	m->m_cgi   = "httpcompression";
+	simple_m_set(Conf,m_httpCompression);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "http compression level";
+	m->m_desc  = "Compression level for dynamic replies, 1 (fastest) to 9 (smallest). "
+		"Static files are always compressed at the highest level.";
+	m->m_cgi   = "httpcompressionlevel";
+	simple_m_set(Conf,m_httpCompressionLevel);
+	m->m_def   = "6";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "http compression min size";
+	m->m_desc  = "Replies smaller than this many bytes are sent uncompressed.";
+	m->m_cgi   = "httpcompressionminsize";
+	simple_m_set(Conf,m_httpCompressionMinSize);
+	m->m_def   = "1024";
+	m->m_units = "bytes";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "spider user agent";
 	m->m_desc  = "Identification seen by web servers when "
 		"the Gigablast spider downloads their web pages. "
@@ -5168,6 +5249,44 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "multicast adaptive replica selection";
+	m->m_desc  = "If enabled requests to a shard go to the twin that has "
+		"answered fastest recently, taking the number of jobs queued "
+		"on the twin into account. Otherwise the twin is chosen by the "
+		"key of the request or round robin.";
+	m->m_cgi   = "mcadaptive";
+	simple_m_set(Conf,m_multicastAdaptiveSelection);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "multicast hedged requests";
+	m->m_desc  = "If enabled a niceness 0 read request (msg 0x00, 0x20, "
+		"0x22 and 0x39) that has not been answered within the 95th "
+		"percentile of its reply times is sent to another twin as well. "
+		"The first reply is used and the other request is cancelled.";
+	m->m_cgi   = "mchedge";
+	simple_m_set(Conf,m_multicastHedging);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "multicast hedge min delay";
+	m->m_desc  = "Never send a hedged request before this many "
+		"milliseconds have passed.";
+	m->m_cgi   = "mchedgemindelay";
+	simple_m_set(Conf,m_multicastHedgeMinDelay);
+	m->m_def   = "5";
+	m->m_units = "milliseconds";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "is live cluster";
 	m->m_desc  = "Is this cluster part of a live production cluster? "
 		"If this is true we make sure that elvtune is being "
@@ -5192,6 +5311,31 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "compress titlerecs with dictionary";
+	m->m_desc  = "If this is true, new titlerecs of a collection are "
+		"compressed with the titlerec.dict preset dictionary in its "
+		"directory, if there is one. Use train_titlerec_dict to create it. "
+		"The titlerec-*.dict files must be copied to all hosts before "
+		"enabling this, or titlerecs cannot be read on the hosts missing "
+		"them.";
+	m->m_cgi   = "titlerecdict";
+	simple_m_set(Conf,m_titleRecDictCompression);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "compress titlerecs with zstd";
+	m->m_desc  = "If this is true, new titlerecs are compressed with zstd "
+		"instead of zlib, using the titlerec.dict dictionary if "
+		"\"compress titlerecs with dictionary\" is on. zstd compresses and "
+		"decompresses faster than zlib. All hosts must run a version that "
+		"reads zstd titlerecs before enabling this.";
+	m->m_cgi   = "titlereczstd";
+	simple_m_set(Conf,m_titleRecZstdCompression);
+	m->m_def   = "0";
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "document summary (w/desc) cache max age";
 	m->m_desc = "How many milliseconds should we cache document summaries";
 	m->m_cgi  = "dswdmca";
@@ -5710,6 +5854,29 @@ void Parms::init ( ) {
 	m->m_page  = PAGE_MASTER;
 	m++;
 
+	m->m_title = "dns negative cache max age";
+	m->m_desc  = "How long to cache failed dns lookups (nxdomain, timeout, servfail). "
+	             "Set to 0 to disable";
+	m->m_cgi   = "dnsnegcachemaxage";
+	simple_m_set(Conf,m_dnsNegativeCacheMaxAge);
+	m->m_def   = "60";
+	m->m_units = "seconds";
+	m->m_group = false;
+	m->m_flags = PF_REBUILDDNSSETTINGS;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
+	m->m_title = "max dns prefetches";
+	m->m_desc  = "How many dns lookups of outlink hosts can be prefetched at the same time. "
+	             "Set to 0 to disable prefetching";
+	m->m_cgi   = "dnsmaxprefetches";
+	simple_m_set(Conf,m_dnsMaxPrefetches);
+	m->m_def   = "100";
+	m->m_units = "";
+	m->m_group = false;
+	m->m_page  = PAGE_MASTER;
+	m++;
+
 	m->m_title = "default collection";
 	m->m_desc  = "When no collection is explicitly specified, assume "
 		"this collection name.";
@@ -5819,6 +5986,30 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "job work stealing";
+	m->m_desc  = "If enabled idle CPU threads run queued summary jobs and idle summary threads run queued "
+		"CPU jobs (intersection, merge, indexing) instead of sleeping while the other pool is backlogged. "
+		"Only takes effect at startup.";
+	m->m_cgi   = "job_work_stealing";
+	simple_m_set(Conf,m_jobWorkStealing);
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "job work stealing max niceness";
+	m->m_desc  = "Only jobs with this niceness or lower are run by threads of another pool, so eg. "
+		"spider jobs do not occupy the threads reserved for queries. Only takes effect at startup.";
+	m->m_cgi   = "job_work_stealing_max_niceness";
+	simple_m_set(Conf,m_jobWorkStealingMaxNiceness);
+	m->m_def   = "0";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "max job cleanup time";
 	m->m_desc  = "Maximum number of milliseconds the main thread is allow to spend on cleanup up finished jobs. "
 		"Disable with =0. If enabled the main thraed will abort the process if it detects a job cleanup taking too long.";
@@ -5832,6 +6023,58 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "use epoll";
+	m->m_desc  = "If enabled the main loop waits for socket events with epoll instead of select(). "
+		"select() costs time proportional to the highest fd on every wakeup and cannot handle fds "
+		"above 1023. Only takes effect at startup.";
+	m->m_cgi   = "use_epoll";
+	simple_m_set(Conf,m_useEpoll);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "use io_uring";
+	m->m_desc  = "If enabled non-blocking file reads are queued on an io_uring instead of each "
+		"occupying an IO thread, so many more reads can be outstanding. Reads fall back to the IO "
+		"threads if the kernel does not support io_uring or the ring is full. Only takes effect at startup.";
+	m->m_cgi   = "use_io_uring";
+	simple_m_set(Conf,m_useIoUring);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "io_uring queue depth";
+	m->m_desc  = "Number of submission queue entries of the io_uring. The kernel rounds it up to a "
+		"power of two. Only takes effect at startup.";
+	m->m_cgi   = "io_uring_queue_depth";
+	simple_m_set(Conf,m_ioUringQueueDepth);
+	m->m_def   = "256";
+	m->m_units = "entries";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
+	m->m_title = "read prefetch min size";
+	m->m_desc  = "Disk reads of at least this many bytes are announced to the kernel "
+		"(posix_fadvise WILLNEED) as soon as they are planned. The disk then works on "
+		"the lists of all terms and files of a query at once instead of one read per "
+		"free disk thread. 0 disables it.";
+	m->m_cgi   = "read_prefetch_min_size";
+	simple_m_set(Conf,m_readPrefetchMinSize);
+	m->m_def   = "65536";
+	m->m_units = "bytes";
+	m->m_min   = 0;
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 
 	m->m_title = "flush disk writes";
 	m->m_desc  = "If enabled then all writes will be flushed to disk. "
@@ -5878,6 +6121,20 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "mmap map and index files";
+	m->m_desc  = "If enabled the map and index files of the rdbs are mmap'ed "
+		"and used in place when they are loaded instead of being read "
+		"into memory. Loading is much faster and the memory is shared "
+		"through the kernel page cache with other instances on the same "
+		"machine. Takes effect when files are loaded.";
+	m->m_cgi   = "mmapmaps";
+	simple_m_set(Conf,m_mmapMapAndIndexFiles);
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m->m_page  = PAGE_MASTER;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "verify disk writes";
 	m->m_desc  = "Read what was written in a verification step. Decreases "
 		"performance, but may help fight disk corruption mostly on "
@@ -7009,6 +7266,19 @@ void Parms::init ( ) {
 	m->m_flags = 0;
 	m++;
 
+	m->m_title = "stream results min results";
+	m->m_desc  = "JSON and XML search requests asking for at least this many results per page "
+		"are streamed back as the summaries arrive, as if &stream=1 was given, instead of "
+		"building the whole reply in memory first. HTTP/1.1 clients get a chunked reply. "
+		"Streamed replies have no moreResultsFollow field. 0 disables.";
+	m->m_cgi   = "stream_results_min_results";
+	simple_m_set(Conf,m_streamResultsMinDocs);
+	m->m_xml   = "stream_results_min_results";
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m++;
+
 
 	m->m_title = "Min DocId splits";
 	m->m_desc  = "Minimum number of Docid splits when deciding how many 'chunks' to use for limiting memory use while intersecting lists";
@@ -7055,6 +7325,97 @@ void Parms::init ( ) {
 	m->m_flags = 0;
 	m++;
 
+	m->m_title = "parallel query intersection";
+	m->m_desc  = "If enabled, Msg39 reads and intersects the termlists of each posdb file and docid range "
+		"concurrently on the cpu threads, each with its own top tree, and merges the top trees at the end. "
+		"Not used when scoring info is requested.";
+	m->m_cgi   = "parallel_query_intersection";
+	simple_m_set(Conf,m_parallelQueryIntersection);
+	m->m_xml   = "parallel_query_intersection";
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "0";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "max parallel intersection units";
+	m->m_desc  = "Maximum number of posdb file/docid range units a single query reads and intersects at the same time "
+		"when parallel query intersection is enabled. Bounds the memory used for termlists by one query.";
+	m->m_cgi   = "max_parallel_intersection_units";
+	simple_m_set(Conf,m_maxParallelIntersectionUnits);
+	m->m_xml   = "max_parallel_intersection_units";
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "8";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "use docid intersection kernel";
+	m->m_desc  = "If enabled, the candidate docids are intersected with the termlists using a galloping/SIMD kernel "
+		"(AVX2 or SSE4.2 if the cpu has it) instead of a record-by-record scan.";
+	m->m_cgi   = "docid_intersect_kernel";
+	simple_m_set(Conf,m_useDocIdIntersectKernel);
+	m->m_xml   = "docid_intersect_kernel";
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "use block-max scoring";
+	m->m_desc  = "If enabled, the candidate docids are split into blocks and an upper bound of the score of each "
+		"block is computed from the termlists. Whole blocks that cannot beat the lowest score in the top tree "
+		"are skipped without merging and scoring their docids.";
+	m->m_cgi   = "block_max_scoring";
+	simple_m_set(Conf,m_useBlockMaxScoring);
+	m->m_xml   = "block_max_scoring";
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "use query result cache";
+	m->m_desc  = "If enabled, the merged docids, scores and cluster levels of a query are cached on the host "
+		"that merged them, so repeated queries with the same collection, language and ranking parameters "
+		"do not have to be sent to the shards again. The cache is invalidated when posdb is dumped.";
+	m->m_cgi   = "qrcache";
+	simple_m_set(Conf,m_useQueryResultCache);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "1";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "query result cache max age";
+	m->m_desc  = "How long the merged results of a query stay in the query result cache. "
+		"Cached results are dropped once a shard dumps or merges posdb, so documents that are "
+		"indexed but not dumped yet can be missing from them for up to this long.";
+	m->m_cgi   = "qrcachemaxage";
+	simple_m_set(Conf,m_queryResultCacheMaxAge);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "60";
+	m->m_units = "seconds";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "query result cache max mem";
+	m->m_desc  = "How many bytes should be used for caching query results? Takes effect on restart.";
+	m->m_cgi   = "qrcachemaxmem";
+	simple_m_set(Conf,m_queryResultCacheMaxMem);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "20000000";
+	m->m_units = "bytes";
+	m->m_flags = 0;
+	m++;
+
+	m->m_title = "query trace sample rate";
+	m->m_desc  = "Record the time spent in each stage of every Nth query on every host involved, "
+		"for inspection on the query traces page. Queries with debug enabled are always traced. "
+		"0 means only debug queries are traced.";
+	m->m_cgi   = "qtracerate";
+	simple_m_set(Conf,m_queryTraceSampleRate);
+	m->m_page  = PAGE_SEARCH;
+	m->m_def   = "100";
+	m->m_flags = 0;
+	m++;
+
 	m->m_title = "use high frequency term cache";
 	m->m_desc  = "If enabled, return generated DocIds from cache "
 		"when detecting a high frequency term.";
@@ -7460,6 +7821,22 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "merge parallel ranges";
+	m->m_desc  = "A merge splits the key space of the files into ranges of "
+		"about the merge buffer size. This many ranges are read and "
+		"merged at the same time on the merge threads and written to "
+		"the merged file in key order. Each range needs its own merge "
+		"buffer.";
+	m->m_cgi   = "mpr";
+	simple_m_set(Conf,m_mergeParallelRanges);
+	m->m_def   = "4";
+	m->m_units = "ranges";
+	m->m_min   = 1;
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "Doledb nuke interval";
 	m->m_desc  = "Sometimes spiderrecords get stuck due to plain bugs or due to priority inversion."
 		"Nuking doledb periodically masks this. 0=disabled";
@@ -7472,6 +7849,19 @@ void Parms::init ( ) {
 	m->m_group = false;
 	m++;
 
+	m->m_title = "Waiting tree rebuild interval";
+	m->m_desc  = "How often to scan all of spiderdb for IPs missing from the waiting tree. "
+		"The waiting tree is kept up to date as spider requests and replies are added, "
+		"so this is only a safety net. 0=disabled";
+	m->m_cgi   = "waitingtreerebuildinterval";
+	simple_m_set(Conf,m_waitingTreeRebuildInterval);
+	m->m_def   = "86400";
+	m->m_units = "seconds";
+	m->m_flags = 0;
+	m->m_page  = PAGE_RDB;
+	m->m_group = false;
+	m++;
+
 	m->m_title = "Nuke doledb now";
 	m->m_desc  = "Clears doledb+waitingtree and refills them from spiderdb";
 	m->m_cgi   = "nukedoledbnow";
@@ -10427,8 +10817,11 @@ void Parms::handleRequest3fLoop(void *weArg) {
 		// . this tells Spider.cpp to rebuild the spider queues
 		// . this is NULL if spider stuff never initialized yet,
 		//   like if you just added the collection
-		if ( cx->m_spiderColl )
+		if ( cx->m_spiderColl ) {
 			cx->m_spiderColl->m_waitingTreeNeedsRebuild = true;
+			// the ips have to be re-evaluated with the new rules
+			cx->m_spiderColl->clearIpScanTable();
+		}
 
 		// . reconstruct the url filters if we were a custom crawl
 		// . this is used to abstract away the complexity of url
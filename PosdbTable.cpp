@@ -18,6 +18,7 @@
 #include "Lang.h"
 #include "GbMutex.h"
 #include "ScopedLock.h"
+#include "DocIdIntersect.h"
 #include <math.h>
 #include <valarray>
 
@@ -173,6 +174,12 @@ void PosdbTable::reset() {
 	m_vecSize = 0;
 	m_allInSameWikiPhrase = 0;
 	m_realMaxTop = 0;
+	m_numScoreBlocks = 0;
+	m_scoreBlockMaxScores.clear();
+	m_scoreBlockCursors.clear();
+	m_scoreBlockCursorBase.clear();
+	m_numScoreBlockCursors = 0;
+	m_maxCompleteScoreMultiplier = 1.0;
 }
 
 
@@ -3784,6 +3791,16 @@ void PosdbTable::intersectLists_real() {
 		numQueryTermsToHandle = 0;
 	}
 
+	// upper score bounds for blocks of docids so we can skip whole
+	// blocks once the top tree is full
+	bool useScoreBlocks = false;
+	if ( g_conf.m_useBlockMaxScoring && numQueryTermsToHandle > 0 && !m_q->m_isBoolean ) {
+		buildScoreBlocks(qtibuf, numQueryTermsToHandle);
+		useScoreBlocks = ( m_numScoreBlocks > 0 );
+	}
+	int32_t scoreBlocksSkipped = 0;
+	int32_t scoreBlockDocIdsSkipped = 0;
+
 
  	//
  	// Run through the scoring logic once or twice. Two passes needed ONLY if we 
@@ -3849,6 +3866,25 @@ void PosdbTable::intersectLists_real() {
 			highestInlinkSiteRank 	= -1;
 			bool docInThisFile;
 
+			// at the start of a block see if any docid in it can
+			// make it into the top tree at all
+			if ( useScoreBlocks && currPassNum == INTERSECT_SCORING && minWinningScore >= 0.0 ) {
+				int32_t docIdNum = (docIdPtr - m_docIdVoteBuf.getBufStart()) / 6;
+				if ( docIdNum % SCORE_BLOCK_SIZE == 0 &&
+				     canSkipScoreBlock(docIdNum / SCORE_BLOCK_SIZE, qtibuf, numQueryTermsToHandle, minWinningScore) ) {
+					skipScoreBlock(docIdNum / SCORE_BLOCK_SIZE, qtibuf);
+					const char *blockEnd = docIdPtr + SCORE_BLOCK_SIZE*6;
+					if ( blockEnd > docIdEnd ) {
+						blockEnd = docIdEnd;
+					}
+					scoreBlocksSkipped++;
+					scoreBlockDocIdsSkipped += (blockEnd - docIdPtr) / 6;
+					docIdPtr = blockEnd;
+					// continue docIdPtr < docIdEnd loop
+					continue;
+				}
+			}
+
 			if ( currPassNum == INTERSECT_SCORING ) {
 				m_docId = *(uint32_t *)(docIdPtr+1);
 				m_docId <<= 8;
@@ -4340,6 +4376,8 @@ void PosdbTable::intersectLists_real() {
 		log(LOG_INFO, "posdb: # prefiltMaxPossScorePass........: %" PRId32" ", prefiltMaxPossScorePass );
 		log(LOG_INFO, "posdb: # prefiltBestDistMaxPossScoreFail: %" PRId32" ", prefiltBestDistMaxPossScoreFail );
 		log(LOG_INFO, "posdb: # prefiltBestDistMaxPossScorePass: %" PRId32" ", prefiltBestDistMaxPossScorePass );
+		log(LOG_INFO, "posdb: # scoreBlocksSkipped.............: %" PRId32" ", scoreBlocksSkipped );
+		log(LOG_INFO, "posdb: # scoreBlockDocIdsSkipped........: %" PRId32" ", scoreBlockDocIdsSkipped );
 	}
 
 	if( g_conf.m_logTracePosdb ) {
@@ -4536,6 +4574,239 @@ float PosdbTable::getMaxPossibleScore(const QueryTermInfo *qti) {
 }
 
 
+//
+// Block-max upper bounds. The candidate docids in m_docIdVoteBuf are split
+// into blocks of SCORE_BLOCK_SIZE docids. For each block and query term we
+// compute a bound that is >= getMaxPossibleScore() of every docid in the
+// block by taking the best hash group, density rank, term freq weight,
+// siterank and language boost of any key of the term in that block. The
+// matching sublists are scanned once for this, so it is much cheaper than
+// merging and scoring each docid. We also remember where each sublist cursor
+// is at the start of a block so intersectLists_real() can jump over blocks
+// that cannot beat the lowest score in the top tree.
+//
+void PosdbTable::buildScoreBlocks(const QueryTermInfo *qtibuf, int32_t numQueryTermsToHandle) {
+	const char *voteBufStart = m_docIdVoteBuf.getBufStart();
+	int32_t numDocIds = m_docIdVoteBuf.length() / 6;
+
+	m_numScoreBlocks = (numDocIds + SCORE_BLOCK_SIZE - 1) / SCORE_BLOCK_SIZE;
+
+	// one block is nothing to skip
+	if ( m_numScoreBlocks < 2 ) {
+		m_numScoreBlocks = 0;
+		return;
+	}
+
+	// docid key of the first docid of each block
+	std::vector<uint64_t> blockFirstKey(m_numScoreBlocks);
+	for ( int32_t b = 0 ; b < m_numScoreBlocks ; b++ ) {
+		blockFirstKey[b] = DocIdIntersect::getVoteRecKey(voteBufStart + (int64_t)b*SCORE_BLOCK_SIZE*6);
+	}
+
+	m_scoreBlockCursorBase.resize(m_numQueryTermInfos);
+	m_numScoreBlockCursors = 0;
+	for ( int32_t i = 0 ; i < m_numQueryTermInfos ; i++ ) {
+		m_scoreBlockCursorBase[i] = m_numScoreBlockCursors;
+		m_numScoreBlockCursors += qtibuf[i].m_numMatchingSubLists;
+	}
+	m_scoreBlockCursors.assign((size_t)m_numScoreBlocks * m_numScoreBlockCursors, NULL);
+	m_scoreBlockMaxScores.assign((size_t)m_numScoreBlocks * m_numQueryTermInfos, -1.0);
+
+	// flags can only boost a docid this much
+	m_maxCompleteScoreMultiplier = 1.0;
+	for ( int i = 0 ; i < 26 ; i++ ) {
+		if ( m_msg39req->m_flagScoreMultiplier[i] > 1.0 ) {
+			m_maxCompleteScoreMultiplier *= m_msg39req->m_flagScoreMultiplier[i];
+		}
+	}
+
+	const float *hashGroupWeights = m_msg39req->m_scoringWeights.m_hashGroupWeights;
+	const float *densityWeights   = m_msg39req->m_scoringWeights.m_densityWeights;
+
+	struct BlockStats {
+		float m_bestHashGroupWeight;
+		float m_bestDensityWeight;
+		float m_bestTermFreqWeight;
+		float m_bestSiteRankFactor;
+		float m_bestLangFactor;
+		bool  m_hasInlinkText;
+	};
+	std::vector<BlockStats> stats(m_numScoreBlocks);
+
+	for ( int32_t i = 0 ; i < m_numQueryTermInfos ; i++ ) {
+		const QueryTermInfo *qti = &qtibuf[i];
+		// negative termlist cursors are never advanced. -1 means no bound
+		if ( qti->m_subList[0].m_bigramFlag & BF_NEGATIVE ) {
+			continue;
+		}
+
+		for ( int32_t b = 0 ; b < m_numScoreBlocks ; b++ ) {
+			stats[b].m_bestHashGroupWeight = -1.0;
+			stats[b].m_bestDensityWeight   = 0.0;
+			stats[b].m_bestTermFreqWeight  = 0.0;
+			stats[b].m_bestSiteRankFactor  = 0.0;
+			stats[b].m_bestLangFactor      = 0.0;
+			stats[b].m_hasInlinkText       = false;
+		}
+
+		for ( int32_t j = 0 ; j < qti->m_numMatchingSubLists ; j++ ) {
+			const char *p   = qti->m_matchingSublist[j].m_start;
+			const char *end = qti->m_matchingSublist[j].m_end;
+			const float termFreqWeight = qti->m_subList[qti->m_matchingSublist[j].m_baseSubListIndex].m_qt->m_termFreqWeight;
+			const char **cursors = &m_scoreBlockCursors[m_scoreBlockCursorBase[i] + j];
+
+			// blocks past the last docid of the sublist start at its end
+			for ( int32_t b = 0 ; b < m_numScoreBlocks ; b++ ) {
+				cursors[(size_t)b*m_numScoreBlockCursors] = end;
+			}
+			cursors[0] = p;
+
+			int32_t b = 0;
+			while ( p < end ) {
+				// p is a 12 byte key starting a new docid
+				uint64_t key = DocIdIntersect::getPosdbRecKey(p);
+				while ( b+1 < m_numScoreBlocks && key >= blockFirstKey[b+1] ) {
+					b++;
+					cursors[(size_t)b*m_numScoreBlockCursors] = p;
+				}
+
+				BlockStats *bs = &stats[b];
+
+				if ( termFreqWeight > bs->m_bestTermFreqWeight ) {
+					bs->m_bestTermFreqWeight = termFreqWeight;
+				}
+
+				float siteRankFactor = ((float)Posdb::getSiteRank(p))*m_siteRankMultiplier+1.0;
+				if ( siteRankFactor > bs->m_bestSiteRankFactor ) {
+					bs->m_bestSiteRankFactor = siteRankFactor;
+				}
+
+				float langFactor = 1.0;
+				if ( m_msg39req->m_language != 0 ) {
+					char docLang = Posdb::getLangId(p);
+					if ( m_msg39req->m_language == docLang ) {
+						langFactor = m_msg39req->m_sameLangWeight;
+					}
+					else
+					if ( docLang == 0 ) {
+						langFactor = m_msg39req->m_unknownLangWeight;
+					}
+				}
+				if ( langFactor > bs->m_bestLangFactor ) {
+					bs->m_bestLangFactor = langFactor;
+				}
+
+				// the 12 byte key and the 6 byte keys following it
+				const char *keyEnd = p + 12;
+				while ( keyEnd < end && (*keyEnd & 0x04) ) {
+					keyEnd += 6;
+				}
+				for ( const char *k = p ; k < keyEnd ; k += (k == p ? 12 : 6) ) {
+					unsigned char hgrp = Posdb::getHashGroup(k);
+					if ( hgrp == HASHGROUP_INLINKTEXT ) {
+						bs->m_hasInlinkText = true;
+					}
+					if ( hashGroupWeights[hgrp] > bs->m_bestHashGroupWeight ) {
+						bs->m_bestHashGroupWeight = hashGroupWeights[hgrp];
+					}
+					float densityWeight = densityWeights[Posdb::getDensityRank(k)];
+					if ( densityWeight > bs->m_bestDensityWeight ) {
+						bs->m_bestDensityWeight = densityWeight;
+					}
+				}
+				p = keyEnd;
+			}
+		}
+
+		// terms we don't apply the max score algo on keep -1 too
+		if ( i >= numQueryTermsToHandle ) {
+			continue;
+		}
+
+		// same formula as getMaxPossibleScore() with the block maximums
+		for ( int32_t b = 0 ; b < m_numScoreBlocks ; b++ ) {
+			const BlockStats *bs = &stats[b];
+			float score;
+			if ( bs->m_hasInlinkText ) {
+				// inlink text is summed up, so no bound
+				score = -1.0;
+			}
+			else if ( bs->m_bestHashGroupWeight < 0 ) {
+				// term has no docids in this block
+				score = 0.0;
+			}
+			else {
+				score = 100.0;
+				score *= bs->m_bestHashGroupWeight;
+				score *= bs->m_bestHashGroupWeight;
+				score *= bs->m_bestDensityWeight;
+				score *= bs->m_bestDensityWeight;
+				if ( qti->m_subList[0].m_bigramFlag & BF_HALFSTOPWIKIBIGRAM ) {
+					score *= WIKI_BIGRAM_WEIGHT;
+					score *= WIKI_BIGRAM_WEIGHT;
+				}
+				score *= bs->m_bestSiteRankFactor;
+				score *= bs->m_bestLangFactor;
+				score *= bs->m_bestTermFreqWeight;
+				score *= bs->m_bestTermFreqWeight;
+				if ( m_allInSameWikiPhrase ) {
+					score *= WIKI_WEIGHT;
+				}
+				score *= m_maxCompleteScoreMultiplier;
+			}
+			m_scoreBlockMaxScores[(size_t)b*m_numQueryTermInfos + i] = score;
+		}
+	}
+
+	logTrace(g_conf.m_logTracePosdb, "Built %" PRId32 " score blocks for %" PRId32 " docids", m_numScoreBlocks, numDocIds);
+}
+
+
+// true if no docid in the block can score above minWinningScore
+bool PosdbTable::canSkipScoreBlock(int32_t block, const QueryTermInfo *qtibuf, int32_t numQueryTermsToHandle, float minWinningScore) const {
+	if ( block >= m_numScoreBlocks ) {
+		return false;
+	}
+
+	const float *maxScores = &m_scoreBlockMaxScores[(size_t)block*m_numQueryTermInfos];
+	for ( int32_t i = 0 ; i < numQueryTermsToHandle ; i++ ) {
+		// -1 means no bound for this term
+		if ( maxScores[i] < 0.0 ) {
+			continue;
+		}
+		// like the per-docid prefilter, one term is enough
+		if ( maxScores[i] <= minWinningScore ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// position the sublist cursors at the first docid after "block"
+void PosdbTable::skipScoreBlock(int32_t block, QueryTermInfo *qtibuf) {
+	int32_t nextBlock = block + 1;
+
+	for ( int32_t i = 0 ; i < m_numQueryTermInfos ; i++ ) {
+		QueryTermInfo *qti = &qtibuf[i];
+		// do not advance negative termlist cursor
+		if ( qti->m_subList[0].m_bigramFlag & BF_NEGATIVE ) {
+			continue;
+		}
+
+		for ( int32_t j = 0 ; j < qti->m_numMatchingSubLists ; j++ ) {
+			if ( nextBlock >= m_numScoreBlocks ) {
+				qti->m_matchingSublist[j].m_cursor = qti->m_matchingSublist[j].m_end;
+			}
+			else {
+				qti->m_matchingSublist[j].m_cursor = m_scoreBlockCursors[(size_t)nextBlock*m_numScoreBlockCursors + m_scoreBlockCursorBase[i] + j];
+			}
+			qti->m_matchingSublist[j].m_savedCursor = NULL;
+		}
+	}
+}
+
+
 float PosdbTable::modifyMaxScoreByDistance(float score,
 					   int32_t bestDist,
 					   int32_t qdist,
@@ -4828,6 +5099,20 @@ void PosdbTable::delNonMatchingDocIdsFromSubLists() {
 
 	//phase 1: shrink the rdblists for all queryterms (except those with a minus sign)
 	std::valarray<char *> newEndPtr(m_q->m_numTerms);
+
+	// docids of the vote buffer for the intersection kernel
+	const bool useKernel = g_conf.m_useDocIdIntersectKernel;
+	std::vector<uint64_t> voteKeys;
+	std::vector<uint64_t> subListKeys;
+	std::vector<uint32_t> subListOffsets;
+	std::vector<uint32_t> matchVote;
+	std::vector<uint32_t> matchSubList;
+	if ( useKernel ) {
+		DocIdIntersect::decodeVoteBuf ( m_docIdVoteBuf.getBufStart(), m_docIdVoteBuf.length(), &voteKeys );
+		matchVote.resize(voteKeys.size());
+		matchSubList.resize(voteKeys.size());
+	}
+
 	for(int i=0; i<m_q->m_numTerms; i++) {
 		newEndPtr[i] = NULL;
 		if(m_q->m_qterms[i].m_termSign=='-')
@@ -4844,6 +5129,24 @@ void PosdbTable::delNonMatchingDocIdsFromSubLists() {
 		const char *dp    =      m_docIdVoteBuf.getBufStart();
 		const char *dpEnd = dp + m_docIdVoteBuf.length();
 		//log(LOG_INFO,"@@@@ i#%d subListPtr=%p subListEnd=%p", i, subListPtr, subListEnd);
+
+		if ( useKernel ) {
+			// find the matching docid heads and move each of them
+			// plus its following 6-byte keys down to dst
+			DocIdIntersect::decodeSubList ( subListPtr, subListEnd, &subListKeys, &subListOffsets );
+			size_t n = DocIdIntersect::intersect ( voteKeys.data(), voteKeys.size(),
+							       subListKeys.data(), subListKeys.size(),
+							       matchVote.data(), matchSubList.data() );
+			for ( size_t k = 0 ; k < n ; k++ ) {
+				uint32_t head = matchSubList[k];
+				const char *src = subListPtr + subListOffsets[head];
+				const char *srcEnd = head+1 < subListOffsets.size() ? subListPtr + subListOffsets[head+1] : subListEnd;
+				memmove ( dst, src, srcEnd - src );
+				dst += srcEnd - src;
+			}
+			newEndPtr[i] = dst;
+			continue;
+		}
 		
 		for(;;) {
 			// scan the docid list for the current docid in this termlist
@@ -4971,6 +5274,41 @@ void PosdbTable::delNonMatchingDocIdsFromSubLists() {
 
 
 
+//
+// Set the vote byte of the m_docIdVoteBuf entries whose docid is in any of
+// the sublists of "qti" to "vote". The vote buffer and the sublist heads are
+// decoded into plain docid arrays and matched with the intersection kernel
+// (galloping/SIMD) instead of stepping through both one entry at a time.
+//
+void PosdbTable::markDocIdVotes ( const QueryTermInfo *qti, char vote ) {
+	char *bufStart = m_docIdVoteBuf.getBufStart();
+
+	std::vector<uint64_t> voteKeys;
+	DocIdIntersect::decodeVoteBuf ( bufStart, m_docIdVoteBuf.length(), &voteKeys );
+	if ( voteKeys.empty() ) {
+		return;
+	}
+
+	std::vector<uint64_t> subListKeys;
+	std::vector<uint32_t> subListOffsets;
+	std::vector<uint32_t> matchVote(voteKeys.size());
+	std::vector<uint32_t> matchSubList(voteKeys.size());
+
+	for ( int32_t i = 0 ; i < qti->m_numSubLists ; i++ ) {
+		RdbList *list = qti->m_subList[i].m_list;
+		DocIdIntersect::decodeSubList ( list->getList(), list->getListEnd(), &subListKeys, &subListOffsets );
+
+		size_t n = DocIdIntersect::intersect ( voteKeys.data(), voteKeys.size(),
+						       subListKeys.data(), subListKeys.size(),
+						       matchVote.data(), matchSubList.data() );
+		for ( size_t k = 0 ; k < n ; k++ ) {
+			bufStart[matchVote[k]*6+5] = vote;
+		}
+	}
+}
+
+
+
 //
 // Removes docids with vote -1, which is set for docids matching
 // negative query terms (e.g. -rock)
@@ -4982,67 +5320,72 @@ void PosdbTable::delDocIdVotes ( const QueryTermInfo *qti ) {
 
 	logTrace(g_conf.m_logTracePosdb, "BEGIN.");
 
-	// just scan each sublist vs. the docid list
-	for ( int32_t i = 0 ; i < qti->m_numSubLists  ; i++ ) {
-		// get that sublist
-		char *subListPtr = qti->m_subList[i].m_list->getList();
-		char *subListEnd = qti->m_subList[i].m_list->getListEnd();
-		// reset docid list ptrs
-		voteBufPtr = m_docIdVoteBuf.getBufStart();
-		voteBufEnd = voteBufPtr + m_docIdVoteBuf.length();
-
-		// loop it
-		while ( subListPtr < subListEnd ) {
-			// scan for his docids and inc the vote
-			for ( ;voteBufPtr <voteBufEnd ;voteBufPtr += 6 ) {
-				// if current docid in docid list is >= the docid
-				// in the sublist, stop. docid in list is 6 bytes and
-				// subListPtr must be pointing to a 12 byte posdb rec.
-				if ( *(uint32_t *)(voteBufPtr+1) > *(uint32_t *)(subListPtr+8) ) {
-					break;
-				}
+	if ( g_conf.m_useDocIdIntersectKernel ) {
+		markDocIdVotes ( qti, -1 );
+	}
+	else {
+		// just scan each sublist vs. the docid list
+		for ( int32_t i = 0 ; i < qti->m_numSubLists  ; i++ ) {
+			// get that sublist
+			char *subListPtr = qti->m_subList[i].m_list->getList();
+			char *subListEnd = qti->m_subList[i].m_list->getListEnd();
+			// reset docid list ptrs
+			voteBufPtr = m_docIdVoteBuf.getBufStart();
+			voteBufEnd = voteBufPtr + m_docIdVoteBuf.length();
+
+			// loop it
+			while ( subListPtr < subListEnd ) {
+				// scan for his docids and inc the vote
+				for ( ;voteBufPtr <voteBufEnd ;voteBufPtr += 6 ) {
+					// if current docid in docid list is >= the docid
+					// in the sublist, stop. docid in list is 6 bytes and
+					// subListPtr must be pointing to a 12 byte posdb rec.
+					if ( *(uint32_t *)(voteBufPtr+1) > *(uint32_t *)(subListPtr+8) ) {
+						break;
+					}
 				
-				// less than? keep going
-				if ( *(uint32_t *)(voteBufPtr+1) < *(uint32_t *)(subListPtr+8) ) {
-					continue;
-				}
+					// less than? keep going
+					if ( *(uint32_t *)(voteBufPtr+1) < *(uint32_t *)(subListPtr+8) ) {
+						continue;
+					}
 				
-				// top 4 bytes are equal. check lower single byte then.
-				if ( *(unsigned char *)(voteBufPtr) > (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
+					// top 4 bytes are equal. check lower single byte then.
+					if ( *(unsigned char *)(voteBufPtr) > (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
+						break;
+					}
+				
+					if ( *(unsigned char *)(voteBufPtr) < (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
+						continue;
+					}
+				
+					// . equal! mark it as nuked!
+					voteBufPtr[5] = -1;
+					// skip it
+					voteBufPtr += 6;
+					// advance subListPtr now
 					break;
 				}
-				
-				if ( *(unsigned char *)(voteBufPtr) < (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
-					continue;
+
+				// if we've exhausted this docid list go to next sublist
+				if ( voteBufPtr >= voteBufEnd ) {
+					goto endloop2;
 				}
-				
-				// . equal! mark it as nuked!
-				voteBufPtr[5] = -1;
-				// skip it
-				voteBufPtr += 6;
-				// advance subListPtr now
-				break;
-			}
 
-			// if we've exhausted this docid list go to next sublist
-			if ( voteBufPtr >= voteBufEnd ) {
-				goto endloop2;
-			}
+				// skip that docid record in our termlist. it MUST have been
+				// 12 bytes, a docid heading record.
+				subListPtr += 12;
+				// skip any following keys that are 6 bytes, that means they
+				// share the same docid
+				for ( ; subListPtr < subListEnd && ((*subListPtr)&0x04); ) {
+					subListPtr += 6;
+				}
 
-			// skip that docid record in our termlist. it MUST have been
-			// 12 bytes, a docid heading record.
-			subListPtr += 12;
-			// skip any following keys that are 6 bytes, that means they
-			// share the same docid
-			for ( ; subListPtr < subListEnd && ((*subListPtr)&0x04); ) {
-				subListPtr += 6;
+				// if we have more posdb recs in this sublist, then keep
+				// adding our docid votes into the docid list
 			}
-
-			// if we have more posdb recs in this sublist, then keep
-			// adding our docid votes into the docid list
+		endloop2: ;
+			// otherwise, advance to next sublist
 		}
-	endloop2: ;
-		// otherwise, advance to next sublist
 	}
 
 	// now remove docids with a -1 vote, they are nuked
@@ -5136,84 +5479,91 @@ void PosdbTable::addDocIdVotes( const QueryTermInfo *qti, int32_t listGroupNum)
 	// 5 sublists, and their QueryTermInfo::m_qtermNum should be the
 	// same for all 5.
 	//
-	for ( int32_t i = 0 ; i < qti->m_numSubLists; i++) {
-		// get that sublist
-		const char *subListPtr = qti->m_subList[i].m_list->getList();
-		const char *subListEnd = qti->m_subList[i].m_list->getListEnd();
-		// reset docid list ptrs
-		voteBufPtr	= m_docIdVoteBuf.getBufStart();
-		voteBufEnd	= voteBufPtr + m_docIdVoteBuf.length();
+	// range terms need to check the value of each matching record so they
+	// are left to the record-by-record scan below
+	if ( ! isRangeTerm && g_conf.m_useDocIdIntersectKernel ) {
+		markDocIdVotes ( qti, listGroupNum );
+	}
+	else {
+		for ( int32_t i = 0 ; i < qti->m_numSubLists; i++) {
+			// get that sublist
+			const char *subListPtr = qti->m_subList[i].m_list->getList();
+			const char *subListEnd = qti->m_subList[i].m_list->getListEnd();
+			// reset docid list ptrs
+			voteBufPtr	= m_docIdVoteBuf.getBufStart();
+			voteBufEnd	= voteBufPtr + m_docIdVoteBuf.length();
 		
-		// loop it
-	handleNextSubListRecord:
+			// loop it
+		handleNextSubListRecord:
 		
-		// scan for his docids and inc the vote
-		for ( ;voteBufPtr < voteBufEnd ; voteBufPtr += 6 ) {
-			// if current docid in docid list is >= the docid
-			// in the sublist, stop. docid in list is 6 bytes and
-			// subListPtr must be pointing to a 12 byte posdb rec.
-			if ( *(uint32_t *)(voteBufPtr+1) > *(uint32_t *)(subListPtr+8) ) {
-				break;
-			}
+			// scan for his docids and inc the vote
+			for ( ;voteBufPtr < voteBufEnd ; voteBufPtr += 6 ) {
+				// if current docid in docid list is >= the docid
+				// in the sublist, stop. docid in list is 6 bytes and
+				// subListPtr must be pointing to a 12 byte posdb rec.
+				if ( *(uint32_t *)(voteBufPtr+1) > *(uint32_t *)(subListPtr+8) ) {
+					break;
+				}
 				
-			// less than? keep going
-			if ( *(uint32_t *)(voteBufPtr+1) < *(uint32_t *)(subListPtr+8) ) {
-				continue;
-			}
+				// less than? keep going
+				if ( *(uint32_t *)(voteBufPtr+1) < *(uint32_t *)(subListPtr+8) ) {
+					continue;
+				}
 			
-			// top 4 bytes are equal. check lower single byte then.
-			if ( *(unsigned char *)(voteBufPtr) > (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
-				break;
-			}
+				// top 4 bytes are equal. check lower single byte then.
+				if ( *(unsigned char *)(voteBufPtr) > (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
+					break;
+				}
 			
-			if ( *(unsigned char *)(voteBufPtr) < (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
-				continue;
-			}
+				if ( *(unsigned char *)(voteBufPtr) < (*(unsigned char *)(subListPtr+7) & 0xfc ) ) {
+					continue;
+				}
 
-			// if we are a range term, does this subtermlist
-			// for this docid meet the min/max requirements
-			// of the range term, i.e. gbmin:offprice:190.
-			// if it doesn't then do not add this docid to the
-			// docidVoteBuf, "voteBufPtr"
-			if ( isRangeTerm && ! isTermValueInRange2(subListPtr, subListEnd, qt)) {
-				break;
-			}
+				// if we are a range term, does this subtermlist
+				// for this docid meet the min/max requirements
+				// of the range term, i.e. gbmin:offprice:190.
+				// if it doesn't then do not add this docid to the
+				// docidVoteBuf, "voteBufPtr"
+				if ( isRangeTerm && ! isTermValueInRange2(subListPtr, subListEnd, qt)) {
+					break;
+				}
 
-			// . equal! record our vote!
-			// . we start at zero for the
-			//   first termlist, and go to 1, etc.
-			voteBufPtr[5] = listGroupNum;
-			// skip it
-			voteBufPtr += 6;
+				// . equal! record our vote!
+				// . we start at zero for the
+				//   first termlist, and go to 1, etc.
+				voteBufPtr[5] = listGroupNum;
+				// skip it
+				voteBufPtr += 6;
 
-			// break out to advance subListPtr
-			break;
-		}
+				// break out to advance subListPtr
+				break;
+			}
 
-		// if we've exhausted this docid list go to next sublist
-		// since this docid is NOT in the current/ongoing intersection
-		// of the docids for each queryterm
-		if ( voteBufPtr >= voteBufEnd ) {
-			continue;
-		}
+			// if we've exhausted this docid list go to next sublist
+			// since this docid is NOT in the current/ongoing intersection
+			// of the docids for each queryterm
+			if ( voteBufPtr >= voteBufEnd ) {
+				continue;
+			}
 
-		// skip that docid record in our termlist. it MUST have been
-		// 12 bytes, a docid heading record.
-		subListPtr += 12;
+			// skip that docid record in our termlist. it MUST have been
+			// 12 bytes, a docid heading record.
+			subListPtr += 12;
 
-		// skip any following keys that are 6 bytes, that means they
-		// share the same docid
-		for ( ; subListPtr < subListEnd && ((*subListPtr)&0x04); ) {
-			subListPtr += 6;
-		}
+			// skip any following keys that are 6 bytes, that means they
+			// share the same docid
+			for ( ; subListPtr < subListEnd && ((*subListPtr)&0x04); ) {
+				subListPtr += 6;
+			}
 		
-		// if we have more posdb recs in this sublist, then keep
-		// adding our docid votes into the docid list
-		if ( subListPtr < subListEnd ) {
-			goto handleNextSubListRecord;
-		}
+			// if we have more posdb recs in this sublist, then keep
+			// adding our docid votes into the docid list
+			if ( subListPtr < subListEnd ) {
+				goto handleNextSubListRecord;
+			}
 			
-		// otherwise, advance to next sublist
+			// otherwise, advance to next sublist
+		}
 	}
 
 
@@ -213,11 +213,16 @@ public:
 	void makeDocIdVoteBufForRarestTerm( const QueryTermInfo *qti , bool isRangeTerm );
 	bool makeDocIdVoteBufForBoolQuery() ;
 	void delDocIdVotes ( const QueryTermInfo *qti );	// for negative query terms...
+	void markDocIdVotes ( const QueryTermInfo *qti, char vote );
 	bool findCandidateDocIds();
 
 
 	// upper score bound
 	float getMaxPossibleScore(const QueryTermInfo *qti) ;
+	// upper score bounds for blocks of candidate docids
+	void buildScoreBlocks(const QueryTermInfo *qtibuf, int32_t numQueryTermsToHandle);
+	bool canSkipScoreBlock(int32_t block, const QueryTermInfo *qtibuf, int32_t numQueryTermsToHandle, float minWinningScore) const;
+	void skipScoreBlock(int32_t block, QueryTermInfo *qtibuf);
 	float modifyMaxScoreByDistance(float score,
 				       int32_t bestDist,
 				       int32_t qdist,
@@ -237,6 +242,17 @@ private:
 	// intersect docids from each QueryTermInfo into here
 	SafeBuf              m_docIdVoteBuf;
 
+	// block-max metadata set by buildScoreBlocks(). m_docIdVoteBuf is
+	// split into blocks of SCORE_BLOCK_SIZE docids and for each block we
+	// keep an upper score bound per query term and the sublist cursors
+	// pointing at the first docid of the block.
+	int32_t                 m_numScoreBlocks;
+	std::vector<float>      m_scoreBlockMaxScores;     //[block*m_numQueryTermInfos + term]
+	std::vector<const char*> m_scoreBlockCursors;      //[block*m_numScoreBlockCursors + m_scoreBlockCursorBase[term] + sublist]
+	std::vector<int32_t>    m_scoreBlockCursorBase;
+	int32_t                 m_numScoreBlockCursors;
+	float                   m_maxCompleteScoreMultiplier;
+
 	int32_t m_filtered;
 
 	// boolean truth table for boolean queries
@@ -253,6 +269,9 @@ private:
 };
 
 
+// number of candidate docids covered by each block-max score bound
+#define SCORE_BLOCK_SIZE 128
+
 // distance used when measuring word from title/linktext/etc to word in body
 #define FIXED_DISTANCE 400
 
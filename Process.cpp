@@ -33,6 +33,7 @@
 #include "PageInject.h"
 #include "CountryCode.h"
 #include "File.h"
+#include "BigFile.h"
 #include "Docid2Siteflags.h"
 #include "UrlRealtimeClassification.h"
 #include "InstanceInfoExchange.h"
@@ -41,6 +42,8 @@
 #include "Mem.h"
 #include "Msg4In.h"
 #include "SummaryCache.h"
+#include "Msg3a.h"
+#include "TitleRecCodec.h"
 #include "GbDns.h"
 #include "DocDelete.h"
 #include "SpiderdbHostDelete.h"
@@ -723,6 +726,9 @@ bool Process::shutdown2() {
 
 	GbDns::finalize();
 
+	// no more reads are waited for past this point
+	BigFile::finalizeIoUring();
+
 	// save the conf files and caches. these block the cpu.
 	if ( m_blockersNeedSave ) {
 		m_blockersNeedSave = false;
@@ -862,13 +868,19 @@ bool Process::saveRdbTrees(bool shuttingDown) {
 		m_calledSave = true;
 	}
 
-	g_spiderCache.save ( useThread );
+	bool spiderCacheSaved = g_spiderCache.save ( useThread );
 
 	// check if any need to finish saving
 	if (isAnyTreeSaving()) {
 		return false;
 	}
 
+	// . wait for an ip scan table save still running from a thread
+	// . when not shutting down they're simply saved again next time
+	if (shuttingDown && !spiderCacheSaved) {
+		return false;
+	}
+
 	// reset for next call
 	m_calledSave = false;
 
@@ -1021,6 +1033,8 @@ void Process::resetAll ( ) {
 	g_wiki.reset();
 	g_profiler.reset();
 	resetMsg13Caches();
+	Msg3a::resetResultCache();
+	TitleRecCodec::reset();
 	resetStopWordTables();
 	g_stable_summary_cache.clear();
 	g_unstable_summary_cache.clear();
@@ -0,0 +1,224 @@
+#include "QueryTrace.h"
+#include "Conf.h"
+#include "SafeBuf.h"
+#include "GbMutex.h"
+#include "ScopedLock.h"
+#include "Errno.h"
+#include "fctypes.h"
+#include "Pages.h"
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+// how many finished traces we keep for the admin page
+static const size_t s_maxTraces = 100;
+
+namespace {
+
+struct TraceRecord {
+	int64_t m_id;
+	int32_t m_hostId;
+	int64_t m_startUs;
+	int64_t m_durationUs;
+	int32_t m_errno;
+	std::string m_query;
+	std::vector<QueryTraceSpan> m_spans;
+};
+
+}
+
+static std::deque<TraceRecord> s_traces;
+static int64_t s_nextTraceId = 1;
+static GbMutex s_mtxTraces;
+
+static std::atomic<uint32_t> s_queryCount(0);
+
+
+void QueryTrace::reset() {
+	m_active = false;
+	m_hostId = -1;
+	m_startUs = 0;
+	m_numSpans = 0;
+}
+
+bool QueryTrace::shouldSample() {
+	int32_t rate = g_conf.m_queryTraceSampleRate;
+	if(rate <= 0)
+		return false;
+	return (++s_queryCount % (uint32_t)rate) == 0;
+}
+
+void QueryTrace::start(int32_t hostId) {
+	m_active = true;
+	m_hostId = hostId;
+	m_startUs = gettimeofdayInMicroseconds();
+	m_numSpans = 0;
+}
+
+int64_t QueryTrace::getNow() const {
+	return m_active ? (int64_t)gettimeofdayInMicroseconds() : 0;
+}
+
+void QueryTrace::addSpan(const char *name, int32_t level, int64_t startUs, int64_t endUs) {
+	if(!m_active || m_numSpans >= MAX_QUERY_TRACE_SPANS)
+		return;
+	QueryTraceSpan *span = &m_spans[m_numSpans++];
+	memset(span, 0, sizeof(*span));
+	strncpy(span->m_name, name, sizeof(span->m_name)-1);
+	span->m_hostId = m_hostId;
+	span->m_level = level;
+	span->m_startUs = startUs - m_startUs;
+	span->m_durationUs = endUs > startUs ? endUs - startUs : 0;
+}
+
+void QueryTrace::addSpan(const char *name, int32_t level, int64_t startUs) {
+	if(!m_active)
+		return;
+	addSpan(name, level, startUs, gettimeofdayInMicroseconds());
+}
+
+bool QueryTrace::addRemoteSpans(const char *buf, int32_t size, int64_t sendUs, int64_t replyUs) {
+	if(!m_active)
+		return true;
+	if(size < 0 || size % (int32_t)sizeof(QueryTraceSpan) != 0)
+		return false;
+	int32_t numSpans = size / (int32_t)sizeof(QueryTraceSpan);
+	const QueryTraceSpan *spans = (const QueryTraceSpan *)buf;
+
+	// how long the remote host worked on it
+	int64_t remoteDurationUs = 0;
+	for(int32_t i = 0; i < numSpans; i++) {
+		if(spans[i].m_startUs + spans[i].m_durationUs > remoteDurationUs)
+			remoteDurationUs = spans[i].m_startUs + spans[i].m_durationUs;
+	}
+
+	// assume the network took equally long both ways
+	int64_t offsetUs = sendUs - m_startUs;
+	int64_t networkUs = (replyUs - sendUs) - remoteDurationUs;
+	if(networkUs > 0)
+		offsetUs += networkUs / 2;
+
+	for(int32_t i = 0; i < numSpans && m_numSpans < MAX_QUERY_TRACE_SPANS; i++) {
+		QueryTraceSpan *span = &m_spans[m_numSpans++];
+		*span = spans[i];
+		span->m_name[sizeof(span->m_name)-1] = '\0';
+		span->m_startUs += offsetUs;
+	}
+	return true;
+}
+
+void QueryTrace::finish(const char *query, int32_t err) {
+	if(!m_active)
+		return;
+	m_active = false;
+
+	TraceRecord tr;
+	tr.m_hostId = m_hostId;
+	tr.m_startUs = m_startUs;
+	tr.m_durationUs = (int64_t)gettimeofdayInMicroseconds() - m_startUs;
+	tr.m_errno = err;
+	tr.m_query = query ? query : "";
+	tr.m_spans.assign(m_spans, m_spans + m_numSpans);
+
+	ScopedLock sl(s_mtxTraces);
+	tr.m_id = s_nextTraceId++;
+	s_traces.push_front(std::move(tr));
+	if(s_traces.size() > s_maxTraces)
+		s_traces.pop_back();
+}
+
+
+void QueryTrace::printTraces(SafeBuf *sb) {
+	ScopedLock sl(s_mtxTraces);
+
+	sb->safePrintf("<table %s>\n", TABLE_STYLE);
+	sb->safePrintf("<tr class=hdrow><td colspan=\"6\"><center><b>Recent Query Traces</b> "
+		       "(<a href=\"/admin/querytraces?format=json\">chrome trace json</a>)</center></td></tr>\n");
+	sb->safePrintf("<tr class=hdrow>"
+		       "<td><b>Id</b></td>"
+		       "<td><b>Time (UTC)</b></td>"
+		       "<td><b>Took (ms)</b></td>"
+		       "<td><b>Error</b></td>"
+		       "<td><b>Query</b></td>"
+		       "<td><b>Breakdown</b></td>"
+		       "</tr>\n");
+
+	for(const auto &tr : s_traces) {
+		time_t t = tr.m_startUs / 1000000;
+		struct tm tm_buf;
+		char timebuf[32];
+		strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", gmtime_r(&t, &tm_buf));
+
+		sb->safePrintf("<tr bgcolor=#%s>", LIGHT_BLUE);
+		sb->safePrintf("<td><a href=\"/admin/querytraces?format=json&id=%" PRId64"\">%" PRId64"</a></td>", tr.m_id, tr.m_id);
+		sb->safePrintf("<td>%s</td>", timebuf);
+		sb->safePrintf("<td>%.1f</td>", tr.m_durationUs / 1000.0);
+		sb->safePrintf("<td>%s</td>", tr.m_errno ? mstrerror(tr.m_errno) : "");
+		sb->safePrintf("<td>");
+		sb->htmlEncode(tr.m_query.c_str());
+		sb->safePrintf("</td>");
+
+		// one line per span, indented by its level
+		sb->safePrintf("<td><pre style=\"margin:0\">");
+		for(const auto &span : tr.m_spans) {
+			sb->safePrintf("%*s%-24s host=%-4" PRId32" +%9.3f %9.3f ms\n",
+				       (int)span.m_level*2, "",
+				       span.m_name,
+				       span.m_hostId,
+				       span.m_startUs / 1000.0,
+				       span.m_durationUs / 1000.0);
+		}
+		sb->safePrintf("</pre></td>");
+		sb->safePrintf("</tr>\n");
+	}
+
+	sb->safePrintf("</table><br>\n");
+}
+
+
+bool QueryTrace::printChromeTrace(SafeBuf *sb, int64_t traceId) {
+	ScopedLock sl(s_mtxTraces);
+
+	sb->safePrintf("{\"traceEvents\":[");
+	bool first = true;
+	for(const auto &tr : s_traces) {
+		if(traceId && tr.m_id != traceId)
+			continue;
+
+		// the whole query, carrying the query string
+		sb->safePrintf("%s\n{\"name\":\"query\",\"cat\":\"query\",\"ph\":\"X\","
+			       "\"ts\":%" PRId64",\"dur\":%" PRId64",\"pid\":%" PRId32",\"tid\":%d,"
+			       "\"args\":{\"trace\":%" PRId64",\"error\":%" PRId32",\"query\":\"",
+			       first ? "" : ",",
+			       tr.m_startUs, tr.m_durationUs,
+			       tr.m_hostId,
+			       (int)QUERY_TRACE_LEVEL_MSG40,
+			       tr.m_id, tr.m_errno);
+		sb->jsonEncode(tr.m_query.c_str());
+		sb->safePrintf("\"}}");
+		first = false;
+
+		for(const auto &span : tr.m_spans) {
+			sb->safePrintf(",\n{\"name\":\"");
+			sb->jsonEncode(span.m_name);
+			sb->safePrintf("\",\"cat\":\"query\",\"ph\":\"X\","
+				       "\"ts\":%" PRId64",\"dur\":%" PRId64",\"pid\":%" PRId32",\"tid\":%" PRId32","
+				       "\"args\":{\"trace\":%" PRId64"}}",
+				       tr.m_startUs + span.m_startUs, span.m_durationUs,
+				       span.m_hostId, span.m_level,
+				       tr.m_id);
+		}
+	}
+	sb->safePrintf("\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	return !first || traceId == 0;
+}
+
+
+void QueryTrace::clearTraces() {
+	ScopedLock sl(s_mtxTraces);
+	s_traces.clear();
+}
@@ -0,0 +1,95 @@
+#ifndef GB_QUERYTRACE_H
+#define GB_QUERYTRACE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+class SafeBuf;
+
+// . per-query latency breakdown
+// . the host that got the query (Msg40/Msg3a) and every shard host (Msg39)
+//   record the stages of a sampled query as spans. The Msg39 spans are
+//   sent back in the Msg39Reply and merged into the trace of the
+//   originating host, which stores the finished trace in a log of recent
+//   traces shown on the admin/querytraces page.
+
+#define MAX_QUERY_TRACE_SPANS 256
+
+// how deep in the query path a span was recorded. Used as the thread id in
+// the chrome trace so the stages of each host are stacked
+enum {
+	QUERY_TRACE_LEVEL_MSG40 = 0,
+	QUERY_TRACE_LEVEL_MSG3A = 1,
+	QUERY_TRACE_LEVEL_MSG39 = 2
+};
+
+// this is sent over the network so it must stay a POD
+struct QueryTraceSpan {
+	char    m_name[24];
+	int32_t m_hostId;
+	int32_t m_level;
+	int64_t m_startUs;     // relative to the start of the trace
+	int64_t m_durationUs;
+};
+
+
+class QueryTrace {
+public:
+	QueryTrace() { reset(); }
+
+	void reset();
+
+	// . true if the next query should be traced
+	// . traces every Nth query as set by g_conf.m_queryTraceSampleRate
+	static bool shouldSample();
+
+	// start tracing. local spans are attributed to "hostId"
+	void start(int32_t hostId);
+	bool isActive() const { return m_active; }
+
+	// absolute start time in microseconds
+	int64_t getStartTime() const { return m_startUs; }
+	// current time in microseconds, or 0 if not tracing
+	int64_t getNow() const;
+
+	// . add a stage that started at the absolute time "startUs" and
+	//   ended at "endUs" (both from gettimeofdayInMicroseconds())
+	// . does nothing if the trace is not active or full
+	void addSpan(const char *name, int32_t level, int64_t startUs, int64_t endUs);
+	// same but ends now
+	void addSpan(const char *name, int32_t level, int64_t startUs);
+
+	// . merge the serialized spans of another host. The remote host does
+	//   not share our clock so its spans are centered in the round trip
+	//   between "sendUs" and "replyUs"
+	// . returns false if the buffer is malformed
+	bool addRemoteSpans(const char *buf, int32_t size, int64_t sendUs, int64_t replyUs);
+
+	int32_t getNumSpans() const { return m_numSpans; }
+	const QueryTraceSpan *getSpan(int32_t i) const { return &m_spans[i]; }
+
+	// for serializing the spans into a reply
+	const char *getSpanBuf() const { return (const char *)m_spans; }
+	int32_t getSpanBufSize() const { return m_numSpans * (int32_t)sizeof(QueryTraceSpan); }
+
+	// store the finished trace in the log of recent traces and deactivate
+	void finish(const char *query, int32_t err);
+
+	// print the log of recent traces as an html table
+	static void printTraces(SafeBuf *sb);
+	// . print the recent traces in the chrome trace event format
+	//   (chrome://tracing, perfetto)
+	// . "traceId" of 0 prints all of them
+	static bool printChromeTrace(SafeBuf *sb, int64_t traceId);
+	// forget all recent traces
+	static void clearTraces();
+
+private:
+	bool    m_active;
+	int32_t m_hostId;
+	int64_t m_startUs;
+	int32_t m_numSpans;
+	QueryTraceSpan m_spans[MAX_QUERY_TRACE_SPANS];
+};
+
+#endif // GB_QUERYTRACE_H
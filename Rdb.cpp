@@ -17,6 +17,7 @@
 #include "Collectiondb.h"
 #include "hash.h"
 #include "Stats.h"
+#include "Msg39.h"
 #include "GbMoveFile.h"
 #include "ip.h"
 #include "max_niceness.h"
@@ -976,6 +977,10 @@ void Rdb::doneDumping ( ) {
 				}
 			}
 		}
+
+		// cached query results may no longer match the index
+		if ( m_rdbId == RDB_POSDB )
+			Msg39::bumpIndexGeneration();
 	} else {
 		if(g_collectiondb.getNumRecsUsed()>1)
 			log(LOG_ERROR,"db: Error encountered while dumping %s tree to file: %s. "
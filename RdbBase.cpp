@@ -22,6 +22,7 @@
 #include "GbMoveFile.h"
 #include "GbMakePath.h"
 #include "Mem.h"
+#include "Msg39.h"
 #include "ScopedLock.h"
 #include <sys/stat.h> //mkdir(), stat()
 #include <fcntl.h>
@@ -1640,7 +1641,7 @@ void RdbBase::renamesDone() {
 	bool wait = false;
 	for ( int32_t i = a ; i < b ; i++ ) {
 		BigFile *bf = m_fileInfo[i].m_file;
-		if ( g_jobScheduler.is_reading_file(bf) ) wait = true;
+		if ( bf->isBeingRead() ) wait = true;
 	}
 	if ( wait ) {
 		log("db: waiting for read thread to exit on unlinked file");
@@ -1675,6 +1676,11 @@ void RdbBase::renamesDone() {
 	
 	g_merge.mergeIncorporated(this);
 
+	// cached query results may no longer match the index
+	if ( m_rdb->getRdbId() == RDB_POSDB ) {
+		Msg39::bumpIndexGeneration();
+	}
+
 	// try to merge more when we are done
 	attemptMergeAll();
 }
@@ -2643,13 +2649,13 @@ void RdbBase::finalizeGlobalIndexThread() {
 	m_globalIndexThreadQueue.finalize();
 }
 
-std::vector<std::pair<int32_t, docidsconst_ptr_t>> RdbBase::prepareGlobalIndexJob(bool markFileReadable, int32_t fileId) {
+std::vector<std::pair<int32_t, docidsview_ptr_t>> RdbBase::prepareGlobalIndexJob(bool markFileReadable, int32_t fileId) {
 	ScopedLock sl(m_mtxFileInfo);
 	return prepareGlobalIndexJob_unlocked(markFileReadable, fileId);
 }
 
-std::vector<std::pair<int32_t, docidsconst_ptr_t>> RdbBase::prepareGlobalIndexJob_unlocked(bool markFileReadable, int32_t fileId) {
-	std::vector<std::pair<int32_t, docidsconst_ptr_t>> docIdFileIndexes;
+std::vector<std::pair<int32_t, docidsview_ptr_t>> RdbBase::prepareGlobalIndexJob_unlocked(bool markFileReadable, int32_t fileId) {
+	std::vector<std::pair<int32_t, docidsview_ptr_t>> docIdFileIndexes;
 
 	// global index does not include RdbIndex from tree/buckets
 	for (int32_t i = 0; i < m_numFiles; i++) {
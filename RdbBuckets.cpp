@@ -9,6 +9,7 @@
 #include "Collectiondb.h"
 #include "Mem.h"
 #include "ScopedLock.h"
+#include "ScopedRWLock.h"
 #include <fcntl.h>
 #include "Posdb.h"
 
@@ -38,8 +39,7 @@ public:
 	void reset();
 	void reBuf(char *newbuf);
 
-	const char *getFirstKey();
-	const char *getFirstKey() const { return const_cast<RdbBucket *>(this)->getFirstKey(); }
+	const char *getFirstKey() const;
 
 	const char *getEndKey() const { return m_endKey; }
 
@@ -54,11 +54,11 @@ public:
 
 	bool addKey(const char *key, const char *data, int32_t dataSize);
 
-	int32_t getNode(const char *key); //returns -1 if not found
+	int32_t getNode(const char *key) const; //returns -1 if not found
 	int32_t getNumNegativeKeys() const;
 
 	bool getList(RdbList *list, const char *startKey, const char *endKey, int32_t minRecSizes,
-	             int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys);
+	             int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const;
 
 	void deleteNode(int32_t i);
 
@@ -77,6 +77,8 @@ public:
 	RdbBucket *split(RdbBucket *newBucket);
 
 private:
+	bool insertKey(const char *newRec, int32_t dataSize);
+
 	char *m_endKey;
 	char *m_keys;
 	RdbBuckets *m_parent;
@@ -126,13 +128,13 @@ void RdbBucket::reset() {
 }
 
 int32_t RdbBuckets::getMemAllocated() const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 	return (sizeof(RdbBuckets) + m_masterSize + m_dataMemOccupied);
 }
 
 //includes data in the data ptrs
 int32_t RdbBuckets::getMemOccupied() const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 	return (m_numKeysApprox * m_recSize) + m_dataMemOccupied + sizeof(RdbBuckets) + m_sortBufSize + BUCKET_SIZE * m_recSize;
 }
 
@@ -154,7 +156,7 @@ static int cmp_int(const void *pv1, const void *pv2) {
 //and we can't then we'll get a partial list added and we will
 //add the whole list again.
 bool RdbBuckets::hasRoom(int32_t numRecs) const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 
 	//Whether we have room or not depends on how many bucket splits will occur. We don't
 	//know that until we see the keys, so we must be a conservative. If we answer yes but
@@ -455,6 +457,10 @@ bool RdbBucket::addKey(const char *key, const char *data, int32_t dataSize) {
 			}
 
 			m_endKey = newLoc;
+		} else {
+			// . keep the bucket sorted here, under the write lock, so
+			// . readers sharing the lock never have to sort it
+			return insertKey(newLoc, dataSize);
 		}
 	}
 	m_numKeys++;
@@ -464,8 +470,60 @@ bool RdbBucket::addKey(const char *key, const char *data, int32_t dataSize) {
 	return true;
 }
 
-int32_t RdbBucket::getNode(const char *key) {
-	sort();
+// . insert the record built at the end of m_keys into its sorted position
+// . a key that matches an existing one (ignoring the delbit) replaces it,
+// . same as the dedup in sort()
+bool RdbBucket::insertKey(const char *newRec, int32_t dataSize) {
+	uint8_t ks = m_parent->m_ks;
+	int32_t recSize = m_parent->m_recSize;
+	int32_t fixedDataSize = m_parent->m_fixedDataSize;
+	bool isNeg = KEYNEG(newRec);
+
+	int32_t low = 0;
+	int32_t high = m_numKeys;
+	while (low < high) {
+		int32_t i = (low + high) / 2;
+		if (KEYCMPNEGEQ(m_keys + (recSize * i), newRec, ks) < 0) {
+			low = i + 1;
+		} else {
+			high = i;
+		}
+	}
+
+	char *loc = m_keys + (recSize * low);
+
+	if (low < m_numKeys && KEYCMPNEGEQ(loc, newRec, ks) == 0) {
+		int32_t bytesRemoved = 0;
+		if (fixedDataSize != 0) {
+			if (fixedDataSize == -1) {
+				bytesRemoved = *(int32_t *)(loc + ks + sizeof(char *));
+			} else {
+				bytesRemoved = fixedDataSize;
+			}
+		}
+		int32_t numNeg = (isNeg ? 1 : 0) - (KEYNEG(loc) ? 1 : 0);
+
+		gbmemcpy(loc, newRec, recSize);
+		m_parent->updateNumRecs_unlocked(0, dataSize - bytesRemoved, numNeg);
+		return true;
+	}
+
+	// newRec sits right past the last key, so save it before shifting over it
+	char tmp[MAX_KEY_BYTES + sizeof(char *) + sizeof(int32_t)];
+	gbmemcpy(tmp, newRec, recSize);
+	memmove(loc + recSize, loc, (m_numKeys - low) * recSize);
+	gbmemcpy(loc, tmp, recSize);
+
+	m_numKeys++;
+	m_lastSorted = m_numKeys;
+	m_endKey = m_keys + ((m_numKeys - 1) * recSize);
+	m_parent->updateNumRecs_unlocked(1, dataSize, isNeg ? 1 : 0);
+
+	logTrace(g_conf.m_logTraceRdbBuckets, "END. Returning true");
+	return true;
+}
+
+int32_t RdbBucket::getNode(const char *key) const {
 
 	uint8_t ks = m_parent->m_ks;
 	int32_t recSize = m_parent->m_recSize;
@@ -545,14 +603,14 @@ bool RdbBucket::selfTest (int32_t bucketnum, const char* prevKey) {
 
 
 void RdbBuckets::printBuckets(std::function<void(const char *, int32_t)> print_fn) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
  	for(int32_t i = 0; i < m_numBuckets; i++) {
 		m_buckets[i]->printBucket(i, print_fn);
 	}
 }
 
 void RdbBuckets::printBucketsStartEnd() {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
  	for(int32_t i = 0; i < m_numBuckets; i++) {
 		m_buckets[i]->printBucketStartEnd(i);
 	}
@@ -632,7 +690,7 @@ RdbBuckets::RdbBuckets()
 
 bool RdbBuckets::set(int32_t fixedDataSize, int32_t maxMem, const char *allocName, rdbid_t rdbId,
                      const char *dbname, char keySize) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	m_numBuckets = 0;
 	m_ks = keySize;
@@ -695,17 +753,17 @@ bool RdbBuckets::isSaving() const {
 }
 
 bool RdbBuckets::needsSave() const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 	return m_needsSave;
 }
 
 void RdbBuckets::setNeedsSave(bool s) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 	m_needsSave = s;
 }
 
 void RdbBuckets::reset() {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 	reset_unlocked();
 }
 
@@ -735,7 +793,7 @@ void RdbBuckets::reset_unlocked() {
 }
 
 void RdbBuckets::clear() {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	for (int32_t j = 0; j < m_numBuckets; j++) {
 		m_buckets[j]->reset();
@@ -869,7 +927,7 @@ bool RdbBuckets::resizeTable_unlocked(int32_t numNeeded) {
 }
 
 bool RdbBuckets::addNode(collnum_t collnum, const char *key, const char *data, int32_t dataSize) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 	return addNode_unlocked(collnum, key, data, dataSize);
 }
 
@@ -1006,10 +1064,45 @@ void RdbBuckets::addBucket_unlocked(RdbBucket *newBucket, int32_t i) {
 
 bool RdbBuckets::getList(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes,
                          RdbList *list, int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const {
-	ScopedLock sl(m_mtx);
+	// buckets are kept sorted by the writers so readers can always share the lock
+	ScopedReadLock sl(m_mtx);
 	return getList_unlocked(collnum, startKey, endKey, minRecSizes, list, numPosRecs, numNegRecs, useHalfKeys);
 }
 
+// . find the first and last bucket that can hold keys in [startKey, endKey]
+// . returns false if there are no such buckets
+bool RdbBuckets::getBucketRange_unlocked(collnum_t collnum, const char *startKey, const char *endKey,
+                                         int32_t *startBucket, int32_t *endBucket) const {
+	m_mtx.verify_is_locked();
+
+	*startBucket = getBucketNum_unlocked(collnum, startKey);
+	if (*startBucket > 0 && bucketCmp_unlocked(collnum, startKey, m_buckets[*startBucket - 1]) < 0) {
+		(*startBucket)--;
+	}
+
+	// if the startKey is past our last bucket, then nothing
+	// to return
+	if (*startBucket == m_numBuckets || m_buckets[*startBucket]->getCollnum() != collnum) {
+		return false;
+	}
+
+	if (bucketCmp_unlocked(collnum, endKey, m_buckets[*startBucket]) <= 0) {
+		*endBucket = *startBucket;
+	} else {
+		*endBucket = getBucketNum_unlocked(collnum, endKey);
+	}
+
+	if (*endBucket == m_numBuckets || m_buckets[*endBucket]->getCollnum() != collnum) {
+		(*endBucket)--;
+	}
+
+	if (m_buckets[*endBucket]->getCollnum() != collnum) {
+		gbshutdownAbort(true);
+	}
+
+	return true;
+}
+
 bool RdbBuckets::getList_unlocked(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes,
                                   RdbList *list, int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const {
 	m_mtx.verify_is_locked();
@@ -1046,31 +1139,10 @@ bool RdbBuckets::getList_unlocked(collnum_t collnum, const char *startKey, const
 		minRecSizes = 0x7fffffff; //LONG_MAX;
 	}
 
-	int32_t startBucket = getBucketNum_unlocked(collnum, startKey);
-	if (startBucket > 0 && bucketCmp_unlocked(collnum, startKey, m_buckets[startBucket - 1]) < 0) {
-		startBucket--;
-	}
-
-	// if the startKey is past our last bucket, then nothing
-	// to return
-	if (startBucket == m_numBuckets || m_buckets[startBucket]->getCollnum() != collnum) {
-		return true;
-	}
-
-
+	int32_t startBucket;
 	int32_t endBucket;
-	if (bucketCmp_unlocked(collnum, endKey, m_buckets[startBucket]) <= 0) {
-		endBucket = startBucket;
-	} else {
-		endBucket = getBucketNum_unlocked(collnum, endKey);
-	}
-
-	if (endBucket == m_numBuckets || m_buckets[endBucket]->getCollnum() != collnum) {
-		endBucket--;
-	}
-	
-	if (m_buckets[endBucket]->getCollnum() != collnum) {
-		gbshutdownAbort(true);
+	if (!getBucketRange_unlocked(collnum, startKey, endKey, &startBucket, &endBucket)) {
+		return true;
 	}
 
 	int32_t growth = 0;
@@ -1130,7 +1202,7 @@ bool RdbBuckets::getList_unlocked(collnum_t collnum, const char *startKey, const
 }
 
 bool RdbBuckets::testAndRepair() {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	if (!selfTest_unlocked(true, false)) {
 		if (!repair_unlocked()) {
@@ -1203,7 +1275,7 @@ bool RdbBuckets::repair_unlocked() {
 
 
 void RdbBuckets::verifyIntegrity() {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 	selfTest_unlocked(true, true);
 }
 
@@ -1410,7 +1482,7 @@ int32_t RdbBuckets::getBucketNum_unlocked(collnum_t collnum, const char *key) co
 }
 
 bool RdbBuckets::collExists(collnum_t collnum) const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 
 	for (int32_t i = 0; i < m_numBuckets; i++) {
 		if (m_buckets[i]->getCollnum() == collnum) {
@@ -1426,7 +1498,7 @@ bool RdbBuckets::collExists(collnum_t collnum) const {
 }
 
 int32_t RdbBuckets::getNumKeys(collnum_t collnum) const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 
 	int32_t numKeys = 0;
 	for (int32_t i = 0; i < m_numBuckets; i++) {
@@ -1443,7 +1515,7 @@ int32_t RdbBuckets::getNumKeys(collnum_t collnum) const {
 }
 
 int32_t RdbBuckets::getNumKeys() const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 	return m_numKeysApprox;
 }
 
@@ -1454,12 +1526,12 @@ int32_t RdbBuckets::getNumKeys_unlocked() const {
 }
 
 int32_t RdbBuckets::getNumNegativeKeys() const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 	return m_numNegKeys;
 }
 
 int32_t RdbBuckets::getNumPositiveKeys() const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 	return m_numKeysApprox - m_numNegKeys;
 }
 
@@ -1471,8 +1543,7 @@ void RdbBuckets::updateNumRecs_unlocked(int32_t n, int32_t bytes, int32_t numNeg
 	m_numNegKeys += numNeg;
 }
 
-const char *RdbBucket::getFirstKey() {
-	sort();
+const char *RdbBucket::getFirstKey() const {
 	return m_keys;
 }
 
@@ -1493,9 +1564,7 @@ int32_t RdbBucket::getNumNegativeKeys ( ) const {
 }
 
 bool RdbBucket::getList(RdbList* list, const char* startKey, const char* endKey, int32_t minRecSizes,
-                        int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) {
-	sort();
-
+                        int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const {
 	//get our bounds within the bucket:
 	uint8_t ks = m_parent->m_ks;
 	int32_t recSize = m_parent->m_recSize;
@@ -1718,7 +1787,7 @@ bool RdbBucket::getList(RdbList* list, const char* startKey, const char* endKey,
 }
 
 bool RdbBuckets::deleteNode(collnum_t collnum, const char *key) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	int32_t i = getBucketNum_unlocked(collnum, key);
 
@@ -1937,7 +2006,7 @@ bool RdbBucket::deleteList(RdbList *list) {
 
 // remove keys from any non-existent collection
 void RdbBuckets::cleanBuckets() {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	// the liberation count
 	int32_t count = 0;
@@ -1977,7 +2046,7 @@ void RdbBuckets::cleanBuckets() {
 }
 
 bool RdbBuckets::delColl(collnum_t collnum) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 	return delColl_unlocked(collnum);
 }
 
@@ -2014,7 +2083,7 @@ bool RdbBuckets::delColl_unlocked(collnum_t collnum) {
 }
 
 int32_t RdbBuckets::addTree(RdbTree *rt) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 	ScopedLock sl2(rt->getLock());
 
 	int32_t n = rt->getFirstNode_unlocked();
@@ -2042,7 +2111,7 @@ int32_t RdbBuckets::addTree(RdbTree *rt) {
 
 //return the total bytes of the list bookended by startKey and endKey
 int64_t RdbBuckets::estimateListSize(collnum_t collnum, const char *startKey, const char *endKey, char *minKey, char *maxKey) const {
-	ScopedLock sl(m_mtx);
+	ScopedReadLock sl(m_mtx);
 
 	if (minKey) {
 		KEYSET(minKey, endKey, m_ks);
@@ -2080,7 +2149,7 @@ int64_t RdbBuckets::estimateListSize(collnum_t collnum, const char *startKey, co
 // . returns false if blocked, true otherwise
 // . sets g_errno on error
 bool RdbBuckets::fastSave(const char *dir, bool useThread, void *state, void (*callback)(void *state)) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	logTrace(g_conf.m_logTraceRdbBuckets, "BEGIN. dir=%s", dir);
 
@@ -2143,7 +2212,7 @@ void RdbBuckets::saveWrapper(void *state) {
 	// get this class
 	RdbBuckets *that = (RdbBuckets *)state;
 
-	ScopedLock sl(that->getLock());
+	ScopedWriteLock sl(that->getLock());
 
 	// assume no error since we're at the start of thread call
 	that->m_errno = 0;
@@ -2303,7 +2372,7 @@ int64_t RdbBuckets::fastSaveColl_unlocked(int fd) {
 }
 
 bool RdbBuckets::loadBuckets(const char *dbname) {
-	ScopedLock sl(m_mtx);
+	ScopedWriteLock sl(m_mtx);
 
 	char filename[256];
 	sprintf(filename, "%s-buckets-saved.dat", dbname);
@@ -2425,6 +2494,9 @@ int64_t RdbBuckets::fastLoadColl_unlocked(BigFile *f, const char *dbname) {
 		if (offset < 0) {
 			return -1;
 		}
+
+		// older saves can have buckets with an unsorted tail
+		m_buckets[i]->sort();
 		m_numBuckets++;
 	}
 
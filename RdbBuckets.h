@@ -29,7 +29,7 @@
 #include "rdbid_t.h"
 #include "collnum_t.h"
 #include "types.h"
-#include "GbMutex.h"
+#include "GbRWLock.h"
 #include "JobScheduler.h"
 
 class BigFile;
@@ -100,7 +100,7 @@ public:
 	bool loadBuckets(const char *dbname);
 
 private:
-	GbMutex& getLock() { return m_mtx; }
+	GbRWLock& getLock() { return m_mtx; }
 
 	static void saveWrapper(void *state);
 	static void saveDoneWrapper(void *state, job_exit_t exit_type);
@@ -116,6 +116,9 @@ private:
 	bool getList_unlocked(collnum_t collnum, const char *startKey, const char *endKey, int32_t minRecSizes, RdbList *list,
 	                      int32_t *numPosRecs, int32_t *numNegRecs, bool useHalfKeys) const;
 
+	bool getBucketRange_unlocked(collnum_t collnum, const char *startKey, const char *endKey,
+	                             int32_t *startBucket, int32_t *endBucket) const;
+
 	bool deleteList_unlocked(collnum_t collnum, RdbList *list);
 
 	bool delColl_unlocked(collnum_t collnum);
@@ -134,7 +137,10 @@ private:
 	bool fastLoad_unlocked(BigFile *f, const char *dbname);
 	int64_t fastLoadColl_unlocked(BigFile *f, const char *dbname);
 
-	mutable GbMutex m_mtx;
+	// readers (getList, estimates, stats) share the lock, adds/deletes/saves
+	// take it exclusively. Buckets are sorted lazily, so a reader that finds
+	// unsorted buckets in its range retries with the exclusive lock
+	mutable GbRWLock m_mtx;
 	RdbBucket **m_buckets;
 	RdbBucket *m_bucketsSpace;
 	char *m_masterPtr;
@@ -28,6 +28,9 @@ RdbCache::RdbCache() : m_dbname(NULL) {
 	m_numPtrsMax   = 0;
 	memset(m_bufs, 0, sizeof(m_bufs));
 	memset(m_bufSizes, 0, sizeof(m_bufSizes));
+	m_shards       = NULL;
+	m_numShards    = 0;
+	m_shardDbname[0] = '\0';
 	reset();
 	m_needsSave    = false;
 	m_convertNumPtrsMax = 0;
@@ -54,6 +57,11 @@ void RdbCache::reset ( ) {
 
 	//if ( m_numBufs > 0 )
 	//	log("db: resetting record cache");
+	if ( m_shards ) {
+		delete[] m_shards;
+		m_shards = NULL;
+	}
+	m_numShards = 0;
 	m_offset = 0;
 	m_tail   = 0;
 	for ( int32_t i = 0 ; i < m_numBufs ; i++ ) {
@@ -92,7 +100,8 @@ bool RdbCache::init ( int32_t  maxMem        ,
 		      const char *dbname  ,
 		      bool  loadFromDisk  ,
 		      char  cacheKeySize  ,
-		      int32_t  numPtrsMax    ) {
+		      int32_t  numPtrsMax    ,
+		      int32_t  numShards     ) {
 	// reset all
 	reset();
 	// watch out 
@@ -138,6 +147,46 @@ bool RdbCache::init ( int32_t  maxMem        ,
 	// if maxMem is zero just return true
 	if ( m_maxMem <= 0 ) return true;
 
+	// . a variable sized record can use up to the whole cache mem and a
+	//   shard only gets its share of it, so only shard fixed size records
+	if ( numShards > 1 && fixedDataSize < 0 ) {
+		log(LOG_WARN, "db: Not sharding cache for %s. Its records have no fixed size.", dbname);
+		numShards = 1;
+	}
+
+	// split the mem and nodes over the shards. each shard is a complete
+	// cache with its own lock, save file and stats.
+	if ( numShards > 1 ) {
+		try {
+			m_shards = new RdbCache[numShards];
+		} catch(std::bad_alloc&) {
+			log(LOG_WARN, "db: Could not allocate %" PRId32" shards for cache for %s.",numShards,dbname);
+			g_errno = ENOMEM;
+			return false;
+		}
+		m_numShards = numShards;
+		for ( int32_t i = 0 ; i < m_numShards ; i++ ) {
+			RdbCache *shard = &m_shards[i];
+			snprintf(shard->m_shardDbname, sizeof(shard->m_shardDbname), "%s-%" PRId32, dbname, i);
+			if ( ! shard->init ( m_maxMem / m_numShards ,
+					     fixedDataSize ,
+					     maxRecs / m_numShards + 1 ,
+					     shard->m_shardDbname ,
+					     loadFromDisk ,
+					     cacheKeySize ,
+					     numPtrsMax > 0 ? numPtrsMax / m_numShards + 1 : -1 ) ) {
+				reset();
+				return false;
+			}
+		}
+
+		// spread a save from before the cache was sharded over the shards
+		if ( loadFromDisk )
+			loadUnshardedSave();
+
+		return true;
+	}
+
 	// assume no need to call convertCache()
 	m_convert = false;
 
@@ -216,15 +265,82 @@ bool RdbCache::init ( int32_t  maxMem        ,
 
 
 int64_t RdbCache::getNumHits() const {
+	if ( m_shards ) {
+		int64_t sum = 0;
+		for ( int32_t i = 0 ; i < m_numShards ; i++ )
+			sum += m_shards[i].getNumHits();
+		return sum;
+	}
 	ScopedLock sl(const_cast<GbMutex&>(mtx_hits_misses));
 	return m_numHits;
 }
 
 int64_t RdbCache::getNumMisses() const {
+	if ( m_shards ) {
+		int64_t sum = 0;
+		for ( int32_t i = 0 ; i < m_numShards ; i++ )
+			sum += m_shards[i].getNumMisses();
+		return sum;
+	}
 	ScopedLock sl(const_cast<GbMutex&>(mtx_hits_misses));
 	return m_numMisses;
 }
 
+int32_t RdbCache::getMemOccupied() const {
+	if ( ! m_shards ) return m_memOccupied;
+	int32_t sum = 0;
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		sum += m_shards[i].getMemOccupied();
+	return sum;
+}
+
+int32_t RdbCache::getMemAllocated() const {
+	if ( ! m_shards ) return m_memAllocated;
+	int32_t sum = 0;
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		sum += m_shards[i].getMemAllocated();
+	return sum;
+}
+
+int32_t RdbCache::getNumUsedNodes() const {
+	if ( ! m_shards ) return m_numPtrsUsed;
+	int32_t sum = 0;
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		sum += m_shards[i].getNumUsedNodes();
+	return sum;
+}
+
+int32_t RdbCache::getNumTotalNodes() const {
+	if ( ! m_shards ) return m_numPtrsMax;
+	int32_t sum = 0;
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		sum += m_shards[i].getNumTotalNodes();
+	return sum;
+}
+
+int64_t RdbCache::getNumAdds() const {
+	if ( ! m_shards ) return m_adds;
+	int64_t sum = 0;
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		sum += m_shards[i].getNumAdds();
+	return sum;
+}
+
+int64_t RdbCache::getNumDeletes() const {
+	if ( ! m_shards ) return m_deletes;
+	int64_t sum = 0;
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		sum += m_shards[i].getNumDeletes();
+	return sum;
+}
+
+// . use a different start hash than the hash table in each shard so the
+//   keys of a shard still spread out over its slots
+RdbCache *RdbCache::getShardForKey ( const char *cacheKey ) {
+	if ( ! m_shards ) return this;
+	return &m_shards[ hash32 ( cacheKey , m_cks , 0x9e3779b9 ) % m_numShards ];
+}
+
 void RdbCache::incrementHits() {
 	ScopedLock sl(mtx_hits_misses);
 	m_numHits++;
@@ -413,6 +529,10 @@ bool RdbCache::getRecord ( collnum_t collnum   ,
 			   bool     promoteRecord ) {
 	// maxAge of 0 means don't check cache
 	if ( maxAge == 0 ) return false;
+	// let the shard owning the key do it
+	if ( m_shards )
+		return getShardForKey(cacheKey)->getRecord ( collnum , cacheKey , rec , recSize , doCopy ,
+							     maxAge , incCounts , cachedTime , promoteRecord );
 	// bail if no cache
 	if ( m_numPtrsMax <= 0 ) return false;
 	// if init() called failed because of oom...
@@ -599,6 +719,11 @@ bool RdbCache::addRecord ( collnum_t collnum ,
 			   int32_t   timestamp ,
 			   char **retRecPtr ) {
 
+	// let the shard owning the key do it
+	if ( m_shards )
+		return getShardForKey(cacheKey)->addRecord ( collnum , cacheKey , rec1 , recSize1 , rec2 , recSize2 ,
+							     timestamp , retRecPtr );
+
 	// bail if cache empty. maybe m_maxMem is 0.
 	if ( m_totalBufSize <= 0 ) return true;
 
@@ -1039,6 +1164,8 @@ void RdbCache::clearAll ( ) {
 //   Rdb::updateToRebuild() when updating/setting the rdb to a rebuilt rdb
 // . try it again now with new 64-bit logic updates (MDW 2/10/2015)
 void RdbCache::clear ( collnum_t collnum ) {
+	for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		m_shards[i].clear ( collnum );
 	for ( int32_t i = 0 ; i < m_numPtrsMax ; i++ ) {
 		// skip if empty bucket
 		if ( ! m_ptrs[i] ) continue;
@@ -1065,6 +1192,13 @@ bool RdbCache::save () {
 		return true;
 	}
 
+	// each shard has its own save file
+	if ( m_shards ) {
+		for ( int32_t i = 0 ; i < m_numShards ; i++ )
+			m_shards[i].save();
+		return true;
+	}
+
 	// if we do not need it, don't bother
 	if ( ! m_needsSave ) {
 		return true;
@@ -1354,6 +1488,48 @@ bool RdbCache::load ( const char *dbname ) {
 	return true;
 }
 
+// . "<dbname>.cache" is the save file of the cache before it was sharded.
+//   add its records to the shards, which save them under their own names.
+// . returns false if there was no such file or it could not be read
+bool RdbCache::loadUnshardedSave ( ) {
+	char filename [ 64 ];
+	if ( strlen(m_dbname) > 50 ) {
+		log(LOG_LOGIC, "db: cache: load: dbname too long.");
+		return false;
+	}
+	sprintf ( filename , "%s.cache" , m_dbname );
+	File f;
+	f.set ( g_hostdb.m_dir , filename );
+	if ( f.doesExist() <= 0 ) {
+		return false;
+	}
+
+	// convertCache() needs the config it was saved with
+	if ( ! f.open ( O_RDONLY ) ) {
+		log(LOG_WARN, "db: Could not open cache save file for %s: %s.", m_dbname, mstrerror(g_errno));
+		return false;
+	}
+	int32_t numPtrsMax;
+	int32_t maxMem;
+	bool ok = f.read ( &numPtrsMax , 4 , 0 ) == 4 &&
+		  f.read ( &maxMem     , 4 , 4 ) == 4;
+	f.close();
+	if ( ! ok || numPtrsMax <= 0 || maxMem <= 0 ) {
+		log(LOG_WARN, "db: Could not read cache save file %s.", f.getFilename());
+		return false;
+	}
+
+	log(LOG_INIT, "db: Spreading %s over %" PRId32" shards.", f.getFilename(), m_numShards);
+	if ( ! convertCache ( numPtrsMax , maxMem ) ) {
+		g_errno = 0;
+		return false;
+	}
+
+	// the shards have the records now
+	f.unlink();
+	return true;
+}
+
 bool RdbCache::convertCache ( int32_t numPtrsMax , int32_t maxMem ) {
 	// divide numPtrsMax by 2 to get maxRecs (see above)
 	int32_t maxRecs = numPtrsMax / 2;
@@ -1427,6 +1603,8 @@ bool RdbCache::convertCache ( int32_t numPtrsMax , int32_t maxMem ) {
 // goes through all the pointers and checks the integrity of the data they 
 // point to. Also checks if m_tail is pointing right or not
 void RdbCache::verify(){
+	 for ( int32_t i = 0 ; i < m_numShards ; i++ )
+		 m_shards[i].verify();
 	 bool foundTail = false;
 	 int32_t count = 0;
 	 logf(LOG_DEBUG,"db: cachebug: verifying");
@@ -1482,17 +1660,34 @@ void RdbCache::verify(){
 
 RdbCacheLock::RdbCacheLock(RdbCache &rdc_)
   : rdc(rdc_),
-    locked(true)
+    locked(false)
 {
-	pthread_mutex_lock(&rdc.m_mtx);
+	lock();
+}
+
+RdbCacheLock::RdbCacheLock(RdbCache &rdc_, const char *cacheKey)
+  : rdc(*rdc_.getShardForKey(cacheKey)),
+    locked(false)
+{
+	lock();
 }
 
 RdbCacheLock::~RdbCacheLock() {
 	unlock();
 }
 
+void RdbCacheLock::lock() {
+	pthread_mutex_lock(&rdc.m_mtx);
+	// always in the same order so two whole-cache locks can't deadlock
+	for(int32_t i = 0; i < rdc.m_numShards; i++)
+		pthread_mutex_lock(&rdc.m_shards[i].m_mtx);
+	locked = true;
+}
+
 void RdbCacheLock::unlock() {
 	if(locked) {
+		for(int32_t i = rdc.m_numShards - 1; i >= 0; i--)
+			pthread_mutex_unlock(&rdc.m_shards[i].m_mtx);
 		pthread_mutex_unlock(&rdc.m_mtx);
 		locked = false;
 	}
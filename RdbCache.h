@@ -67,6 +67,7 @@ class RdbCache {
 
 	bool isInitialized () const { 
 		if ( m_ptrs ) return true; 
+		if ( m_shards ) return true;
 		return false;
 	}
 
@@ -74,13 +75,21 @@ class RdbCache {
 	// . a fixedDataSize of -1 means the dataSize varies from rec to rec
 	// . set "maxNumNodes" to -1 for it to be auto determined
 	// . can only do this if fixedDataSize is not -1
+	// . if "numShards" is more than 1 the mem and nodes are split over
+	//   that many independently locked caches and the key hash picks
+	//   the one a record goes in. use RdbCacheLock(cache,key) to only
+	//   lock the shard of a key.
+	// . only caches with a fixed data size are sharded, so a shard's
+	//   share of the mem doesn't limit how big a record can be
+	// . a "<dbname>.cache" saved before sharding is spread over the shards
 	bool init ( int32_t maxCacheMem   , 
 		    int32_t fixedDataSize , 
 		    int32_t maxCacheNodes ,
 		    const char *dbname       ,
 		    bool  loadFromDisk ,
 		    char  cacheKeySize,
-		    int32_t  numPtrsMax);
+		    int32_t  numPtrsMax,
+		    int32_t  numShards = 1);
 
 	// . a quick hack for SpiderCache.cpp
 	// . if your record is always a 4 byte int32_t call this
@@ -197,24 +206,24 @@ class RdbCache {
 
 	void verify();
 
-	// these include our mem AND our tree's mem combined
-	int32_t getMemOccupied () const {
-		return m_memOccupied ;
-	}
-
-	int32_t getMemAllocated() const {
-		return m_memAllocated;
-	}
+	// . these include our mem AND our tree's mem combined
+	// . for a sharded cache these are the sums over all shards
+	int32_t getMemOccupied () const;
+	int32_t getMemAllocated() const;
 
 	int32_t getMaxMem      () const { return m_maxMem; }
 
 	// cache stats
 	int64_t getNumHits() const;
 	int64_t getNumMisses() const;
-	int32_t getNumUsedNodes  () const { return m_numPtrsUsed; }
-	int32_t getNumTotalNodes () const { return m_numPtrsMax ; }
-	int64_t getNumAdds() const { return m_adds; }
-	int64_t getNumDeletes() const { return m_deletes; }
+	int32_t getNumUsedNodes  () const;
+	int32_t getNumTotalNodes () const;
+	int64_t getNumAdds() const;
+	int64_t getNumDeletes() const;
+
+	// per-shard stats. an unsharded cache is its own single shard.
+	int32_t getNumShards () const { return m_shards ? m_numShards : 1; }
+	const RdbCache *getShard ( int32_t i ) const { return m_shards ? &m_shards[i] : this; }
 
 	bool useDisk ( ) const { return m_useDisk; }
 	bool load ( const char *dbname );
@@ -235,6 +244,9 @@ class RdbCache {
 	}
 
 private:
+	// the shard "cacheKey" goes in, or ourselves if not sharded
+	RdbCache *getShardForKey ( const char *cacheKey );
+
 	bool save_r ( );
 	bool save2_r ( int fd );
 	bool load   ( );
@@ -257,6 +269,7 @@ private:
 
 	void markDeletedRecord(char *ptr);
 	bool convertCache ( int32_t numPtrsMax , int32_t maxMem ) ;
+	bool loadUnshardedSave ( );
 
 	void incrementHits();
 	void incrementMisses();
@@ -317,19 +330,29 @@ private:
 	int64_t m_deletes;
 
 	bool m_needsSave;
+
+	// if sharded, these hold the records and we just pick one
+	RdbCache *m_shards;
+	int32_t   m_numShards;
+	// "<dbname>-<shardnum>" when we are a shard
+	char      m_shardDbname[64];
 	
 	friend class RdbCacheLock;
 };	
 
 
-//Lock class to hold down an rdbcache while examining/copying or modifying a cache
+//Lock class to hold down an rdbcache while examining/copying or modifying a cache.
+//Locking a sharded cache without a key locks all of its shards. Locking it with
+//the key of the record about to be looked up or added only locks that shard.
 class RdbCacheLock {
 	RdbCacheLock(const RdbCacheLock&);
 	RdbCacheLock& operator=(const RdbCacheLock&);
 	RdbCache &rdc;
 	bool locked;
+	void lock();
 public:
 	RdbCacheLock(RdbCache &rdc_);
+	RdbCacheLock(RdbCache &rdc_, const char *cacheKey);
 	~RdbCacheLock();
 	void unlock();
 };
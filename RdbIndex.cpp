@@ -12,7 +12,9 @@
 #include "RdbBuckets.h"
 #include "JobScheduler.h"
 #include "ScopedLock.h"
+#include "MappedFile.h"
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <iterator>
 
@@ -34,7 +36,8 @@ RdbIndex::RdbIndex()
 	, m_ks(0)
 	, m_rdbId(RDB_NONE)
 	, m_version(s_rdbIndexCurrentVersion)
-	, m_docIds(new docids_t)
+	, m_docIds(new DocIdsView)
+	, m_fileIsMapped(false)
 	, m_docIdsMtx()
 	, m_pendingMergeMtx()
 	, m_pendingMergeCond(PTHREAD_COND_INITIALIZER)
@@ -64,7 +67,8 @@ void RdbIndex::reset(bool isStatic) {
 	m_file.reset();
 
 	/// @todo ALC do we need to lock here?
-	m_docIds.reset(new docids_t);
+	m_docIds.reset(new DocIdsView);
+	m_fileIsMapped = false;
 
 	m_pendingDocIds.reset(new docids_t);
 	if (!isStatic) {
@@ -80,7 +84,7 @@ void RdbIndex::reset(bool isStatic) {
 void RdbIndex::clear() {
 	ScopedLock sl(m_pendingDocIdsMtx);
 
-	m_docIds.reset(new docids_t);
+	m_docIds.reset(new DocIdsView);
 	m_pendingDocIds.reset(new docids_t);
 	m_pendingDocIds->reserve(m_generatingIndex ? s_generateReserveSize : s_defaultReserveSize);
 
@@ -176,6 +180,15 @@ bool RdbIndex::writeIndex(bool finalWrite) {
 
 	log(LOG_INFO, "db: Saving %s", m_file.getFilename());
 
+	// . don't truncate a file that is mmap'ed. readers may still use the
+	//   docids in it so write a new file and leave the old one to the mapping
+	if (m_fileIsMapped) {
+		char filename[1024];
+		snprintf(filename, sizeof(filename), "%s/%s", m_file.getDir(), m_file.getFilename());
+		::unlink(filename);
+		m_fileIsMapped = false;
+	}
+
 	// open a new file
 	if (!m_file.open(O_RDWR | O_CREAT | O_TRUNC)) {
 		logError("END. Could not open %s for writing: %s. Returning false.", m_file.getFilename(), mstrerror(g_errno));
@@ -203,9 +216,8 @@ bool RdbIndex::writeIndex2(bool finalWrite) {
 	int64_t offset = 0LL;
 
 	// make sure we always write the newest tree
-	// remove const as m_file.write does not accept const buffer
 	ScopedLock sl(m_pendingDocIdsMtx);
-	docids_ptr_t tmpDocIds = std::const_pointer_cast<docids_t>(mergePendingDocIds_unlocked(finalWrite));
+	docidsview_ptr_t tmpDocIds = mergePendingDocIds_unlocked(finalWrite);
 	m_needToWrite = false;
 	sl.unlock();
 
@@ -229,7 +241,8 @@ bool RdbIndex::writeIndex2(bool finalWrite) {
 	offset += sizeof(docid_count);
 
 	if (docid_count) {
-		m_file.write(&(*tmpDocIds)[0], docid_count * sizeof((*tmpDocIds)[0]), offset);
+		// remove const as m_file.write does not accept const buffer
+		m_file.write(const_cast<uint64_t*>(tmpDocIds->data()), docid_count * sizeof(uint64_t), offset);
 		if (g_errno) {
 			logError("Failed to write to %s (docids): %s", m_file.getFilename(), mstrerror(g_errno));
 			return false;
@@ -263,7 +276,19 @@ bool RdbIndex::readIndex() {
 		return false;
 	}
 
-	bool status = readIndex2();
+	// . use the index file in place if we can mmap it
+	// . a file split into part files can't be mapped as a whole
+	bool status;
+	char filename[1024];
+	snprintf(filename, sizeof(filename), "%s/%s", m_file.getDir(), m_file.getFilename());
+	std::shared_ptr<MappedFile> mappedFile(new MappedFile);
+	if (g_conf.m_mmapMapAndIndexFiles && mappedFile->map(filename) &&
+	    (int64_t)mappedFile->getSize() == m_file.getFileSize()) {
+		status = readMappedIndex(mappedFile);
+	} else {
+		g_errno = 0;
+		status = readIndex2();
+	}
 
 	m_file.closeFds();
 
@@ -316,7 +341,45 @@ bool RdbIndex::readIndex2() {
 	logTrace(g_conf.m_logTraceRdbIndex, "END. Returning true with %zu docIds loaded", tmpDocIds->size());
 
 	// replace with new index
-	swapDocIds(tmpDocIds);
+	swapDocIds(docidsview_ptr_t(new DocIdsView(tmpDocIds)));
+
+	return true;
+}
+
+// . same as readIndex2() but uses the docids in place in the mmap'ed index file
+// . the mapping is unmapped when the last DocIdsView using it goes away
+bool RdbIndex::readMappedIndex(std::shared_ptr<MappedFile> mappedFile) {
+	const char *p = mappedFile->getData();
+	int64_t headerSize = sizeof(m_version) + sizeof(size_t);
+	if ((int64_t)mappedFile->getSize() < headerSize) {
+		return false;
+	}
+
+	// first 8 bytes is the index version
+	memcpy(&m_version, p, sizeof(m_version));
+	p += sizeof(m_version);
+
+	// the docids are used in place, so they must be in the current format
+	if (m_version != s_rdbIndexCurrentVersion) {
+		logError("Index file %s has version %" PRId64", expected %" PRId64, m_file.getFilename(), m_version, s_rdbIndexCurrentVersion);
+		return false;
+	}
+
+	// next 8 bytes are the total number of docids in the index file
+	size_t docid_count;
+	memcpy(&docid_count, p, sizeof(docid_count));
+	p += sizeof(docid_count);
+
+	int64_t expectedFileSize = headerSize + (int64_t)docid_count * sizeof(uint64_t);
+	if (expectedFileSize != (int64_t)mappedFile->getSize()) {
+		logError("Index file size[%zu] differs from expected size[%" PRId64"]", mappedFile->getSize(), expectedFileSize);
+		return false;
+	}
+
+	logTrace(g_conf.m_logTraceRdbIndex, "Mapped %zu docIds from %s", docid_count, m_file.getFilename());
+
+	m_fileIsMapped = true;
+	swapDocIds(docidsview_ptr_t(new DocIdsView(mappedFile, (const uint64_t *)p, docid_count)));
 
 	return true;
 }
@@ -334,12 +397,12 @@ bool RdbIndex::verifyIndex() {
 	return true;
 }
 
-docidsconst_ptr_t RdbIndex::mergePendingDocIds(bool finalWrite) {
+docidsview_ptr_t RdbIndex::mergePendingDocIds(bool finalWrite) {
 	ScopedLock sl(m_pendingDocIdsMtx);
 	return mergePendingDocIds_unlocked(finalWrite);
 }
 
-docidsconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
+docidsview_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
 	logTrace(g_conf.m_logTraceRdbIndex, "BEGIN %s[%p] finalWrite=%s", m_file.getFilename(), this, finalWrite ? "true" : "false");
 
 	// don't need to merge when there are no pending docIds
@@ -376,7 +439,7 @@ docidsconst_ptr_t RdbIndex::mergePendingDocIds_unlocked(bool finalWrite) {
 	}
 
 	// replace existing even if size doesn't change (could change from positive to negative key)
-	swapDocIds(tmpDocIds);
+	swapDocIds(docidsview_ptr_t(new DocIdsView(tmpDocIds)));
 
 	if (finalWrite) {
 		// make sure memory is freed
@@ -721,7 +784,7 @@ bool RdbIndex::generateIndex(BigFile *f) {
 	return true;
 }
 
-docidsconst_ptr_t RdbIndex::getDocIds() {
+docidsview_ptr_t RdbIndex::getDocIds() {
 	ScopedLock sl(m_docIdsMtx);
 	return m_docIds;
 }
@@ -742,11 +805,11 @@ bool RdbIndex::exist(uint64_t docId) {
 	// std::lower_bound works on sorted list
 	std::stable_sort(m_pendingDocIds->begin(), m_pendingDocIds->end(), cmplt_fn);
 
-	it = std::lower_bound(m_pendingDocIds->cbegin(), m_pendingDocIds->cend(), docId << RdbIndex::s_docIdOffset);
-	return (it != m_pendingDocIds->cend() && ((*it >> RdbIndex::s_docIdOffset) == docId));
+	auto pendingIt = std::lower_bound(m_pendingDocIds->cbegin(), m_pendingDocIds->cend(), docId << RdbIndex::s_docIdOffset);
+	return (pendingIt != m_pendingDocIds->cend() && ((*pendingIt >> RdbIndex::s_docIdOffset) == docId));
 }
 
-void RdbIndex::swapDocIds(docidsconst_ptr_t docIds) {
+void RdbIndex::swapDocIds(docidsview_ptr_t docIds) {
 	ScopedLock sl(m_docIdsMtx);
 	m_docIds.swap(docIds);
 }
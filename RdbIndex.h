@@ -13,11 +13,57 @@
 class RdbTree;
 class RdbBuckets;
 class RdbList;
+class MappedFile;
 
 typedef std::vector<uint64_t> docids_t;
 typedef std::shared_ptr<docids_t> docids_ptr_t;
 typedef std::shared_ptr<const docids_t> docidsconst_ptr_t;
 
+// . read-only sorted docids of an RdbIndex
+// . either a docids_t or the docids of an index file mmap'ed in place
+class DocIdsView {
+public:
+	typedef const uint64_t *const_iterator;
+	typedef const_iterator iterator;
+
+	DocIdsView()
+		: m_owner()
+		, m_begin(NULL)
+		, m_size(0) {
+	}
+
+	explicit DocIdsView(docidsconst_ptr_t docIds)
+		: m_owner(docIds)
+		, m_begin(docIds->data())
+		, m_size(docIds->size()) {
+	}
+
+	DocIdsView(std::shared_ptr<const MappedFile> file, const uint64_t *begin, size_t size)
+		: m_owner(file)
+		, m_begin(begin)
+		, m_size(size) {
+	}
+
+	const_iterator begin() const { return m_begin; }
+	const_iterator end() const { return m_begin + m_size; }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	const uint64_t *data() const { return m_begin; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	uint64_t operator[](size_t i) const { return m_begin[i]; }
+
+private:
+	// keeps the vector or mapping alive
+	std::shared_ptr<const void> m_owner;
+	const uint64_t *m_begin;
+	size_t m_size;
+};
+
+typedef std::shared_ptr<const DocIdsView> docidsview_ptr_t;
+
 class RdbIndex {
 public:
 	RdbIndex();
@@ -75,7 +121,7 @@ public:
 	// key format
 	// ........ ........ ........ dddddddd  d = docId
 	// dddddddd dddddddd dddddddd dddddd.Z  Z = delBit
-	docidsconst_ptr_t getDocIds();
+	docidsview_ptr_t getDocIds();
 
 	bool exist(uint64_t docId);
 
@@ -91,10 +137,12 @@ private:
 	bool writeIndex2(bool finalWrite);
 	bool readIndex2();
 
-	docidsconst_ptr_t mergePendingDocIds(bool finalWrite = false);
-	docidsconst_ptr_t mergePendingDocIds_unlocked(bool finalWrite = false);
+	docidsview_ptr_t mergePendingDocIds(bool finalWrite = false);
+	docidsview_ptr_t mergePendingDocIds_unlocked(bool finalWrite = false);
 
-	void swapDocIds(docidsconst_ptr_t docIds);
+	bool readMappedIndex(std::shared_ptr<MappedFile> mappedFile);
+
+	void swapDocIds(docidsview_ptr_t docIds);
 
 	// the index file
 	BigFile m_file;
@@ -108,7 +156,11 @@ private:
 	int64_t m_version;
 
 	// always sorted
-	docidsconst_ptr_t m_docIds;
+	docidsview_ptr_t m_docIds;
+
+	// m_docIds (or an older version of it) points into the mmap'ed index
+	// file so it must not be truncated
+	bool m_fileIsMapped;
 	GbMutex m_docIdsMtx;
 
 	GbMutex m_pendingMergeMtx;
@@ -4,12 +4,12 @@
 
 RdbIndexQuery::RdbIndexQuery(RdbBase *base)
 	: RdbIndexQuery(base ? (base->getGlobalIndex() ? base->getGlobalIndex() : docidsconst_ptr_t()) : docidsconst_ptr_t(),
-	                base ? (base->getTreeIndex() ? base->getTreeIndex()->getDocIds() : docidsconst_ptr_t()) : docidsconst_ptr_t(),
+	                base ? (base->getTreeIndex() ? base->getTreeIndex()->getDocIds() : docidsview_ptr_t()) : docidsview_ptr_t(),
 	                base ? base->getNumFiles() : 0,
 	                base ? base->hasPendingGlobalIndexJob() : false) {
 }
 
-RdbIndexQuery::RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob)
+RdbIndexQuery::RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsview_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob)
 	: m_globalIndexData(globalIndexData)
 	, m_treeIndexData(treeIndexData)
 	, m_numFiles(numFiles)
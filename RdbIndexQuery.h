@@ -24,10 +24,10 @@ private:
 	RdbIndexQuery(const RdbIndexQuery&);
 	RdbIndexQuery& operator=(const RdbIndexQuery&);
 
-	RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsconst_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob);
+	RdbIndexQuery(docidsconst_ptr_t globalIndexData, docidsview_ptr_t treeIndexData, int32_t numFiles, bool hasPendingGlobalIndexJob);
 
 	docidsconst_ptr_t m_globalIndexData;
-	docidsconst_ptr_t m_treeIndexData;
+	docidsview_ptr_t m_treeIndexData;
 	int32_t m_numFiles;
 	bool m_hasPendingGlobalIndexJob;
 };
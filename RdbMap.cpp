@@ -8,6 +8,7 @@
 #include "Conf.h"
 #include "Mem.h"
 #include <fcntl.h>
+#include <unistd.h>
 
 
 RdbMap::RdbMap() {
@@ -94,12 +95,15 @@ void RdbMap::reset ( ) {
 	}
 
 	for ( int32_t i = 0 ; i < m_numSegments; i++ ) {
-		mfree(m_keys[i],m_ks *pps,"RdbMap");
-		mfree(m_offsets[i], 2*pps,"RdbMap");
+		if ( ! m_mappedFile.contains(m_keys[i]) ) {
+			mfree(m_keys[i],m_ks *pps,"RdbMap");
+			mfree(m_offsets[i], 2*pps,"RdbMap");
+		}
 		// set to NULL so we know if accessed illegally
 		m_keys   [i] = NULL;
 		m_offsets[i] = NULL;
 	}
+	m_mappedFile.unmap();
 
 	// the ptrs themselves are now a dynamic array to save mem
 	// when we have thousands of collections
@@ -147,6 +151,14 @@ bool RdbMap::writeMap ( bool allDone ) {
 
 	log(LOG_INFO, "db: Saving %s", m_file.getFilename());
 
+	// . don't truncate the file we have mmap'ed. we would get a SIGBUS
+	//   accessing it. write a new file and leave the old one to the mapping
+	if ( m_mappedFile.isMapped() ) {
+		char filename[1024];
+		snprintf(filename, sizeof(filename), "%s/%s", m_file.getDir(), m_file.getFilename());
+		::unlink(filename);
+	}
+
 	// open a new file
 	if ( ! m_file.open ( O_RDWR | O_CREAT | O_TRUNC ) ) {
 		log(LOG_ERROR, "%s:%s: END. Could not open %s for writing: %s. Returning false.",
@@ -316,7 +328,19 @@ bool RdbMap::readMap ( BigFile *dataFile )
 		return false;
 	}
 
-	bool status = readMap2();
+	// . use the map file in place if we can mmap it
+	// . a file split into part files can't be mapped as a whole
+	bool status;
+	char filename[1024];
+	snprintf(filename, sizeof(filename), "%s/%s", m_file.getDir(), m_file.getFilename());
+	if ( g_conf.m_mmapMapAndIndexFiles && m_mappedFile.map(filename) &&
+	     (int64_t)m_mappedFile.getSize() == m_file.getFileSize() ) {
+		status = readMappedMap();
+	} else {
+		m_mappedFile.unmap();
+		g_errno = 0;
+		status = readMap2();
+	}
 
 	// . close map
 	// . no longer since we use BigFile
@@ -633,6 +657,66 @@ int64_t RdbMap::readSegment ( int32_t seg , int64_t offset , int32_t fileSize )
 	return offset ;
 }
 
+// . same as readMap2() but on the mmap'ed map file
+// . the file layout is the one written by writeMap2()
+bool RdbMap::readMappedMap ( ) {
+	const char *data = m_mappedFile.getData();
+	int64_t fileSize = m_mappedFile.getSize();
+
+	int64_t offset = 8 + 8 + 8 + 8 + m_ks;
+	if ( fileSize < offset ) {
+		log( LOG_WARN, "db: Map file %s is too small.", m_file.getFilename());
+		return false;
+	}
+
+	int64_t numPositiveRecs;
+	int64_t numNegativeRecs;
+	memcpy ( &m_offset          , data      , 8 );
+	memcpy ( &m_fileStartOffset , data + 8  , 8 );
+	memcpy ( &numPositiveRecs   , data + 16 , 8 );
+	memcpy ( &numNegativeRecs   , data + 24 , 8 );
+	memcpy ( m_lastKey          , data + 32 , m_ks );
+	m_numPositiveRecs = numPositiveRecs;
+	m_numNegativeRecs = numNegativeRecs;
+
+	int32_t slotSize = m_ks + 2;
+	if ( ( ( fileSize - offset ) % slotSize ) != 0 ) {
+		log( LOG_WARN, "db: Had error reading part of map %s: Bad map size.", m_file.getFilename());
+		return false;
+	}
+
+	for ( int32_t seg = 0 ; offset < fileSize ; seg++ ) {
+		int32_t numKeys = (int32_t)std::min ( (int64_t)PAGES_PER_SEGMENT, ( fileSize - offset ) / slotSize );
+
+		if ( numKeys == PAGES_PER_SEGMENT ) {
+			// use it in place. the offsets are 2-byte aligned since
+			// keys are an even number of bytes
+			if ( ! addSegmentPtr ( seg ) ) {
+				return false;
+			}
+			m_keys   [seg] = m_mappedFile.getData() + offset;
+			m_offsets[seg] = (int16_t *)(m_mappedFile.getData() + offset + numKeys * m_ks);
+			m_numSegments++;
+			m_maxNumPages += PAGES_PER_SEGMENT;
+		} else {
+			// the last partial segment is copied so records can be
+			// added to it
+			if ( ! addSegment ( ) ) {
+				return false;
+			}
+			memcpy ( m_keys   [seg] , data + offset , numKeys * m_ks );
+			memcpy ( m_offsets[seg] , data + offset + numKeys * m_ks , numKeys * 2 );
+		}
+
+		offset += numKeys * slotSize;
+		m_numPages += numKeys;
+	}
+
+	logTrace( g_conf.m_logTraceRdbMap, "Mapped %" PRId32" pages from %s", m_numPages, m_file.getFilename());
+
+	return true;
+}
+
 // . add a record to the map
 // . returns false and sets g_errno on error
 // . offset is the current offset of the rdb file where the key/data was added
@@ -1107,7 +1191,22 @@ int64_t RdbMap::getMemAllocated() const {
 	// . each page has a key and a 2 byte offset
 	int64_t space = PAGES_PER_SEGMENT * (m_ks + 2);
 	// how many segments we use * segment allocation
-	return (int64_t)m_numSegments * space;
+	return (int64_t)m_numSegments * space - getMemMapped();
+}
+
+int64_t RdbMap::getMemMapped() const {
+	if ( ! m_mappedFile.isMapped() ) {
+		return 0;
+	}
+
+	int64_t space = PAGES_PER_SEGMENT * (m_ks + 2);
+	int64_t mapped = 0;
+	for ( int32_t i = 0 ; i < m_numSegments ; i++ ) {
+		if ( m_mappedFile.contains(m_keys[i]) ) {
+			mapped += space;
+		}
+	}
+	return mapped;
 }
 
 bool RdbMap::addSegmentPtr ( int32_t n ) {
@@ -1179,6 +1278,11 @@ void RdbMap::reduceMemFootPrint () {
 	 //     m_file.getDir(),
 	 //     m_file.getFilename());
 
+	// a mapped segment doesn't use any memory of its own
+	if ( m_mappedFile.contains(m_keys[0]) ) {
+		return;
+	}
+
 	// seems kinda buggy now..
 	m_reducedMem = true;
 
@@ -1286,8 +1390,10 @@ bool RdbMap::chopHead ( int32_t fileHeadSize ) {
 	int32_t ks = m_ks;
 	// remove segments before segNum
 	for ( int32_t i = 0 ; i < segNum ; i++ ) {
-		mfree ( m_keys   [i] , ks * PAGES_PER_SEGMENT , "RdbMap" );
-		mfree ( m_offsets[i] , 2  * PAGES_PER_SEGMENT , "RdbMap" );
+		if ( ! m_mappedFile.contains(m_keys[i]) ) {
+			mfree ( m_keys   [i] , ks * PAGES_PER_SEGMENT , "RdbMap" );
+			mfree ( m_offsets[i] , 2  * PAGES_PER_SEGMENT , "RdbMap" );
+		}
 		// set to NULL so we know if accessed illegally
 		m_keys   [i] = NULL;
 		m_offsets[i] = NULL;
@@ -15,6 +15,7 @@
 #include <atomic>
 #include "BigFile.h"
 #include "RdbList.h"
+#include "MappedFile.h"
 #include "Sanity.h"
 
 
@@ -240,6 +241,8 @@ class RdbMap {
 	bool readMap     ( BigFile *dataFile );
 	bool readMap2    ( );
 	int64_t readSegment ( int32_t segment, int64_t offset, int32_t fileSize);
+	// like readMap2() but full segments point into the mmap'ed map file
+	bool readMappedMap ( );
 
 	// due to disk corruption keys or offsets can be out of order in map
 	bool verifyMap   ( BigFile *dataFile );
@@ -273,8 +276,10 @@ class RdbMap {
 	// . we must remove our segments
 	bool chopHead (int32_t fileSize );
 
-	// how much mem is being used by this map?
+	// how much mem is being used by this map? (excluding mmap'ed segments)
 	int64_t getMemAllocated() const;
+	// how much of the map is used in place in the mmap'ed map file?
+	int64_t getMemMapped() const;
 
 	// . attempts to auto-generate from data file, f
 	// . returns false and sets g_errno on error
@@ -306,6 +311,12 @@ class RdbMap {
 	int16_t         **m_offsets;
 	int32_t            m_numSegmentOffs;
 
+	// . the map file when loaded with readMappedMap()
+	// . full segments of it are used in place, it's a private mapping so
+	//   fixing keys/offsets in them doesn't change the file
+	// . segments pointing into it must not be freed
+	MappedFile m_mappedFile;
+
 	bool m_reducedMem;
 
 	// number of valid pages in the map.
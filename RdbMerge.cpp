@@ -14,7 +14,10 @@ RdbMerge::RdbMerge()
 	m_isAcquireLockJobSubmited(false),
 	m_isLockAquired(false),
     m_doneMerging(false),
-    m_getListOutstanding(false),
+    m_mergeErrno(0),
+    m_doneReading(false),
+    m_isDumping(false),
+    m_isSleeping(false),
     m_startFileNum(0),
     m_numFiles(0),
     m_fixedDataSize(0),
@@ -22,11 +25,14 @@ RdbMerge::RdbMerge()
     m_targetMap(NULL),
     m_targetIndex(NULL),
 	m_doneRegenerateFiles(false),
+    m_ranges(NULL),
+    m_numRanges(0),
+    m_firstRange(0),
+    m_numRangesUsed(0),
+    m_numRangesRead(0),
     m_isMerging(false),
     m_isHalted(false),
     m_dump(),
-    m_msg5(),
-    m_list(),
     m_niceness(0),
     m_rdbId(RDB_NONE),
     m_collnum(0),
@@ -37,6 +43,19 @@ RdbMerge::RdbMerge()
 
 RdbMerge::~RdbMerge() {
 	delete m_mergeSpaceCoordinator;
+	delete[] m_ranges;
+}
+
+
+RdbMerge::MergeRange::MergeRange()
+  : m_merge(NULL),
+    m_state(state_free),
+    m_errno(0),
+    m_msg5(),
+    m_list()
+{
+	memset(m_startKey, 0, sizeof(m_startKey));
+	memset(m_endKey, 0, sizeof(m_endKey));
 }
 
 
@@ -94,8 +113,14 @@ bool RdbMerge::merge(rdbid_t rdbId,
 	m_niceness        = niceness;
 	m_doneRegenerateFiles = false;
 	m_doneMerging     = false;
+	m_mergeErrno      = 0;
+	m_doneReading     = false;
+	m_isDumping       = false;
+	m_isSleeping      = false;
 	m_ks              = rdb->getKeySize();
 
+	allocRanges();
+
 	// . set the key range we want to retrieve from the files
 	// . just get from the files, not tree (not cache?)
 	KEYMIN(m_startKey,m_ks);
@@ -317,67 +342,93 @@ void RdbMerge::haltMerge() {
 void RdbMerge::doSleep() {
 	log(LOG_WARN, "db: Merge had error: %s. Sleeping and retrying.", mstrerror(g_errno));
 	g_errno = 0;
+	m_isSleeping = true;
 	g_loop.registerSleepCallback(1000, this, tryAgainWrapper, "RdbMerge::tryAgainWrapper");
 }
 
-// . return false if blocked, otherwise true
-// . sets g_errno on error
-bool RdbMerge::resumeMerge() {
-	if(m_isHalted) {
-		return true;
+void RdbMerge::allocRanges() {
+	int32_t numRanges = g_conf.m_mergeParallelRanges;
+	if (numRanges < 1) {
+		numRanges = 1;
 	}
 
-	// the usual loop
-	for (;;) {
-		// . this returns false if blocked, true otherwise
-		// . sets g_errno on error
-		// . we return true if it blocked
-		if (!getNextList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. getNextList blocked. list=%p", &m_list);
-			return false;
-		}
+	if (numRanges != m_numRanges) {
+		delete[] m_ranges;
+		m_ranges = new MergeRange[numRanges];
+		m_numRanges = numRanges;
+	}
 
-		// if g_errno is out of memory then msg3 wasn't able to get the lists
-		// so we should sleep and retry...
-		if (g_errno == ENOMEM) {
-			doSleep();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. out of memory. list=%p", &m_list);
-			return false;
-		}
+	for (int32_t i = 0; i < m_numRanges; i++) {
+		m_ranges[i].m_merge = this;
+		m_ranges[i].m_state = MergeRange::state_free;
+		m_ranges[i].m_errno = 0;
+	}
 
-		// if list is empty or we had an error then we're done
-		if (g_errno || m_doneMerging) {
-			doneMerging();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. error/done merging. list=%p", &m_list);
-			return true;
-		}
+	m_firstRange = 0;
+	m_numRangesUsed = 0;
+	m_numRangesRead = 0;
+}
 
-		// return if this blocked
-		if (!filterList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. filterList blocked. list=%p", &m_list);
-			return false;
+// . pick the end key of a range starting at "startKey" so the range holds
+//   about m_mergeBufSize bytes of the files being merged
+// . the biggest file's map is used as a sample of the key distribution
+// . ranges are split between key pairs, so a positive key and its negative
+//   twin are always merged by the same range and can annihilate
+void RdbMerge::getRangeEndKey(RdbBase *base, const char *startKey, char *endKey) const {
+	KEYSET(endKey, KEYMAX(), m_ks);
+
+	int32_t numFiles = m_numFiles > 0 ? m_numFiles : base->getNumFiles() - m_startFileNum;
+
+	const RdbMap *biggest = NULL;
+	int64_t totalSize = 0;
+	for (int32_t i = m_startFileNum; i < m_startFileNum + numFiles && i < base->getNumFiles(); i++) {
+		const RdbMap *map = base->getMap(i);
+		if (!map) {
+			continue;
+		}
+		totalSize += map->getFileSize();
+		if (!biggest || map->getFileSize() > biggest->getFileSize()) {
+			biggest = map;
 		}
+	}
 
-		// . otherwise dump the list we read to our target file
-		// . this returns false if blocked, true otherwise
-		if (!dumpList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. dumpList blocked. list=%p", &m_list);
-			return false;
+	if (!biggest || biggest->getNumPages() <= 0 || totalSize <= 0) {
+		return;
+	}
+
+	int64_t numPages = (int64_t)biggest->getNumPages() * g_conf.m_mergeBufSize / totalSize;
+	if (numPages < 1) {
+		numPages = 1;
+	}
+
+	for (int64_t page = biggest->getPage(startKey) + numPages; page < biggest->getNumPages(); page++) {
+		// end just before the negative twin of the page key
+		char key[MAX_KEY_BYTES];
+		KEYSET(key, biggest->getKeyPtr(page), m_ks);
+		key[0] &= 0xfe;
+		if (KEYCMP(key, startKey, m_ks) > 0) {
+			KEYSET(endKey, key, m_ks);
+			KEYDEC(endKey, m_ks);
+			return;
 		}
 	}
 }
 
-// . return false if blocked, true otherwise
-// . sets g_errno on error
-bool RdbMerge::getNextList() {
-	// return true if g_errno is set
-	if (g_errno || m_doneMerging) {
-		return true;
+bool RdbMerge::isReading() const {
+	for (int32_t i = 0; i < m_numRanges; i++) {
+		if (m_ranges[i].m_state == MergeRange::state_reading) {
+			return true;
+		}
 	}
+	return false;
+}
 
-	// it's suspended so we count this as blocking
-	if(m_isHalted) {
-		return false;
+// . hand out key ranges to free slots and start reading the ones not read yet
+// . each Msg5 merges its lists on a merge thread, so up to m_numRanges
+//   ranges are merged at once
+void RdbMerge::readRanges() {
+	if (m_isSleeping) {
+		return;
 	}
 
 	// get base, returns NULL and sets g_errno to ENOCOLLREC on error
@@ -386,39 +437,27 @@ bool RdbMerge::getNextList() {
 		// hmmm it doesn't set g_errno so we set it here now
 		// otherwise we do an infinite loop sometimes if a collection
 		// rec is deleted for the collnum
-		g_errno = ENOCOLLREC;
-		return true;
+		m_mergeErrno = ENOCOLLREC;
+		m_doneMerging = true;
+		return;
 	}
 
-	// otherwise, get it now
-	return getAnotherList();
-}
-
-bool RdbMerge::getAnotherList() {
-	logDebug(g_conf.m_logDebugMerge, "db: Getting another list for merge.");
+	while (!m_doneReading && m_numRangesUsed < m_numRanges) {
+		MergeRange *range = &m_ranges[(m_firstRange + m_numRangesUsed) % m_numRanges];
+		KEYSET(range->m_startKey, m_startKey, m_ks);
+		getRangeEndKey(base, m_startKey, range->m_endKey);
+		range->m_state = MergeRange::state_pending;
+		m_numRangesUsed++;
+		m_numRangesRead++;
 
-	// clear it up in case it was already set
-	g_errno = 0;
-
-	// get base, returns NULL and sets g_errno to ENOCOLLREC on error
-	RdbBase *base = getRdbBase(m_rdbId, m_collnum);
-	if (!base) {
-		return true;
+		if (KEYCMP(range->m_endKey, KEYMAX(), m_ks) == 0) {
+			m_doneReading = true;
+		} else {
+			KEYSET(m_startKey, range->m_endKey, m_ks);
+			KEYINC(m_startKey, m_ks);
+		}
 	}
 
-	logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s",
-	         &m_list, KEYSTR(m_startKey, m_ks));
-
-	// . this returns false if blocked, true otherwise
-	// . sets g_errno on error
-	// . we return false if it blocked
-	// . m_maxBufSize may be exceeded by a rec, it's just a target size
-	// . niceness is usually MAX_NICENESS, but reindex.cpp sets to 0
-	// . this was a call to Msg3, but i made it call Msg5 since
-	//   we now do the merging in Msg5, not in msg3 anymore
-	// . this will now handle truncation, dup and neg rec removal
-	// . it remembers last termId and count so it can truncate even when
-	//   IndexList is split between successive reads
 	// . IMPORTANT: when merging titledb we could be merging about 255
 	//   files, so if we are limited to only X fds it can have a cascade
 	//   affect where reading from one file closes the fd of another file
@@ -430,75 +469,151 @@ bool RdbMerge::getAnotherList() {
 	int32_t nn = base->getNumFiles();
 	if ( m_numFiles > 0 && m_numFiles < nn ) nn = m_numFiles;
 
-	int32_t bufSize = g_conf.m_mergeBufSize;
-	// get it
-	m_getListOutstanding = true;
-	bool rc = m_msg5.getList(m_rdbId,
-				 m_collnum,
-				 &m_list,
-				 m_startKey,
-				 KEYMAX(),        // usually is maxed!
-				 bufSize,
-				 false,           // includeTree?
-				 m_startFileNum,  // startFileNum
-				 m_numFiles,
-				 this,            // state
-				 gotListWrapper,  // callback
-				 m_niceness,      // niceness
-				 true,            // do error correction?
-				 nn + 75,         // max retries (mk it high)
-				 true);            // isRealMerge? absolutely!
-	if(rc)
-		m_getListOutstanding = false;
-	return rc;
-	
-}
+	// . getRangeEndKey() only samples the biggest file, so a range can
+	//   still be big in the other files. cap each read so the ranges
+	//   held at once stay within the merge buffer size
+	// . dumpedList() continues a truncated range from the list's end key
+	int32_t bufSize = g_conf.m_mergeBufSize / m_numRanges;
+	if (bufSize < 1) {
+		bufSize = 1;
+	}
 
-void RdbMerge::gotListWrapper(void *state, RdbList * /*list*/, Msg5 * /*msg5*/) {
-	// get a ptr to ourselves
-	RdbMerge *THIS = (RdbMerge *)state;
+	for (int32_t i = 0; i < m_numRangesUsed; i++) {
+		MergeRange *range = &m_ranges[(m_firstRange + i) % m_numRanges];
+		if (range->m_state != MergeRange::state_pending) {
+			continue;
+		}
+
+		logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s endKey=%s",
+		         &range->m_list, KEYSTR(range->m_startKey, m_ks), KEYSTR(range->m_endKey, m_ks));
 
-	logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s",
-	         &(THIS->m_list), KEYSTR(THIS->m_startKey, THIS->m_ks));
+		// clear it up in case it was already set
+		g_errno = 0;
+
+		// . this returns false if blocked, true otherwise
+		// . sets g_errno on error
+		// . this will now handle truncation, dup and neg rec removal
+		range->m_state = MergeRange::state_reading;
+		if (range->m_msg5.getList(m_rdbId,
+		                          m_collnum,
+		                          &range->m_list,
+		                          range->m_startKey,
+		                          range->m_endKey,
+		                          bufSize,         // minRecSizes
+		                          false,           // includeTree?
+		                          m_startFileNum,  // startFileNum
+		                          m_numFiles,
+		                          range,           // state
+		                          gotListWrapper,  // callback
+		                          m_niceness,      // niceness
+		                          true,            // do error correction?
+		                          nn + 75,         // max retries (mk it high)
+		                          true)) {         // isRealMerge? absolutely!
+			range->m_state = MergeRange::state_read;
+			range->m_errno = g_errno;
+		}
+	}
 
-	THIS->m_getListOutstanding = false;
+	g_errno = 0;
+}
 
+// . return false if blocked, otherwise true
+// . sets g_errno on error
+bool RdbMerge::resumeMerge() {
+	// the usual loop
 	for (;;) {
+		if (m_isHalted) {
+			return true;
+		}
+
+		// tryAgainWrapper() will call us
+		if (m_isSleeping) {
+			logTrace(g_conf.m_logTraceRdbMerge, "END. sleeping");
+			return false;
+		}
+
+		if (!m_doneMerging) {
+			readRanges();
+		}
+
+		// all ranges dumped?
+		if (!m_doneMerging && m_numRangesUsed == 0) {
+			m_doneMerging = true;
+		}
+
+		// wait for outstanding reads before ending the merge, their
+		// Msg5 and lists are freed by doneMerging()
+		if (m_doneMerging) {
+			if (isReading()) {
+				logTrace(g_conf.m_logTraceRdbMerge, "END. waiting for reads before ending merge");
+				return false;
+			}
+			g_errno = m_mergeErrno;
+			doneMerging();
+			logTrace(g_conf.m_logTraceRdbMerge, "END. error/done merging");
+			return true;
+		}
+
+		MergeRange *range = getFirstRange();
+		if (range->m_state != MergeRange::state_read) {
+			logTrace(g_conf.m_logTraceRdbMerge, "END. waiting for list=%p", &range->m_list);
+			return false;
+		}
+
 		// if g_errno is out of memory then msg3 wasn't able to get the lists
-		// so we should sleep and retry
-		if (g_errno == ENOMEM) {
-			THIS->doSleep();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. out of memory. list=%p", &THIS->m_list);
-			return;
+		// so we should sleep and retry...
+		if (range->m_errno == ENOMEM) {
+			range->m_state = MergeRange::state_pending;
+			g_errno = range->m_errno;
+			doSleep();
+			logTrace(g_conf.m_logTraceRdbMerge, "END. out of memory. list=%p", &range->m_list);
+			return false;
 		}
 
-		// if g_errno we're done
-		if (g_errno || THIS->m_doneMerging) {
-			THIS->doneMerging();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. error/done merging. list=%p", &THIS->m_list);
-			return;
+		if (range->m_errno) {
+			m_mergeErrno = range->m_errno;
+			m_doneMerging = true;
+			continue;
 		}
 
 		// return if this blocked
-		if (!THIS->filterList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. filterList blocked. list=%p", &THIS->m_list);
-			return;
+		if (!filterList()) {
+			logTrace(g_conf.m_logTraceRdbMerge, "END. filterList blocked. list=%p", &range->m_list);
+			return false;
 		}
 
-		// return if this blocked
-		if (!THIS->dumpList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. dumpList blocked. list=%p", &THIS->m_list);
-			return;
+		// . otherwise dump the list we read to our target file
+		// . this returns false if blocked, true otherwise
+		if (!dumpList()) {
+			logTrace(g_conf.m_logTraceRdbMerge, "END. dumpList blocked. list=%p", &range->m_list);
+			return false;
 		}
 
-		// return if this blocked
-		if (!THIS->getNextList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. getNextList blocked. list=%p", &THIS->m_list);
-			return;
+		if (!dumpedList()) {
+			logTrace(g_conf.m_logTraceRdbMerge, "END. sleeping after dump. list=%p", &range->m_list);
+			return false;
 		}
+	}
+}
+
+void RdbMerge::gotListWrapper(void *state, RdbList * /*list*/, Msg5 * /*msg5*/) {
+	MergeRange *range = static_cast<MergeRange*>(state);
+	RdbMerge *THIS = range->m_merge;
 
-		// otherwise, keep on trucking
+	logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s endKey=%s",
+	         &range->m_list, KEYSTR(range->m_startKey, THIS->m_ks), KEYSTR(range->m_endKey, THIS->m_ks));
+
+	range->m_state = MergeRange::state_read;
+	range->m_errno = g_errno;
+	g_errno = 0;
+
+	// the first range is being dumped or we are sleeping. we'll get to
+	// this list when that is done
+	if (THIS->m_isDumping || THIS->m_isSleeping) {
+		return;
 	}
+
+	THIS->resumeMerge();
 }
 
 // called after sleeping for 1 sec because of ENOMEM
@@ -508,32 +623,31 @@ void RdbMerge::tryAgainWrapper(int /*fd*/, void *state) {
 
 	// unregister the sleep callback
 	g_loop.unregisterSleepCallback(THIS, tryAgainWrapper);
+	THIS->m_isSleeping = false;
 
 	// clear this
 	g_errno = 0;
 
-	// return if this blocked
-	if (!THIS->getNextList()) {
-		logTrace(g_conf.m_logTraceRdbMerge, "END. getNextList blocked. list=%p", &THIS->m_list);
+	if (THIS->m_isDumping) {
 		return;
 	}
 
-	// if this didn't block do the loop
-	gotListWrapper(THIS, NULL, NULL);
+	THIS->resumeMerge();
 }
 
 void RdbMerge::filterListWrapper(void *state) {
 	RdbMerge *THIS = (RdbMerge *)state;
+	RdbList *list = &THIS->getFirstRange()->m_list;
 
-	logTrace(g_conf.m_logTraceRdbMerge, "BEGIN. list=%p m_startKey=%s", &THIS->m_list, KEYSTR(THIS->m_startKey, THIS->m_ks));
+	logTrace(g_conf.m_logTraceRdbMerge, "BEGIN. list=%p", list);
 
 	if (THIS->m_rdbId == RDB_SPIDERDB) {
-		dedupSpiderdbList(&(THIS->m_list));
+		dedupSpiderdbList(list);
 	} else if (THIS->m_rdbId == RDB_TITLEDB) {
-//		filterTitledbList(&(THIS->m_list));
+//		filterTitledbList(list);
 	}
 
-	logTrace(g_conf.m_logTraceRdbMerge, "END. list=%p", &THIS->m_list);
+	logTrace(g_conf.m_logTraceRdbMerge, "END. list=%p", list);
 }
 
 // similar to gotListWrapper but we call dumpList() before dedupList()
@@ -541,69 +655,38 @@ void RdbMerge::filterDoneWrapper(void *state, job_exit_t exit_type) {
 	// get a ptr to ourselves
 	RdbMerge *THIS = (RdbMerge *)state;
 
-	logTrace(g_conf.m_logTraceRdbMerge, "BEGIN. list=%p m_startKey=%s", &THIS->m_list, KEYSTR(THIS->m_startKey, THIS->m_ks));
+	logTrace(g_conf.m_logTraceRdbMerge, "BEGIN. list=%p", &THIS->getFirstRange()->m_list);
 
-	for (;;) {
-		// return if this blocked
-		if (!THIS->dumpList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. dumpList blocked. list=%p", &THIS->m_list);
-			return;
-		}
+	THIS->m_isDumping = false;
 
-		// return if this blocked
-		if (!THIS->getNextList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. getNextList blocked. list=%p", &THIS->m_list);
-			return;
-		}
-
-		// if g_errno is out of memory then msg3 wasn't able to get the lists
-		// so we should sleep and retry
-		if (g_errno == ENOMEM) {
-			THIS->doSleep();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. out of memory. list=%p", &THIS->m_list);
-			return;
-		}
-
-		// if g_errno we're done
-		if (g_errno || THIS->m_doneMerging) {
-			THIS->doneMerging();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. error/done merging. list=%p", &THIS->m_list);
-			return;
-		}
+	if (THIS->m_isHalted) {
+		return;
+	}
 
-		// return if this blocked
-		if (!THIS->filterList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. filterList blocked. list=%p", &THIS->m_list);
-			return;
-		}
+	// return if this blocked
+	if (!THIS->dumpList()) {
+		logTrace(g_conf.m_logTraceRdbMerge, "END. dumpList blocked. list=%p", &THIS->getFirstRange()->m_list);
+		return;
+	}
 
-		// otherwise, keep on trucking
+	if (!THIS->dumpedList()) {
+		return;
 	}
+
+	THIS->resumeMerge();
 }
 
 bool RdbMerge::filterList() {
-	// return true on g_errno
-	if (g_errno) {
-		return true;
-	}
-
 	// . it's suspended so we count this as blocking
-	// . resumeMerge() will call getNextList() again, not dumpList() so
-	//   don't advance m_startKey
+	// . resumeMerge() will start over with the same range
 	if(m_isHalted) {
 		return false;
 	}
 
-	// if we use getLastKey() for this the merge completes but then
-	// tries to merge two empty lists and cores in the merge function
-	// because of that. i guess it relies on endkey rollover only and
-	// not on reading less than minRecSizes to determine when to stop
-	// doing the merge.
-	m_list.getEndKey(m_startKey) ;
-	KEYINC(m_startKey,m_ks);
+	RdbList *list = &getFirstRange()->m_list;
 
-	logTrace(g_conf.m_logTraceRdbMerge, "listEndKey=%s startKey=%s",
-	         KEYSTR(m_list.getEndKey(), m_list.getKeySize()), KEYSTR(m_startKey, m_ks));
+	logTrace(g_conf.m_logTraceRdbMerge, "listStartKey=%s listEndKey=%s",
+	         KEYSTR(list->getStartKey(), list->getKeySize()), KEYSTR(list->getEndKey(), list->getKeySize()));
 
 	/////
 	//
@@ -611,17 +694,19 @@ bool RdbMerge::filterList() {
 	//
 	/////
 	if (m_rdbId == RDB_SPIDERDB || m_rdbId == RDB_TITLEDB) {
+		m_isDumping = true;
 		if (g_jobScheduler.submit(filterListWrapper, filterDoneWrapper, this, thread_type_merge_filter, 0)) {
 			return false;
 		}
+		m_isDumping = false;
 
 		log(LOG_WARN, "db: Unable to submit job for merge filter. Will run in main thread");
 
 		// fall back to filter without thread
 		if (m_rdbId == RDB_SPIDERDB) {
-			dedupSpiderdbList(&m_list);
+			dedupSpiderdbList(list);
 		} else {
-//			filterTitledbList(&m_list);
+//			filterTitledbList(list);
 		}
 	}
 
@@ -636,57 +721,19 @@ void RdbMerge::dumpListWrapper(void *state) {
 	// get a ptr to ourselves
 	RdbMerge *THIS = (RdbMerge *)state;
 
-	logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s",
-	         &(THIS->m_list), KEYSTR(THIS->m_startKey, THIS->m_ks));
-
-	for (;;) {
-		// collection reset or deleted while RdbDump.cpp was writing out?
-		if (g_errno == ENOCOLLREC) {
-			THIS->doneMerging();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. error/done merging. list=%p", &THIS->m_list);
-			return;
-		}
-		// return if this blocked
-		if (!THIS->getNextList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. getNextList blocked. list=%p", &THIS->m_list);
-			return;
-		}
-
-		// if g_errno is out of memory then msg3 wasn't able to get the lists
-		// so we should sleep and retry
-		if (g_errno == ENOMEM) {
-			// if the dump failed, it should reset m_dump.m_offset of
-			// the file to what it was originally (in case it failed
-			// in adding the list to the map). we do not need to set
-			// m_startKey back to the startkey of this list, because
-			// it is *now* only advanced on successful dump!!
-			THIS->doSleep();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. out of memory. list=%p", &THIS->m_list);
-			return;
-		}
-
-		// . if g_errno we're done
-		// . if list is empty we're done
-		if (g_errno || THIS->m_doneMerging) {
-			THIS->doneMerging();
-			logTrace(g_conf.m_logTraceRdbMerge, "END. error/done merging. list=%p", &THIS->m_list);
-			return;
-		}
+	logTrace(g_conf.m_logTraceRdbMerge, "list=%p", &THIS->getFirstRange()->m_list);
 
-		// return if this blocked
-		if (!THIS->filterList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. filterList blocked. list=%p", &THIS->m_list);
-			return;
-		}
+	THIS->m_isDumping = false;
 
-		// return if this blocked
-		if (!THIS->dumpList()) {
-			logTrace(g_conf.m_logTraceRdbMerge, "END. dumpList blocked. list=%p", &THIS->m_list);
-			return;
-		}
+	if (THIS->m_isHalted) {
+		return;
+	}
 
-		// otherwise, keep on trucking
+	if (!THIS->dumpedList()) {
+		return;
 	}
+
+	THIS->resumeMerge();
 }
 
 // . return false if blocked, true otherwise
@@ -694,15 +741,12 @@ void RdbMerge::dumpListWrapper(void *state) {
 // . list should be truncated, possible have all negative keys removed,
 //   and de-duped thanks to RdbList::indexMerge_r() and RdbList::merge_r()
 bool RdbMerge::dumpList() {
-	// if the startKey rolled over we're done
-	if (KEYCMP(m_startKey, KEYMIN(), m_ks) == 0) {
-		m_doneMerging = true;
-	}
-
 	logDebug(g_conf.m_logDebugMerge, "db: Dumping list.");
 
-	logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s",
-	         &m_list, KEYSTR(m_startKey, m_ks));
+	MergeRange *range = getFirstRange();
+
+	logTrace(g_conf.m_logTraceRdbMerge, "list=%p startKey=%s endKey=%s",
+	         &range->m_list, KEYSTR(range->m_startKey, m_ks), KEYSTR(range->m_endKey, m_ks));
 
 	// . send the whole list to the dump
 	// . it returns false if blocked, true otherwise
@@ -710,7 +754,52 @@ bool RdbMerge::dumpList() {
 	// . it calls dumpListWrapper when done dumping
 	// . return true if m_dump had an error or it did not block
 	// . if it gets a EFILECLOSED error it will keep retrying forever
-	return m_dump.dumpList(&m_list);
+	m_isDumping = true;
+	if (!m_dump.dumpList(&range->m_list)) {
+		return false;
+	}
+	m_isDumping = false;
+	return true;
+}
+
+// . the first range was dumped (or failed to). g_errno is set on error
+// . the range slot is handed to the next range on success, or the rest
+//   of the range is read again if the list was truncated
+// . returns false if we are sleeping after ENOMEM, tryAgainWrapper() will
+//   resume the merge
+bool RdbMerge::dumpedList() {
+	if (g_errno == ENOMEM) {
+		// if the dump failed, it should reset m_dump.m_offset of
+		// the file to what it was originally (in case it failed
+		// in adding the list to the map). the list is dumped again
+		// after sleeping
+		doSleep();
+		return false;
+	}
+
+	// . collection reset or deleted while RdbDump.cpp was writing out?
+	// . any other error ends the merge
+	if (g_errno) {
+		m_mergeErrno = g_errno;
+		m_doneMerging = true;
+		g_errno = 0;
+		return true;
+	}
+
+	MergeRange *range = getFirstRange();
+
+	// list was truncated by minRecSizes. read the rest of the range
+	if (KEYCMP(range->m_list.getEndKey(), range->m_endKey, m_ks) < 0) {
+		range->m_list.getEndKey(range->m_startKey);
+		KEYINC(range->m_startKey, m_ks);
+		range->m_state = MergeRange::state_pending;
+		return true;
+	}
+
+	range->m_state = MergeRange::state_free;
+	m_firstRange = (m_firstRange + 1) % m_numRanges;
+	m_numRangesUsed--;
+	return true;
 }
 
 void RdbMerge::doneMerging() {
@@ -720,17 +809,22 @@ void RdbMerge::doneMerging() {
 	// let RdbDump free its m_verifyBuf buffer if it existed
 	m_dump.reset();
 
-	// . free the list's memory, reset() doesn't do it
-	// . when merging titledb i'm still seeing 200MB allocs to read from tfndb.
-	m_list.freeList();
+	for (int32_t i = 0; i < m_numRanges; i++) {
+		// . free the list's memory, reset() doesn't do it
+		// . when merging titledb i'm still seeing 200MB allocs to read from tfndb.
+		m_ranges[i].m_list.freeList();
 
-	log(LOG_INFO,"db: Merge status: %s.",mstrerror(g_errno));
+		// . reset our class
+		// . this will free it's cutoff keys buffer, trash buffer, treelist
+		// . TODO: should we not reset to keep the mem handy for next time
+		//   to help avoid out of mem errors?
+		m_ranges[i].m_msg5.reset();
 
-	// . reset our class
-	// . this will free it's cutoff keys buffer, trash buffer, treelist
-	// . TODO: should we not reset to keep the mem handy for next time
-	//   to help avoid out of mem errors?
-	m_msg5.reset();
+		m_ranges[i].m_state = MergeRange::state_free;
+	}
+	m_numRangesUsed = 0;
+
+	log(LOG_INFO,"db: Merge status: %s.",mstrerror(g_errno));
 
 	// if collection rec was deleted while merging files for it
 	// then the rdbbase should be NULL i guess.
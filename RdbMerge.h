@@ -56,6 +56,9 @@ public:
 
 	bool isMerging() const { return m_isMerging; }
 
+	// number of key ranges the last merge was split into so far
+	int32_t getNumRangesRead() const { return m_numRangesRead; }
+
 	// stop further actions
 	void haltMerge();
 
@@ -77,10 +80,42 @@ private:
 	static void gotListWrapper(void *state, RdbList *list, Msg5 *msg5);
 	static void tryAgainWrapper(int fd, void *state);
 
+	// . a key range of the files being merged
+	// . several ranges are read and merged at the same time (the merge
+	//   itself runs on the merge threads) and dumped in key order
+	struct MergeRange {
+		MergeRange();
+
+		enum State {
+			state_free,
+			state_pending, // key range set, read not started
+			state_reading,
+			state_read
+		};
+
+		RdbMerge *m_merge;
+		State m_state;
+		int32_t m_errno;
+
+		// key range of the list
+		char m_startKey[MAX_KEY_BYTES];
+		char m_endKey[MAX_KEY_BYTES];
+
+		// a Msg5 for getting RdbLists from disk/cache
+		Msg5 m_msg5;
+
+		RdbList m_list;
+	};
+
+	void allocRanges();
+	void getRangeEndKey(RdbBase *base, const char *startKey, char *endKey) const;
+	void readRanges();
+	bool isReading() const;
+	MergeRange *getFirstRange() { return &m_ranges[m_firstRange]; }
+
 	bool filterList();
 	bool dumpList();
-	bool getNextList();
-	bool getAnotherList();
+	bool dumpedList();
 	void doneMerging();
 
 	// . return false and sets errno on error merging
@@ -101,10 +136,19 @@ private:
 	std::atomic<bool> m_isAcquireLockJobSubmited;
 	bool m_isLockAquired;
 
-	// set to true when m_startKey wraps back to 0
+	// set when all ranges are dumped or we had an error. the merge ends
+	// once the outstanding reads are done
 	bool m_doneMerging;
+	int32_t m_mergeErrno;
+
+	// set when the range ending at KEYMAX has been handed out
+	bool m_doneReading;
+
+	// filtering or dumping the first range
+	bool m_isDumping;
 
-	bool m_getListOutstanding;
+	// sleeping after ENOMEM
+	bool m_isSleeping;
 
 	uint64_t m_spaceNeededForMerge;
 	// . we get the units from the master and the mergees from the units
@@ -117,19 +161,22 @@ private:
 	RdbIndex *m_targetIndex;
 	bool m_doneRegenerateFiles;
 
+	// start of the next range to read
 	char m_startKey[MAX_KEY_BYTES];
 
+	// ring of ranges. m_firstRange is the next one to dump
+	MergeRange *m_ranges;
+	int32_t m_numRanges;
+	int32_t m_firstRange;
+	int32_t m_numRangesUsed;
+	int32_t m_numRangesRead;
+
 	bool m_isMerging;
 	bool m_isHalted;
 
 	// for writing to target file
 	RdbDump m_dump;
 
-	// a Msg5 for getting RdbLists from disk/cache
-	Msg5 m_msg5;
-
-	RdbList m_list;
-
 	int32_t m_niceness;
 
 	// for getting the RdbBase class doing the merge
@@ -6,29 +6,29 @@
 
 RobotRule::RobotRule( bool isAllow, const char *path, int32_t pathLen )
 	: m_isAllow( isAllow )
-	, m_path( path )
+	, m_path()
 	, m_pathLen( pathLen )
-	, m_pathNormalized()
 	, m_wildcardFound( false )
 	, m_wildcardCount( 0 )
-	, m_lineAnchorFound( ( m_path[ m_pathLen - 1] == '$' ) ) {
+	, m_lineAnchorFound( ( path[ pathLen - 1] == '$' ) ) {
 	if ( !m_lineAnchorFound ) {
 		// strip ending asterisk
-		while ( m_pathLen > 0 && m_path[m_pathLen - 1] == '*' ) {
+		while ( m_pathLen > 0 && path[m_pathLen - 1] == '*' ) {
 			--m_pathLen;
 		}
 	}
 
-	const char *asteriskPos = static_cast<const char*>( memchr( m_path, '*', m_pathLen ) );
+	const char *asteriskPos = static_cast<const char*>( memchr( path, '*', m_pathLen ) );
 	if ( asteriskPos != NULL ) {
 		m_wildcardFound = true;
-		m_wildcardCount = std::count( asteriskPos, m_path + m_pathLen, '*');
+		m_wildcardCount = std::count( asteriskPos, path + m_pathLen, '*');
 	}
 
-	const char *percentPos = static_cast<const char*>( memchr( m_path, '%', m_pathLen ) );
+	m_path.assign( path, m_pathLen );
+
+	const char *percentPos = static_cast<const char*>( memchr( path, '%', m_pathLen ) );
 	if ( percentPos != NULL ) {
-		m_pathNormalized = std::string( m_path, m_pathLen );
-		UrlComponent::normalize( &m_pathNormalized );
+		UrlComponent::normalize( &m_path );
 	}
 }
 
@@ -88,8 +88,8 @@ static bool matchWildcard( const char *haystack, int32_t haystackLen, const char
 }
 
 bool RobotRule::isMatching( Url *url ) const {
-	const char *path = m_pathNormalized.empty() ? m_path : m_pathNormalized.c_str();
-	int32_t pathLen = m_pathNormalized.empty() ? m_pathLen : m_pathNormalized.size();
+	const char *path = m_path.c_str();
+	int32_t pathLen = m_path.size();
 
 	if ( m_wildcardFound ) {
 		return matchWildcard( url->getPath(), url->getPathLenWithCgi(), path, pathLen, m_lineAnchorFound );
@@ -116,8 +116,8 @@ void RobotRule::print( int level ) const {
 	// 2 space indentation per level
 	level *= 2;
 
-	const char *path = m_pathNormalized.empty() ? m_path : m_pathNormalized.c_str();
-	int32_t pathLen = m_pathNormalized.empty() ? m_pathLen : m_pathNormalized.size();
+	const char *path = m_path.c_str();
+	int32_t pathLen = m_path.size();
 
 	logf( LOG_DEBUG, "%*s RobotRule: type=%s wildcardFound=%d wildcardCount=%d lineAnchorFound=%d path=%.*s", level, "",
 	      m_isAllow ? "allow" : "disallow", m_wildcardFound, m_wildcardCount, m_lineAnchorFound, pathLen, path );
@@ -20,14 +20,24 @@ public:
 		return m_pathLen;
 	}
 
+	// path to match (normalized if it had percent encoding)
+	const std::string& getPath() const {
+		return m_path;
+	}
+
+	// a rule with a wildcard or a line anchor is not a simple prefix
+	bool isPrefix() const {
+		return ( !m_wildcardFound && !m_lineAnchorFound );
+	}
+
 	void print( int level = 0 ) const;
 
 private:
 	bool m_isAllow;
 
-	const char *m_path;
+	// we keep our own copy so parsed rules can outlive the robots.txt
+	std::string m_path;
 	int32_t m_pathLen;
-	std::string m_pathNormalized;
 
 	bool m_wildcardFound;
 	int32_t m_wildcardCount;
@@ -3,9 +3,14 @@
 #include "fctypes.h"
 #include "Log.h"
 #include "Conf.h"
+#include "GbCache.h"
+#include "hash.h"
 #include <functional>
 #include <algorithm>
 
+// parsed robots.txt keyed by hash of content & user agent
+static GbCache<uint64_t, std::shared_ptr<const Robots>> s_cache;
+
 Robots::Robots( const char *robotsTxt, int32_t robotsTxtLen, const char *userAgent )
 	: m_robotsTxt( robotsTxt )
 	, m_robotsTxtLen( robotsTxtLen )
@@ -23,6 +28,37 @@ Robots::Robots( const char *robotsTxt, int32_t robotsTxtLen, const char *userAge
 		// parse robots.txt into what we need
 		parse();
 	}
+
+	buildMatcher();
+}
+
+std::shared_ptr<const Robots> Robots::getRobots( const char *robotsTxt, int32_t robotsTxtLen, const char *userAgent ) {
+	uint64_t key = hash64( robotsTxt, robotsTxtLen, hash64n( userAgent ) );
+	key = hash64( key, static_cast<uint64_t>( robotsTxtLen ) );
+
+	std::shared_ptr<const Robots> robots;
+	if ( s_cache.lookup( key, &robots ) ) {
+		return robots;
+	}
+
+	Robots *newRobots = new Robots( robotsTxt, robotsTxtLen, userAgent );
+
+	// rules have their own copy of the path, so we don't need the buffer anymore
+	newRobots->m_robotsTxt = NULL;
+	newRobots->m_robotsTxtLen = 0;
+
+	robots.reset( newRobots );
+	s_cache.insert( key, robots );
+
+	return robots;
+}
+
+void Robots::initializeSettings() {
+	s_cache.configure( g_conf.m_robotsCacheMaxAge * 1000, g_conf.m_robotsCacheSize, g_conf.m_logTraceRobots, "robots cache" );
+}
+
+void Robots::clearCache() {
+	s_cache.clear();
 }
 
 bool Robots::getNextLine() {
@@ -333,29 +369,111 @@ void Robots::parse() {
 	}
 }
 
-bool Robots::isAllowed( Url *url ) {
-	int64_t startTime = 0;
-	if ( g_conf.m_logTimingRobots ) {
-		startTime = gettimeofdayInMilliseconds();
+const std::vector<RobotRule>* Robots::getRules() const {
+	if ( m_userAgentFound ) {
+		return &m_rules;
+	} else if ( m_defaultUserAgentFound ) {
+		return &m_defaultRules;
 	}
 
-	std::vector<RobotRule> *rules = NULL;
+	return NULL;
+}
 
-	if ( m_userAgentFound ) {
-		rules = &m_rules;
-	} else if ( m_defaultUserAgentFound ) {
-		rules = &m_defaultRules;
+void Robots::buildMatcher() {
+	m_matchNodes.clear();
+	m_patternRules.clear();
+
+	// root node
+	MatchNode root = { -1, -1, -1, '\0' };
+	m_matchNodes.push_back( root );
+
+	const std::vector<RobotRule> *rules = getRules();
+	if ( !rules ) {
+		return;
+	}
+
+	for ( int32_t i = 0; i < static_cast<int32_t>( rules->size() ); ++i ) {
+		const RobotRule &rule = (*rules)[i];
+		if ( !rule.isPrefix() ) {
+			m_patternRules.push_back( i );
+			continue;
+		}
+
+		const std::string &path = rule.getPath();
+
+		int32_t node = 0;
+		for ( std::string::const_iterator it = path.begin(); it != path.end(); ++it ) {
+			int32_t child = m_matchNodes[node].m_firstChild;
+			while ( child >= 0 && m_matchNodes[child].m_c != *it ) {
+				child = m_matchNodes[child].m_nextSibling;
+			}
+
+			if ( child < 0 ) {
+				MatchNode newNode = { -1, m_matchNodes[node].m_firstChild, -1, *it };
+				child = static_cast<int32_t>( m_matchNodes.size() );
+				m_matchNodes.push_back( newNode );
+				m_matchNodes[node].m_firstChild = child;
+			}
+
+			node = child;
+		}
+
+		// rules are sorted, so the first rule ending here wins
+		if ( m_matchNodes[node].m_ruleIndex < 0 ) {
+			m_matchNodes[node].m_ruleIndex = i;
+		}
+	}
+}
+
+bool Robots::isAllowed( Url *url ) const {
+	int64_t startTime = 0;
+	if ( g_conf.m_logTimingRobots ) {
+		startTime = gettimeofdayInMilliseconds();
 	}
 
 	// default allow
 	bool isAllowed = true;
 
+	const std::vector<RobotRule> *rules = getRules();
 	if ( rules ) {
-		for ( std::vector<RobotRule>::const_iterator it = rules->begin(); it != rules->end(); ++it ) {
-			if ( it->isMatching( url ) ) {
-				isAllowed = it->isAllow();
+		// same result as matching the sorted rules one by one: the lowest matching rule index wins
+		int32_t bestRule = m_matchNodes[0].m_ruleIndex;
+
+		const char *path = url->getPath();
+		int32_t pathLen = url->getPathLenWithCgi();
+
+		int32_t node = 0;
+		for ( int32_t i = 0; i < pathLen; ++i ) {
+			int32_t child = m_matchNodes[node].m_firstChild;
+			while ( child >= 0 && m_matchNodes[child].m_c != path[i] ) {
+				child = m_matchNodes[child].m_nextSibling;
+			}
+
+			if ( child < 0 ) {
+				break;
+			}
+
+			node = child;
+
+			int32_t ruleIndex = m_matchNodes[node].m_ruleIndex;
+			if ( ruleIndex >= 0 && ( bestRule < 0 || ruleIndex < bestRule ) ) {
+				bestRule = ruleIndex;
+			}
+		}
+
+		for ( std::vector<int32_t>::const_iterator it = m_patternRules.begin(); it != m_patternRules.end(); ++it ) {
+			if ( bestRule >= 0 && *it > bestRule ) {
 				break;
 			}
+
+			if ( (*rules)[*it].isMatching( url ) ) {
+				bestRule = *it;
+				break;
+			}
+		}
+
+		if ( bestRule >= 0 ) {
+			isAllowed = (*rules)[bestRule].isAllow();
 		}
 	}
 
@@ -372,7 +490,7 @@ bool Robots::isAllowed( Url *url ) {
 	return isAllowed;
 }
 
-int32_t Robots::getCrawlDelay() {
+int32_t Robots::getCrawlDelay() const {
 	int32_t crawlDelay = -1;
 
 	if ( m_userAgentFound ) {
@@ -390,7 +508,7 @@ int32_t Robots::getCrawlDelay() {
 
 void Robots::print() const {
 	logf( LOG_DEBUG, "############ Robots ############");
-	logf( LOG_DEBUG, "Robots::m_robotsTxt\n%.*s", m_robotsTxtLen, m_robotsTxt );
+	logf( LOG_DEBUG, "Robots::m_robotsTxt\n%.*s", m_robotsTxtLen, m_robotsTxt ? m_robotsTxt : "" );
 	logf( LOG_DEBUG, "Robots::m_userAgent='%.*s'", m_userAgentLen, m_userAgent );
 	logf( LOG_DEBUG, "Robots::m_userAgentFound=%s", m_userAgentFound ? "true" : "false" );
 	logf( LOG_DEBUG, "Robots::m_crawlDelay=%d", m_crawlDelay );
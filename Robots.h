@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <memory>
 #include "RobotRule.h"
 
 class Url;
@@ -11,8 +12,14 @@ class Robots {
 public:
 	Robots( const char* robotsTxt, int32_t robotsTxtLen, const char *userAgent );
 
-	bool isAllowed( Url *url );
-	int32_t getCrawlDelay();
+	// parsed robots.txt shared between docs. robots.txt of a site is fetched for every url we spider,
+	// so we look up the parsed rules by content instead of parsing it again
+	static std::shared_ptr<const Robots> getRobots( const char *robotsTxt, int32_t robotsTxtLen, const char *userAgent );
+	static void initializeSettings();
+	static void clearCache();
+
+	bool isAllowed( Url *url ) const;
+	int32_t getCrawlDelay() const;
 
 	void print() const;
 
@@ -41,6 +48,9 @@ private:
 	bool parseAllow( const char *field, int32_t fieldLen, bool isUserAgent );
 	bool parseDisallow( const char *field, int32_t fieldLen, bool isUserAgent );
 
+	const std::vector<RobotRule>* getRules() const;
+	void buildMatcher();
+
 	const char *m_robotsTxt;
 	int32_t m_robotsTxtLen;
 
@@ -60,6 +70,19 @@ private:
 
 	std::vector<RobotRule> m_rules;
 	std::vector<RobotRule> m_defaultRules;
+
+	// . plain prefix rules of the effective rule set are merged into a trie so we only walk the url path once
+	// . every node has the lowest rule index (longest path) ending there. rules with wildcard/line anchor are
+	//   matched one by one, but only the ones sorted before the best prefix match
+	struct MatchNode {
+		int32_t m_firstChild;
+		int32_t m_nextSibling;
+		int32_t m_ruleIndex;
+		char m_c;
+	};
+
+	std::vector<MatchNode> m_matchNodes;
+	std::vector<int32_t> m_patternRules;
 };
 
 #endif // GB_ROBOTS_H
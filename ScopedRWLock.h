@@ -0,0 +1,62 @@
+#ifndef SCOPED_RWLOCK_H_
+#define SCOPED_RWLOCK_H_
+
+#include "GbRWLock.h"
+#include <pthread.h>
+#include <assert.h>
+
+//small scoped shared lock on reader/writer locks
+class ScopedReadLock {
+	pthread_rwlock_t &rwlock;
+	bool locked;
+	ScopedReadLock(const ScopedReadLock&);
+	ScopedReadLock& operator=(const ScopedReadLock&);
+public:
+	ScopedReadLock(GbRWLock &l)
+	  : rwlock(l.rwlock), locked(true)
+	{
+		int rc = pthread_rwlock_rdlock(&rwlock);
+		assert(rc==0);
+	}
+	~ScopedReadLock() {
+		if(locked) {
+			int rc = pthread_rwlock_unlock(&rwlock);
+			assert(rc==0);
+		}
+	}
+	void unlock() {
+		assert(locked);
+		int rc = pthread_rwlock_unlock(&rwlock);
+		assert(rc==0);
+		locked = false;
+	}
+};
+
+//small scoped exclusive lock on reader/writer locks
+class ScopedWriteLock {
+	pthread_rwlock_t &rwlock;
+	bool locked;
+	ScopedWriteLock(const ScopedWriteLock&);
+	ScopedWriteLock& operator=(const ScopedWriteLock&);
+public:
+	ScopedWriteLock(GbRWLock &l)
+	  : rwlock(l.rwlock), locked(true)
+	{
+		int rc = pthread_rwlock_wrlock(&rwlock);
+		assert(rc==0);
+	}
+	~ScopedWriteLock() {
+		if(locked) {
+			int rc = pthread_rwlock_unlock(&rwlock);
+			assert(rc==0);
+		}
+	}
+	void unlock() {
+		assert(locked);
+		int rc = pthread_rwlock_unlock(&rwlock);
+		assert(rc==0);
+		locked = false;
+	}
+};
+
+#endif
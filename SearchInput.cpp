@@ -235,11 +235,19 @@ bool SearchInput::set ( TcpSocket *sock , HttpRequest *r ) {
 	// and set from the http request. will set m_coll, etc.
 	g_parms.setFromRequest ( &m_hr , sock , cr , (char *)this , OBJ_SI );
 
+	// . big result pages are streamed so the reply isn't held in memory
+	//   and the first results go out right away
+	if ( ! m_streamResults &&
+	     g_conf.m_streamResultsMinDocs > 0 &&
+	     m_docsWanted >= g_conf.m_streamResultsMinDocs &&
+	     ( tmpFormat == FORMAT_XML || tmpFormat == FORMAT_JSON ) )
+		m_streamResults = true;
+
 	if ( m_streamResults &&
 	     tmpFormat != FORMAT_XML &&
 	     tmpFormat != FORMAT_JSON ) {
 		log("si: streamResults only supported for "
-		    "xml/csv/json. disabling");
+		    "xml/json. disabling");
 		m_streamResults = false;
 	}
 
@@ -276,8 +276,8 @@ void getSpiderStatusMsg(const CollectionRec *cx, const char **msg, spider_status
 // evalIpLoop() can also be called with its m_nextKey/m_endKey limited
 // to just scan the SpiderRequests for a specific IP address. It does
 // this after adding a SpiderReply. addSpiderReply() calls addToWaitingTree()
-// with the "0" time entry, and addToWaitingTree() calls 
-// populateDoledbFromWaitingTree() which will see that "0" entry and call
+// with the time the same ip wait is over (or "0"), and once that time is
+// reached populateDoledbFromWaitingTree() will see the entry and call
 // evalIpLoop(true) after setting m_nextKey/m_endKey for that IP.
 
 
@@ -27,23 +27,27 @@ bool SpiderCache::init ( ) {
 }
 
 // return false if any tree save blocked
-void SpiderCache::save ( bool useThread ) {
+bool SpiderCache::save ( bool useThread ) {
+	bool status = true;
 	// loop over all SpiderColls and get the best
 	for ( int32_t i = 0 ; i < g_collectiondb.getNumRecs(); i++ ) {
 		SpiderColl *sc = getSpiderCollIffNonNull(i);//m_spiderColls[i];
 		if ( ! sc ) continue;
+		char dir[1024];
+		sprintf(dir,"%scoll.%s.%" PRId32,g_hostdb.m_dir,
+			sc->m_coll,(int32_t)sc->m_collnum);
+		// returns false if it blocked
+		if ( ! sc->saveIpScanTable(dir, useThread) ) status = false;
 		RdbTree *tree = &sc->m_waitingTree;
 		if ( ! tree->needsSave() ) continue;
 		// if already saving from a thread
 		if ( tree->isSaving() ) continue;
-		char dir[1024];
-		sprintf(dir,"%scoll.%s.%" PRId32,g_hostdb.m_dir,
-			sc->m_coll,(int32_t)sc->m_collnum);
 		// log it for now
 		log("spider: saving waiting tree for cn=%" PRId32,(int32_t)i);
 		// returns false if it blocked, callback will be called
 		tree->fastSave(dir, useThread, NULL, NULL);
 	}
+	return status;
 }
 
 void SpiderCache::reset ( ) {
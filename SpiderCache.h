@@ -23,7 +23,7 @@ public:
 	// called by main.cpp on exit to free memory
 	void reset();
 
-	void save ( bool useThread );
+	bool save ( bool useThread );
 
 };
 
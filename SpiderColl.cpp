@@ -117,6 +117,9 @@ SpiderColl::SpiderColl(CollectionRec *cr) {
 	m_pageNumInlinks = 0;
 	m_lastCBlockIp = 0;
 	m_lastOverflowFirstIp = 0;
+	m_ipScanTableNeedsSave = false;
+	m_ipScanTableIsSaving = false;
+	m_ipScanTableDir[0] = '\0';
 
 	reset();
 
@@ -196,6 +199,9 @@ bool SpiderColl::load ( ) {
 	if (!m_waitingTable.set (4,8,16,NULL,0,false,"waittbl"))
 		return false;
 
+	if (!m_ipScanTable.set(4, sizeof(IpScanState), 16, NULL, 0, false, "ipscantbl"))
+		return false;
+
 	// . a tree of keys, key is earliestSpiderTime|ip (key=12 bytes)
 	// . earliestSpiderTime is 0 if unknown
 	// . max nodes is 1M but we should grow dynamically! TODO
@@ -224,6 +230,12 @@ bool SpiderColl::load ( ) {
 
 	// init wait table. scan wait tree and add the ips into table.
 	if ( ! makeWaitingTable() ) err = g_errno;
+
+	// what we knew about the ips. not having it just means more reads
+	if ( ! m_ipScanTable.load ( dir , "ipscantable-saved.dat" ) ) {
+		m_ipScanTable.clear();
+		g_errno = 0;
+	}
 	// save it
 	g_errno = err;
 	// return false on error
@@ -401,6 +413,8 @@ void SpiderColl::reset ( ) {
 	m_cdTable     .reset();
 	m_sniTable    .reset();
 	m_waitingTable.reset();
+	m_ipScanTable.reset();
+	m_ipScanTableNeedsSave = false;
 	m_waitingTree.reset();
 	m_waitingMem  .reset();
 	m_winnerTree.reset();
@@ -556,12 +570,15 @@ bool SpiderColl::addSpiderReply(const SpiderReply *srep) {
 		    srep->m_key.n1,
 		    srep->m_key.n0);
 
+	// the ip has to be read from spiderdb again
+	removeFromIpScanTable(srep->m_firstIp);
+
 	// . add to wait tree and let it populate doledb on its batch run
-	// . use a spiderTime of 0 which means unknown and that it needs to
-	//   scan spiderdb to get that
+	// . none of the ip's urls can be spidered before the same ip wait is
+	//   over, so don't have evalIpLoop() scan spiderdb for it until then
 	// . returns false if did not add to waiting tree
 	// . returns false sets g_errno on error
-	addToWaitingTree(srep->m_firstIp);
+	addToWaitingTree(srep->m_firstIp, getIpSpiderTimeMS(srep->m_downloadEndTime));
 
 	// ignore errors i guess
 	g_errno = 0;
@@ -720,11 +737,24 @@ bool SpiderColl::addSpiderRequest(const SpiderRequest *sreq) {
 		}
 	}
 
+	// . if we just downloaded from this ip the request has to wait for
+	//   the same ip wait anyway (injections and reindexes do not)
+	uint64_t spiderTimeMS = 0;
+	if (!sreq->m_isInjecting && !sreq->m_isPageReindex) {
+		RdbCacheLock rcl(m_lastDownloadCache);
+		int64_t lastMS = m_lastDownloadCache.getLongLong(m_collnum, sreq->m_firstIp, -1, true);
+		rcl.unlock();
+		spiderTimeMS = getIpSpiderTimeMS(lastMS);
+	}
+
+	// the ip has to be read from spiderdb again
+	removeFromIpScanTable(sreq->m_firstIp);
+
 	// once in waiting tree, we will scan waiting tree and then lookup
 	// each firstIp in waiting tree in spiderdb to get the best
 	// SpiderRequest for that firstIp, then we can add it to doledb
 	// as long as it can be spidered now
-	bool added = addToWaitingTree(sreq->m_firstIp);
+	bool added = addToWaitingTree(sreq->m_firstIp, spiderTimeMS);
 
 	// if already doled and we beat the priority/spidertime of what
 	// was doled then we should probably delete the old doledb key
@@ -818,9 +848,9 @@ bool SpiderColl::printWaitingTree() {
 // . if one of these add fails consider increasing mem used by tree/table
 // . if we lose an ip that sux because it won't be gotten again unless
 //   we somehow add another request/reply to spiderdb in the future
-bool SpiderColl::addToWaitingTree(int32_t firstIp) {
+bool SpiderColl::addToWaitingTree(int32_t firstIp, uint64_t spiderTimeMS) {
 	char ipbuf[16];
-	logDebug( g_conf.m_logDebugSpider, "spider: addtowaitingtree ip=%s", iptoa(firstIp,ipbuf) );
+	logDebug( g_conf.m_logDebugSpider, "spider: addtowaitingtree ip=%s time=%" PRIu64, iptoa(firstIp,ipbuf), spiderTimeMS );
 
 	// we are currently reading spiderdb for this ip and trying to find
 	// a best SpiderRequest or requests to add to doledb. so if this 
@@ -840,11 +870,10 @@ bool SpiderColl::addToWaitingTree(int32_t firstIp) {
 		//return true;
 	}
 
-	// . this can now be only 0
-	// . only evalIpLoop() will add a waiting tree key with a non-zero
-	//   value after it figures out the EARLIEST time that a 
-	//   SpiderRequest from this firstIp can be spidered.
-	uint64_t spiderTimeMS = 0;
+	// . this is 0 or the end of the same ip wait
+	// . evalIpLoop() will replace the key after it figures out the
+	//   EARLIEST time that a SpiderRequest from this firstIp can be
+	//   spidered.
 
 	// don't write to tree if we're shutting down
 	if (g_process.isShuttingDown()) {
@@ -1310,10 +1339,19 @@ void SpiderColl::populateWaitingTreeFromSpiderdb ( bool reentry ) {
 			continue;
 		}
 
-		// otherwise, we want to add it with 0 time so the doledb
-		// scan will evaluate it properly
+		// . nothing changed for the ip since we last read it from
+		//   spiderdb, so we know when it can be spidered, if ever
+		// . otherwise, we want to add it with 0 time so the doledb
+		//   scan will evaluate it properly
+		int64_t minFutureTimeMS = 0;
+		if (getFromIpScanTable(firstIp, &minFutureTimeMS) && minFutureTimeMS == 0) {
+			char ipbuf[16];
+			logTrace( g_conf.m_logTraceSpider, "Skipping, IP [%s] has nothing to spider" , iptoa(firstIp,ipbuf));
+			continue;
+		}
+
 		// this will return false if we are saving the tree i guess
-		if (!addToWaitingTree(firstIp)) {
+		if (!addToWaitingTree(firstIp, minFutureTimeMS)) {
 			char ipbuf[16];
 			log(LOG_INFO, "spider: failed to add ip %s to waiting tree. "
 			              "ip will not get spidered then and our population of waiting tree will repeat until this add happens.",
@@ -1652,6 +1690,11 @@ void SpiderColl::populateDoledbFromWaitingTree ( ) { // bool reentry ) {
 		m_totalNewSpiderRequests = 0LL;
 		m_lastOverflowFirstIp = 0;
 		
+		// if nothing changed for the ip since we read it we don't read again
+		if ( evalIpFromIpScanTable() ) {
+			continue;
+		}
+
 		// . look up in spiderdb otherwise and add best req to doledb from ip
 		// . if it blocks ultimately it calls gotSpiderdbListWrapper() which
 		//   calls this function again with re-entry set to true
@@ -2856,6 +2899,15 @@ bool SpiderColl::addWinnersIntoDoledb ( ) {
 	// we will re-scan spiderdb. if we had something to spider but it was 
 	// in the future the m_minFutureTimeMS will be non-zero, and we deal
 	// with that below...
+	// . remember what we found if we read spiderdb for it and nothing
+	//   changed meanwhile
+	// . page counts for quotas change without anything being added for
+	//   the ip, so those collections always read
+	if (m_winnerTree.isEmpty() && m_didRead && !m_gotNewDataForScanningIp &&
+	    !m_cr->m_urlFiltersHavePageCounts) {
+		addToIpScanTable(m_scanningIp, m_minFutureTimeMS);
+	}
+
 	if (m_winnerTree.isEmpty() && ! m_minFutureTimeMS ) {
 		// if we received new incoming requests while we were
 		// scanning, which is happening for some crawls, then do
@@ -3268,6 +3320,28 @@ bool SpiderColl::addDoleBufIntoDoledb ( SafeBuf *doleBuf, bool isFromCache ) {
 }
 
 
+// . earliest time any url from an ip can be spidered after we downloaded
+//   from it at lastDownloadMS, whichever url filter rule the url matches
+// . 0 if we did not download from it lately
+uint64_t SpiderColl::getIpSpiderTimeMS(int64_t lastDownloadMS) const {
+	if (lastDownloadMS <= 0 || m_cr->m_numRegExs <= 0) {
+		return 0;
+	}
+
+	int32_t minWaitMS = m_cr->m_spiderIpWaits[0];
+	for (int32_t i = 1; i < m_cr->m_numRegExs; i++) {
+		if (m_cr->m_spiderIpWaits[i] < minWaitMS) {
+			minWaitMS = m_cr->m_spiderIpWaits[i];
+		}
+	}
+
+	if (minWaitMS <= 0) {
+		return 0;
+	}
+
+	return (uint64_t)(lastDownloadMS + minWaitMS);
+}
+
 uint64_t SpiderColl::getSpiderTimeMS(const SpiderRequest *sreq, int32_t ufn, const SpiderReply *srep, int64_t nowMS) {
 	// . get the scheduled spiderTime for it
 	// . assume this SpiderRequest never been successfully spidered
@@ -3627,3 +3701,167 @@ void SpiderColl::clearWaitingTable() {
 	ScopedLock sl(m_waitingTableMtx);
 	m_waitingTable.clear();
 }
+
+void SpiderColl::addToIpScanTable(int32_t firstIp, int64_t minFutureTimeMS) {
+	ScopedLock sl(m_ipScanTableMtx);
+
+	IpScanState state;
+	state.m_minFutureTimeMS = minFutureTimeMS;
+	state.m_scanTime = getTimeLocal();
+	if (!m_ipScanTable.addKey(&firstIp, &state)) {
+		// just means we read it again next time
+		g_errno = 0;
+		return;
+	}
+	m_ipScanTableNeedsSave = true;
+}
+
+void SpiderColl::removeFromIpScanTable(int32_t firstIp) {
+	ScopedLock sl(m_ipScanTableMtx);
+	if (!m_ipScanTable.isInTable(&firstIp)) {
+		return;
+	}
+	m_ipScanTable.removeKey(&firstIp);
+	m_ipScanTableNeedsSave = true;
+}
+
+// . returns true if nothing changed for the ip since it was last read
+//   from spiderdb, and sets *minFutureTimeMS
+// . entries expire after the waiting tree rebuild interval so things we
+//   do not track (like url block lists) are picked up eventually
+bool SpiderColl::getFromIpScanTable(int32_t firstIp, int64_t *minFutureTimeMS) {
+	ScopedLock sl(m_ipScanTableMtx);
+
+	const IpScanState *state = (const IpScanState *)m_ipScanTable.getValue(&firstIp);
+	if (!state) {
+		return false;
+	}
+
+	int32_t maxAge = g_conf.m_waitingTreeRebuildInterval > 0 ? g_conf.m_waitingTreeRebuildInterval : 86400;
+	if (getTimeLocal() - state->m_scanTime > maxAge) {
+		return false;
+	}
+
+	*minFutureTimeMS = state->m_minFutureTimeMS;
+	return true;
+}
+
+int32_t SpiderColl::getIpScanTableCount() const {
+	ScopedLock sl(m_ipScanTableMtx);
+	return m_ipScanTable.getNumUsedSlots();
+}
+
+void SpiderColl::clearIpScanTable() {
+	ScopedLock sl(m_ipScanTableMtx);
+	m_ipScanTable.clear();
+	m_ipScanTableNeedsSave = true;
+}
+
+bool SpiderColl::saveIpScanTable(const char *dir, bool useThread) {
+	ScopedLock sl(m_ipScanTableMtx);
+	if (!m_ipScanTableNeedsSave) {
+		return true;
+	}
+
+	// already in the middle of saving
+	if (m_ipScanTableIsSaving.exchange(true)) {
+		return false;
+	}
+
+	// . save a copy so adds and lookups don't wait for the disk
+	// . the copy is only touched by the save until m_ipScanTableIsSaving is cleared
+	m_ipScanTableSaveCopy.reset();
+	if (!m_ipScanTableSaveCopy.set(4, sizeof(IpScanState), m_ipScanTable.getNumUsedSlots() * 2 + 16, NULL, 0, false, "ipscantblsv")) {
+		log(LOG_ERROR, "spider: Could not copy ip scan table for %s", m_coll);
+		m_ipScanTableIsSaving = false;
+		return true;
+	}
+
+	for (int32_t i = 0; i < m_ipScanTable.getNumSlots(); i++) {
+		if (m_ipScanTable.isEmpty(i)) {
+			continue;
+		}
+
+		if (!m_ipScanTableSaveCopy.addKey(m_ipScanTable.getKeyFromSlot(i), m_ipScanTable.getValueFromSlot(i))) {
+			log(LOG_ERROR, "spider: Could not copy ip scan table for %s", m_coll);
+			m_ipScanTableSaveCopy.reset();
+			m_ipScanTableIsSaving = false;
+			return true;
+		}
+	}
+
+	// changes from now on need another save
+	m_ipScanTableNeedsSave = false;
+
+	sl.unlock();
+
+	strncpy(m_ipScanTableDir, dir, sizeof(m_ipScanTableDir) - 1);
+	m_ipScanTableDir[sizeof(m_ipScanTableDir) - 1] = '\0';
+
+	if (useThread) {
+		if (g_jobScheduler.submit(saveIpScanTableWrapper, saveIpScanTableDoneWrapper, this, thread_type_unspecified_io, 1/*niceness*/)) {
+			return false;
+		}
+
+		// if it failed
+		if (g_jobScheduler.are_new_jobs_allowed()) {
+			log(LOG_WARN, "spider: Thread creation failed. Blocking while saving ip scan table.");
+		}
+	}
+
+	saveIpScanTableWrapper(this);
+	saveIpScanTableDoneWrapper(this, job_exit_normal);
+	return true;
+}
+
+void SpiderColl::saveIpScanTableWrapper(void *state) {
+	SpiderColl *that = static_cast<SpiderColl*>(state);
+
+	// m_ipScanTableMtx isn't held here. we write the copy made by saveIpScanTable
+	if (!that->m_ipScanTableSaveCopy.save(that->m_ipScanTableDir, "ipscantable-saved.dat")) {
+		log(LOG_ERROR, "spider: Had error saving ip scan table for %s", that->m_coll);
+
+		ScopedLock sl(that->m_ipScanTableMtx);
+		that->m_ipScanTableNeedsSave = true;
+	}
+}
+
+// also called if the job was cancelled at shutdown
+void SpiderColl::saveIpScanTableDoneWrapper(void *state, job_exit_t exit_type) {
+	SpiderColl *that = static_cast<SpiderColl*>(state);
+	if (exit_type != job_exit_normal) {
+		ScopedLock sl(that->m_ipScanTableMtx);
+		that->m_ipScanTableNeedsSave = true;
+	}
+	that->m_ipScanTableSaveCopy.reset();
+	that->m_ipScanTableIsSaving = false;
+}
+
+// . called for the ip we got from the waiting tree instead of reading its
+//   spiderdb list, if we know the outcome of that already
+// . returns false if the ip has to be read
+bool SpiderColl::evalIpFromIpScanTable() {
+	if (m_countingPagesIndexed || g_errno) {
+		return false;
+	}
+
+	int64_t minFutureTimeMS;
+	if (!getFromIpScanTable(m_scanningIp, &minFutureTimeMS)) {
+		return false;
+	}
+
+	// due now, so we have to find out what can be spidered
+	if (minFutureTimeMS != 0 && minFutureTimeMS <= gettimeofdayInMilliseconds()) {
+		return false;
+	}
+
+	char ipbuf[16];
+	logDebug(g_conf.m_logDebugSpider, "spider: ip=%s unchanged since last read. minfuturetime=%" PRId64,
+	         iptoa(m_scanningIp, ipbuf), minFutureTimeMS);
+
+	// . this nukes the waiting tree key or moves it to the future time
+	// . m_didRead is false so it is not added to m_ipScanTable again
+	m_minFutureTimeMS = minFutureTimeMS;
+	addWinnersIntoDoledb();
+	return true;
+}
@@ -16,6 +16,7 @@
 #include "max_coll_len.h"
 #include <time.h>
 #include <vector>
+#include <atomic>
 
 
 class CollectionRec;
@@ -83,7 +84,9 @@ public:
 
 	bool printWaitingTree();
 
-	bool addToWaitingTree(int32_t firstIp);
+	// . spiderTimeMS is the earliest time the ip can be spidered, if
+	//   known. 0 means now, evalIpLoop() will figure it out
+	bool addToWaitingTree(int32_t firstIp, uint64_t spiderTimeMS = 0);
 	void populateDoledbFromWaitingTree();
 
 	void populateWaitingTreeFromSpiderdb(bool reentry);
@@ -91,6 +94,14 @@ public:
 	int32_t getWaitingTableCount() const;
 	void clearWaitingTable();
 
+	// forget what we know about the ips, e.g. when the url filters change
+	void clearIpScanTable();
+	int32_t getIpScanTableCount() const;
+	// . returns false if blocked
+	// . saved from a thread like the waiting tree if useThread is true
+	bool saveIpScanTable(const char *dir, bool useThread);
+	bool isSavingIpScanTable() const { return m_ipScanTableIsSaving; }
+
 	bool     m_waitingTreeNeedsRebuild;
 	RdbTree    m_waitingTree;
 	RdbMem     m_waitingMem; // used by m_waitingTree
@@ -131,6 +142,7 @@ private:
 	bool updateSiteNumInlinksTable(int32_t siteHash32, int32_t sni, time_t tstamp);
 
 	uint64_t getSpiderTimeMS(const SpiderRequest *sreq, int32_t ufn, const SpiderReply *srep, int64_t nowMS);
+	uint64_t getIpSpiderTimeMS(int64_t lastDownloadMS) const;
 
 	bool makeWaitingTable();
 	bool addToWaitingTable(int32_t firstIp, int64_t timeMs);
@@ -139,6 +151,11 @@ private:
 	bool isInWaitingTable(int32_t firstIp) const;
 	bool setWaitingTableSize(int32_t numSlots);
 
+	void addToIpScanTable(int32_t firstIp, int64_t minFutureTimeMS);
+	void removeFromIpScanTable(int32_t firstIp);
+	bool getFromIpScanTable(int32_t firstIp, int64_t *minFutureTimeMS);
+	bool evalIpFromIpScanTable();
+
 	int32_t getNextIpFromWaitingTree ( );
 
 	// broke up scanSpiderdb into simpler functions:
@@ -166,6 +183,24 @@ private:
 	HashTableX m_waitingTable;
 	mutable GbMutex m_waitingTableMtx;
 
+	// m_ipScanTable (HashTableX, 32 bit keys, IpScanState data)
+	// Purpose: remember the outcome of the last spiderdb read for a firstIp
+	// that did not dole anything, so we do not read its spiderdb list
+	// again until something changed.
+	// Key is the firstIp. The entry is removed when a SpiderRequest or
+	// SpiderReply for the firstIp is added. It is saved with the waiting
+	// tree.
+	struct IpScanState {
+		int64_t m_minFutureTimeMS; // 0 if nothing could be spidered
+		int32_t m_scanTime;        // when spiderdb was read
+	} __attribute__((packed));
+	HashTableX m_ipScanTable;
+	mutable GbMutex m_ipScanTableMtx;
+	bool m_ipScanTableNeedsSave;
+	std::atomic<bool> m_ipScanTableIsSaving;
+	HashTableX m_ipScanTableSaveCopy;
+	char m_ipScanTableDir[1024];
+
 	// m_doledbIpTable (HashTableX, 96 bit keys, no data)
 	// Purpose: let's us know how many SpiderRequests have been doled out for a given firstIP
 	// Key is simply a 4-byte IP.
@@ -240,6 +275,8 @@ private:
 
 	static void gotSpiderdbListWrapper(void *state, RdbList *list, Msg5 *msg5);
 	static void gotSpiderdbWaitingTreeListWrapper(void *state, RdbList *list, Msg5 *msg5);
+	static void saveIpScanTableWrapper(void *state);
+	static void saveIpScanTableDoneWrapper(void *state, job_exit_t exit_type);
 };
 
 #endif // GB_SPIDERCOLL_H
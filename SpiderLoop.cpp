@@ -11,6 +11,7 @@
 #include "DailyMerge.h"
 #include "Process.h"
 #include "XmlDoc.h"
+#include "Robots.h"
 #include "HttpServer.h"
 #include "Pages.h"
 #include "Parms.h"
@@ -57,13 +58,11 @@ SpiderLoop g_spiderLoop;
 
 SpiderLoop::SpiderLoop ( ) {
 	m_crx = NULL;
-	// clear array of ptrs to Doc's
-	memset ( m_docs , 0 , sizeof(XmlDoc *) * MAX_SPIDERS );
 
 	// Coverity
 	m_numSpidersOut = 0;
+	m_numParsing = 0;
 	m_launches = 0;
-	m_maxUsed = 0;
 	m_sc = NULL;
 	m_gettingDoledbList = false;
 	m_activeList = NULL;
@@ -82,13 +81,20 @@ SpiderLoop::~SpiderLoop ( ) {
 // free all doc's
 void SpiderLoop::reset() {
 	// delete all doc's in use
-	for ( int32_t i = 0 ; i < MAX_SPIDERS ; i++ ) {
+	for ( int32_t i = 0 ; i < (int32_t)m_docs.size() ; i++ ) {
 		if ( m_docs[i] ) {
 			mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
 			delete (m_docs[i]);
 		}
-		m_docs[i] = NULL;
 	}
+	m_docs.clear();
+	m_docSlots.clear();
+	m_freeDocSlots.clear();
+	m_docSlotMap.clear();
+	m_spidersOutPerIp.clear();
+	m_spidersOutPerCollIp.clear();
+	m_parseQueue.clear();
+	m_numParsing = 0;
 	m_list.freeList();
 	m_lockTable.reset();
 	m_winnerListCache.reset();
@@ -107,10 +113,14 @@ void SpiderLoop::init() {
 	m_gettingDoledbList = false;
 
 	// clear array of ptrs to Doc's
-	memset ( m_docs , 0 , sizeof(XmlDoc *) * MAX_SPIDERS );
-	// . m_maxUsed is the largest i such that m_docs[i] is in use
-	// . -1 means there are no used m_docs's
-	m_maxUsed = -1;
+	m_docs.clear();
+	m_docSlots.clear();
+	m_freeDocSlots.clear();
+	m_docSlotMap.clear();
+	m_spidersOutPerIp.clear();
+	m_spidersOutPerCollIp.clear();
+	m_parseQueue.clear();
+	m_numParsing = 0;
 	m_numSpidersOut = 0;
 
 	// for locking. key size is 8 for easier debugging
@@ -143,6 +153,7 @@ void SpiderLoop::init() {
 
 void SpiderLoop::initSettings() {
     m_urlCache.configure(g_conf.m_spiderUrlCacheMaxAge*1000, g_conf.m_spiderUrlCacheSize, g_conf.m_logTraceSpiderUrlCache, "spider url cache");
+    Robots::initializeSettings();
 }
 
 void SpiderLoop::nukeWinnerListCache(collnum_t collnum) {
@@ -154,6 +165,10 @@ void SpiderLoop::nukeWinnerListCache(collnum_t collnum) {
 // call this every 50ms it seems to try to spider urls and populate doledb
 // from the waiting tree
 void SpiderLoop::doneSleepingWrapperSL ( int fd , void *state ) {
+	// downloaded docs waiting to be parsed are resumed even if spidering
+	// was turned off since they are out already
+	g_spiderLoop.resumeWaitingToParse();
+
 	// if spidering disabled then do not do this crap
 	if ( ! g_conf.m_spideringEnabled )  return;
 	if ( ! g_hostdb.getMyHost( )->m_spiderEnabled ) return;
@@ -207,9 +222,12 @@ void SpiderLoop::doneSleepingWrapperSL ( int fd , void *state ) {
 			continue;
 		}
 
-		// always do a scan at startup & every 24 hrs
+		// always do a scan at startup & every 24 hrs (by default)
 		// AND at process startup!!!
-		if ( ! sc->m_waitingTreeNeedsRebuild && now - sc->getLastScanTime() > 24*3600 ) {
+		if ( ! sc->m_waitingTreeNeedsRebuild &&
+		     ( sc->getLastScanTime() == 0 ||
+		       ( g_conf.m_waitingTreeRebuildInterval > 0 &&
+			 now - sc->getLastScanTime() > g_conf.m_waitingTreeRebuildInterval ) ) ) {
 			// if a scan is ongoing, this will re-set it
 			sc->resetWaitingTreeNextKey();
 			sc->m_waitingTreeNeedsRebuild = true;
@@ -356,12 +374,6 @@ subloop:
 		return;
 	}
 	
-	// stop if too many out. this is now 50 down from 500.
-	if ( m_numSpidersOut >= MAX_SPIDERS ) {
-		logTrace( g_conf.m_logTraceSpider, "END, reached max spiders"  );
-		return;
-	}
-	
 	// a new global conf rule
 	if ( m_numSpidersOut >= g_conf.m_maxTotalSpiders ) {
 		logTrace( g_conf.m_logTraceSpider, "END, reached max total spiders"  );
@@ -660,7 +672,7 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// skip if too many udp slots being used
 	if (g_udpServer.getNumUsedSlotsIncoming() >= MAXUDPSLOTS ) bail =true;
 	// stop if too many out
-	if ( m_numSpidersOut >= MAX_SPIDERS ) bail = true;
+	if ( m_numSpidersOut >= g_conf.m_maxTotalSpiders ) bail = true;
 
 	if ( bail ) {
 		// return false to indicate to try another
@@ -804,21 +816,18 @@ bool SpiderLoop::gotDoledbList2 ( ) {
 	// . how many spiders out for this ip now?
 	// . TODO: count locks in case twin is spidering... but it did not seem
 	//   to work right for some reason
-	for ( int32_t i = 0 ; i <= m_maxUsed ; i++ ) {
-		// get it
-		const XmlDoc *xd = m_docs[i];
-		if ( ! xd ) continue;
-		if ( ! xd->m_sreqValid ) continue;
-		// to prevent one collection from hogging all the urls for
-		// particular IP and starving other collections, let's make 
-		// this a per collection count.
-		// then allow msg13.cpp to handle the throttling on its end.
-		// also do a global count over all collections now
-		if ( xd->m_sreq.m_firstIp == sreq->m_firstIp ) globalOut++;
+	// . to prevent one collection from hogging all the urls for
+	//   particular IP and starving other collections, let's make
+	//   this a per collection count.
+	//   then allow msg13.cpp to handle the throttling on its end.
+	// . also do a global count over all collections now
+	{
+		auto it = m_spidersOutPerIp.find(sreq->m_firstIp);
+		if ( it != m_spidersOutPerIp.end() ) globalOut = it->second;
 		// only count for our same collection otherwise another
 		// collection can starve us out
-		if ( xd->m_collnum != cr->m_collnum ) continue;
-		if ( xd->m_sreq.m_firstIp == sreq->m_firstIp ) ipOut++;
+		auto cit = m_spidersOutPerCollIp.find(((uint64_t)(uint16_t)cr->m_collnum << 32) | (uint32_t)sreq->m_firstIp);
+		if ( cit != m_spidersOutPerCollIp.end() ) ipOut = cit->second;
 	}
 
 	// don't give up on this priority, just try next in the list.
@@ -981,7 +990,7 @@ bool SpiderLoop::spiderUrl(SpiderRequest *sreq, const key96_t *doledbKey, collnu
 	     // repairing the collection's rdbs?
 	     g_repairMode ) {
 		// try to cancel outstanding spiders, ignore injects
-		for ( int32_t i = 0 ; i <= m_maxUsed ; i++ ) {
+		for ( int32_t i = 0 ; i < (int32_t)m_docs.size() ; i++ ) {
 			// get it
 			XmlDoc *xd = m_docs[i];
 			if ( ! xd                      ) continue;
@@ -1036,7 +1045,7 @@ bool SpiderLoop::spiderUrl(SpiderRequest *sreq, const key96_t *doledbKey, collnu
 	// to zero, we do a re-scan and get a doledbkey that is currently
 	// being spidered or is waiting for its negative doledb key to
 	// get into our doledb tree
-	for ( int32_t i = 0 ; i <= m_maxUsed ; i++ ) {
+	for ( int32_t i = 0 ; i < (int32_t)m_docs.size() ; i++ ) {
 		// get it
 		XmlDoc *xd = m_docs[i];
 		if ( ! xd ) continue;
@@ -1168,18 +1177,6 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, const key96_t *doledbKey, colln
 		m_urlCache.insert(url, NULL);
 	}
 
-	// . find an available doc slot
-	// . we can have up to MAX_SPIDERS spiders (300)
-	int32_t i;
-	for ( i=0 ; i<MAX_SPIDERS ; i++ ) if (! m_docs[i]) break;
-
-	// come back later if we're full
-	if ( i >= MAX_SPIDERS ) {
-		log(LOG_DEBUG,"build: Already have %" PRId32" outstanding spiders.",
-		    (int32_t)MAX_SPIDERS);
-		g_process.shutdownAbort(true);
-	}
-
 	XmlDoc *xd;
 	// otherwise, make a new one if we have to
 	try { xd = new (XmlDoc); }
@@ -1196,7 +1193,7 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, const key96_t *doledbKey, colln
 	// register it's mem usage with Mem.cpp class
 	mnew ( xd , sizeof(XmlDoc) , "XmlDoc" );
 	// add to the array
-	m_docs [ i ] = xd;
+	int32_t i = addDoc ( xd , sreq->m_firstIp , collnum );
 
 	CollectionRec *cr = g_collectiondb.getRec(collnum);
 	const char *coll = "collnumwasinvalid";
@@ -1217,9 +1214,9 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, const key96_t *doledbKey, colln
 	// this returns false and sets g_errno on error
 	if (!xd->set4(sreq, doledbKey, coll, NULL, MAX_NICENESS)) {
 		// i guess m_coll is no longer valid?
-		mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
-		delete (m_docs[i]);
-		m_docs[i] = NULL;
+		removeDoc ( i );
+		mdelete ( xd , sizeof(XmlDoc) , "Doc" );
+		delete (xd);
 		// error, g_errno should be set!
 		logTrace( g_conf.m_logTraceSpider, "END, xd->set4 returned false" );
 		return true;
@@ -1228,8 +1225,6 @@ bool SpiderLoop::spiderUrl2(SpiderRequest *sreq, const key96_t *doledbKey, colln
 	// call this after doc gets indexed
 	xd->setCallback ( xd  , indexedDocWrapper );
 
-	// increase m_maxUsed if we have to
-	if ( i > m_maxUsed ) m_maxUsed = i;
 	// count it
 	m_numSpidersOut++;
 	// count this
@@ -1290,17 +1285,11 @@ bool SpiderLoop::indexedDoc ( XmlDoc *xd ) {
 	logTrace( g_conf.m_logTraceSpider, "BEGIN" );
 
 	// get our doc #, i
-	int32_t i = 0;
-	for ( ; i < MAX_SPIDERS ; i++ ) if ( m_docs[i] == xd) break;
+	auto it = m_docSlotMap.find(xd);
 	// sanity check
-	if ( i >= MAX_SPIDERS ) { g_process.shutdownAbort(true); }
+	if ( it == m_docSlotMap.end() ) { g_process.shutdownAbort(true); }
+	int32_t i = it->second;
 
-	// . decrease m_maxUsed if we need to
-	// . we can decrease all the way to -1, which means no spiders going on
-	if ( m_maxUsed == i ) {
-		m_maxUsed--;
-		while ( m_maxUsed >= 0 && ! m_docs[m_maxUsed] ) m_maxUsed--;
-	}
 	// count it
 	m_numSpidersOut--;
 
@@ -1336,9 +1325,9 @@ bool SpiderLoop::indexedDoc ( XmlDoc *xd ) {
 	g_errno = 0;
 
 	// we are responsible for deleting doc now
-	mdelete ( m_docs[i] , sizeof(XmlDoc) , "Doc" );
-	delete (m_docs[i]);
-	m_docs[i] = NULL;
+	removeDoc ( i );
+	mdelete ( xd , sizeof(XmlDoc) , "Doc" );
+	delete (xd);
 
 	// we did not block, so return true
 	logTrace( g_conf.m_logTraceSpider, "END" );
@@ -1346,6 +1335,91 @@ bool SpiderLoop::indexedDoc ( XmlDoc *xd ) {
 }
 
 
+// . put the doc in a free slot, or a new one if there is none
+// . returns the slot
+int32_t SpiderLoop::addDoc ( XmlDoc *xd , int32_t firstIp , collnum_t collnum ) {
+	int32_t i;
+	if ( ! m_freeDocSlots.empty() ) {
+		i = m_freeDocSlots.back();
+		m_freeDocSlots.pop_back();
+	} else {
+		i = (int32_t)m_docs.size();
+		m_docs.push_back ( NULL );
+		m_docSlots.push_back ( DocSlot() );
+	}
+
+	m_docs[i] = xd;
+	m_docSlots[i].m_firstIp = firstIp;
+	m_docSlots[i].m_collnum = collnum;
+	m_docSlots[i].m_parsing = false;
+	m_docSlotMap[xd] = i;
+
+	m_spidersOutPerIp[firstIp]++;
+	m_spidersOutPerCollIp[((uint64_t)(uint16_t)collnum << 32) | (uint32_t)firstIp]++;
+	return i;
+}
+
+
+// . free slot i. does not delete the doc
+void SpiderLoop::removeDoc ( int32_t i ) {
+	const DocSlot &slot = m_docSlots[i];
+
+	auto it = m_spidersOutPerIp.find(slot.m_firstIp);
+	if ( it != m_spidersOutPerIp.end() && --it->second <= 0 )
+		m_spidersOutPerIp.erase(it);
+	auto cit = m_spidersOutPerCollIp.find(((uint64_t)(uint16_t)slot.m_collnum << 32) | (uint32_t)slot.m_firstIp);
+	if ( cit != m_spidersOutPerCollIp.end() && --cit->second <= 0 )
+		m_spidersOutPerCollIp.erase(cit);
+
+	if ( slot.m_parsing ) m_numParsing--;
+
+	m_docSlotMap.erase ( m_docs[i] );
+	m_docs[i] = NULL;
+	m_freeDocSlots.push_back ( i );
+}
+
+
+// . a doc of ours is downloaded and wants to be parsed and indexed
+// . docs that are not ours (injections etc) are always let through
+bool SpiderLoop::admitToParse ( XmlDoc *xd ) {
+	auto it = m_docSlotMap.find(xd);
+	if ( it == m_docSlotMap.end() ) return true;
+
+	// a redirect is downloaded while parsing
+	DocSlot &slot = m_docSlots[it->second];
+	if ( slot.m_parsing ) return true;
+
+	// wait our turn if others are already waiting
+	if ( ( g_conf.m_maxParsingSpiders > 0 && m_numParsing >= g_conf.m_maxParsingSpiders ) ||
+	     ! m_parseQueue.empty() ) {
+		m_parseQueue.push_back ( xd );
+		return false;
+	}
+
+	slot.m_parsing = true;
+	m_numParsing++;
+	return true;
+}
+
+
+// resume the downloaded docs waiting for the parse/index stage
+void SpiderLoop::resumeWaitingToParse ( ) {
+	while ( ! m_parseQueue.empty() &&
+		( g_conf.m_maxParsingSpiders <= 0 || m_numParsing < g_conf.m_maxParsingSpiders ) ) {
+		XmlDoc *xd = m_parseQueue.front();
+		m_parseQueue.pop_front();
+
+		auto it = m_docSlotMap.find(xd);
+		if ( it == m_docSlotMap.end() ) continue;
+		m_docSlots[it->second].m_parsing = true;
+		m_numParsing++;
+
+		// this may delete the doc when it is done
+		xd->m_masterLoop ( xd->m_masterState );
+	}
+}
+
+
 
 // use -1 for any collnum
 int32_t SpiderLoop::getNumSpidersOutPerIp(int32_t firstIp, collnum_t collnum) {
@@ -11,6 +11,9 @@
 #include "GbCache.h"
 #include <time.h>
 #include <atomic>
+#include <vector>
+#include <deque>
+#include <unordered_map>
 
 // . the spider loop
 // . it gets urls to spider from the SpiderCache global class, g_spiderCache
@@ -19,9 +22,13 @@
 // . supports <META NAME="ROBOTS" CONTENT="NOFOLLOW"> (no links)
 // . supports limiting spiders per domain
 
-// . max spiders we can have going at once for this process
-// . limit to 50 to preven OOM conditions
-#define MAX_SPIDERS 300
+// . there is no fixed limit on the spiders we can have going at once. the
+//   total is limited by g_conf.m_maxTotalSpiders
+// . a doc that is waiting on its download only uses a small part of an
+//   XmlDoc. once downloaded it has to be admitted to the parse/index stage
+//   which only allows g_conf.m_maxParsingSpiders docs at once, so a high
+//   number of concurrent downloads does not mean as many docs in memory
+//   being parsed
 
 
 class UdpSlot;
@@ -54,8 +61,17 @@ public:
 	void removeLock(int64_t key);
 	void clearLocks(collnum_t collnum);
 
-	// for spidering/parsing/indexing a url(s)
-	XmlDoc *m_docs [ MAX_SPIDERS ];
+	// . for spidering/parsing/indexing a url(s)
+	// . slots can be NULL
+	int32_t getNumDocSlots() const { return (int32_t)m_docs.size(); }
+	XmlDoc *getDoc(int32_t i) const { return m_docs[i]; }
+
+	// . called by the doc when its download is done
+	// . returns false if the parse/index stage is full. the doc is
+	//   resumed later
+	bool admitToParse(XmlDoc *xd);
+	int32_t getNumParsing() const { return m_numParsing; }
+	int32_t getNumWaitingToParse() const { return (int32_t)m_parseQueue.size(); }
 
 	RdbCache   m_winnerListCache;
 
@@ -79,14 +95,37 @@ private:
 
 	bool indexedDoc ( XmlDoc *doc );
 
+	int32_t addDoc(XmlDoc *xd, int32_t firstIp, collnum_t collnum);
+	void removeDoc(int32_t i);
+	void resumeWaitingToParse();
+
 	CollectionRec *getActiveList();
 	void buildActiveList ( ) ;
 
 	std::atomic<int32_t> m_numSpidersOut;
 
-	// . this is "i" where m_msg14[i] is the highest m_msg14 in use
-	// . we use it to limit our scanning to the first "i" m_msg14's
-	int32_t m_maxUsed;
+	// what we know about the doc in m_docs[i]
+	struct DocSlot {
+		int32_t m_firstIp;
+		collnum_t m_collnum;
+		bool m_parsing;
+	};
+
+	// . m_docs grows as needed. freed slots are reused
+	// . m_docSlots[i] is for m_docs[i]
+	std::vector<XmlDoc*> m_docs;
+	std::vector<DocSlot> m_docSlots;
+	std::vector<int32_t> m_freeDocSlots;
+	std::unordered_map<const XmlDoc*, int32_t> m_docSlotMap;
+
+	// spiders out per firstip, over all collections and per collection
+	// (keyed by collnum<<32|firstip)
+	std::unordered_map<int32_t, int32_t> m_spidersOutPerIp;
+	std::unordered_map<uint64_t, int32_t> m_spidersOutPerCollIp;
+
+	// docs in the parse/index stage, and the downloaded docs waiting for it
+	int32_t m_numParsing;
+	std::deque<XmlDoc*> m_parseQueue;
 
 	int32_t m_launches;
 
@@ -14,6 +14,8 @@
 #include "GbMutex.h"
 #include "Lang.h"
 #include "CountryCode.h"
+#include "LatencyHistogram.h"
+#include "SafeBuf.h"
 #include <stddef.h>
 #include <string.h>
 #include <stdio.h>
@@ -66,6 +68,26 @@ static unsigned ms_to_tr(unsigned ms) {
 	return i;
 }
 
+
+//////////////////////////////////////////////////////////////////////////////
+// Latency histograms
+// Unlike the timerange statistics above these are never reset. They are
+// scraped through print_metrics()
+
+static LatencyHistogram query_latency;
+static LatencyHistogram spider_latency[2];	//indexed by is_new
+static LatencyHistogram io_latency[2];		//indexed by is_write
+
+static const msg_type_t udp_msg_types[] = {
+	msg_type_0, msg_type_4, msg_type_7, msg_type_c, msg_type_13, msg_type_20, msg_type_22,
+	msg_type_25, msg_type_39, msg_type_3e, msg_type_3f, msg_type_54, msg_type_fd, msg_type_dns
+};
+static const size_t udp_msg_type_count = sizeof(udp_msg_types)/sizeof(udp_msg_types[0]);
+static LatencyHistogram udp_roundtrip_latency[udp_msg_type_count];
+
+static const int job_thread_type_count = thread_type_config_load+1;
+static LatencyHistogram job_queue_latency[job_thread_type_count];
+
 //////////////////////////////////////////////////////////////////////////////
 // Query statistics
 
@@ -74,6 +96,8 @@ static query_trs_t query_trs;
 static GbMutex mtx_query_trs;
 
 void Statistics::register_query_time(unsigned term_count, unsigned qlang, int error_code, unsigned ms) {
+	query_latency.record(ms*(uint64_t)1000);
+
 	unsigned i = ms_to_tr(ms);
 	auto key = std::make_tuple(error_code, term_count, qlang);
 
@@ -136,6 +160,8 @@ static spider_trs_t new_spider_trs;
 static GbMutex mtx_spider_trs;
 
 void Statistics::register_spider_time(bool is_new, int error_code, int http_status, unsigned ms) {
+	spider_latency[is_new?1:0].record(ms*(uint64_t)1000);
+
 	int i = ms_to_tr(ms);
 	auto key = std::make_pair(error_code, http_status);
 
@@ -305,7 +331,10 @@ typedef std::map<std::pair<bool, int>, IOStatistics> ios_t;
 static ios_t io_stats;
 static GbMutex mtx_io_stats;
 
-void Statistics::register_io_time( bool is_write, int error_code, unsigned long bytes, unsigned /*ms*/ ) {
+void Statistics::register_io_time( bool is_write, int error_code, unsigned long bytes, uint64_t us ) {
+	if ( !error_code )
+		io_latency[is_write?1:0].record(us);
+
 	auto key = std::make_pair(is_write, error_code);
 
 	ScopedLock sl(mtx_io_stats);
@@ -541,6 +570,104 @@ static void dump_crawl_ban_statistics(FILE *fp) {
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// UDP round trip and job queue latency
+
+void Statistics::register_udp_roundtrip_time(msg_type_t msg_type, uint64_t us) {
+	for(size_t i = 0; i < udp_msg_type_count; i++) {
+		if(udp_msg_types[i] == msg_type) {
+			udp_roundtrip_latency[i].record(us);
+			return;
+		}
+	}
+}
+
+bool Statistics::get_udp_roundtrip_snapshot(msg_type_t msg_type, LatencyHistogram::Snapshot *snapshot) {
+	for(size_t i = 0; i < udp_msg_type_count; i++) {
+		if(udp_msg_types[i] == msg_type) {
+			udp_roundtrip_latency[i].getSnapshot(snapshot);
+			return true;
+		}
+	}
+	return false;
+}
+
+void Statistics::register_job_queue_time(thread_type_t thread_type, uint64_t us) {
+	if(thread_type >= 0 && thread_type < job_thread_type_count)
+		job_queue_latency[thread_type].record(us);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// metrics
+
+static const double metric_quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+static void print_metric_header(SafeBuf *sb, const char *name, const char *help) {
+	sb->safePrintf("# HELP %s %s\n", name, help);
+	sb->safePrintf("# TYPE %s summary\n", name);
+}
+
+//print a histogram as a summary. "labels" is empty or like 'op="read"'
+static void print_metric_summary(SafeBuf *sb, const char *name, const char *labels, const LatencyHistogram &histogram) {
+	LatencyHistogram::Snapshot snapshot;
+	histogram.getSnapshot(&snapshot);
+
+	const char *sep = labels[0] ? "," : "";
+	for(double q : metric_quantiles) {
+		sb->safePrintf("%s{%s%squantile=\"%g\"} %.6f\n",
+		               name, labels, sep, q,
+		               snapshot.getValueAtPercentile(q*100.0) / 1000000.0);
+	}
+	if(labels[0]) {
+		sb->safePrintf("%s_sum{%s} %.6f\n", name, labels, snapshot.m_sum / 1000000.0);
+		sb->safePrintf("%s_count{%s} %" PRIu64 "\n", name, labels, snapshot.m_count);
+	} else {
+		sb->safePrintf("%s_sum %.6f\n", name, snapshot.m_sum / 1000000.0);
+		sb->safePrintf("%s_count %" PRIu64 "\n", name, snapshot.m_count);
+	}
+}
+
+void Statistics::print_metrics(SafeBuf *sb) {
+	print_metric_header(sb, "gb_query_latency_seconds", "Time to answer a search query.");
+	print_metric_summary(sb, "gb_query_latency_seconds", "", query_latency);
+
+	print_metric_header(sb, "gb_spider_latency_seconds", "Time to spider a document.");
+	print_metric_summary(sb, "gb_spider_latency_seconds", "is_new=\"0\"", spider_latency[0]);
+	print_metric_summary(sb, "gb_spider_latency_seconds", "is_new=\"1\"", spider_latency[1]);
+
+	print_metric_header(sb, "gb_disk_io_latency_seconds", "Time of successful disk reads and writes.");
+	print_metric_summary(sb, "gb_disk_io_latency_seconds", "op=\"read\"", io_latency[0]);
+	print_metric_summary(sb, "gb_disk_io_latency_seconds", "op=\"write\"", io_latency[1]);
+
+	// only the message types and job types that have been seen
+	print_metric_header(sb, "gb_udp_roundtrip_seconds", "Time from sending a udp request until the reply is complete.");
+	for(size_t i = 0; i < udp_msg_type_count; i++) {
+		LatencyHistogram::Snapshot snapshot;
+		udp_roundtrip_latency[i].getSnapshot(&snapshot);
+		if(snapshot.m_count == 0)
+			continue;
+		char labels[64];
+		if(udp_msg_types[i] == msg_type_dns)
+			snprintf(labels, sizeof(labels), "msg_type=\"dns\"");
+		else
+			snprintf(labels, sizeof(labels), "msg_type=\"0x%02x\"", (unsigned)udp_msg_types[i]);
+		print_metric_summary(sb, "gb_udp_roundtrip_seconds", labels, udp_roundtrip_latency[i]);
+	}
+
+	print_metric_header(sb, "gb_job_queue_wait_seconds", "Time a job waited in the job scheduler queue before it started.");
+	for(int i = 0; i < job_thread_type_count; i++) {
+		LatencyHistogram::Snapshot snapshot;
+		job_queue_latency[i].getSnapshot(&snapshot);
+		if(snapshot.m_count == 0)
+			continue;
+		char labels[64];
+		snprintf(labels, sizeof(labels), "thread_type=\"%s\"", thread_type_name((thread_type_t)i));
+		print_metric_summary(sb, "gb_job_queue_wait_seconds", labels, job_queue_latency[i]);
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 // statistics
 
@@ -2,6 +2,11 @@
 #define GB_STATISTICS_H
 
 #include <cstdint>
+#include "msgtype_t.h"
+#include "JobScheduler.h"
+#include "LatencyHistogram.h"
+
+class SafeBuf;
 
 namespace Statistics {
 
@@ -12,7 +17,14 @@ void register_query_time(unsigned term_count, unsigned qlang, int error_code, un
 
 void register_spider_time( bool is_new, int error_code, int http_status, unsigned ms );
 
-void register_io_time( bool is_write, int error_code, unsigned long bytes, unsigned ms );
+void register_io_time( bool is_write, int error_code, unsigned long bytes, uint64_t us );
+
+void register_udp_roundtrip_time( msg_type_t msg_type, uint64_t us );
+
+//take a snapshot of the udp round trip times of a msg type. Returns false if the type isn't tracked
+bool get_udp_roundtrip_snapshot( msg_type_t msg_type, LatencyHistogram::Snapshot *snapshot );
+
+void register_job_queue_time( thread_type_t thread_type, uint64_t us );
 
 void register_document_encoding(int error_code, int16_t charsetId, uint8_t langId, uint16_t countryId);
 
@@ -30,6 +42,9 @@ void increment_url_block_counter_default();
 
 void increment_crawl_ban_counter(const char *group);
 
+//print the latency histograms in the prometheus text exposition format
+void print_metrics(SafeBuf *sb);
+
 } //namespace
 
 #endif
@@ -44,6 +44,7 @@ void Stats::clearMsgStats() {
 	memset(m_acksIn, 0, sizeof(m_acksIn));
 	memset(m_acksOut, 0, sizeof(m_acksOut));
 	memset(m_reroutes, 0, sizeof(m_reroutes));
+	memset(m_hedges, 0, sizeof(m_hedges));
 	memset(m_errors, 0, sizeof(m_errors));
 	memset(m_timeouts, 0, sizeof(m_timeouts));
 	memset(m_nomem, 0, sizeof(m_nomem));
@@ -93,6 +93,7 @@ class Stats {
 	int32_t m_acksIn     [MAX_MSG_TYPES][2];
 	int32_t m_acksOut    [MAX_MSG_TYPES][2];
 	int32_t m_reroutes   [MAX_MSG_TYPES][2];
+	int32_t m_hedges     [MAX_MSG_TYPES][2]; // hedged requests sent
 	int32_t m_errors     [MAX_MSG_TYPES][2];
 	int32_t m_timeouts   [MAX_MSG_TYPES][2]; // specific error
 	int32_t m_nomem      [MAX_MSG_TYPES][2]; // specific error
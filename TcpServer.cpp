@@ -791,15 +791,16 @@ TcpSocket *TcpServer::getNewSocket ( ) {
 		//::close(sd);
 		sd = newSock;
 	}
-	if ( sd >= MAX_NUM_FDS ) {
-		log("tcp: using statically linked libc that only supports "
-		    "an fd of up to %" PRId32", but got an fd = %" PRId32". fd_set is "
-		    "only geared for 1024 bits of file descriptors for "
-		    "doing poll() in Loop.cpp. Ensure 'ulimit -a' limits "
-		    "open files to 1024. "
+	// select() in Loop.cpp only handles fds below FD_SETSIZE, epoll
+	// handles all the fds Loop has slots for
+	int32_t maxFd = g_loop.isUsingEpoll() ? MAX_NUM_FDS : FD_SETSIZE;
+	if ( sd >= maxFd ) {
+		log("tcp: Loop.cpp only supports "
+		    "an fd of up to %" PRId32", but got an fd = %" PRId32". "
+		    "Ensure 'ulimit -n' limits open files to %" PRId32". "
 		    "Check open fds using ls /proc/<gb-pid>/fds/ and ensure "
-		    "they are all BELOW 1024.",
-		    (int32_t)MAX_NUM_FDS,(int32_t)sd);
+		    "they are all BELOW %" PRId32".",
+		    maxFd,(int32_t)sd,maxFd,maxFd);
 		g_process.shutdownAbort(true); 
 	}
 	// return NULL and set g_errno on failure
@@ -2627,7 +2628,8 @@ bool TcpServer::sendChunk( TcpSocket *s, SafeBuf *sb, void *state,
 			   // so that it can read another chunk and call
 			   // sendChunk() again.
 			   void ( *doneSendingWrapper )( void *, TcpSocket * ) ) {
-	log( "tcp: sending chunk of %" PRId32 " bytes sd=%i", sb->length(), s->m_sd );
+	if ( g_conf.m_logDebugTcp )
+		log( LOG_DEBUG, "tcp: sending chunk of %" PRId32 " bytes sd=%i", sb->length(), s->m_sd );
 
 	// if socket had shit on there already, free that memory
 	// just like TcpServer::destroySocket would
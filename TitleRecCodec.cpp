@@ -0,0 +1,262 @@
+#include "TitleRecCodec.h"
+#include "TitleRecVersion.h"
+#include "GbCompress.h"
+#include "Collectiondb.h"
+#include "Hostdb.h"
+#include "Dir.h"
+#include "Conf.h"
+#include "Log.h"
+#include "GbMutex.h"
+#include "ScopedLock.h"
+#include "fctypes.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <map>
+#include <algorithm>
+#include <memory>
+
+
+//don't look for new dictionary files of a collection more often than this
+static const int32_t s_dictReloadInterval = 60;
+
+namespace {
+struct Dict {
+	explicit Dict(const std::string &data)
+	  : m_data(data),
+	    m_zstd((const unsigned char*)m_data.data(), m_data.size()) {
+	}
+	std::string m_data;
+	GbZstdDict m_zstd;
+};
+
+struct CollDicts {
+	CollDicts() : m_currentDictId(0), m_loadTime(0) {}
+	uint32_t m_currentDictId; //0 if there is no titlerec.dict
+	std::map<uint32_t, std::shared_ptr<const Dict> > m_dicts;
+	int32_t m_loadTime;
+};
+} //anonymous namespace
+
+static GbMutex s_mtx;
+static std::map<collnum_t, CollDicts> s_collDicts;
+
+
+static bool readFile(const char *filename, std::string *content) {
+	FILE *fp = fopen(filename, "r");
+	if(!fp)
+		return false;
+	content->clear();
+	char buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		content->append(buf, n);
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+
+static bool writeFile(const char *filename, const std::string &content) {
+	char tmpFilename[1024];
+	snprintf(tmpFilename, sizeof(tmpFilename), "%s.tmp", filename);
+	FILE *fp = fopen(tmpFilename, "w");
+	if(!fp) {
+		log(LOG_WARN, "titlerec: Could not create %s: %s", tmpFilename, strerror(errno));
+		return false;
+	}
+	bool ok = fwrite(content.data(), 1, content.size(), fp) == content.size();
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok || rename(tmpFilename, filename) != 0) {
+		log(LOG_WARN, "titlerec: Could not write %s: %s", filename, strerror(errno));
+		unlink(tmpFilename);
+		return false;
+	}
+	return true;
+}
+
+
+//(re)load the dictionary files of a collection. caller holds s_mtx
+static void loadCollDicts(collnum_t collnum, CollDicts *cd) {
+	cd->m_loadTime = getTime();
+
+	const CollectionRec *cr = g_collectiondb.getRec(collnum);
+	if(!cr)
+		return;
+
+	char dirname[1024];
+	snprintf(dirname, sizeof(dirname), "%scoll.%s.%" PRId32"/", g_hostdb.m_dir, cr->m_coll, (int32_t)collnum);
+
+	Dir dir;
+	if(!dir.set(dirname) || !dir.open())
+		return;
+
+	std::string dict;
+	while(const char *filename = dir.getNextFilename("titlerec-*.dict")) {
+		char path[sizeof(dirname)+256];
+		snprintf(path, sizeof(path), "%s%s", dirname, filename);
+		if(!readFile(path, &dict) || dict.empty()) {
+			log(LOG_WARN, "titlerec: Could not read dictionary %s", path);
+			continue;
+		}
+		uint32_t dictId = gbdictid((const unsigned char*)dict.data(), dict.size());
+		if(cd->m_dicts.find(dictId) == cd->m_dicts.end()) {
+			cd->m_dicts[dictId] = std::make_shared<const Dict>(dict);
+			log(LOG_INFO, "titlerec: Loaded dictionary %s (%zu bytes, id=%08x)", path, dict.size(), dictId);
+		}
+	}
+
+	char path[sizeof(dirname)+64];
+	snprintf(path, sizeof(path), "%stitlerec.dict", dirname);
+	cd->m_currentDictId = 0;
+	if(readFile(path, &dict) && !dict.empty()) {
+		uint32_t dictId = gbdictid((const unsigned char*)dict.data(), dict.size());
+		// it must also be kept for reading once it is replaced
+		if(cd->m_dicts.find(dictId) == cd->m_dicts.end()) {
+			log(LOG_WARN, "titlerec: %s has no titlerec-%08x.dict copy. Not using it.", path, dictId);
+		} else {
+			cd->m_currentDictId = dictId;
+		}
+	}
+}
+
+
+static std::shared_ptr<const Dict> getCurrentDict(collnum_t collnum) {
+	ScopedLock sl(s_mtx);
+	std::map<collnum_t, CollDicts>::iterator it = s_collDicts.find(collnum);
+	if(it == s_collDicts.end()) {
+		it = s_collDicts.insert(std::make_pair(collnum, CollDicts())).first;
+		loadCollDicts(collnum, &it->second);
+	}
+	if(it->second.m_currentDictId == 0)
+		return std::shared_ptr<const Dict>();
+	return it->second.m_dicts[it->second.m_currentDictId];
+}
+
+
+static std::shared_ptr<const Dict> getDict(collnum_t collnum, uint32_t dictId) {
+	ScopedLock sl(s_mtx);
+	std::map<collnum_t, CollDicts>::iterator it = s_collDicts.find(collnum);
+	if(it == s_collDicts.end()) {
+		it = s_collDicts.insert(std::make_pair(collnum, CollDicts())).first;
+		loadCollDicts(collnum, &it->second);
+	} else if(it->second.m_dicts.find(dictId) == it->second.m_dicts.end() &&
+		  getTime() - it->second.m_loadTime >= s_dictReloadInterval) {
+		// it may have been copied here after we loaded
+		loadCollDicts(collnum, &it->second);
+	}
+	std::map<uint32_t, std::shared_ptr<const Dict> >::const_iterator dit = it->second.m_dicts.find(dictId);
+	if(dit == it->second.m_dicts.end())
+		return std::shared_ptr<const Dict>();
+	return dit->second;
+}
+
+
+uint32_t TitleRecCodec::compressBound(uint32_t sourceLen) {
+	// . according to zlib.h line 613 compress buffer must be .1% larger
+	//   than source plus 12 bytes. (i add one for round off error)
+	// . now i added another extra 12 bytes cuz compress seemed to want it
+	// . plus 4 for the dictionary id when compressing with a dictionary
+	uint32_t zlibBound = ((uint64_t)sourceLen * 1001ULL) / 1000ULL + 13 + 12 + 4;
+	uint32_t zstdBound = gbzstdcompressbound(sourceLen) + 4;
+	return std::max(zlibBound, zstdBound);
+}
+
+
+static void storeDictId(unsigned char *p, uint32_t dictId) {
+	p[0] = (unsigned char)(dictId >> 24);
+	p[1] = (unsigned char)(dictId >> 16);
+	p[2] = (unsigned char)(dictId >> 8);
+	p[3] = (unsigned char)dictId;
+}
+
+
+static uint32_t loadDictId(const unsigned char *p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+
+int TitleRecCodec::compress(collnum_t collnum, unsigned char *dest, uint32_t *destLen,
+			    const unsigned char *source, uint32_t sourceLen, int32_t *codec) {
+	std::shared_ptr<const Dict> dict;
+	if(g_conf.m_titleRecDictCompression)
+		dict = getCurrentDict(collnum);
+
+	if(g_conf.m_titleRecZstdCompression) {
+		if(dict) {
+			if(*destLen < 4)
+				return Z_BUF_ERROR;
+			*codec = TITLEREC_CODEC_ZSTD_DICT;
+			storeDictId(dest, gbdictid((const unsigned char*)dict->m_data.data(), dict->m_data.size()));
+			uint32_t len = *destLen - 4;
+			int err = gbzstdcompress(dest + 4, &len, source, sourceLen, &dict->m_zstd);
+			if(err == Z_OK)
+				*destLen = len + 4;
+			return err;
+		}
+
+		*codec = TITLEREC_CODEC_ZSTD;
+		return gbzstdcompress(dest, destLen, source, sourceLen);
+	}
+
+	if(dict) {
+		*codec = TITLEREC_CODEC_ZLIB_DICT;
+		return gbcompress(dest, destLen, source, sourceLen, (const unsigned char*)dict->m_data.data(), dict->m_data.size());
+	}
+
+	*codec = TITLEREC_CODEC_ZLIB;
+	return gbcompress(dest, destLen, source, sourceLen);
+}
+
+
+int TitleRecCodec::uncompress(collnum_t collnum, int32_t codec, unsigned char *dest, uint32_t *destLen,
+			      const unsigned char *source, uint32_t sourceLen) {
+	switch(codec) {
+		case TITLEREC_CODEC_ZLIB:
+			return gbuncompress(dest, destLen, source, sourceLen);
+		case TITLEREC_CODEC_ZLIB_DICT: {
+			uint32_t dictId = gbgetdictid(source, sourceLen);
+			std::shared_ptr<const Dict> dict = getDict(collnum, dictId);
+			if(!dict) {
+				log(LOG_ERROR, "titlerec: Missing dictionary %08x for collnum %" PRId32, dictId, (int32_t)collnum);
+				return Z_NEED_DICT;
+			}
+			return gbuncompress(dest, destLen, source, sourceLen, (const unsigned char*)dict->m_data.data(), dict->m_data.size());
+		}
+		case TITLEREC_CODEC_ZSTD:
+			return gbzstduncompress(dest, destLen, source, sourceLen);
+		case TITLEREC_CODEC_ZSTD_DICT: {
+			if(sourceLen < 4)
+				return Z_DATA_ERROR;
+			uint32_t dictId = loadDictId(source);
+			std::shared_ptr<const Dict> dict = getDict(collnum, dictId);
+			if(!dict) {
+				log(LOG_ERROR, "titlerec: Missing dictionary %08x for collnum %" PRId32, dictId, (int32_t)collnum);
+				return Z_NEED_DICT;
+			}
+			return gbzstduncompress(dest, destLen, source + 4, sourceLen - 4, &dict->m_zstd);
+		}
+		default:
+			log(LOG_ERROR, "titlerec: Unknown compression codec %" PRId32, codec);
+			return Z_DATA_ERROR;
+	}
+}
+
+
+bool TitleRecCodec::saveDictionary(const char *dir, const std::string &dict) {
+	uint32_t dictId = gbdictid((const unsigned char*)dict.data(), dict.size());
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/titlerec-%08x.dict", dir, dictId);
+	if(!writeFile(path, dict))
+		return false;
+
+	snprintf(path, sizeof(path), "%s/titlerec.dict", dir);
+	return writeFile(path, dict);
+}
+
+
+void TitleRecCodec::reset() {
+	ScopedLock sl(s_mtx);
+	s_collDicts.clear();
+}
@@ -0,0 +1,44 @@
+#ifndef GB_TITLERECCODEC_H_
+#define GB_TITLERECCODEC_H_
+
+#include "collnum_t.h"
+#include <inttypes.h>
+#include <string>
+
+//Compression of the titlerec data (everything after the key, dataSize and
+//uncompressed size). The codec used is stored in the uncompressed size field,
+//see TitleRecVersion.h.
+//
+//New titlerecs are compressed with zstd or zlib, see the "compress titlerecs
+//with zstd" parm. Both can use the collection's dictionary.
+//
+//A collection can have shared dictionaries trained on its titlerecs (see
+//tools/train_titlerec_dict). They are kept in the collection directory:
+//  titlerec.dict            - the dictionary new titlerecs are compressed with
+//  titlerec-<dictid>.dict   - every dictionary ever used, for reading
+//All hosts must have the same dictionary files since a titlerec compressed on
+//one host is read on its twins.
+namespace TitleRecCodec {
+
+//size of the "dest" buffer compress() needs for "sourceLen" bytes
+uint32_t compressBound(uint32_t sourceLen);
+
+//compress "source" into "dest". returns a zlib error code and sets *codec to
+//the TITLEREC_CODEC_* used
+int compress(collnum_t collnum, unsigned char *dest, uint32_t *destLen,
+	     const unsigned char *source, uint32_t sourceLen, int32_t *codec);
+
+//uncompress titlerec data that was compressed with "codec". returns a zlib
+//error code, Z_NEED_DICT if we don't have the dictionary it was compressed with
+int uncompress(collnum_t collnum, int32_t codec, unsigned char *dest, uint32_t *destLen,
+	       const unsigned char *source, uint32_t sourceLen);
+
+//save a dictionary as the one to compress new titlerecs of "dir" with
+bool saveDictionary(const char *dir, const std::string &dict);
+
+//forget the loaded dictionaries (they are reloaded when needed)
+void reset();
+
+} //namespace TitleRecCodec
+
+#endif // GB_TITLERECCODEC_H_
@@ -24,4 +24,22 @@
 // new adult detection
 #define TITLEREC_CURRENT_VERSION	126
 
+// . the uncompressed size stored in front of the compressed titlerec data
+//   has the compression codec in its top bits
+// . titlerecs from before the codec field have 0 there, which is zlib
+// . the uncompressed size of a titlerec must fit in the low 28 bits
+#define TITLEREC_CODEC_SHIFT		28
+#define TITLEREC_CODEC_MASK		0x70000000
+#define TITLEREC_UNCOMPRESSED_SIZE_MASK	0x0fffffff
+
+// plain zlib
+#define TITLEREC_CODEC_ZLIB		0
+// zlib with a preset dictionary trained on the titlerecs of the collection
+#define TITLEREC_CODEC_ZLIB_DICT	1
+// zstd
+#define TITLEREC_CODEC_ZSTD		2
+// zstd with the same dictionary. the dictionary id (big endian) is stored
+// in front of the zstd frame
+#define TITLEREC_CODEC_ZSTD_DICT	3
+
 #endif // GB_TITLERECVERSION_H
@@ -510,6 +510,35 @@ bool TopTree::addNode ( TopNode *t , int32_t tnn ) {
 }
 
 
+bool TopTree::addNodes ( TopTree *src ) {
+	// nothing to merge?
+	if ( src->m_numNodes == 0 || src->m_numUsedNodes == 0 ) return true;
+
+	if ( m_numNodes == 0 ) {
+		if ( ! setNumNodes ( src->m_docsWanted, src->m_doSiteClustering ) )
+			return false;
+		m_useIntScores = src->m_useIntScores;
+	}
+
+	// add from the high scorer down so the low scorers are the ones
+	// that are kicked out if we are full
+	for ( int32_t si = src->getHighNode(); si >= 0; si = src->getPrev(si) ) {
+		const TopNode *s = src->getNode(si);
+		int32_t tn = getEmptyNode();
+		TopNode *t = getNode(tn);
+		t->m_score        = s->m_score;
+		t->m_docId        = s->m_docId;
+		t->m_flags        = s->m_flags;
+		t->m_intScore     = s->m_intScore;
+		t->m_clusterLevel = s->m_clusterLevel;
+		t->m_clusterRec   = s->m_clusterRec;
+		addNode ( t, tn );
+	}
+
+	return true;
+}
+
+
 // . remove this node from the tree
 // . used to remove the last node and replace it with a higher scorer
 void TopTree::deleteNode ( int32_t i , uint8_t domHash ) {
@@ -51,6 +51,12 @@ class TopTree {
 	//   m_numNodes == m_numUsedNodes
 	bool addNode ( TopNode *t , int32_t tnn );
 
+	// . add all nodes of "src" to this tree, used for merging the trees
+	//   of parallel intersections
+	// . sizes this tree like "src" if it has not been set up yet
+	// . returns false and sets g_errno on error
+	bool addNodes ( TopTree *src );
+
 	int32_t getLowNode  ( ) { return m_lowNode ; }
 	// . this is computed and stored on demand
 	// . WARNING: only call after all nodes have been added!
@@ -6,6 +6,7 @@
 #include "Hostdb.h"
 #include "Profiler.h"
 #include "Stats.h"
+#include "Statistics.h"
 #include "Proxy.h"
 #include "Process.h"
 #include "Loop.h"
@@ -54,6 +55,10 @@ void UdpServer::reset() {
 	m_slots = NULL;
 	if ( m_buf ) mfree ( m_buf , m_bufSize , "UdpServer");
 	m_buf = NULL;
+	if ( m_readBatchBuf ) mfree ( m_readBatchBuf , UDP_READ_BATCH*UDP_READ_BUFFER_SIZE , "UdpServer");
+	m_readBatchBuf = NULL;
+	m_readBatchCount = 0;
+	m_readBatchPos = 0;
 }
 
 
@@ -62,6 +67,9 @@ UdpServer::UdpServer ( ) {
 	m_slots = NULL;
 	m_maxSlots = 0;
 	m_buf = NULL;
+	m_readBatchBuf = NULL;
+	m_readBatchCount = 0;
+	m_readBatchPos = 0;
 	m_writeRegistered = false;
 
 	// Coverity
@@ -206,6 +214,15 @@ bool UdpServer::init ( uint16_t port, UdpProtocol *proto,
 	memset ( m_ptrs , 0 , sizeof(UdpSlot *)*m_numBuckets );
 	log(LOG_DEBUG,"udp: Allocated %" PRId32" bytes for table.",m_bufSize);
 
+	// buffers for receiving a batch of dgrams with one system call
+	m_readBatchBuf = (char *)mmalloc ( UDP_READ_BATCH*UDP_READ_BUFFER_SIZE , "UdpServer" );
+	if ( ! m_readBatchBuf ) {
+		log("udp: Failed to allocate %" PRId32" bytes for read buffers.",(int32_t)(UDP_READ_BATCH*UDP_READ_BUFFER_SIZE));
+		return false;
+	}
+	m_readBatchCount = 0;
+	m_readBatchPos = 0;
+
 	m_numUsedSlots   = 0;
 	m_numUsedSlotsIncoming   = 0;
 	// clear this
@@ -880,38 +897,68 @@ void UdpServer::readPollWrapper(int fd, void *state) {
 }
 
 
+int32_t UdpServer::readBatch_unlocked() {
+	m_mtx.verify_is_locked();
+
+	m_readBatchCount = 0;
+	m_readBatchPos = 0;
+
+	// without batching we still use recvmmsg() but for one dgram at a time
+	int32_t maxDgrams = g_conf.m_udpBatchIo ? UDP_READ_BATCH : 1;
+	for ( int32_t i = 0; i < maxDgrams; i++ ) {
+		m_readBatchIov[i].iov_base = m_readBatchBuf + i*UDP_READ_BUFFER_SIZE;
+		m_readBatchIov[i].iov_len  = UDP_READ_BUFFER_SIZE;
+		memset ( &m_readBatchMsgs[i], 0, sizeof(m_readBatchMsgs[i]) );
+		m_readBatchMsgs[i].msg_hdr.msg_name    = &m_readBatchAddrs[i];
+		m_readBatchMsgs[i].msg_hdr.msg_namelen = sizeof(m_readBatchAddrs[i]);
+		m_readBatchMsgs[i].msg_hdr.msg_iov     = &m_readBatchIov[i];
+		m_readBatchMsgs[i].msg_hdr.msg_iovlen  = 1;
+	}
+
+	int rc = recvmmsg ( m_sock, m_readBatchMsgs, maxDgrams, MSG_DONTWAIT, NULL );
+	if ( rc < 0 )
+		return -1;
+
+	m_readBatchCount = rc;
+	return rc;
+}
+
 // . returns -1 on error, 0 if blocked, 1 if completed reading dgram
 int32_t UdpServer::readSock(UdpSlot **slotPtr, int64_t now) {
 	ScopedLock sl(m_mtx);
 
 	// NULLify slot
 	*slotPtr = NULL;
-	sockaddr_in from;
-	socklen_t fromLen = sizeof ( struct sockaddr );
-	char readBuffer[64*1024];
-	int readSize = recvfrom ( m_sock,
-				  readBuffer,
-				  sizeof(readBuffer),
-				  0,                        //flags
-				  (sockaddr *)(void*)&from,
-				  &fromLen);
-
-	logDebug(g_conf.m_logDebugLoop, "loop: readsock: readSize=%i m_sock/fd=%i", readSize,m_sock);
-
-	// cancel silly g_errnos and return 0 since we blocked
-	if ( readSize < 0 ) {
-		g_errno = errno;
 
-		if ( g_errno == 0 || g_errno == EILSEQ || g_errno == EAGAIN ) {
-			g_errno = 0;
-			return 0;
-		}
+	// get more dgrams from the kernel if we processed all we had
+	if ( m_readBatchPos >= m_readBatchCount ) {
+		int32_t numRead = readBatch_unlocked();
 
-		// Interrupted system call (4) (from valgrind)
-		log( LOG_WARN, "udp: readDgram: %s (%d).", mstrerror( g_errno ), g_errno );
-		return -1;
+		logDebug(g_conf.m_logDebugLoop, "loop: readsock: numRead=%" PRId32" m_sock/fd=%i", numRead,m_sock);
+
+		// cancel silly g_errnos and return 0 since we blocked
+		if ( numRead < 0 ) {
+			g_errno = errno;
+
+			if ( g_errno == 0 || g_errno == EILSEQ || g_errno == EAGAIN ) {
+				g_errno = 0;
+				return 0;
+			}
+
+			// Interrupted system call (4) (from valgrind)
+			log( LOG_WARN, "udp: readDgram: %s (%d).", mstrerror( g_errno ), g_errno );
+			return -1;
+		}
+		if ( numRead == 0 )
+			return 0;
 	}
 
+	// take the next dgram from the batch
+	sockaddr_in from = m_readBatchAddrs[m_readBatchPos];
+	const char *readBuffer = m_readBatchBuf + m_readBatchPos*UDP_READ_BUFFER_SIZE;
+	int readSize = m_readBatchMsgs[m_readBatchPos].msg_len;
+	m_readBatchPos++;
+
 	uint32_t ip2;
 	Host *h;
 	key96_t key;
@@ -1502,6 +1549,8 @@ bool UdpServer::makeCallback(UdpSlot *slot) {
 			g_stats.m_nomem[msgType][slot->getNiceness()]++;
 		else if ( g_errno ) 
 			g_stats.m_errors[msgType][slot->getNiceness()]++;
+		else
+			Statistics::register_udp_roundtrip_time(msgType, gettimeofdayInMicroseconds() - slot->m_startTimeUs);
 
 		if ( g_conf.m_maxCallbackDelay >= 0 ) {
 			start = gettimeofdayInMilliseconds();
@@ -35,10 +35,17 @@
 #include "GbMutex.h"
 #include <inttypes.h>
 #include <atomic>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 
 static const int64_t udpserver_sendrequest_infinite_timeout = 999999999999;
 
+// how many dgrams we receive with one recvmmsg() call
+#define UDP_READ_BATCH 16
+// the size of the buffer for each received dgram
+#define UDP_READ_BUFFER_SIZE (64*1024)
+
 class UdpSlot;
 class Host;
 
@@ -247,6 +254,11 @@ private:
 	// . called by readPoll()
 	int32_t readSock(UdpSlot **slot, int64_t now);
 
+	// . receive as many dgrams as are pending (up to UDP_READ_BATCH) into
+	//   the read batch with one system call
+	// . returns -1 and sets errno on error, otherwise the number received
+	int32_t readBatch_unlocked();
+
 	void sendReply_unlocked(char *msg, int32_t msgSize, char *alloc, int32_t allocSize, UdpSlot *slot, void *state = NULL,
 	                        void (*callback2)(void *state, UdpSlot *slot) = NULL);
 
@@ -314,6 +326,15 @@ private:
 	char *m_buf;     // memory to hold m_ptrs
 	int32_t m_bufSize;
 
+	// dgrams received by readBatch_unlocked() that readSock() has not
+	// processed yet. m_readBatchBuf holds UDP_READ_BATCH buffers
+	char *m_readBatchBuf;
+	struct mmsghdr m_readBatchMsgs[UDP_READ_BATCH];
+	struct iovec m_readBatchIov[UDP_READ_BATCH];
+	sockaddr_in m_readBatchAddrs[UDP_READ_BATCH];
+	int32_t m_readBatchCount;
+	int32_t m_readBatchPos;
+
 	// linked list of available slots (uses UdpSlot::m_next)
 	UdpSlot *m_availableListHead;
 
@@ -11,6 +11,9 @@
 #include "Conf.h"
 #include "ip.h"
 #include "Mem.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/udp.h>
 #ifdef _VALGRIND_
 #include <valgrind/memcheck.h>
 #endif
@@ -80,6 +83,85 @@ int32_t g_cancelAcksRead = 0;
 // see comment above for why we put this back from 12 to 4
 #define ACK_WINDOW_SIZE_LB    4
 
+// max number of dgrams sent with one system call. the ack windows above
+// limit it further
+#define UDP_SEND_BATCH 16
+
+// generic segmentation offload for udp, linux 4.18+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+// cleared if the kernel or the network device does not support UDP_SEGMENT
+static bool s_useGso = true;
+
+
+// . send "numDgrams" dgrams, each made of two iovecs, to "to"
+// . if all but the last dgram are "segmentSize" bytes they are sent as one
+//   big dgram that the kernel splits up (UDP_SEGMENT), otherwise with one
+//   sendmmsg() call
+// . returns the number of dgrams sent and their sizes in "bytesSent", or
+//   -1 and sets errno on error
+static int32_t sendDatagrams(int sock, struct sockaddr_in *to, struct iovec (*iov)[2], const int32_t *dgramSizes,
+                             int32_t numDgrams, int32_t segmentSize, int *bytesSent) {
+	if ( numDgrams > 1 && s_useGso ) {
+		bool allFull = true;
+		for ( int32_t i = 0; i < numDgrams-1; i++ )
+			if ( dgramSizes[i] != segmentSize )
+				allFull = false;
+		int32_t totalSize = (numDgrams-1)*segmentSize + dgramSizes[numDgrams-1];
+		if ( allFull && totalSize <= 65000 ) {
+			struct msghdr mh;
+			memset ( &mh, 0, sizeof(mh) );
+			mh.msg_name    = to;
+			mh.msg_namelen = sizeof(*to);
+			mh.msg_iov     = &iov[0][0];
+			mh.msg_iovlen  = numDgrams*2;
+			char control [ CMSG_SPACE(sizeof(uint16_t)) ];
+			memset ( control, 0, sizeof(control) );
+			mh.msg_control    = control;
+			mh.msg_controllen = sizeof(control);
+			struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+			cm->cmsg_level = SOL_UDP;
+			cm->cmsg_type  = UDP_SEGMENT;
+			cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+			uint16_t gsoSize = (uint16_t)segmentSize;
+			memcpy ( CMSG_DATA(cm), &gsoSize, sizeof(gsoSize) );
+
+			int rc = sendmsg ( sock, &mh, 0 );
+			if ( rc >= 0 ) {
+				// it is all or nothing
+				for ( int32_t i = 0; i < numDgrams; i++ )
+					bytesSent[i] = rc == totalSize ? dgramSizes[i] : 0;
+				return numDgrams;
+			}
+			if ( errno != EIO && errno != EINVAL && errno != ENOPROTOOPT && errno != EOPNOTSUPP )
+				return -1;
+			// not supported here. fall back to sendmmsg()
+			log(LOG_INFO, "udp: UDP segmentation offload not supported (%s). Using sendmmsg().", mstrerror(errno));
+			s_useGso = false;
+		}
+	}
+
+	struct mmsghdr msgs [ UDP_SEND_BATCH ];
+	memset ( msgs, 0, sizeof(msgs[0])*numDgrams );
+	for ( int32_t i = 0; i < numDgrams; i++ ) {
+		msgs[i].msg_hdr.msg_name    = to;
+		msgs[i].msg_hdr.msg_namelen = sizeof(*to);
+		msgs[i].msg_hdr.msg_iov     = iov[i];
+		msgs[i].msg_hdr.msg_iovlen  = 2;
+	}
+	int rc = sendmmsg ( sock, msgs, numDgrams, 0 );
+	if ( rc <= 0 ) {
+		if ( rc == 0 )
+			errno = EAGAIN;
+		return -1;
+	}
+	for ( int32_t i = 0; i < rc; i++ )
+		bytesSent[i] = msgs[i].msg_len;
+	return rc;
+}
+
 void UdpSlot::connect ( UdpProtocol *proto    ,
 			sockaddr_in *endPoint ,
 			Host        *host     ,
@@ -124,6 +206,7 @@ void UdpSlot::connect ( UdpProtocol    *proto    ,
 	m_niceness = niceness ;
 	// initialize our time of birth
 	m_startTime = now;
+	m_startTimeUs = gettimeofdayInMicroseconds();
 	// reset this
 	m_queuedTime = -1;
 	
@@ -519,14 +602,20 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	// . MTU is very high here
 	if ( ip_distance(m_ip)==ip_distance_ourselves )
 		ip = g_hostdb.getLoopbackIp();
-	// pick a dgram to send
-	int32_t dgramNum = m_nextToSend;
-
-	// . store dgram #dgramNum from this send buf into "dgram"
-	// . let the protocol set the dgram from the m_sendBuf for us
-	char buf [ DGRAM_SIZE_CEILING ];
-	// should hold all headers
-	char saved [ 32 ];
+	// . pick the dgrams to send: the next ones not sent yet, as many as
+	//   the ack window allows
+	// . with batch io they are all sent with one system call
+	int32_t window = ACK_WINDOW_SIZE;
+	if ( ip_distance(m_ip)==ip_distance_ourselves ) window = ACK_WINDOW_SIZE_LB;
+	int32_t maxDgrams = m_readAckBitsOn + window - m_sentBitsOn;
+	if ( maxDgrams > UDP_SEND_BATCH ) maxDgrams = UDP_SEND_BATCH;
+	if ( maxDgrams < 1 || ! g_conf.m_udpBatchIo ) maxDgrams = 1;
+	int32_t dgramNums[UDP_SEND_BATCH];
+	int32_t numDgrams = 0;
+	for ( int32_t d = m_nextToSend; d < m_dgramsToSend && numDgrams < maxDgrams;
+	      d = getNextUnlitBit ( d, m_sentBits2, m_dgramsToSend ) )
+		dgramNums[numDgrams++] = d;
+
 	// the header size
 	int32_t headerSize = m_proto->getHeaderSize(0);
 	// bitch if too big
@@ -536,37 +625,36 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	// . now from here on we only use headerSize so we can strip the header
 	// . so if the protocol wants the headers, leave them in...
 	if ( ! m_proto->stripHeaders() ) headerSize = 0;
-	// offset into send buffer, the data to send
-	int32_t offset = dgramNum * ( m_maxDgramSize - headerSize );
-	// what should we send, and how much?
-	char *send      = m_sendBuf     + offset;
-	int32_t  sendSize  = m_sendBufSize - offset;
+
+	// . each dgram is sent as its header followed by its data straight
+	//   from the send buffer, so nothing is copied
+	char headers [ UDP_SEND_BATCH ][ 32 ];
+	struct iovec iov [ UDP_SEND_BATCH ][ 2 ];
+	int32_t dgramSizes [ UDP_SEND_BATCH ];
+	for ( int32_t i = 0; i < numDgrams; i++ ) {
+		// offset into send buffer, the data to send
+		int32_t offset = dgramNums[i] * ( m_maxDgramSize - headerSize );
+		// what should we send, and how much?
+		char *send      = m_sendBuf     + offset;
+		int32_t  sendSize  = m_sendBufSize - offset;
 #ifdef _VALGRIND_
-	VALGRIND_CHECK_MEM_IS_DEFINED(send,sendSize);
+		VALGRIND_CHECK_MEM_IS_DEFINED(send,sendSize);
 #endif
-	// truncate to max size of dgram we're allowed
-	if ( sendSize > m_maxDgramSize - headerSize ) 
-		sendSize = m_maxDgramSize - headerSize;
-	// where to store the dgram, header and data, assume "buf"
-	char *dgram = buf;
-	// size of dgram, header and data
-	int32_t  dgramSize = headerSize + sendSize;
-	// if we're NOT the 1st dgram we can store into send buf directly
-	if ( dgramNum != 0 ) {
-		// where to store the header? right into send buf
-		dgram = send - headerSize;
-		// but save before overwriting
-		gbmemcpy ( saved , dgram , headerSize );
-	}
-	// store header into "dgram"
-	m_proto->setHeader(dgram, m_sendBufSize, m_msgType, dgramNum, m_transId, m_callback, m_localErrno, m_niceness);
+		// truncate to max size of dgram we're allowed
+		if ( sendSize > m_maxDgramSize - headerSize ) 
+			sendSize = m_maxDgramSize - headerSize;
+		// store header
+		m_proto->setHeader(headers[i], m_sendBufSize, m_msgType, dgramNums[i], m_transId, m_callback, m_localErrno, m_niceness);
 #ifdef _VALGRIND_
-	VALGRIND_CHECK_MEM_IS_DEFINED(dgram,headerSize);
+		VALGRIND_CHECK_MEM_IS_DEFINED(headers[i],headerSize);
 #endif
-	// . if we're the first dgram, we can't back up for the header...
-	// . copy data into dgram if we're the 1st dgram
-	if ( dgramNum == 0 )
-		gbmemcpy ( dgram + headerSize , send , sendSize );
+		iov[i][0].iov_base = headers[i];
+		iov[i][0].iov_len  = headerSize;
+		iov[i][1].iov_base = send;
+		iov[i][1].iov_len  = sendSize;
+		// size of dgram, header and data
+		dgramSizes[i] = headerSize + sendSize;
+	}
 
 	// if we are the proxy sending a udp packet to our flock, then make
 	// sure that we send to tmp cluster if we should
@@ -584,11 +672,9 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 	//to.sin_addr.s_addr = .... more complicated than that
 	to.sin_port        = htons ( m_port );
 	// are we sending to loopback? if so, treat as eth0.
+	bool isOutsider = false;
 	if ( ip_distance(ip) == ip_distance_ourselves ) {
 		to.sin_addr.s_addr = ip;
-		// update stats, just put them all in g_udpServer
-		g_udpServer.m_eth0PacketsOut += 1;
-		g_udpServer.m_eth0BytesOut   += dgramSize;
 	} else if ( m_host ) {
 		if ( m_preferEth == 1 ) {
 			// we now pick ip based on this. if we fail to get a timely ACK
@@ -597,30 +683,21 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 		} else {
 			to.sin_addr.s_addr = m_host->m_ip;
 		}
-
-		// update stats, just put them all in g_udpServer
-		g_udpServer.m_eth0PacketsOut += 1;
-		g_udpServer.m_eth0BytesOut   += dgramSize;
 	} else {
 		// count packets to/from hosts outside the cluster separately
 		// these guys are importing link text usually
 		to.sin_addr.s_addr = ip;
-		g_udpServer.m_outsiderPacketsOut += 1;
-		g_udpServer.m_outsiderBytesOut   += dgramSize;
+		isOutsider = true;
 	}
 
 	// . this socket should be non-blocking (i.e. return immediately)
 	// . this should set g_errno on error!
 	// MSG_DONTROUTE makes dns fail
-	int bytesSent = sendto(sock, dgram, dgramSize, 0, (struct sockaddr *) (void *) &to, sizeof(to));
-
-	// restore what we overwrote
-	if ( dgramNum != 0 ) {
-		gbmemcpy ( dgram , saved , headerSize );
-	}
+	int bytesSent [ UDP_SEND_BATCH ];
+	int32_t numSent = sendDatagrams ( sock, &to, iov, dgramSizes, numDgrams, m_maxDgramSize, bytesSent );
 
 	// return -1 on error or 0 if blocked
-	if ( bytesSent < 0 ) {
+	if ( numSent < 0 ) {
 		// copy errno to g_errno
 		g_errno = errno;
 		if ( g_errno == EAGAIN  ) { g_errno = 0; return 0;}
@@ -649,90 +726,101 @@ int32_t UdpSlot::sendDatagramOrAck ( int sock, bool allowResends, int64_t now ){
 		// . actually, just pretend we sent it. we won't get an ack
 		//   and the resend algo will switch ports
 		//return -1;
-		bytesSent = dgramSize;
-	}
-	// this should not happen
-	if ( bytesSent != dgramSize ) {
-		g_errno = EBADENGINEER;
-		log(LOG_WARN, "udp: sendto only sent %i bytes, not %" PRId32". Undersend.", bytesSent,dgramSize);
-		return -1;
+		numSent = numDgrams;
+		for ( int32_t i = 0; i < numDgrams; i++ )
+			bytesSent[i] = dgramSizes[i];
 	}
-	// general count
-	if ( m_niceness == 0 ) g_stats.m_packetsOut[m_msgType][0]++;
-	else                   g_stats.m_packetsOut[m_msgType][1]++;
-	// keep stats
-	if ( m_host ) m_host->m_dgramsTo++;
-	// keep track of dgrams sent outside of our cluster
-	//else          g_stats.m_dgramsToStrangers++;
-	// get time now
-	//int64_t  now = gettimeofdayInMilliseconds();
-	// . if it's our first, mark this for g_stats UDP_*_OUT_BPS
-	// . sendSetup() will set m_firstSendTime to -1
-	if (m_sentBitsOn == 0 && m_firstSendTime == -1) m_firstSendTime =now;
-	// mark this dgram as sent
-	setBit ( dgramNum , m_sentBits2 );
-	// count the bit we lit
-	m_sentBitsOn++;
-	// update last send time stamp even if we're a resend
-	m_lastSendTime = now;
-	// update m_nextToSend
-	m_nextToSend = getNextUnlitBit ( dgramNum, m_sentBits2,m_dgramsToSend);
-	// log network info
-	if ( g_conf.m_logDebugUdp ) {
-		//int32_t shotgun = 0;
-		//if ( g_conf.m_useShotgun &&   s_useShotgunIp ) shotgun = 1;
-		int32_t eth = 1;
-		if ( m_host && m_host->m_ip == to.sin_addr.s_addr ) eth = 0;
-		// if sending outside, always use eth0
-		if ( ! m_host ) eth = 0;
-		//if ( m_host->m_ip == (uint32_t)ip ) eth = 0;
-		int32_t hid = -1;
-		if ( m_host )
-			hid = m_host->m_hostId;
 
-		int32_t kk = 0; if ( m_callback ) kk = 1;
-		char ipbuf[16];
-		log(LOG_DEBUG,
-		    "udp: sent dgram "
-		    "dgram=%" PRId32" "
-		    "dgrams=%" PRId32" "
-		    "msg=0x%02x "
-		    "tid=%" PRId32" "
-		    "dst=%s:%hu "
-		    "eth=%" PRId32" "
-		    "init=%" PRId32" "
-		    "age=%" PRId32" "
-		    "dsent=%" PRId32" "
-		    "aread=%" PRId32" "
-		    "len=%" PRId32" "
-		    "msgSz=%" PRId32" "
-		    "cnt=%" PRId32" "
-		    "wait=%" PRId32" "
-		    "error=%" PRId32" "
-		    "k.n1=%" PRIu32" n0=%" PRIu64" "
-		    "maxdgramsz=%" PRId32" "
-		    "hid=%" PRId32 " "
-		    "bytesSent=%d",
-		    (int32_t)dgramNum, 
-		    (int32_t)m_dgramsToSend,
-		    (int16_t)m_msgType,
-		    m_transId,
-		    iptoa(to.sin_addr.s_addr,ipbuf),
-		    (uint16_t)m_port,
-		    eth,//shotgun,
-		    (int32_t)kk ,
-		    (int32_t)(now-m_startTime) ,
-		    (int32_t)m_sentBitsOn , 
-		    (int32_t)m_readAckBitsOn ,
-		    (int32_t)bytesSent ,
-		    (int32_t)m_sendBufSize, 
-		    (int32_t)m_resendCount, 
-		    (int32_t)m_resendTime ,
-		    (int32_t)m_localErrno ,
-		    m_key.n1,m_key.n0 ,
-		    m_maxDgramSize ,
-		    hid,
-		    bytesSent);
+	for ( int32_t i = 0; i < numSent; i++ ) {
+		int32_t dgramNum  = dgramNums[i];
+		int32_t dgramSize = dgramSizes[i];
+		// this should not happen
+		if ( bytesSent[i] != dgramSize ) {
+			g_errno = EBADENGINEER;
+			log(LOG_WARN, "udp: sendto only sent %i bytes, not %" PRId32". Undersend.", bytesSent[i],dgramSize);
+			return -1;
+		}
+		// update stats, just put them all in g_udpServer
+		if ( isOutsider ) {
+			g_udpServer.m_outsiderPacketsOut += 1;
+			g_udpServer.m_outsiderBytesOut   += dgramSize;
+		} else {
+			g_udpServer.m_eth0PacketsOut += 1;
+			g_udpServer.m_eth0BytesOut   += dgramSize;
+		}
+		// general count
+		if ( m_niceness == 0 ) g_stats.m_packetsOut[m_msgType][0]++;
+		else                   g_stats.m_packetsOut[m_msgType][1]++;
+		// keep stats
+		if ( m_host ) m_host->m_dgramsTo++;
+		// . if it's our first, mark this for g_stats UDP_*_OUT_BPS
+		// . sendSetup() will set m_firstSendTime to -1
+		if (m_sentBitsOn == 0 && m_firstSendTime == -1) m_firstSendTime =now;
+		// mark this dgram as sent
+		setBit ( dgramNum , m_sentBits2 );
+		// count the bit we lit
+		m_sentBitsOn++;
+		// update last send time stamp even if we're a resend
+		m_lastSendTime = now;
+		// update m_nextToSend
+		m_nextToSend = getNextUnlitBit ( dgramNum, m_sentBits2,m_dgramsToSend);
+		// log network info
+		if ( g_conf.m_logDebugUdp ) {
+			//int32_t shotgun = 0;
+			//if ( g_conf.m_useShotgun &&   s_useShotgunIp ) shotgun = 1;
+			int32_t eth = 1;
+			if ( m_host && m_host->m_ip == to.sin_addr.s_addr ) eth = 0;
+			// if sending outside, always use eth0
+			if ( ! m_host ) eth = 0;
+			//if ( m_host->m_ip == (uint32_t)ip ) eth = 0;
+			int32_t hid = -1;
+			if ( m_host )
+				hid = m_host->m_hostId;
+
+			int32_t kk = 0; if ( m_callback ) kk = 1;
+			char ipbuf[16];
+			log(LOG_DEBUG,
+			    "udp: sent dgram "
+			    "dgram=%" PRId32" "
+			    "dgrams=%" PRId32" "
+			    "msg=0x%02x "
+			    "tid=%" PRId32" "
+			    "dst=%s:%hu "
+			    "eth=%" PRId32" "
+			    "init=%" PRId32" "
+			    "age=%" PRId32" "
+			    "dsent=%" PRId32" "
+			    "aread=%" PRId32" "
+			    "len=%" PRId32" "
+			    "msgSz=%" PRId32" "
+			    "cnt=%" PRId32" "
+			    "wait=%" PRId32" "
+			    "error=%" PRId32" "
+			    "k.n1=%" PRIu32" n0=%" PRIu64" "
+			    "maxdgramsz=%" PRId32" "
+			    "hid=%" PRId32 " "
+			    "bytesSent=%d",
+			    (int32_t)dgramNum, 
+			    (int32_t)m_dgramsToSend,
+			    (int16_t)m_msgType,
+			    m_transId,
+			    iptoa(to.sin_addr.s_addr,ipbuf),
+			    (uint16_t)m_port,
+			    eth,//shotgun,
+			    (int32_t)kk ,
+			    (int32_t)(now-m_startTime) ,
+			    (int32_t)m_sentBitsOn , 
+			    (int32_t)m_readAckBitsOn ,
+			    (int32_t)bytesSent[i] ,
+			    (int32_t)m_sendBufSize, 
+			    (int32_t)m_resendCount, 
+			    (int32_t)m_resendTime ,
+			    (int32_t)m_localErrno ,
+			    m_key.n1,m_key.n0 ,
+			    m_maxDgramSize ,
+			    hid,
+			    bytesSent[i]);
+		}
 	}
 
 	// return 1 cuz we didn't block
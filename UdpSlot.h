@@ -388,6 +388,8 @@ private:
 	// . birth time of the udpslot
 	// . m_sendTimes are relative to this
 	int64_t m_startTime;
+	// same in microseconds for the round trip latency histograms
+	int64_t m_startTimeUs;
 
 	// these are for measuring bps (bandwidth) for g_stats
 	int64_t m_firstSendTime;
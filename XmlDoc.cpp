@@ -29,6 +29,7 @@
 #include "Domains.h"
 #include "FxAdultCheck.h"
 #include "Doledb.h"
+#include "SpiderLoop.h"
 #include "IPAddressChecks.h"
 #include "PageRoot.h"
 #include "BitOperations.h"
@@ -38,6 +39,7 @@
 #include "Process.h"
 #include "Statistics.h"
 #include "GbCompress.h"
+#include "TitleRecCodec.h"
 #include "GbUtil.h"
 #include "ScopedLock.h"
 #include "Mem.h"
@@ -118,6 +120,9 @@ XmlDoc::XmlDoc() {
 	m_statusMsg = NULL;
 	m_errno = 0;
 	m_docId = 0;
+	m_msge0 = NULL;
+	m_msge1 = NULL;
+	m_matches = NULL;
 
 	reset();
 }
@@ -307,8 +312,21 @@ void XmlDoc::reset ( ) {
 	m_dupList.reset();
 	m_msg8a.reset();
 	m_msg13.reset();
-	m_msge0.reset();
-	m_msge1.reset();
+	if ( m_msge0 ) {
+		mdelete ( m_msge0 , sizeof(Msge0) , "xdmsge0" );
+		delete m_msge0;
+		m_msge0 = NULL;
+	}
+	if ( m_msge1 ) {
+		mdelete ( m_msge1 , sizeof(Msge1) , "xdmsge1" );
+		delete m_msge1;
+		m_msge1 = NULL;
+	}
+	if ( m_matches ) {
+		mdelete ( m_matches , sizeof(Matches) , "xdmatches" );
+		delete m_matches;
+		m_matches = NULL;
+	}
 	m_reply.reset();
 	// mroe stuff skipped
 
@@ -911,7 +929,13 @@ bool XmlDoc::set2 ( char    *titleRec ,
 	int32_t cbufSize = dataSize + 4 + sizeof(key96_t);
 	// . the actual data follows "dataSize"
 	// . what's the size of the uncompressed compressed stuff below here?
+	// . the top bits hold the compression codec (see TitleRecVersion.h)
 	m_ubufSize = *(int32_t  *) p ; p += 4;
+	int32_t codec = TITLEREC_CODEC_ZLIB;
+	if ( m_ubufSize > 0 ) {
+		codec = ( m_ubufSize & TITLEREC_CODEC_MASK ) >> TITLEREC_CODEC_SHIFT;
+		m_ubufSize &= TITLEREC_UNCOMPRESSED_SIZE_MASK;
+	}
 
 	// . because of disk/network data corruption this may be wrong!
 	// . we can now have absolutely huge titlerecs...
@@ -966,10 +990,18 @@ bool XmlDoc::set2 ( char    *titleRec ,
 	setStatus( "Uncompressing title rec." );
 	// . uncompress the data into m_ubuf
 	// . m_ubufSize should remain unchanged since we stored it
-	int err = gbuncompress ( (unsigned char *)  m_ubuf ,
-				 (uint32_t *) &realSize   ,
-				 (unsigned char *)  p ,
-				 (uint32_t  ) (dataSize - 4) );
+	int err = TitleRecCodec::uncompress ( m_collnum ,
+					      codec ,
+					      (unsigned char *)  m_ubuf ,
+					      (uint32_t *) &realSize   ,
+					      (unsigned char *)  p ,
+					      (uint32_t  ) (dataSize - 4) );
+	// we don't have the dictionary it was compressed with
+	if ( err == Z_NEED_DICT ) {
+		log(LOG_ERROR, "!!! Missing titlerec compression dictionary for docId %" PRId64 ". Copy the titlerec-*.dict files from the other hosts.", m_docId);
+		g_errno = EUNCOMPRESSERROR;
+		return false;
+	}
 	// hmmmm...
 	if ( err == Z_BUF_ERROR ) {
 		log(LOG_ERROR, "!!! Buffer is too small to hold uncompressed document. Probable disk corruption in a titledb file.");
@@ -2879,6 +2911,13 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 		// add it in
 		m_internalFlags1 |= mask;
 	}
+	// the uncompressed size shares its header word with the codec
+	if ( need1 <= 0 || need1 > TITLEREC_UNCOMPRESSED_SIZE_MASK ) {
+		g_errno = EBUFTOOSMALL;
+		log(LOG_WARN, "xmldoc: titlerec of %" PRId32" bytes is too big for docid %" PRId64,
+		    need1, docId);
+		return false;
+	}
 	// alloc the buffer
 	char *ubuf = (char *) mmalloc ( need1 , "xdtrb" );
 	// return NULL with g_errno set on error
@@ -2925,10 +2964,8 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 	if ( p != ubuf + need1 ) { g_process.shutdownAbort(true); }
 
 	// . make a buf big enough to hold compressed, we'll realloc afterwards
-	// . according to zlib.h line 613 compress buffer must be .1% larger
-	//   than source plus 12 bytes. (i add one for round off error)
-	// . now i added another extra 12 bytes cuz compress seemed to want it
-	int32_t need2 = ((int64_t)need1 * 1001LL) / 1000LL + 13 + 12;
+	// worst case compressed size of any titlerec codec
+	int32_t need2 = TitleRecCodec::compressBound ( need1 );
 
 	// we also need to store a key then regular dataSize then
 	// the uncompressed size in cbuf before the compression of m_ubuf
@@ -2954,10 +2991,13 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 	// . uncompress the data into ubuf
 	// . this will reset cbufSize to a smaller value probably
 	// . "size" is set to how many bytes we wrote into "cbuf + hdrSize"
-	int err = gbcompress ( (unsigned char *)cbuf + hdrSize,
-			       (uint32_t *)&size,
-			       (unsigned char *)ubuf ,
-			       (uint32_t  )need1 );
+	int32_t codec = TITLEREC_CODEC_ZLIB;
+	int err = TitleRecCodec::compress ( m_collnum ,
+					    (unsigned char *)cbuf + hdrSize,
+					    (uint32_t *)&size,
+					    (unsigned char *)ubuf ,
+					    (uint32_t  )need1 ,
+					    &codec );
 
 	// free the buf we were trying to compress now
 	mfree ( ubuf , need1 , "trub" );
@@ -2995,8 +3035,8 @@ bool XmlDoc::setTitleRecBuf ( SafeBuf *tbuf, int64_t docId, int64_t uh48 ){
 	*(int32_t  *) p = dataSize ;
 	p += 4;
 
-	// store uncompressed size in header
-	*(int32_t  *) p = need1;
+	// store uncompressed size and the codec in header
+	*(int32_t  *) p = need1 | ( codec << TITLEREC_CODEC_SHIFT );
 	p += 4;
 
 	// sanity check
@@ -7305,12 +7345,11 @@ bool *XmlDoc::getIsAllowed ( ) {
 	}
 
 
-	/// @todo ALC cache robots instead of robots.txt
-	// initialize robots
-	Robots robots( content, contentLen, g_conf.m_spiderBotName );
+	// get parsed robots (shared with other docs of the same site)
+	std::shared_ptr<const Robots> robots = Robots::getRobots( content, contentLen, g_conf.m_spiderBotName );
 
-	m_isAllowed = robots.isAllowed( cu );
-	m_crawlDelay = robots.getCrawlDelay();
+	m_isAllowed = robots->isAllowed( cu );
+	m_crawlDelay = robots->getCrawlDelay();
 
 	if( m_crawlDelay == -1 ) {
 		// robots.txt found, but it contains no crawl-delay for us. Set to configured default.
@@ -7862,6 +7901,11 @@ static void gotHttpReplyWrapper ( void *state ) {
 	XmlDoc *THIS = (XmlDoc *)state;
 	// this sets g_errno on error
 	THIS->gotHttpReply ( );
+	// . the spider loop bounds how many downloaded docs are parsed and
+	//   indexed at once. it resumes us later if we have to wait
+	// . errors are handled right away since g_errno would not survive
+	//   the wait
+	if ( ! g_errno && ! g_spiderLoop.admitToParse ( THIS ) ) return;
 	// resume. this checks g_errno for being set.
 	THIS->m_masterLoop ( THIS->m_masterState );
 }
@@ -10649,8 +10693,8 @@ TagRec ***XmlDoc::getOutlinkTagRecVector () {
 	logTrace( g_conf.m_logTraceXmlDoc, "BEGIN" );
 
 	// error?
-	if ( m_outlinkTagRecVectorValid && m_msge0.getErrno() ) {
-		g_errno = m_msge0.getErrno();
+	if ( m_outlinkTagRecVectorValid && m_msge0->getErrno() ) {
+		g_errno = m_msge0->getErrno();
 		logTrace( g_conf.m_logTraceXmlDoc, "END, g_errno %" PRId32, g_errno);
 		return NULL;
 	}
@@ -10659,7 +10703,7 @@ TagRec ***XmlDoc::getOutlinkTagRecVector () {
 	if ( m_outlinkTagRecVectorValid )
 	{
 		logTrace( g_conf.m_logTraceXmlDoc, "END, already valid (and not fake IPs)" );
-		return m_msge0.getTagRecPtrsPtr();
+		return m_msge0->getTagRecPtrsPtr();
 	}
 
 	Links *links = getLinks();
@@ -10686,10 +10730,20 @@ TagRec ***XmlDoc::getOutlinkTagRecVector () {
 		return (TagRec ***)gr;
 	}
 
+	if ( ! m_msge0 ) {
+		try { m_msge0 = new ( Msge0 ); }
+		catch(std::bad_alloc&) {
+			g_errno = ENOMEM;
+			logTrace( g_conf.m_logTraceXmlDoc, "END - out of memory" );
+			return NULL;
+		}
+		mnew ( m_msge0 , sizeof(Msge0) , "xdmsge0" );
+	}
+
 	// assume valid
 	m_outlinkTagRecVectorValid = true;
 	// go get it
-	if ( ! m_msge0.getTagRecs ( const_cast<const char **>(links->m_linkPtrs),
+	if ( ! m_msge0->getTagRecs ( const_cast<const char **>(links->m_linkPtrs),
 				    links->m_linkFlags ,
 				    links->m_numLinks  ,
 				    // make it point to this basetagrec if
@@ -10715,8 +10769,8 @@ TagRec ***XmlDoc::getOutlinkTagRecVector () {
 	}
 
 	// or this?
-	if ( m_msge0.getErrno() ) {
-		g_errno = m_msge0.getErrno();
+	if ( m_msge0->getErrno() ) {
+		g_errno = m_msge0->getErrno();
 		logTrace( g_conf.m_logTraceXmlDoc, "END, m_msge0.m_errno=%" PRId32, g_errno);
 		return NULL;
 	}
@@ -10724,7 +10778,7 @@ TagRec ***XmlDoc::getOutlinkTagRecVector () {
 	//m_outlinkTagRecVector = m_msge0.m_tagRecPtrs;
 	// ptr to a list of ptrs to tag recs
 	logTrace( g_conf.m_logTraceXmlDoc, "END, got list" );
-	return m_msge0.getTagRecPtrsPtr();
+	return m_msge0->getTagRecPtrsPtr();
 }
 
 
@@ -10734,15 +10788,15 @@ int32_t **XmlDoc::getOutlinkFirstIpVector () {
 	if ( ! links ) return NULL;
 
 	// error?
-	if ( m_outlinkTagRecVectorValid && m_msge1.getErrno() ) {
-		g_errno = m_msge1.getErrno();
+	if ( m_outlinkTagRecVectorValid && m_msge1 && m_msge1->getErrno() ) {
+		g_errno = m_msge1->getErrno();
 		logTrace( g_conf.m_logTraceXmlDoc, "END, g_errno %" PRId32, g_errno);
 		return NULL;
 	}
 
 	// return msge1's buf otherwise
 	if ( m_outlinkIpVectorValid )
-		return m_msge1.getIpBufPtr();
+		return m_msge1->getIpBufPtr();
 
 	// should we have some kinda error for msge1?
 	//if ( m_outlinkIpVectorValid && m_msge1.m_errno ) {
@@ -10761,6 +10815,15 @@ int32_t **XmlDoc::getOutlinkFirstIpVector () {
 	if ( ! grv || grv == (void *)-1 ) return (int32_t **)grv;
 	// note it
 	setStatus ( "getting outlink first ip vector" );
+	if ( ! m_msge1 ) {
+		try { m_msge1 = new ( Msge1 ); }
+		catch(std::bad_alloc&) {
+			g_errno = ENOMEM;
+			logTrace( g_conf.m_logTraceXmlDoc, "END - out of memory" );
+			return NULL;
+		}
+		mnew ( m_msge1 , sizeof(Msge1) , "xdmsge1" );
+	}
 	// assume valid
 	m_outlinkIpVectorValid = true;
 	// sanity check
@@ -10779,7 +10842,7 @@ int32_t **XmlDoc::getOutlinkFirstIpVector () {
 	// . this will now update Tagdb with the "firstip" tags if it should!!
 	// . this just dns looks up the DOMAINS of each outlink because these
 	//   are *first* ips and ONLY used by Spider.cpp for throttling!!!
-	if ( ! m_msge1.getFirstIps ( *grv               ,
+	if ( ! m_msge1->getFirstIps ( *grv               ,
 				     const_cast<const char**>(links->m_linkPtrs),
 				     links->m_linkFlags ,
 				     links->m_numLinks  ,
@@ -10795,14 +10858,14 @@ int32_t **XmlDoc::getOutlinkFirstIpVector () {
 	// error?
        	if ( g_errno ) return NULL;
 	// or this?
-	if ( m_msge1.getErrno() ) {
-		g_errno = m_msge1.getErrno();
+	if ( m_msge1->getErrno() ) {
+		g_errno = m_msge1->getErrno();
 		logTrace( g_conf.m_logTraceXmlDoc, "END, m_msge1.m_errno=%" PRId32, g_errno);
 		return NULL;
 	}
 	// . ptr to a list of ptrs to tag recs
 	// . ip will be -1 on error
-	return m_msge1.getIpBufPtr();
+	return m_msge1->getIpBufPtr();
 }
 
 int32_t *XmlDoc::getUrlFilterNum ( ) {
@@ -15966,12 +16029,21 @@ Query *XmlDoc::getQuery() {
 
 Matches *XmlDoc::getMatches () {
 	// return it if it is set
-	if ( m_matchesValid ) return &m_matches;
+	if ( m_matchesValid ) return m_matches;
+
+	if ( ! m_matches ) {
+		try { m_matches = new ( Matches ); }
+		catch(std::bad_alloc&) {
+			g_errno = ENOMEM;
+			return NULL;
+		}
+		mnew ( m_matches , sizeof(Matches) , "xdmatches" );
+	}
 
 	// if no query, matches are empty
 	if ( ! m_req || ! m_req->ptr_qbuf ) {
 		m_matchesValid = true;
-		return &m_matches;
+		return m_matches;
 	}
 
 	// need a buncha crap
@@ -15996,13 +16068,13 @@ Matches *XmlDoc::getMatches () {
 	int64_t start = logQueryTimingStart();
 
 	// set it up
-	m_matches.setQuery ( q );
+	m_matches->setQuery ( q );
 
 	LinkInfo *linkInfo = getLinkInfo1();
 	if(linkInfo==(LinkInfo*)-1)
 		linkInfo = NULL;
 	// returns false and sets g_errno on error
-	if ( !m_matches.set( ww, phrases, ss, bits, pos, xml, ti, getFirstUrl(), linkInfo ) ) {
+	if ( !m_matches->set( ww, phrases, ss, bits, pos, xml, ti, getFirstUrl(), linkInfo ) ) {
 		return NULL;
 	}
 
@@ -16010,7 +16082,7 @@ Matches *XmlDoc::getMatches () {
 
 	// we got it
 	m_matchesValid = true;
-	return &m_matches;
+	return m_matches;
 }
 
 // sender wants meta description, custom tags, etc.
@@ -936,8 +936,11 @@ public:
 	int32_t m_hostHash32a;
 	int32_t m_domHash32;
 
-	Msge0 m_msge0;
-	Msge1 m_msge1;
+	// . the outlink lookups and the query matches are big so they are
+	//   only allocated when needed. that keeps a doc that is waiting on
+	//   its download small
+	Msge0 *m_msge0;
+	Msge1 *m_msge1;
 
 	Json *getParsedJson();
 	// object that parses the json
@@ -966,7 +969,7 @@ public:
 
 	const char *m_note;
 	Query m_query;
-	Matches m_matches;
+	Matches *m_matches;
 	// meta description buf
 	int32_t m_dbufSize;
 	char m_dbuf[1024];
@@ -1212,6 +1212,7 @@ int main2 ( int argc , char *argv[] ) {
 		log( LOG_ERROR, "db: JobScheduler init failed." );
 		return 1;
 	}
+	g_jobScheduler.set_work_stealing(g_conf.m_jobWorkStealing, g_conf.m_jobWorkStealingMaxNiceness);
 	
 	// put in read only mode
 	if ( useTmpCluster ) {
@@ -1224,6 +1225,11 @@ int main2 ( int argc , char *argv[] ) {
 		return 1;
 	}
 
+	// needs g_loop. falls back to the io threads if not supported
+	if ( g_conf.m_useIoUring ) {
+		BigFile::initializeIoUring(g_conf.m_ioUringQueueDepth);
+	}
+
 	// the new way to save all rdbs and conf
 	// must call after Loop::init() so it can register its sleep callback
 	g_process.init();
@@ -2262,6 +2268,7 @@ static bool registerMsgHandlers2() {
 	if ( ! Msg13::registerHandler() ) return false;
 
 	if ( ! Msg39::registerHandler()) return false;
+	if ( ! Msg3a::initResultCache() ) return false;
 
 	if ( ! Msg4In::registerHandler() ) return false;
 	if ( ! Msg4::initializeOutHandling() ) return false;
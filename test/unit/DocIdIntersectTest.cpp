@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "DocIdIntersect.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+static std::vector<uint64_t> makeSortedKeys(size_t count, uint64_t maxKey, bool allowDups) {
+	std::vector<uint64_t> keys;
+	for (size_t i = 0; i < count; i++) {
+		keys.push_back(((uint64_t)rand() * RAND_MAX + rand()) % maxKey);
+	}
+	std::sort(keys.begin(), keys.end());
+	if (!allowDups) {
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	}
+	return keys;
+}
+
+static void verifyKernel(DocIdIntersect::intersect_fn_t fn, const std::vector<uint64_t> &a, const std::vector<uint64_t> &b) {
+	size_t maxMatches = std::min(a.size(), b.size()) + 1;
+	std::vector<uint32_t> expectedA(maxMatches), expectedB(maxMatches);
+	std::vector<uint32_t> matchA(maxMatches), matchB(maxMatches);
+
+	size_t expected = DocIdIntersect::intersectScalar(a.data(), a.size(), b.data(), b.size(), expectedA.data(), expectedB.data());
+	size_t n = fn(a.data(), a.size(), b.data(), b.size(), matchA.data(), matchB.data());
+
+	ASSERT_EQ(expected, n);
+	for (size_t i = 0; i < n; i++) {
+		EXPECT_EQ(expectedA[i], matchA[i]);
+		EXPECT_EQ(expectedB[i], matchB[i]);
+		EXPECT_EQ(a[matchA[i]], b[matchB[i]]);
+	}
+}
+
+static void verifyAllKernels(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b) {
+	verifyKernel(DocIdIntersect::intersectGalloping, a, b);
+	verifyKernel(DocIdIntersect::getBlockKernel(), a, b);
+	verifyKernel(DocIdIntersect::intersectSSE42, a, b);
+	if (__builtin_cpu_supports("avx2")) {
+		verifyKernel(DocIdIntersect::intersectAVX2, a, b);
+	}
+}
+
+TEST(DocIdIntersectTest, Basic) {
+	std::vector<uint64_t> a = {1, 3, 5, 7, 9, 11, 13};
+	std::vector<uint64_t> b = {2, 3, 4, 5, 6, 13, 14};
+
+	std::vector<uint32_t> matchA(7), matchB(7);
+	size_t n = DocIdIntersect::intersect(a.data(), a.size(), b.data(), b.size(), matchA.data(), matchB.data());
+	ASSERT_EQ(3U, n);
+	EXPECT_EQ(1U, matchA[0]);
+	EXPECT_EQ(1U, matchB[0]);
+	EXPECT_EQ(2U, matchA[1]);
+	EXPECT_EQ(3U, matchB[1]);
+	EXPECT_EQ(6U, matchA[2]);
+	EXPECT_EQ(5U, matchB[2]);
+
+	verifyAllKernels(a, b);
+	verifyAllKernels(b, a);
+}
+
+TEST(DocIdIntersectTest, Empty) {
+	std::vector<uint64_t> a;
+	std::vector<uint64_t> b = {1, 2, 3};
+	uint32_t matchA[4], matchB[4];
+	EXPECT_EQ(0U, DocIdIntersect::intersect(a.data(), a.size(), b.data(), b.size(), matchA, matchB));
+	EXPECT_EQ(0U, DocIdIntersect::intersect(b.data(), b.size(), a.data(), a.size(), matchA, matchB));
+}
+
+TEST(DocIdIntersectTest, Random) {
+	srand(42);
+	const size_t sizes[] = {1, 3, 4, 5, 17, 100, 1000, 10000};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+			std::vector<uint64_t> a = makeSortedKeys(sizes[i], 20000, false);
+			std::vector<uint64_t> b = makeSortedKeys(sizes[j], 20000, false);
+			verifyAllKernels(a, b);
+		}
+	}
+}
+
+TEST(DocIdIntersectTest, Duplicates) {
+	srand(4242);
+	for (int i = 0; i < 50; i++) {
+		std::vector<uint64_t> a = makeSortedKeys(200, 100, true);
+		std::vector<uint64_t> b = makeSortedKeys(300, 100, true);
+		verifyAllKernels(a, b);
+	}
+}
+
+TEST(DocIdIntersectTest, VoteBufAndSubListKeys) {
+	// 6-byte vote entry and 12-byte posdb head for the same docid must decode to the same key
+	char rec[12] = {0, 0, 0, 0, 0, 0, 0, (char)0xa7, 0x12, 0x34, 0x56, 0x78};
+	char vote[6] = {(char)0xa4, 0x12, 0x34, 0x56, 0x78, 3};
+	EXPECT_EQ(DocIdIntersect::getPosdbRecKey(rec), DocIdIntersect::getVoteRecKey(vote));
+
+	// a head followed by two 6-byte keys of the same docid, then a new head
+	char subList[36] = {};
+	memcpy(subList, rec, 12);
+	subList[12] = 0x04;
+	subList[18] = 0x04;
+	memcpy(subList + 24, rec, 12);
+	subList[24 + 8] = 0x13;
+
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> offsets;
+	DocIdIntersect::decodeSubList(subList, subList + sizeof(subList), &keys, &offsets);
+	ASSERT_EQ(2U, keys.size());
+	EXPECT_EQ(0U, offsets[0]);
+	EXPECT_EQ(24U, offsets[1]);
+	EXPECT_LT(keys[0], keys[1]);
+}
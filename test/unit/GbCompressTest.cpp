@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "GbCompress.h"
+#include <string.h>
+
+static std::string makeDoc(int i) {
+	char buf[512];
+	snprintf(buf, sizeof(buf),
+	         "<html><head><title>Product %d</title><meta name=\"description\" content=\"Buy product %d online\">"
+	         "<link rel=\"stylesheet\" href=\"/static/css/main.css\"></head><body><div class=\"header\">"
+	         "<a href=\"/\">Home</a> | <a href=\"/about\">About us</a></div><p>Item %d in stock</p></body></html>",
+	         i, i * 7, i * 13);
+	return buf;
+}
+
+static std::string compress(const std::string &src, const std::string *dict) {
+	std::string dst(src.size() + src.size() / 1000 + 64, '\0');
+	uint32_t dstLen = dst.size();
+	int err;
+	if (dict) {
+		err = gbcompress((unsigned char *)&dst[0], &dstLen, (const unsigned char *)src.data(), src.size(),
+		                 (const unsigned char *)dict->data(), dict->size());
+	} else {
+		err = gbcompress((unsigned char *)&dst[0], &dstLen, (const unsigned char *)src.data(), src.size());
+	}
+	EXPECT_EQ(Z_OK, err);
+	dst.resize(dstLen);
+	return dst;
+}
+
+TEST(GbCompressTest, RoundTripNoDict) {
+	std::string doc = makeDoc(1);
+	std::string c = compress(doc, NULL);
+	EXPECT_EQ(0U, gbgetdictid((const unsigned char *)c.data(), c.size()));
+
+	std::string u(doc.size(), '\0');
+	uint32_t uLen = u.size();
+	EXPECT_EQ(Z_OK, gbuncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size()));
+	EXPECT_EQ(doc.size(), uLen);
+	EXPECT_EQ(doc, u);
+
+	// old records can be read with the dictionary aware function too
+	uLen = u.size();
+	std::string dict = "unused";
+	EXPECT_EQ(Z_OK, gbuncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size(),
+	                             (const unsigned char *)dict.data(), dict.size()));
+	EXPECT_EQ(doc, u);
+}
+
+TEST(GbCompressTest, RoundTripDict) {
+	std::vector<std::string> samples;
+	for (int i = 0; i < 100; i++) {
+		samples.push_back(makeDoc(i));
+	}
+
+	std::string dict;
+	ASSERT_TRUE(gbtraindict(samples, 4096, &dict));
+	EXPECT_FALSE(dict.empty());
+	EXPECT_LE(dict.size(), 4096U);
+
+	std::string doc = makeDoc(1000);
+	std::string c = compress(doc, &dict);
+	EXPECT_EQ(gbdictid((const unsigned char *)dict.data(), dict.size()), gbgetdictid((const unsigned char *)c.data(), c.size()));
+
+	// smaller than without the dictionary
+	EXPECT_LT(c.size(), compress(doc, NULL).size());
+
+	std::string u(doc.size(), '\0');
+	uint32_t uLen = u.size();
+	EXPECT_EQ(Z_OK, gbuncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size(),
+	                             (const unsigned char *)dict.data(), dict.size()));
+	EXPECT_EQ(doc.size(), uLen);
+	EXPECT_EQ(doc, u);
+
+	// without or with the wrong dictionary
+	uLen = u.size();
+	EXPECT_EQ(Z_DATA_ERROR, gbuncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size()));
+
+	std::string otherDict = dict + "x";
+	uLen = u.size();
+	EXPECT_EQ(Z_NEED_DICT, gbuncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size(),
+	                                    (const unsigned char *)otherDict.data(), otherDict.size()));
+}
+
+TEST(GbCompressTest, TrainEmpty) {
+	std::vector<std::string> samples;
+	std::string dict;
+	EXPECT_FALSE(gbtraindict(samples, 4096, &dict));
+}
+
+static std::string zstdCompress(const std::string &src, const GbZstdDict *dict) {
+	std::string dst(gbzstdcompressbound(src.size()), '\0');
+	uint32_t dstLen = dst.size();
+	EXPECT_EQ(Z_OK, gbzstdcompress((unsigned char *)&dst[0], &dstLen, (const unsigned char *)src.data(), src.size(), dict));
+	dst.resize(dstLen);
+	return dst;
+}
+
+TEST(GbCompressTest, ZstdRoundTripNoDict) {
+	std::string doc = makeDoc(1);
+	std::string c = zstdCompress(doc, NULL);
+
+	std::string u(doc.size(), '\0');
+	uint32_t uLen = u.size();
+	EXPECT_EQ(Z_OK, gbzstduncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size()));
+	EXPECT_EQ(doc.size(), uLen);
+	EXPECT_EQ(doc, u);
+
+	// destination too small
+	uLen = doc.size() / 2;
+	EXPECT_EQ(Z_BUF_ERROR, gbzstduncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size()));
+}
+
+TEST(GbCompressTest, ZstdRoundTripDict) {
+	std::vector<std::string> samples;
+	for (int i = 0; i < 100; i++) {
+		samples.push_back(makeDoc(i));
+	}
+
+	std::string dictData;
+	ASSERT_TRUE(gbtraindict(samples, 4096, &dictData));
+	GbZstdDict dict((const unsigned char *)dictData.data(), dictData.size());
+	ASSERT_TRUE(dict.isValid());
+
+	std::string doc = makeDoc(1000);
+	std::string c = zstdCompress(doc, &dict);
+
+	// smaller than without the dictionary
+	EXPECT_LT(c.size(), zstdCompress(doc, NULL).size());
+
+	std::string u(doc.size(), '\0');
+	uint32_t uLen = u.size();
+	EXPECT_EQ(Z_OK, gbzstduncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size(), &dict));
+	EXPECT_EQ(doc.size(), uLen);
+	EXPECT_EQ(doc, u);
+
+	// without the dictionary
+	uLen = u.size();
+	EXPECT_NE(Z_OK, gbzstduncompress((unsigned char *)&u[0], &uLen, (const unsigned char *)c.data(), c.size()));
+}
@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include "HttpCompression.h"
+#include "GbCompress.h"
+#include "SafeBuf.h"
+#include "Conf.h"
+#include <brotli/decode.h>
+#include <string.h>
+
+static http_encoding_t getAccepted(const char *request) {
+	return HttpCompression::getAcceptedEncoding(request, strlen(request));
+}
+
+static std::string gunzip(const SafeBuf &sb, uint32_t maxLen) {
+	std::string dst(maxLen, '\0');
+	uint32_t dstLen = dst.size();
+	EXPECT_EQ(Z_OK, gbuncompress((unsigned char *)&dst[0], &dstLen, (const unsigned char *)sb.getBufStart(), sb.length()));
+	dst.resize(dstLen);
+	return dst;
+}
+
+// decode what we have of a brotli stream. "finished" is set if it ended
+static std::string unbrotli(const SafeBuf &sb, bool *finished) {
+	BrotliDecoderState *state = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+	size_t availIn = sb.length();
+	const uint8_t *nextIn = (const uint8_t *)sb.getBufStart();
+
+	std::string dst;
+	BrotliDecoderResult result;
+	do {
+		uint8_t buf[4096];
+		size_t availOut = sizeof(buf);
+		uint8_t *nextOut = buf;
+		result = BrotliDecoderDecompressStream(state, &availIn, &nextIn, &availOut, &nextOut, NULL);
+		dst.append((const char *)buf, nextOut - buf);
+	// it can hold back output when it runs out of input
+	} while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT || BrotliDecoderHasMoreOutput(state));
+
+	EXPECT_NE(BROTLI_DECODER_RESULT_ERROR, result);
+	EXPECT_EQ(0U, availIn);
+	*finished = (result == BROTLI_DECODER_RESULT_SUCCESS);
+	BrotliDecoderDestroyInstance(state);
+	return dst;
+}
+
+static std::string makeContent() {
+	std::string content;
+	for (int i = 0; i < 200; i++) {
+		content += "{\"docId\":";
+		content += std::to_string(i * 7919);
+		content += ",\"title\":\"some result title\",\"url\":\"http://www.example.com/\"}\n";
+	}
+	return content;
+}
+
+TEST(HttpCompressionTest, AcceptedEncoding) {
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, getAccepted("GET / HTTP/1.1\r\nHost: example.com\r\n\r\n"));
+	EXPECT_EQ(HTTP_ENCODING_GZIP, getAccepted("GET / HTTP/1.1\r\nAccept-Encoding: gzip, deflate\r\n\r\n"));
+	EXPECT_EQ(HTTP_ENCODING_BROTLI, getAccepted("GET / HTTP/1.1\r\naccept-encoding: gzip, deflate, br\r\n\r\n"));
+	EXPECT_EQ(HTTP_ENCODING_GZIP, getAccepted("GET / HTTP/1.1\r\nAccept-Encoding: br;q=0, gzip;q=0.5\r\n\r\n"));
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, getAccepted("GET / HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\n\r\n"));
+	EXPECT_EQ(HTTP_ENCODING_GZIP, getAccepted("GET / HTTP/1.1\r\nAccept-Encoding: *\r\n\r\n"));
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, getAccepted("GET / HTTP/1.1\r\nAccept-Encoding: identity\r\n\r\n"));
+
+	// not in a posted body
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, getAccepted("POST / HTTP/1.1\r\nContent-Length: 22\r\n\r\n\r\nAccept-Encoding: gzip"));
+}
+
+TEST(HttpCompressionTest, AddEncodingToMime) {
+	const char *mime = "HTTP/1.0 200 OK\r\n"
+	                   "Content-Length: 1234\r\n"
+	                   "Content-Type: text/html\r\n"
+	                   "\r\n";
+	SafeBuf sb;
+	EXPECT_TRUE(HttpCompression::addEncodingToMime(mime, strlen(mime), 56, HTTP_ENCODING_GZIP, &sb));
+	EXPECT_STREQ("HTTP/1.0 200 OK\r\n"
+	             "Content-Length: 56\r\n"
+	             "Content-Type: text/html\r\n"
+	             "Content-Encoding: gzip\r\n"
+	             "Vary: Accept-Encoding\r\n"
+	             "\r\n", sb.getBufStart());
+
+	// streamed reply without a content length
+	const char *chunkedMime = "HTTP/1.1 200 OK\r\n"
+	                          "Transfer-Encoding: chunked\r\n"
+	                          "\r\n";
+	sb.reset();
+	EXPECT_TRUE(HttpCompression::addEncodingToMime(chunkedMime, strlen(chunkedMime), -1, HTTP_ENCODING_BROTLI, &sb));
+	EXPECT_STREQ("HTTP/1.1 200 OK\r\n"
+	             "Transfer-Encoding: chunked\r\n"
+	             "Content-Encoding: br\r\n"
+	             "Vary: Accept-Encoding\r\n"
+	             "\r\n", sb.getBufStart());
+}
+
+TEST(HttpCompressionTest, ReplyEncoding) {
+	const char *request = "GET /search HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n";
+	const char *json = "HTTP/1.0 200 OK\r\nContent-Length: 5000\r\nContent-Type: application/json\r\n\r\n";
+	const char *png = "HTTP/1.0 200 OK\r\nContent-Length: 5000\r\nContent-Type: image/png\r\n\r\n";
+	const char *gz = "HTTP/1.0 200 OK\r\nContent-Length: 5000\r\nContent-Encoding: gzip\r\nContent-Type: text/plain\r\n\r\n";
+
+	g_conf.m_httpCompression = true;
+	g_conf.m_httpCompressionMinSize = 1024;
+	EXPECT_EQ(HTTP_ENCODING_GZIP, HttpCompression::getReplyEncoding(request, strlen(request), json, strlen(json), 5000));
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, HttpCompression::getReplyEncoding(request, strlen(request), json, strlen(json), 100));
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, HttpCompression::getReplyEncoding(request, strlen(request), png, strlen(png), 5000));
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, HttpCompression::getReplyEncoding(request, strlen(request), gz, strlen(gz), 5000));
+
+	g_conf.m_httpCompression = false;
+	EXPECT_EQ(HTTP_ENCODING_IDENTITY, HttpCompression::getReplyEncoding(request, strlen(request), json, strlen(json), 5000));
+	g_conf.m_httpCompression = true;
+}
+
+TEST(HttpCompressionTest, GzipRoundTrip) {
+	std::string content = makeContent();
+	SafeBuf sb;
+	EXPECT_TRUE(HttpCompression::compress(HTTP_ENCODING_GZIP, 6, content.data(), content.size(), &sb));
+	EXPECT_LT(sb.length(), (int32_t)content.size() / 4);
+	EXPECT_EQ(content, gunzip(sb, content.size() * 2));
+}
+
+TEST(HttpCompressionTest, GzipStream) {
+	std::string content = makeContent();
+	HttpCompressor compressor;
+	EXPECT_TRUE(compressor.init(HTTP_ENCODING_GZIP, 6));
+
+	// every piece is flushed, the last one ends the stream
+	SafeBuf sb;
+	size_t pieceLen = content.size() / 3;
+	EXPECT_TRUE(compressor.compress(content.data(), pieceLen, false, &sb));
+	int32_t firstLen = sb.length();
+	EXPECT_GT(firstLen, 0);
+	EXPECT_TRUE(compressor.compress(content.data() + pieceLen, pieceLen, false, &sb));
+	EXPECT_GT(sb.length(), firstLen);
+	EXPECT_TRUE(compressor.compress(content.data() + 2 * pieceLen, content.size() - 2 * pieceLen, true, &sb));
+
+	EXPECT_EQ(content, gunzip(sb, content.size() * 2));
+}
+
+TEST(HttpCompressionTest, Brotli) {
+	std::string content = makeContent();
+	SafeBuf sb;
+	EXPECT_TRUE(HttpCompression::compress(HTTP_ENCODING_BROTLI, 6, content.data(), content.size(), &sb));
+	EXPECT_GT(sb.length(), 0);
+	EXPECT_LT(sb.length(), (int32_t)content.size() / 4);
+
+	bool finished = false;
+	EXPECT_EQ(content, unbrotli(sb, &finished));
+	EXPECT_TRUE(finished);
+}
+
+TEST(HttpCompressionTest, BrotliStream) {
+	std::string content = makeContent();
+	HttpCompressor compressor;
+	EXPECT_TRUE(compressor.init(HTTP_ENCODING_BROTLI, 6));
+
+	// every piece is flushed so all of it can be decoded before the stream ends
+	SafeBuf sb;
+	size_t pieceLen = content.size() / 3;
+	bool finished = true;
+	EXPECT_TRUE(compressor.compress(content.data(), pieceLen, false, &sb));
+	EXPECT_EQ(content.substr(0, pieceLen), unbrotli(sb, &finished));
+	EXPECT_FALSE(finished);
+
+	EXPECT_TRUE(compressor.compress(content.data() + pieceLen, pieceLen, false, &sb));
+	EXPECT_EQ(content.substr(0, 2 * pieceLen), unbrotli(sb, &finished));
+	EXPECT_FALSE(finished);
+
+	EXPECT_TRUE(compressor.compress(content.data() + 2 * pieceLen, content.size() - 2 * pieceLen, true, &sb));
+	EXPECT_EQ(content, unbrotli(sb, &finished));
+	EXPECT_TRUE(finished);
+}
+
+TEST(HttpCompressionTest, StaticContent) {
+	std::string content = makeContent();
+	HttpCompression::clearStatic();
+	EXPECT_TRUE(HttpCompression::addStatic("/test.json", 1000, content.data(), content.size()));
+
+	const std::string *gz = HttpCompression::getStatic("//test.json", 1000, content.size(), HTTP_ENCODING_GZIP);
+	ASSERT_TRUE(gz != NULL);
+	SafeBuf sb;
+	sb.safeMemcpy(gz->data(), gz->size());
+	EXPECT_EQ(content, gunzip(sb, content.size() * 2));
+	const std::string *br = HttpCompression::getStatic("/test.json", 1000, content.size(), HTTP_ENCODING_BROTLI);
+	ASSERT_TRUE(br != NULL);
+	sb.reset();
+	sb.safeMemcpy(br->data(), br->size());
+	bool finished = false;
+	EXPECT_EQ(content, unbrotli(sb, &finished));
+	EXPECT_TRUE(finished);
+
+	// changed since
+	EXPECT_TRUE(HttpCompression::getStatic("/test.json", 1001, content.size(), HTTP_ENCODING_GZIP) == NULL);
+	EXPECT_TRUE(HttpCompression::getStatic("/test.json", 1000, content.size(), HTTP_ENCODING_IDENTITY) == NULL);
+	HttpCompression::clearStatic();
+}
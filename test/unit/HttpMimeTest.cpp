@@ -76,6 +76,35 @@ static void expectLine(TestHttpMime *httpMime, const char *expectedLine = "") {
 	EXPECT_EQ(0, strncmp(expectedLine, httpMime->getCurrentLine(), httpMime->getCurrentLineLen()));
 }
 
+TEST(HttpMimeTest, MakeMimeChunked) {
+	HttpMime mime;
+	mime.makeMime(-1, 0, 0, 0, -1, NULL, false, "application/json", "utf-8", -1, NULL, true);
+
+	std::string str(mime.getMime(), mime.getMimeLen());
+	EXPECT_EQ(0U, str.find("HTTP/1.1 200 OK\r\n"));
+	EXPECT_NE(std::string::npos, str.find("\r\nTransfer-Encoding: chunked\r\n"));
+	EXPECT_EQ(std::string::npos, str.find("Content-Length"));
+}
+
+TEST(HttpMimeTest, FrameChunk) {
+	SafeBuf sb;
+	sb.safeStrcpy("MIME\r\n\r\n");
+	int32_t offset = sb.length();
+	sb.safeStrcpy("0123456789abcdefghij");
+	ASSERT_TRUE(HttpMime::frameChunk(&sb, offset, false));
+	EXPECT_STREQ("MIME\r\n\r\n14\r\n0123456789abcdefghij\r\n", sb.getBufStart());
+
+	sb.reset();
+	sb.safeStrcpy("tail");
+	ASSERT_TRUE(HttpMime::frameChunk(&sb, 0, true));
+	EXPECT_STREQ("4\r\ntail\r\n0\r\n\r\n", sb.getBufStart());
+
+	// nothing left to send but the end of the reply
+	sb.reset();
+	ASSERT_TRUE(HttpMime::frameChunk(&sb, 0, true));
+	EXPECT_STREQ("0\r\n\r\n", sb.getBufStart());
+}
+
 TEST(HttpMimeTest, GetNextLineSingle) {
 	char httpResponse[] =
 		"HTTP/1.1 200 OK\r\n"
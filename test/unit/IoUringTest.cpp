@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "IoUring.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <vector>
+
+static void waitForCompletions(IoUring *ring) {
+	struct pollfd pfd;
+	pfd.fd = ring->getEventFd();
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	ASSERT_EQ(1, poll(&pfd, 1, 5000));
+	ring->clearEvent();
+}
+
+TEST(IoUringTest, ReadFile) {
+	static const char *filename = "iouringtest.dat";
+	static const size_t fileSize = 64 * 1024;
+
+	std::vector<char> data(fileSize);
+	for (size_t i = 0; i < fileSize; i++) {
+		data[i] = (char)(i * 7);
+	}
+
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ((ssize_t)fileSize, write(fd, data.data(), fileSize));
+
+	IoUring ring;
+	if (!ring.init(8)) {
+		// kernel without io_uring (or disabled). nothing to test
+		close(fd);
+		unlink(filename);
+		return;
+	}
+
+	EXPECT_GE(ring.getNumEntries(), 8U);
+
+	static const int numReads = 4;
+	std::vector<char> bufs[numReads];
+	struct iovec iovs[numReads];
+	for (int i = 0; i < numReads; i++) {
+		bufs[i].resize(1000);
+		iovs[i].iov_base = bufs[i].data();
+		iovs[i].iov_len = bufs[i].size();
+		ASSERT_TRUE(ring.queueRead(fd, &iovs[i], i * 10000, i));
+	}
+	EXPECT_EQ((unsigned)numReads, ring.getNumQueued());
+	ASSERT_TRUE(ring.submit());
+	EXPECT_EQ(0U, ring.getNumQueued());
+
+	int numCompleted = 0;
+	bool seen[numReads] = {};
+	while (numCompleted < numReads) {
+		waitForCompletions(&ring);
+
+		uint64_t userData;
+		int32_t res;
+		while (ring.getCompletion(&userData, &res)) {
+			ASSERT_LT(userData, (uint64_t)numReads);
+			EXPECT_FALSE(seen[userData]);
+			seen[userData] = true;
+			EXPECT_EQ(1000, res);
+			EXPECT_EQ(0, memcmp(bufs[userData].data(), data.data() + userData * 10000, 1000));
+			numCompleted++;
+		}
+	}
+
+	// read past the end of the file
+	char tail[100];
+	struct iovec iov;
+	iov.iov_base = tail;
+	iov.iov_len = sizeof(tail);
+	ASSERT_TRUE(ring.queueRead(fd, &iov, fileSize - 10, 42));
+	ASSERT_TRUE(ring.submit());
+	waitForCompletions(&ring);
+
+	uint64_t userData;
+	int32_t res;
+	ASSERT_TRUE(ring.getCompletion(&userData, &res));
+	EXPECT_EQ(42U, userData);
+	EXPECT_EQ(10, res);
+	EXPECT_FALSE(ring.getCompletion(&userData, &res));
+
+	close(fd);
+	unlink(filename);
+}
+
+TEST(IoUringTest, QueueFull) {
+	IoUring ring;
+	if (!ring.init(4)) {
+		return;
+	}
+
+	int fd = open("/dev/zero", O_RDONLY);
+	ASSERT_GE(fd, 0);
+
+	char buf[16];
+	struct iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	unsigned i = 0;
+	for (; i < ring.getNumEntries(); i++) {
+		ASSERT_TRUE(ring.queueRead(fd, &iov, 0, i));
+	}
+	EXPECT_FALSE(ring.queueRead(fd, &iov, 0, i));
+
+	ASSERT_TRUE(ring.submit());
+	EXPECT_TRUE(ring.queueRead(fd, &iov, 0, i));
+
+	ring.reset();
+	close(fd);
+}
@@ -0,0 +1,123 @@
+#include "JobScheduler.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "BigFile.h"
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+static void msleep(int msecs) {
+	struct timespec ts;
+	ts.tv_sec = msecs/1000;
+	ts.tv_nsec = (msecs%1000)*1000000;
+	nanosleep(&ts,NULL);
+}
+static bool job_a_started=false;
+static void start_routine_a(void *) {
+	job_a_started = true;
+	msleep(200);
+}
+static bool job_b_started=false;
+static void start_routine_b(void *) {
+	job_b_started = true;
+	msleep(200);
+}
+static void finish_routine(void *, job_exit_t) {
+}
+
+int main(void) {
+	g_conf.m_maxMem = 1000000000LL;
+	g_mem.init();
+	
+	//without work stealing the second intersect job waits for the only cpu thread
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,0,0,0);
+		
+		job_a_started = false;
+		job_b_started = false;
+		js.submit(start_routine_a, finish_routine, NULL, thread_type_query_intersect, 0);
+		js.submit(start_routine_b, finish_routine, NULL, thread_type_query_intersect, 0);
+		
+		msleep(50);
+		assert(job_a_started);
+		assert(!job_b_started);
+		msleep(250);
+		assert(job_b_started);
+		
+		msleep(200);
+		js.cleanup_finished_jobs();
+		js.finalize();
+	}
+	
+	//with work stealing the idle summary thread runs it
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,0,0,0);
+		js.set_work_stealing(true,0);
+		
+		job_a_started = false;
+		job_b_started = false;
+		js.submit(start_routine_a, finish_routine, NULL, thread_type_query_intersect, 0);
+		js.submit(start_routine_b, finish_routine, NULL, thread_type_query_intersect, 0);
+		
+		msleep(50);
+		assert(job_a_started);
+		assert(job_b_started);
+		
+		msleep(250);
+		js.cleanup_finished_jobs();
+		auto stats = js.query_job_statistics(true);
+		assert(stats[thread_type_query_intersect].job_count==2);
+		assert(stats[thread_type_query_intersect].stolen_count==1);
+		js.finalize();
+	}
+	
+	//jobs above the niceness limit are not stolen
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,0,0,0);
+		js.set_work_stealing(true,0);
+		
+		job_a_started = false;
+		job_b_started = false;
+		js.submit(start_routine_a, finish_routine, NULL, thread_type_spider_index, 1);
+		js.submit(start_routine_b, finish_routine, NULL, thread_type_spider_index, 1);
+		
+		msleep(50);
+		assert(job_a_started);
+		assert(!job_b_started);
+		msleep(250);
+		assert(job_b_started);
+		
+		msleep(200);
+		js.cleanup_finished_jobs();
+		js.finalize();
+	}
+	
+	//coordinator jobs are never stolen
+	{
+		JobScheduler js;
+		js.initialize(1,1,1,1,0,0,0);
+		js.set_work_stealing(true,0);
+		
+		job_a_started = false;
+		job_b_started = false;
+		js.submit(start_routine_a, finish_routine, NULL, thread_type_query_coordinator, 0);
+		js.submit(start_routine_b, finish_routine, NULL, thread_type_query_coordinator, 0);
+		
+		msleep(50);
+		assert(job_a_started);
+		assert(!job_b_started);
+		msleep(250);
+		assert(job_b_started);
+		
+		msleep(200);
+		js.cleanup_finished_jobs();
+		js.finalize();
+	}
+	
+	printf("success\n");
+	return 0;
+}
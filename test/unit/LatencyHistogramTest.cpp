@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "LatencyHistogram.h"
+#include <thread>
+#include <vector>
+
+TEST(LatencyHistogramTest, BucketBoundaries) {
+	// small values are exact
+	for (uint64_t v = 0; v < (uint64_t)LatencyHistogram::s_subBucketCount; v++) {
+		EXPECT_EQ(v, LatencyHistogram::getBucketHighestValue(LatencyHistogram::getBucketIndex(v)));
+	}
+
+	// every value lands in a bucket that covers it with less than 3.2% error
+	for (uint64_t v = 64; v < 100000000; v = v * 21 / 20 + 1) {
+		int32_t index = LatencyHistogram::getBucketIndex(v);
+		ASSERT_GE(index, 0);
+		ASSERT_LT(index, LatencyHistogram::s_numBuckets);
+		uint64_t highest = LatencyHistogram::getBucketHighestValue(index);
+		EXPECT_GE(highest, v);
+		EXPECT_LE(highest - v, v / 31);
+		// the next bucket starts right after
+		EXPECT_EQ(index + 1, LatencyHistogram::getBucketIndex(highest + 1));
+	}
+
+	// huge values are clamped into the last bucket
+	EXPECT_EQ(LatencyHistogram::s_numBuckets - 1, LatencyHistogram::getBucketIndex(UINT64_MAX));
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+	LatencyHistogram histogram;
+
+	LatencyHistogram::Snapshot empty;
+	histogram.getSnapshot(&empty);
+	EXPECT_EQ(0U, empty.m_count);
+	EXPECT_EQ(0U, empty.getValueAtPercentile(50.0));
+
+	for (uint64_t v = 1; v <= 10000; v++) {
+		histogram.record(v);
+	}
+
+	LatencyHistogram::Snapshot snapshot;
+	histogram.getSnapshot(&snapshot);
+	EXPECT_EQ(10000U, snapshot.m_count);
+	EXPECT_EQ(10000U * 10001U / 2, snapshot.m_sum);
+	EXPECT_EQ(10000U, snapshot.m_max);
+
+	EXPECT_NEAR(5000.0, (double)snapshot.getValueAtPercentile(50.0), 5000 * 0.035);
+	EXPECT_NEAR(9900.0, (double)snapshot.getValueAtPercentile(99.0), 9900 * 0.035);
+	EXPECT_NEAR(9990.0, (double)snapshot.getValueAtPercentile(99.9), 9990 * 0.035);
+	EXPECT_EQ(10000U, snapshot.getValueAtPercentile(100.0));
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecord) {
+	LatencyHistogram histogram;
+
+	static const int num_threads = 16;
+	static const int num_records = 10000;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; t++) {
+		threads.emplace_back([&histogram]() {
+			for (int i = 0; i < num_records; i++) {
+				histogram.record(100);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	LatencyHistogram::Snapshot snapshot;
+	histogram.getSnapshot(&snapshot);
+	EXPECT_EQ((uint64_t)num_threads * num_records, snapshot.m_count);
+	EXPECT_EQ((uint64_t)num_threads * num_records * 100, snapshot.m_sum);
+	EXPECT_EQ(100U, snapshot.m_max);
+}
+
+TEST(LatencyHistogramTest, SubtractSnapshot) {
+	LatencyHistogram histogram;
+	for (uint64_t i = 0; i < 1000; i++) {
+		histogram.record(50000);
+	}
+
+	LatencyHistogram::Snapshot earlier;
+	histogram.getSnapshot(&earlier);
+
+	for (uint64_t i = 1; i <= 100; i++) {
+		histogram.record(i * 10);
+	}
+
+	LatencyHistogram::Snapshot window;
+	histogram.getSnapshot(&window);
+	window.subtract(earlier);
+
+	EXPECT_EQ(100U, window.m_count);
+	EXPECT_EQ(50500U, window.m_sum);
+	EXPECT_EQ(LatencyHistogram::getBucketHighestValue(LatencyHistogram::getBucketIndex(1000)), window.m_max);
+	EXPECT_NEAR(950.0, (double)window.getValueAtPercentile(95.0), 950 * 0.035);
+}
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include "Loop.h"
+#include "Conf.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+static void countCallback(int /*fd*/, void *state) {
+	(*(int *)state)++;
+}
+
+// static files HttpServer sends are regular files, which epoll refuses.
+// they must still be reported ready like with select()
+TEST(LoopTest, EpollRegularFileIsReady) {
+	bool oldUseEpoll = g_conf.m_useEpoll;
+	g_conf.m_useEpoll = true;
+	ASSERT_TRUE(g_loop.init());
+	ASSERT_TRUE(g_loop.isUsingEpoll());
+
+	char filename[] = "/tmp/LoopTestXXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(5, write(fd, "hello", 5));
+
+	int numCalls = 0;
+	ASSERT_TRUE(g_loop.registerReadCallback(fd, &numCalls, countCallback, "LoopTest::countCallback", 0));
+	for (int i = 0; i < 10 && numCalls == 0; i++) {
+		g_loop.doPoll();
+	}
+	EXPECT_GT(numCalls, 0);
+
+	// no longer called once unregistered
+	g_loop.unregisterReadCallback(fd, &numCalls, countCallback);
+	numCalls = 0;
+	g_loop.doPoll();
+	EXPECT_EQ(0, numCalls);
+
+	close(fd);
+	unlink(filename);
+
+	g_loop.reset();
+	new(&g_loop) Loop(); // some variables are not Loop::reset. Call the constructor to re-initialize them
+	g_conf.m_useEpoll = oldUseEpoll;
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "Multicast.h"
+#include "Hostdb.h"
+
+static const int64_t s_nowMs = 1000000;
+
+TEST(MulticastTest, ReplyTimeEwma) {
+	Host h;
+	h.m_hostId = 1;
+
+	EXPECT_EQ(0, Multicast::getReplyTime(&h, msg_type_39, s_nowMs));
+
+	Multicast::recordReplyTime(&h, msg_type_39, 8000, s_nowMs, false);
+	EXPECT_EQ(8000, Multicast::getReplyTime(&h, msg_type_39, s_nowMs));
+
+	Multicast::recordReplyTime(&h, msg_type_39, 16000, s_nowMs, false);
+	EXPECT_EQ(9000, Multicast::getReplyTime(&h, msg_type_39, s_nowMs));
+
+	// other msg types are tracked separately
+	EXPECT_EQ(0, Multicast::getReplyTime(&h, msg_type_22, s_nowMs));
+}
+
+TEST(MulticastTest, ReplyTimeCancelledRequest) {
+	Host h;
+	h.m_hostId = 2;
+
+	Multicast::recordReplyTime(&h, msg_type_39, 8000, s_nowMs, false);
+
+	// a host that lost the race quickly must not look faster than it is
+	Multicast::recordReplyTime(&h, msg_type_39, 100, s_nowMs + 10, true);
+	EXPECT_EQ(8000, Multicast::getReplyTime(&h, msg_type_39, s_nowMs + 10));
+
+	// but a cancelled request that took longer shows that the host is slow
+	Multicast::recordReplyTime(&h, msg_type_39, 16000, s_nowMs + 20, true);
+	EXPECT_EQ(9000, Multicast::getReplyTime(&h, msg_type_39, s_nowMs + 20));
+}
+
+TEST(MulticastTest, ReplyTimeCancelledRequestUnknownHost) {
+	Host h;
+	h.m_hostId = 3;
+
+	// better than not knowing it is slow
+	Multicast::recordReplyTime(&h, msg_type_39, 5000, s_nowMs, true);
+	EXPECT_EQ(5000, Multicast::getReplyTime(&h, msg_type_39, s_nowMs));
+}
+
+TEST(MulticastTest, ReplyTimeExpires) {
+	Host h;
+	h.m_hostId = 4;
+
+	Multicast::recordReplyTime(&h, msg_type_39, 50000, s_nowMs, false);
+	EXPECT_EQ(0, Multicast::getReplyTime(&h, msg_type_39, s_nowMs + 60000));
+
+	// an old reply time doesn't keep a cancelled request from being recorded
+	Multicast::recordReplyTime(&h, msg_type_39, 2000, s_nowMs + 60000, true);
+	EXPECT_EQ(2000, Multicast::getReplyTime(&h, msg_type_39, s_nowMs + 60000));
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "QueryTrace.h"
+#include "SafeBuf.h"
+#include "Conf.h"
+#include <string.h>
+
+TEST(QueryTraceTest, Inactive) {
+	QueryTrace trace;
+	EXPECT_FALSE(trace.isActive());
+	EXPECT_EQ(0, trace.getNow());
+
+	trace.addSpan("msg40 getdocids", QUERY_TRACE_LEVEL_MSG40, 1000, 2000);
+	EXPECT_EQ(0, trace.getNumSpans());
+	EXPECT_EQ(0, trace.getSpanBufSize());
+}
+
+TEST(QueryTraceTest, Sampling) {
+	int32_t savedRate = g_conf.m_queryTraceSampleRate;
+
+	g_conf.m_queryTraceSampleRate = 0;
+	for (int i = 0; i < 10; i++) {
+		EXPECT_FALSE(QueryTrace::shouldSample());
+	}
+
+	g_conf.m_queryTraceSampleRate = 4;
+	int sampled = 0;
+	for (int i = 0; i < 100; i++) {
+		if (QueryTrace::shouldSample()) {
+			sampled++;
+		}
+	}
+	EXPECT_EQ(25, sampled);
+
+	g_conf.m_queryTraceSampleRate = savedRate;
+}
+
+TEST(QueryTraceTest, RemoteSpans) {
+	// the shard worked 3ms on it, relative to when it got the request
+	QueryTrace shard;
+	shard.start(7);
+	int64_t shardStart = shard.getStartTime();
+	shard.addSpan("msg39 getlists", QUERY_TRACE_LEVEL_MSG39, shardStart, shardStart + 1000);
+	shard.addSpan("msg39 total", QUERY_TRACE_LEVEL_MSG39, shardStart, shardStart + 3000);
+	ASSERT_EQ(2, shard.getNumSpans());
+	EXPECT_EQ(0, shard.getSpan(0)->m_startUs);
+	EXPECT_EQ(1000, shard.getSpan(0)->m_durationUs);
+	EXPECT_EQ(7, shard.getSpan(0)->m_hostId);
+
+	// the round trip took 5ms so the shard spans are 1ms after the send
+	QueryTrace trace;
+	trace.start(0);
+	int64_t start = trace.getStartTime();
+	trace.addSpan("msg3a shard 0", QUERY_TRACE_LEVEL_MSG3A, start + 500, start + 5500);
+	ASSERT_TRUE(trace.addRemoteSpans(shard.getSpanBuf(), shard.getSpanBufSize(), start + 500, start + 5500));
+	ASSERT_EQ(3, trace.getNumSpans());
+	EXPECT_STREQ("msg39 getlists", trace.getSpan(1)->m_name);
+	EXPECT_EQ(7, trace.getSpan(1)->m_hostId);
+	EXPECT_EQ(1500, trace.getSpan(1)->m_startUs);
+	EXPECT_EQ(1500, trace.getSpan(2)->m_startUs);
+	EXPECT_EQ(3000, trace.getSpan(2)->m_durationUs);
+
+	// truncated span buffer
+	EXPECT_FALSE(trace.addRemoteSpans(shard.getSpanBuf(), shard.getSpanBufSize() - 1, start, start));
+	EXPECT_EQ(3, trace.getNumSpans());
+}
+
+TEST(QueryTraceTest, ChromeTrace) {
+	QueryTrace::clearTraces();
+
+	QueryTrace trace;
+	trace.start(3);
+	int64_t start = trace.getStartTime();
+	trace.addSpan("msg40 getdocids", QUERY_TRACE_LEVEL_MSG40, start, start + 2000);
+	trace.finish("hello \"world\"", 0);
+	EXPECT_FALSE(trace.isActive());
+
+	SafeBuf sb;
+	EXPECT_TRUE(QueryTrace::printChromeTrace(&sb, 0));
+	sb.nullTerm();
+	const char *json = sb.getBufStart();
+	EXPECT_TRUE(strstr(json, "\"traceEvents\":[") != NULL);
+	EXPECT_TRUE(strstr(json, "\"name\":\"msg40 getdocids\"") != NULL);
+	EXPECT_TRUE(strstr(json, "\"dur\":2000,\"pid\":3,\"tid\":0") != NULL);
+	EXPECT_TRUE(strstr(json, "hello \\\"world\\\"") != NULL);
+
+	// unknown trace
+	SafeBuf sb2;
+	EXPECT_FALSE(QueryTrace::printChromeTrace(&sb2, 123456));
+
+	QueryTrace::clearTraces();
+}
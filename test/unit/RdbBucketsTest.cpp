@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include "RdbBuckets.h"
 #include "Posdb.h"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 static bool addPosdbKey(RdbBuckets *buckets, int64_t termId, int64_t docId, bool delKey = false) {
 	char key[MAX_KEY_BYTES];
@@ -162,3 +165,95 @@ TEST(RdbBucketsTest, PosdbAddDuplicateNode) {
 	expectRecord(&list, 2, docId);
 	EXPECT_TRUE(list.isExhausted());
 }
+
+TEST(RdbBucketsTest, PosdbAddOutOfOrderNode) {
+	static const int64_t docId = 1;
+	RdbBuckets buckets;
+	buckets.set(Posdb::getFixedDataSize(), 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+
+	addPosdbKey(&buckets, 1, docId);
+	addPosdbKey(&buckets, 3, docId);
+	addPosdbKey(&buckets, 5, docId);
+
+	// out of order adds are kept sorted and the latest key wins
+	addPosdbKey(&buckets, 3, docId, true);
+	addPosdbKey(&buckets, 2, docId);
+
+	EXPECT_EQ(4, buckets.getNumKeys());
+	EXPECT_EQ(1, buckets.getNumNegativeKeys());
+
+	int32_t numPosRecs  = 0;
+	int32_t numNegRecs = 0;
+
+	RdbList list;
+	buckets.getList(0, KEYMIN(), KEYMAX(), -1, &list, &numPosRecs, &numNegRecs, Posdb::getUseHalfKeys());
+	expectRecord(&list, 1, docId);
+	expectRecord(&list, 2, docId);
+	expectRecord(&list, 3, docId, true);
+	expectRecord(&list, 5, docId);
+	EXPECT_TRUE(list.isExhausted());
+}
+
+TEST(RdbBucketsTest, PosdbConcurrentAddGetList) {
+	static const int total_records = 50000;
+	static const int64_t docId = 1;
+	RdbBuckets buckets;
+	buckets.set(Posdb::getFixedDataSize(), 32 * 1024 * 1024, "test-posdb", RDB_POSDB, "posdb", Posdb::getKeySize());
+
+	std::atomic<bool> done(false);
+	std::atomic<int> failures(0);
+
+	// readers must always see a sorted list that only grows while the writer adds keys
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; t++) {
+		readers.emplace_back([&]() {
+			int32_t lastCount = 0;
+			while (!done) {
+				int32_t numPosRecs  = 0;
+				int32_t numNegRecs = 0;
+
+				RdbList list;
+				buckets.getList(0, KEYMIN(), KEYMAX(), -1, &list, &numPosRecs, &numNegRecs, Posdb::getUseHalfKeys());
+
+				int32_t count = 0;
+				int64_t lastTermId = -1;
+				for (list.resetListPtr(); !list.isExhausted(); list.skipCurrentRecord()) {
+					int64_t termId = Posdb::getTermId(list.getCurrentRec());
+					if (termId <= lastTermId) {
+						failures++;
+					}
+					lastTermId = termId;
+					count++;
+				}
+
+				if (count < lastCount) {
+					failures++;
+				}
+				lastCount = count;
+			}
+		});
+	}
+
+	// add in reverse so every add is inserted in front of existing keys
+	for (int i = total_records - 1; i >= 0; i--) {
+		addPosdbKey(&buckets, i, docId);
+	}
+
+	done = true;
+	for (auto &reader : readers) {
+		reader.join();
+	}
+
+	EXPECT_EQ(0, failures);
+	EXPECT_EQ(total_records, buckets.getNumKeys());
+
+	int32_t numPosRecs  = 0;
+	int32_t numNegRecs = 0;
+
+	RdbList list;
+	buckets.getList(0, KEYMIN(), KEYMAX(), -1, &list, &numPosRecs, &numNegRecs, Posdb::getUseHalfKeys());
+	for (int i = 0; i < total_records; i++) {
+		expectRecord(&list, i, docId);
+	}
+	EXPECT_TRUE(list.isExhausted());
+}
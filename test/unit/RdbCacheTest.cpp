@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "types.h"
+#include "RdbCache.h"
+#include "Hostdb.h"
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static key96_t makeCacheKey(int32_t i) {
+	key96_t k;
+	k.n1 = 0;
+	k.n0 = (uint64_t)i * 0x9e3779b97f4a7c15ULL + 1;
+	return k;
+}
+
+TEST(RdbCacheTest, ShardedAddGet) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(1000000, 8, 10000, "shardtest", false, sizeof(key96_t), -1, 4));
+	EXPECT_TRUE(cache.isInitialized());
+	EXPECT_EQ(4, cache.getNumShards());
+
+	for (int32_t i = 0; i < 1000; i++) {
+		key96_t k = makeCacheKey(i);
+		int64_t value = i;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		EXPECT_TRUE(cache.addRecord((collnum_t)0, k, (const char *)&value, sizeof(value)));
+	}
+
+	EXPECT_EQ(1000, cache.getNumUsedNodes());
+	EXPECT_EQ(1000, cache.getNumAdds());
+
+	// every shard should have gotten some of the keys
+	int32_t sum = 0;
+	for (int32_t i = 0; i < cache.getNumShards(); i++) {
+		EXPECT_GT(cache.getShard(i)->getNumUsedNodes(), 0);
+		sum += cache.getShard(i)->getNumUsedNodes();
+	}
+	EXPECT_EQ(1000, sum);
+
+	for (int32_t i = 0; i < 1000; i++) {
+		key96_t k = makeCacheKey(i);
+		char *rec;
+		int32_t recSize;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		ASSERT_TRUE(cache.getRecord((collnum_t)0, k, &rec, &recSize, false, -1, true));
+		EXPECT_EQ(8, recSize);
+		EXPECT_EQ(i, *(int64_t *)rec);
+	}
+
+	// not there
+	{
+		key96_t k = makeCacheKey(5000);
+		char *rec;
+		int32_t recSize;
+		RdbCacheLock rcl(cache);
+		EXPECT_FALSE(cache.getRecord((collnum_t)0, k, &rec, &recSize, false, -1, true));
+	}
+
+	EXPECT_EQ(1000, cache.getNumHits());
+	EXPECT_EQ(1, cache.getNumMisses());
+}
+
+TEST(RdbCacheTest, ShardedClear) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(1000000, 8, 10000, "shardtest", false, sizeof(key96_t), -1, 4));
+
+	for (int32_t i = 0; i < 100; i++) {
+		key96_t k = makeCacheKey(i);
+		int64_t value = i;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		cache.addRecord((collnum_t)1, k, (const char *)&value, sizeof(value));
+	}
+
+	{
+		RdbCacheLock rcl(cache);
+		cache.clear((collnum_t)1);
+	}
+
+	for (int32_t i = 0; i < 100; i++) {
+		key96_t k = makeCacheKey(i);
+		char *rec;
+		int32_t recSize;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		EXPECT_FALSE(cache.getRecord((collnum_t)1, k, &rec, &recSize, false, -1, true));
+	}
+}
+
+TEST(RdbCacheTest, ShardedVariableSizeNotSharded) {
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(1000000, -1, 1000, "shardtest", false, sizeof(key96_t), -1, 4));
+	EXPECT_EQ(1, cache.getNumShards());
+
+	// bigger than a quarter of the cache
+	std::vector<char> big(400000, 'x');
+	key96_t k = makeCacheKey(1);
+	RdbCacheLock rcl(cache, (const char *)&k);
+	EXPECT_TRUE(cache.addRecord((collnum_t)0, k, big.data(), big.size()));
+
+	char *rec;
+	int32_t recSize;
+	ASSERT_TRUE(cache.getRecord((collnum_t)0, k, &rec, &recSize, false, -1, true));
+	EXPECT_EQ((int32_t)big.size(), recSize);
+}
+
+TEST(RdbCacheTest, ShardedLoadUnshardedSave) {
+	{
+		RdbCache cache;
+		ASSERT_TRUE(cache.init(1000000, 8, 10000, "shardlegacytest", true, sizeof(key96_t), -1));
+
+		for (int32_t i = 0; i < 100; i++) {
+			key96_t k = makeCacheKey(i);
+			int64_t value = i;
+			RdbCacheLock rcl(cache);
+			ASSERT_TRUE(cache.addRecord((collnum_t)0, k, (const char *)&value, sizeof(value)));
+		}
+
+		ASSERT_TRUE(cache.save());
+	}
+
+	RdbCache cache;
+	ASSERT_TRUE(cache.init(1000000, 8, 10000, "shardlegacytest", true, sizeof(key96_t), -1, 4));
+	EXPECT_EQ(4, cache.getNumShards());
+	EXPECT_EQ(100, cache.getNumUsedNodes());
+
+	for (int32_t i = 0; i < 100; i++) {
+		key96_t k = makeCacheKey(i);
+		char *rec;
+		int32_t recSize;
+		RdbCacheLock rcl(cache, (const char *)&k);
+		ASSERT_TRUE(cache.getRecord((collnum_t)0, k, &rec, &recSize, false, -1, true));
+		EXPECT_EQ(i, *(int64_t *)rec);
+	}
+
+	// the shards save the records under their own names from now on
+	std::string legacyFile(g_hostdb.m_dir);
+	legacyFile.append("shardlegacytest.cache");
+	EXPECT_NE(0, access(legacyFile.c_str(), F_OK));
+
+	for (int32_t i = 0; i < cache.getNumShards(); i++) {
+		std::string shardFile(g_hostdb.m_dir);
+		shardFile.append("shardlegacytest-").append(std::to_string(i)).append(".cache");
+		unlink(shardFile.c_str());
+	}
+	unlink(legacyFile.c_str());
+}
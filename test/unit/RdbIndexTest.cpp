@@ -3,12 +3,15 @@
 #include "RdbBuckets.h"
 #include "Posdb.h"
 #include "GigablastTestUtils.h"
+#include "Conf.h"
+#include <fcntl.h>
+#include <unistd.h>
 
-static uint64_t getDocId(docidsconst_ptr_t docIds, size_t index) {
+static uint64_t getDocId(docidsview_ptr_t docIds, size_t index) {
 	return ((*docIds.get())[index] >> RdbIndex::s_docIdOffset);
 }
 
-static bool isDel(docidsconst_ptr_t docIds, size_t index) {
+static bool isDel(docidsview_ptr_t docIds, size_t index) {
 	return (((*docIds.get())[index] & 0x01) == 0);
 }
 
@@ -257,3 +260,76 @@ TEST(RdbIndexTest, DeleteAddKeySave) {
 	// cleanup
 	index.unlink();
 }
+
+TEST(RdbIndexTest, ReadMappedIndex) {
+	static const int64_t termId = 1;
+	static const int32_t wordPos = 1;
+	static const int total_records = 100;
+
+	{
+		RdbIndex index;
+		index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, false);
+		for (int i = 1; i <= total_records; i++) {
+			GbTest::addPosdbKey(&index, termId, i, wordPos, (i % 10 == 0));
+		}
+		index.writeIndex(true);
+	}
+
+	bool oldMmap = g_conf.m_mmapMapAndIndexFiles;
+	g_conf.m_mmapMapAndIndexFiles = true;
+
+	RdbIndex index;
+	index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, true);
+	ASSERT_TRUE(index.readIndex());
+	EXPECT_TRUE(index.verifyIndex());
+
+	auto docIds = index.getDocIds();
+	ASSERT_EQ(total_records, docIds->size());
+	for (int i = 0; i < total_records; i++) {
+		EXPECT_EQ(i + 1, getDocId(docIds, i));
+		EXPECT_EQ(((i + 1) % 10 == 0), isDel(docIds, i));
+	}
+	EXPECT_TRUE(index.exist(50));
+	EXPECT_FALSE(index.exist(total_records + 1));
+
+	// rewriting the file must not change docids still in use from the mapping
+	GbTest::addPosdbKey(&index, termId, total_records + 1, wordPos, false);
+	index.writeIndex(true);
+
+	EXPECT_EQ(total_records, docIds->size());
+	EXPECT_EQ(1, getDocId(docIds, 0));
+	EXPECT_EQ(total_records + 1, index.getDocIds()->size());
+
+	g_conf.m_mmapMapAndIndexFiles = oldMmap;
+
+	// cleanup
+	index.unlink();
+}
+
+TEST(RdbIndexTest, ReadMappedIndexBadVersion) {
+	{
+		RdbIndex index;
+		index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, false);
+		GbTest::addPosdbKey(&index, 1, 1, 1, false);
+		index.writeIndex(true);
+	}
+
+	// the version is the first 8 bytes
+	int fd = open("./test-posdbidx", O_RDWR);
+	ASSERT_GE(fd, 0);
+	int64_t version = 1;
+	ASSERT_EQ(8, pwrite(fd, &version, 8, 0));
+	close(fd);
+
+	bool oldMmap = g_conf.m_mmapMapAndIndexFiles;
+	g_conf.m_mmapMapAndIndexFiles = true;
+
+	RdbIndex index;
+	index.set(".", "test-posdbidx", Posdb::getFixedDataSize(), Posdb::getUseHalfKeys(), Posdb::getKeySize(), RDB_POSDB, true);
+	EXPECT_FALSE(index.readIndex());
+
+	g_conf.m_mmapMapAndIndexFiles = oldMmap;
+
+	// cleanup
+	index.unlink();
+}
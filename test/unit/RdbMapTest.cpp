@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "RdbMap.h"
+#include "BigFile.h"
+#include "Process.h"
+#include "Conf.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+static const int32_t s_pageSize = 1024;
+static const char s_ks = sizeof(key96_t);
+
+// enough pages for the first segment to be used in place in the mapping
+static const int32_t s_numRecs = (PAGES_PER_SEGMENT + 100) * (s_pageSize / s_ks);
+
+static void writeTestMap() {
+	RdbMap map;
+	map.set(".", "test-rdbmap.map", 0, false, s_ks, s_pageSize);
+	for (int32_t i = 0; i < s_numRecs; i++) {
+		key96_t k;
+		k.n1 = 0;
+		k.n0 = ((uint64_t)i << 1) | 1;
+		ASSERT_TRUE(map.addRecord((char *)&k, (char *)&k, s_ks));
+	}
+	ASSERT_TRUE(map.writeMap(true));
+
+	// the data file only has to be of the right size
+	int fd = open("./test-rdbmap.dat", O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(0, ftruncate(fd, map.getFileSize()));
+	close(fd);
+}
+
+class RdbMapTest : public ::testing::Test {
+protected:
+	void SetUp() {
+		m_oldMmap = g_conf.m_mmapMapAndIndexFiles;
+		g_conf.m_mmapMapAndIndexFiles = true;
+		writeTestMap();
+	}
+
+	void TearDown() {
+		g_conf.m_mmapMapAndIndexFiles = m_oldMmap;
+		unlink("./test-rdbmap.map");
+		unlink("./test-rdbmap.dat");
+		unlink(Process::getAbortFileName());
+	}
+
+	bool m_oldMmap;
+};
+
+TEST_F(RdbMapTest, ReadMappedMap) {
+	BigFile dataFile;
+	dataFile.set(".", "test-rdbmap.dat");
+
+	RdbMap map;
+	map.set(".", "test-rdbmap.map", 0, false, s_ks, s_pageSize);
+	ASSERT_TRUE(map.readMap(&dataFile));
+	EXPECT_GT(map.getMemMapped(), 0);
+
+	ASSERT_GT(map.getNumPages(), PAGES_PER_SEGMENT);
+	for (int32_t page = 1; page < map.getNumPages(); page++) {
+		EXPECT_LT(KEYCMP(map.getKeyPtr(page - 1), map.getKeyPtr(page), s_ks), 0);
+	}
+}
+
+TEST_F(RdbMapTest, ReadMappedMapCorruptKey) {
+	// a key in the middle of the first segment, which is used in place
+	int fd = open("./test-rdbmap.map", O_RDWR);
+	ASSERT_GE(fd, 0);
+	char bad[sizeof(key96_t)];
+	memset(bad, 0xff, sizeof(bad));
+	ASSERT_EQ(s_ks, pwrite(fd, bad, s_ks, 8 + 8 + 8 + 8 + s_ks + 5 * s_ks));
+	close(fd);
+
+	BigFile dataFile;
+	dataFile.set(".", "test-rdbmap.dat");
+
+	RdbMap map;
+	map.set(".", "test-rdbmap.map", 0, false, s_ks, s_pageSize);
+	// out of order keys in the map abort so the map can be fixed
+	EXPECT_DEATH(map.readMap(&dataFile), "");
+}
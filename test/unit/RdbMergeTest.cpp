@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+#include "RdbMerge.h"
+#include "RdbBase.h"
+#include "Msg5.h"
+#include "Posdb.h"
+#include "Loop.h"
+#include "Mem.h"
+#include "GigablastTestUtils.h"
+#include "Conf.h"
+
+static const int s_numFiles = 3;
+
+static void dumpPosdb() {
+	g_posdb.getRdb()->submitRdbDumpJob(true);
+	while (g_posdb.getRdb()->hasPendingRdbDumpJob()) {
+		usleep(100000); //sleep 100ms
+	}
+	g_posdb.getRdb()->getBase(0)->markNewFileReadable();
+	g_posdb.getRdb()->getBase(0)->generateGlobalIndex();
+}
+
+// termIds are spread over the files so every range is merged from all of them
+static void addPosdbFiles(int32_t numTermIds, int32_t numDocIds) {
+	Rdb *rdb = g_posdb.getRdb();
+	for (int file = 0; file < s_numFiles; file++) {
+		for (int32_t termId = 1; termId <= numTermIds; termId++) {
+			if (termId % s_numFiles != file) {
+				continue;
+			}
+			for (int32_t docId = 1; docId <= numDocIds; docId++) {
+				GbTest::addPosdbKey(rdb, termId, docId, 0);
+			}
+		}
+		dumpPosdb();
+	}
+}
+
+// pump the loop until the merge is done or we give up
+static void runLoop(int64_t maxWaitMs, bool untilMerged) {
+	RdbBase *base = g_posdb.getRdb()->getBase(0);
+	int64_t start = gettimeofdayInMilliseconds();
+	while (gettimeofdayInMilliseconds() - start < maxWaitMs) {
+		if (untilMerged && !g_merge.isMerging() && !base->isMerging()) {
+			return;
+		}
+		g_loop.doPoll();
+	}
+}
+
+static void expectAllRecords(int32_t numTermIds, int32_t numDocIds) {
+	Msg5 msg5;
+	RdbList list;
+	ASSERT_TRUE(msg5.getList(RDB_POSDB, 0, &list, KEYMIN(), KEYMAX(), -1, false, 0, -1, NULL, NULL, 0, false, 0, false));
+	list.resetListPtr();
+
+	// every range must be dumped in key order
+	for (int32_t termId = 1; termId <= numTermIds; termId++) {
+		for (int32_t docId = 1; docId <= numDocIds; docId++) {
+			ASSERT_FALSE(list.isExhausted());
+			const char *rec = list.getCurrentRec();
+			ASSERT_EQ(termId, Posdb::getTermId(rec));
+			ASSERT_EQ(docId, Posdb::getDocId(rec));
+			list.skipCurrentRecord();
+		}
+	}
+	EXPECT_TRUE(list.isExhausted());
+}
+
+class RdbMergeTest : public ::testing::Test {
+protected:
+	void SetUp() {
+		GbTest::initializeRdbs();
+		m_oldMergeBufSize = g_conf.m_mergeBufSize;
+		m_oldMergeParallelRanges = g_conf.m_mergeParallelRanges;
+		m_oldMaxMem = g_conf.m_maxMem;
+	}
+
+	void TearDown() {
+		g_conf.m_mergeBufSize = m_oldMergeBufSize;
+		g_conf.m_mergeParallelRanges = m_oldMergeParallelRanges;
+		g_conf.m_maxMem = m_oldMaxMem;
+
+		GbTest::resetRdbs();
+
+		// a halted merge can't be resumed
+		g_merge.~RdbMerge();
+		new(&g_merge) RdbMerge();
+	}
+
+	int32_t m_oldMergeBufSize;
+	int32_t m_oldMergeParallelRanges;
+	size_t m_oldMaxMem;
+};
+
+TEST_F(RdbMergeTest, ParallelRangesInKeyOrder) {
+	static const int32_t numTermIds = 300;
+	static const int32_t numDocIds = 10;
+
+	addPosdbFiles(numTermIds, numDocIds);
+
+	RdbBase *base = g_posdb.getRdb()->getBase(0);
+	ASSERT_EQ(s_numFiles, base->getNumFiles());
+
+	// small reads so there are many ranges and truncated lists
+	g_conf.m_mergeParallelRanges = 4;
+	g_conf.m_mergeBufSize = 4096;
+
+	ASSERT_TRUE(base->attemptMerge(1, true));
+	runLoop(60000, true);
+
+	ASSERT_FALSE(g_merge.isMerging());
+	EXPECT_EQ(1, base->getNumFiles());
+
+	expectAllRecords(numTermIds, numDocIds);
+}
+
+TEST_F(RdbMergeTest, OutOfMemoryRetry) {
+	static const int32_t numTermIds = 3000;
+	static const int32_t numDocIds = 50;
+
+	addPosdbFiles(numTermIds, numDocIds);
+
+	RdbBase *base = g_posdb.getRdb()->getBase(0);
+	ASSERT_EQ(s_numFiles, base->getNumFiles());
+
+	g_conf.m_mergeParallelRanges = 2;
+	g_conf.m_mergeBufSize = 4000000;
+
+	// no room for the lists. the merge sleeps and retries
+	g_conf.m_maxMem = g_mem.getUsedMem() + 1100000;
+
+	ASSERT_TRUE(base->attemptMerge(1, true));
+	runLoop(8000, false);
+	EXPECT_TRUE(g_merge.isMerging());
+	// the merge target is there as well
+	EXPECT_EQ(s_numFiles + 1, base->getNumFiles());
+
+	g_conf.m_maxMem = m_oldMaxMem;
+	runLoop(60000, true);
+
+	ASSERT_FALSE(g_merge.isMerging());
+	EXPECT_EQ(1, base->getNumFiles());
+
+	expectAllRecords(numTermIds, numDocIds);
+}
+
+TEST_F(RdbMergeTest, HaltMerge) {
+	static const int32_t numTermIds = 300;
+	static const int32_t numDocIds = 10;
+
+	addPosdbFiles(numTermIds, numDocIds);
+
+	RdbBase *base = g_posdb.getRdb()->getBase(0);
+	ASSERT_EQ(s_numFiles, base->getNumFiles());
+
+	g_conf.m_mergeParallelRanges = 4;
+	g_conf.m_mergeBufSize = 4096;
+
+	ASSERT_TRUE(base->attemptMerge(1, true));
+	g_merge.haltMerge();
+
+	// past the merge lock retry
+	runLoop(8000, false);
+
+	EXPECT_TRUE(g_merge.isHalted());
+	// the merge target is there as well
+	EXPECT_EQ(s_numFiles + 1, base->getNumFiles());
+
+	// nothing is lost
+	expectAllRecords(numTermIds, numDocIds);
+}
+
+TEST_F(RdbMergeTest, DeletedKeysOnRangeBoundaries) {
+	static const int32_t numTermIds = 2000;
+	static const int32_t numDocIds = 20;
+
+	Rdb *rdb = g_posdb.getRdb();
+
+	// older file has all the keys
+	for (int32_t termId = 1; termId <= numTermIds; termId++) {
+		for (int32_t docId = 1; docId <= numDocIds; docId++) {
+			GbTest::addPosdbKey(rdb, termId, docId, 0);
+		}
+	}
+	dumpPosdb();
+
+	// newer file deletes all but the first docid, so every range boundary
+	// taken from the older file's map is on a positive/negative key pair
+	for (int32_t termId = 1; termId <= numTermIds; termId++) {
+		for (int32_t docId = 2; docId <= numDocIds; docId++) {
+			GbTest::addPosdbKey(rdb, termId, docId, 0, true);
+		}
+	}
+	dumpPosdb();
+
+	RdbBase *base = rdb->getBase(0);
+	ASSERT_EQ(2, base->getNumFiles());
+
+	g_conf.m_mergeParallelRanges = 4;
+	g_conf.m_mergeBufSize = 4096;
+
+	ASSERT_TRUE(base->attemptMerge(1, true));
+	runLoop(60000, true);
+
+	ASSERT_FALSE(g_merge.isMerging());
+	EXPECT_EQ(1, base->getNumFiles());
+	EXPECT_GT(g_merge.getNumRangesRead(), 1);
+
+	Msg5 msg5;
+	RdbList list;
+	ASSERT_TRUE(msg5.getList(RDB_POSDB, 0, &list, KEYMIN(), KEYMAX(), -1, false, 0, -1, NULL, NULL, 0, false, 0, false));
+	list.resetListPtr();
+
+	// no deleted record came back
+	for (int32_t termId = 1; termId <= numTermIds; termId++) {
+		ASSERT_FALSE(list.isExhausted());
+		const char *rec = list.getCurrentRec();
+		EXPECT_EQ(termId, Posdb::getTermId(rec));
+		EXPECT_EQ(1, Posdb::getDocId(rec));
+		EXPECT_FALSE(KEYNEG(rec));
+		list.skipCurrentRecord();
+	}
+	EXPECT_TRUE(list.isExhausted());
+}
@@ -2,6 +2,7 @@
 #include "Robots.h"
 #include "Url.h"
 #include "Log.h"
+#include "Conf.h"
 
 #include <fstream>
 #include <sstream>
@@ -1834,3 +1835,88 @@ TEST( RobotsTest, RRobotsCoriolisIo ) {
 	EXPECT_FALSE( robots.isDefaultUserAgentFound() );
 	EXPECT_TRUE( robots.isDefaultRulesEmpty() );
 }
+
+//
+// Test compiled matcher
+//
+
+TEST( RobotsTest, MatcherLongestMatch ) {
+	const char *robotsTxt = "user-agent: testbot\n"
+	                        "disallow: /a\n"
+	                        "allow: /a/b\n"
+	                        "disallow: /a/*/c\n"
+	                        "allow: /a/b/c$\n"
+	                        "disallow: /*.php\n"
+	                        "allow: /\n";
+
+	TestRobots robots( robotsTxt, strlen( robotsTxt ) );
+
+	EXPECT_TRUE( robots.isAllowed( "/" ) );
+	EXPECT_TRUE( robots.isAllowed( "/b" ) );
+	EXPECT_FALSE( robots.isAllowed( "/a" ) );
+	EXPECT_FALSE( robots.isAllowed( "/ab" ) );
+	EXPECT_TRUE( robots.isAllowed( "/a/b" ) );
+	EXPECT_FALSE( robots.isAllowed( "/a/x/c" ) );
+	EXPECT_TRUE( robots.isAllowed( "/a/b/c" ) );
+	EXPECT_FALSE( robots.isAllowed( "/a/b/cd" ) );
+	EXPECT_FALSE( robots.isAllowed( "/x.php" ) );
+	EXPECT_FALSE( robots.isAllowed( "/a/b.php" ) );
+}
+
+TEST( RobotsTest, MatcherSharedPrefix ) {
+	const char *robotsTxt = "user-agent: testbot\n"
+	                        "disallow: /shop\n"
+	                        "allow: /shop/\n"
+	                        "disallow: /shop/cart\n"
+	                        "allow: /shoes\n";
+
+	TestRobots robots( robotsTxt, strlen( robotsTxt ) );
+
+	EXPECT_TRUE( robots.isAllowed( "/sh" ) );
+	EXPECT_FALSE( robots.isAllowed( "/shop" ) );
+	EXPECT_FALSE( robots.isAllowed( "/shopping" ) );
+	EXPECT_TRUE( robots.isAllowed( "/shop/" ) );
+	EXPECT_TRUE( robots.isAllowed( "/shop/car" ) );
+	EXPECT_FALSE( robots.isAllowed( "/shop/cart?id=1" ) );
+	EXPECT_TRUE( robots.isAllowed( "/shoes/red" ) );
+}
+
+//
+// Test parsed robots cache
+//
+
+TEST( RobotsTest, GetRobotsCache ) {
+	const char *robotsTxt = "user-agent: testbot\n"
+	                        "disallow: /private\n";
+	const char *otherRobotsTxt = "user-agent: *\n"
+	                             "disallow: /\n";
+
+	Url url;
+	url.set( TEST_DOMAIN "/private/page.html" );
+
+	g_conf.m_robotsCacheMaxAge = 3600;
+	g_conf.m_robotsCacheSize = 100;
+	Robots::initializeSettings();
+
+	std::shared_ptr<const Robots> robots = Robots::getRobots( robotsTxt, strlen( robotsTxt ), "testbot" );
+	EXPECT_FALSE( robots->isAllowed( &url ) );
+	EXPECT_EQ( robots, Robots::getRobots( robotsTxt, strlen( robotsTxt ), "testbot" ) );
+
+	// different user agent / content
+	std::shared_ptr<const Robots> otherAgentRobots = Robots::getRobots( robotsTxt, strlen( robotsTxt ), "otherbot" );
+	EXPECT_NE( robots, otherAgentRobots );
+	EXPECT_TRUE( otherAgentRobots->isAllowed( &url ) );
+
+	std::shared_ptr<const Robots> otherRobots = Robots::getRobots( otherRobotsTxt, strlen( otherRobotsTxt ), "testbot" );
+	EXPECT_NE( robots, otherRobots );
+	EXPECT_FALSE( otherRobots->isAllowed( &url ) );
+
+	// disabled
+	Robots::clearCache();
+	g_conf.m_robotsCacheSize = 0;
+	Robots::initializeSettings();
+
+	robots = Robots::getRobots( robotsTxt, strlen( robotsTxt ), "testbot" );
+	EXPECT_NE( robots, Robots::getRobots( robotsTxt, strlen( robotsTxt ), "testbot" ) );
+	EXPECT_FALSE( robots->isAllowed( &url ) );
+}
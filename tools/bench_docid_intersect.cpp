@@ -0,0 +1,281 @@
+#include "DocIdIntersect.h"
+#include "BigFile.h"
+#include "RdbList.h"
+#include "Posdb.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include "GbUtil.h"
+#include <libgen.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] FILE TERMID TERMID [TERMID ...]\n", argv0);
+	fprintf(stdout, "Benchmark docid vote buffer intersection on termlists from a posdb file\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+static int64_t getNowNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// collect the docids of the requested termids by scanning the whole file
+static bool readTermLists(BigFile *f, std::map<int64_t, std::vector<uint64_t> > *termDocIds) {
+	const int64_t fileSize = f->getFileSize();
+	if (fileSize <= 0) {
+		return false;
+	}
+
+	int64_t bufSize = std::min(fileSize, (int64_t)(10 * 1024 * 1024));
+	char *buf = (char *)mmalloc(bufSize, "bench");
+	if (!buf) {
+		return false;
+	}
+
+	char key[MAX_KEY_BYTES];
+	int64_t offset = 0;
+	while (offset < fileSize) {
+		int64_t readSize = std::min(fileSize - offset, bufSize);
+		if (!f->read(buf, readSize, offset)) {
+			mfree(buf, bufSize, "bench");
+			return false;
+		}
+
+		RdbList list;
+		list.set(buf, readSize, buf, readSize, KEYMIN(), KEYMAX(), Posdb::getFixedDataSize(), false, Posdb::getUseHalfKeys(), Posdb::getKeySize());
+		if (offset > 0) {
+			list.setListPtrLo(key + (Posdb::getKeySize() - 12));
+		}
+
+		bool cutOff = false;
+		for (; !list.isExhausted(); list.skipCurrentRecord()) {
+			char *rec = list.getCurrentRec();
+			if (rec + 64 > list.getListEnd() && offset + readSize < fileSize) {
+				offset += (rec - buf);
+				cutOff = true;
+				break;
+			}
+
+			list.getCurrentKey(key);
+			if (KEYNEG(key)) {
+				continue;
+			}
+
+			std::map<int64_t, std::vector<uint64_t> >::iterator it = termDocIds->find(Posdb::getTermId(key));
+			if (it == termDocIds->end()) {
+				continue;
+			}
+
+			uint64_t docId = Posdb::getDocId(key);
+			if (it->second.empty() || it->second.back() != docId) {
+				it->second.push_back(docId);
+			}
+		}
+
+		if (!cutOff) {
+			offset += readSize;
+		}
+	}
+
+	mfree(buf, bufSize, "bench");
+	return true;
+}
+
+// build a mangled sublist (12-byte head followed by 6-byte keys of the same docid)
+static void makeSubList(int64_t termId, const std::vector<uint64_t> &docIds, std::vector<char> *subList) {
+	subList->clear();
+	char key[18];
+	for (size_t i = 0; i < docIds.size(); i++) {
+		Posdb::makeKey(key, termId, docIds[i], 0, 0, 0, 0, 0, 0, 0, 0, false, false, false);
+		subList->insert(subList->end(), key, key + 12);
+		// pretend every docid has one extra position
+		key[0] |= 0x04;
+		subList->insert(subList->end(), key, key + 6);
+	}
+}
+
+// same layout as PosdbTable::makeDocIdVoteBufForRarestTerm()
+static void makeVoteBuf(const std::vector<char> &subList, std::vector<char> *voteBuf) {
+	voteBuf->clear();
+	for (const char *p = subList.data(); p < subList.data() + subList.size(); p += 18) {
+		char rec[6];
+		memcpy(rec, p + 7, 5);
+		rec[0] &= 0xfc;
+		rec[5] = 0;
+		voteBuf->insert(voteBuf->end(), rec, rec + 6);
+	}
+}
+
+// the record-by-record scan PosdbTable::addDocIdVotes() does without the kernel
+static void legacyVote(char *voteBuf, int32_t voteBufLen, const char *subListPtr, const char *subListEnd, char vote) {
+	char *voteBufPtr = voteBuf;
+	char *voteBufEnd = voteBuf + voteBufLen;
+	while (subListPtr < subListEnd && voteBufPtr < voteBufEnd) {
+		for (; voteBufPtr < voteBufEnd; voteBufPtr += 6) {
+			if (*(uint32_t *)(voteBufPtr + 1) > *(uint32_t *)(subListPtr + 8)) {
+				break;
+			}
+			if (*(uint32_t *)(voteBufPtr + 1) < *(uint32_t *)(subListPtr + 8)) {
+				continue;
+			}
+			if (*(unsigned char *)(voteBufPtr) > (*(unsigned char *)(subListPtr + 7) & 0xfc)) {
+				break;
+			}
+			if (*(unsigned char *)(voteBufPtr) < (*(unsigned char *)(subListPtr + 7) & 0xfc)) {
+				continue;
+			}
+			voteBufPtr[5] = vote;
+			voteBufPtr += 6;
+			break;
+		}
+
+		subListPtr += 12;
+		while (subListPtr < subListEnd && (*subListPtr & 0x04)) {
+			subListPtr += 6;
+		}
+	}
+}
+
+static void kernelVote(DocIdIntersect::intersect_fn_t fn, char *voteBuf, int32_t voteBufLen, const char *subListPtr, const char *subListEnd, char vote) {
+	std::vector<uint64_t> voteKeys;
+	std::vector<uint64_t> subListKeys;
+	std::vector<uint32_t> subListOffsets;
+	DocIdIntersect::decodeVoteBuf(voteBuf, voteBufLen, &voteKeys);
+	DocIdIntersect::decodeSubList(subListPtr, subListEnd, &subListKeys, &subListOffsets);
+
+	std::vector<uint32_t> matchVote(voteKeys.size());
+	std::vector<uint32_t> matchSubList(voteKeys.size());
+	size_t n = fn(voteKeys.data(), voteKeys.size(), subListKeys.data(), subListKeys.size(), matchVote.data(), matchSubList.data());
+	for (size_t k = 0; k < n; k++) {
+		voteBuf[matchVote[k] * 6 + 5] = vote;
+	}
+}
+
+static int32_t countVotes(const std::vector<char> &voteBuf, char vote) {
+	int32_t count = 0;
+	for (size_t i = 5; i < voteBuf.size(); i += 6) {
+		if (voteBuf[i] == vote) {
+			count++;
+		}
+	}
+	return count;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0 ) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (argc < 4) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	char filepath[PATH_MAX];
+
+	char dir[PATH_MAX];
+	strcpy(filepath, argv[1]);
+	strcpy(dir, dirname(filepath));
+
+	char filename[PATH_MAX];
+	strcpy(filepath, argv[1]);
+	strcpy(filename, basename(filepath));
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	g_log.m_logPrefix = false;
+
+	std::map<int64_t, std::vector<uint64_t> > termDocIds;
+	for (int i = 2; i < argc; i++) {
+		termDocIds[strtoll(argv[i], NULL, 10)];
+	}
+
+	BigFile bigFile;
+	bigFile.set(dir, filename);
+
+	int64_t start = getNowNanos();
+	if (!readTermLists(&bigFile, &termDocIds)) {
+		fprintf(stdout, "Unable to read %s\n", filename);
+		return 1;
+	}
+	fprintf(stdout, "Read termlists in %" PRId64" ms\n", (getNowNanos() - start) / 1000000);
+
+	// rarest term first, as PosdbTable does
+	std::vector<std::pair<size_t, int64_t> > order;
+	for (std::map<int64_t, std::vector<uint64_t> >::const_iterator it = termDocIds.begin(); it != termDocIds.end(); ++it) {
+		fprintf(stdout, "termId=%" PRId64" docIds=%zu\n", it->first, it->second.size());
+		order.push_back(std::make_pair(it->second.size(), it->first));
+	}
+	std::sort(order.begin(), order.end());
+
+	std::vector<std::vector<char> > subLists(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		makeSubList(order[i].second, termDocIds[order[i].second], &subLists[i]);
+	}
+
+	std::vector<char> origVoteBuf;
+	makeVoteBuf(subLists[0], &origVoteBuf);
+
+	static const int s_iterations = 20;
+
+	struct Variant {
+		const char *name;
+		DocIdIntersect::intersect_fn_t fn;
+	};
+	const Variant variants[] = {
+		{ "legacy", NULL },
+		{ "intersect", &DocIdIntersect::intersect },
+		{ "scalar", &DocIdIntersect::intersectScalar },
+		{ "galloping", &DocIdIntersect::intersectGalloping },
+		{ "sse4.2", &DocIdIntersect::intersectSSE42 },
+		{ "avx2", &DocIdIntersect::intersectAVX2 },
+	};
+
+	fprintf(stdout, "Block kernel for this cpu: %s\n", DocIdIntersect::getBlockKernelName());
+
+	for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+		// don't run instructions the cpu doesn't have
+		if ((strcmp(variants[v].name, "avx2") == 0 && !__builtin_cpu_supports("avx2")) ||
+		    (strcmp(variants[v].name, "sse4.2") == 0 && !__builtin_cpu_supports("sse4.2"))) {
+			continue;
+		}
+
+		std::vector<char> voteBuf;
+		int64_t total = 0;
+		for (int iter = 0; iter < s_iterations; iter++) {
+			voteBuf = origVoteBuf;
+			start = getNowNanos();
+			for (size_t i = 1; i < subLists.size(); i++) {
+				const char *subList = subLists[i].data();
+				const char *subListEnd = subList + subLists[i].size();
+				if (variants[v].fn) {
+					kernelVote(variants[v].fn, voteBuf.data(), voteBuf.size(), subList, subListEnd, (char)i);
+				} else {
+					legacyVote(voteBuf.data(), voteBuf.size(), subList, subListEnd, (char)i);
+				}
+			}
+			total += getNowNanos() - start;
+		}
+
+		fprintf(stdout, "%-10s avg=%8" PRId64" us matches=%" PRId32"\n", variants[v].name, total / s_iterations / 1000,
+		        countVotes(voteBuf, (char)(subLists.size() - 1)));
+	}
+
+	return 0;
+}
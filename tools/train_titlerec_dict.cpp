@@ -0,0 +1,285 @@
+#include "TitleRecCodec.h"
+#include "TitleRecVersion.h"
+#include "GbCompress.h"
+#include "BigFile.h"
+#include "RdbList.h"
+#include "Dir.h"
+#include "Log.h"
+#include "Conf.h"
+#include "Mem.h"
+#include <libgen.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// total size of the sampled titlerecs
+static const size_t s_maxSampleBytes = 16 * 1024 * 1024;
+// zlib can't use more than its 32KB window of a dictionary
+static const uint32_t s_maxDictLen = 32 * 1024;
+
+static void print_usage(const char *argv0) {
+	fprintf(stdout, "Usage: %s [-h] FILE OUTPUT_DIR [MAX_SAMPLES]\n", argv0);
+	fprintf(stdout, "Train a titlerec compression dictionary on the titlerecs of a titledb file\n");
+	fprintf(stdout, "and save it as OUTPUT_DIR/titlerec.dict (normally the collection directory)\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  -h, --help     display this help and exit\n");
+}
+
+// existing dictionaries so titlerecs already compressed with one can be sampled too
+static void loadDictionaries(const char *dir, std::map<uint32_t, std::string> *dicts) {
+	Dir d;
+	if (!d.set(dir) || !d.open()) {
+		return;
+	}
+
+	while (const char *filename = d.getNextFilename("titlerec-*.dict")) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", dir, filename);
+		FILE *fp = fopen(path, "r");
+		if (!fp) {
+			continue;
+		}
+
+		std::string dict;
+		char buf[4096];
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+			dict.append(buf, n);
+		}
+		fclose(fp);
+
+		(*dicts)[gbdictid((const unsigned char *)dict.data(), dict.size())] = dict;
+	}
+}
+
+static bool uncompressTitleRec(const char *data, int32_t dataSize, const std::map<uint32_t, std::string> &dicts, std::string *ubuf) {
+	if (dataSize <= 4) {
+		return false;
+	}
+
+	int32_t ubufSize = *(const int32_t *)data;
+	if (ubufSize <= 0) {
+		return false;
+	}
+	int32_t codec = (ubufSize & TITLEREC_CODEC_MASK) >> TITLEREC_CODEC_SHIFT;
+	ubufSize &= TITLEREC_UNCOMPRESSED_SIZE_MASK;
+	if (ubufSize > 100 * 1024 * 1024) {
+		return false;
+	}
+
+	const unsigned char *cbuf = (const unsigned char *)data + 4;
+	uint32_t cbufSize = dataSize - 4;
+
+	ubuf->resize(ubufSize);
+	uint32_t realSize = ubufSize;
+	int err;
+	if (codec == TITLEREC_CODEC_ZLIB) {
+		err = gbuncompress((unsigned char *)&(*ubuf)[0], &realSize, cbuf, cbufSize);
+	} else if (codec == TITLEREC_CODEC_ZLIB_DICT) {
+		std::map<uint32_t, std::string>::const_iterator it = dicts.find(gbgetdictid(cbuf, cbufSize));
+		if (it == dicts.end()) {
+			return false;
+		}
+		err = gbuncompress((unsigned char *)&(*ubuf)[0], &realSize, cbuf, cbufSize,
+		                   (const unsigned char *)it->second.data(), it->second.size());
+	} else if (codec == TITLEREC_CODEC_ZSTD) {
+		err = gbzstduncompress((unsigned char *)&(*ubuf)[0], &realSize, cbuf, cbufSize);
+	} else if (codec == TITLEREC_CODEC_ZSTD_DICT) {
+		if (cbufSize < 4) {
+			return false;
+		}
+		uint32_t dictId = ((uint32_t)cbuf[0] << 24) | ((uint32_t)cbuf[1] << 16) | ((uint32_t)cbuf[2] << 8) | cbuf[3];
+		std::map<uint32_t, std::string>::const_iterator it = dicts.find(dictId);
+		if (it == dicts.end()) {
+			return false;
+		}
+		static std::map<uint32_t, std::unique_ptr<GbZstdDict>> s_zstdDicts;
+		std::unique_ptr<GbZstdDict> &zstdDict = s_zstdDicts[dictId];
+		if (!zstdDict) {
+			zstdDict.reset(new GbZstdDict((const unsigned char *)it->second.data(), it->second.size()));
+		}
+		err = gbzstduncompress((unsigned char *)&(*ubuf)[0], &realSize, cbuf + 4, cbufSize - 4, zstdDict.get());
+	} else {
+		return false;
+	}
+
+	return err == Z_OK && realSize == (uint32_t)ubufSize;
+}
+
+// sample every n'th titlerec of the file
+static bool readSamples(BigFile *f, int32_t maxSamples, const std::map<uint32_t, std::string> &dicts, std::vector<std::string> *samples) {
+	const int64_t fileSize = f->getFileSize();
+	if (fileSize <= 0) {
+		return false;
+	}
+
+	int64_t bufSize = std::min(fileSize, (int64_t)(64 * 1024 * 1024));
+	char *buf = (char *)mmalloc(bufSize, "traindict");
+	if (!buf) {
+		return false;
+	}
+
+	size_t sampleBytes = 0;
+	int64_t recNum = 0;
+	int64_t offset = 0;
+	while (offset < fileSize && (int32_t)samples->size() < maxSamples && sampleBytes < s_maxSampleBytes) {
+		int64_t readSize = std::min(fileSize - offset, bufSize);
+		if (!f->read(buf, readSize, offset)) {
+			mfree(buf, bufSize, "traindict");
+			return false;
+		}
+
+		RdbList list;
+		list.set(buf, readSize, buf, readSize, KEYMIN(), KEYMAX(), -1, false, false, sizeof(key96_t));
+
+		bool cutOff = false;
+		for (; !list.isExhausted(); list.skipCurrentRecord()) {
+			char *rec = list.getCurrentRec();
+			if (offset + readSize < fileSize &&
+			    (rec + sizeof(key96_t) + 4 > list.getListEnd() || rec + list.getCurrentRecSize() > list.getListEnd())) {
+				offset += (rec - buf);
+				cutOff = true;
+				break;
+			}
+
+			if (KEYNEG(rec)) {
+				continue;
+			}
+
+			// spread the samples over the whole file
+			if (recNum++ % 4 != 0) {
+				continue;
+			}
+
+			std::string ubuf;
+			if (!uncompressTitleRec(list.getCurrentData(), list.getCurrentDataSize(), dicts, &ubuf)) {
+				continue;
+			}
+
+			sampleBytes += ubuf.size();
+			samples->push_back(ubuf);
+			if ((int32_t)samples->size() >= maxSamples || sampleBytes >= s_maxSampleBytes) {
+				break;
+			}
+		}
+
+		if (!cutOff) {
+			offset += readSize;
+		}
+	}
+
+	mfree(buf, bufSize, "traindict");
+	return true;
+}
+
+static uint64_t compressedSize(const std::vector<std::string> &samples, const std::string *dict, bool zstd) {
+	std::unique_ptr<GbZstdDict> zstdDict;
+	if (zstd && dict) {
+		zstdDict.reset(new GbZstdDict((const unsigned char *)dict->data(), dict->size()));
+	}
+
+	uint64_t total = 0;
+	std::vector<unsigned char> cbuf;
+	for (size_t i = 0; i < samples.size(); i++) {
+		uint32_t cbufSize = TitleRecCodec::compressBound(samples[i].size());
+		cbuf.resize(cbufSize);
+		int err;
+		if (zstd) {
+			err = gbzstdcompress(cbuf.data(), &cbufSize, (const unsigned char *)samples[i].data(), samples[i].size(),
+			                     zstdDict.get());
+		} else if (dict) {
+			err = gbcompress(cbuf.data(), &cbufSize, (const unsigned char *)samples[i].data(), samples[i].size(),
+			                 (const unsigned char *)dict->data(), dict->size());
+		} else {
+			err = gbcompress(cbuf.data(), &cbufSize, (const unsigned char *)samples[i].data(), samples[i].size());
+		}
+		if (err == Z_OK) {
+			total += cbufSize;
+		}
+	}
+	return total;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0 ) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (argc < 3) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	char filepath[PATH_MAX];
+
+	char dir[PATH_MAX];
+	strcpy(filepath, argv[1]);
+	strcpy(dir, dirname(filepath));
+
+	char filename[PATH_MAX];
+	strcpy(filepath, argv[1]);
+	strcpy(filename, basename(filepath));
+
+	const char *outputDir = argv[2];
+	int32_t maxSamples = (argc > 3) ? atoi(argv[3]) : 10000;
+
+	// initialize library
+	g_mem.init();
+	hashinit();
+
+	g_conf.init(NULL);
+
+	g_log.m_logPrefix = false;
+
+	std::map<uint32_t, std::string> dicts;
+	loadDictionaries(outputDir, &dicts);
+
+	BigFile bigFile;
+	bigFile.set(dir, filename);
+
+	std::vector<std::string> samples;
+	if (!readSamples(&bigFile, maxSamples, dicts, &samples)) {
+		fprintf(stdout, "Unable to read %s\n", filename);
+		return 1;
+	}
+
+	uint64_t sampleBytes = 0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		sampleBytes += samples[i].size();
+	}
+	fprintf(stdout, "Sampled %zu titlerecs (%" PRIu64" bytes)\n", samples.size(), sampleBytes);
+
+	std::string dict;
+	if (!gbtraindict(samples, s_maxDictLen, &dict)) {
+		fprintf(stdout, "Unable to train dictionary\n");
+		return 1;
+	}
+
+	uint64_t plainSize = compressedSize(samples, NULL, false);
+	uint64_t dictSize = compressedSize(samples, &dict, false);
+	uint64_t zstdPlainSize = compressedSize(samples, NULL, true);
+	uint64_t zstdDictSize = compressedSize(samples, &dict, true);
+	fprintf(stdout, "Dictionary id=%08x size=%zu\n", gbdictid((const unsigned char *)dict.data(), dict.size()), dict.size());
+	fprintf(stdout, "zlib compressed size without dictionary: %" PRIu64" bytes\n", plainSize);
+	fprintf(stdout, "zlib compressed size with dictionary:    %" PRIu64" bytes (%.1f%%)\n", dictSize,
+	        plainSize ? 100.0 * dictSize / plainSize : 0.0);
+	fprintf(stdout, "zstd compressed size without dictionary: %" PRIu64" bytes (%.1f%%)\n", zstdPlainSize,
+	        plainSize ? 100.0 * zstdPlainSize / plainSize : 0.0);
+	fprintf(stdout, "zstd compressed size with dictionary:    %" PRIu64" bytes (%.1f%%)\n", zstdDictSize,
+	        plainSize ? 100.0 * zstdDictSize / plainSize : 0.0);
+
+	if (!TitleRecCodec::saveDictionary(outputDir, dict)) {
+		fprintf(stdout, "Unable to save dictionary in %s\n", outputDir);
+		return 1;
+	}
+
+	fprintf(stdout, "Saved %s/titlerec.dict. Copy the titlerec*.dict files to all hosts.\n", outputDir);
+	return 0;
+}